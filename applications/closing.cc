@@ -15,6 +15,8 @@
 #include <irtkDilation.h>
 #include <irtkErosion.h>
 
+#include <irtkBinaryMorphology.h>
+
 char *input_name = NULL, *output_name = NULL;
 
 void usage()
@@ -22,13 +24,15 @@ void usage()
   cerr << "Usage: closing [in] [out] <options>\n";
   cerr << "Where <options> are one or more of the following:\n";
   cerr << "\t<-iterations n>    Number of iterations\n";
+  cerr << "\t<-radius r>        Use a sphere with radius r (in mm) on the binary image\n";
   exit(1);
 }
 
 int main(int argc, char **argv)
 {
   bool ok;
-  int i, iterations;
+  int iterations;
+  double radius;
   irtkGreyImage image;
 
   // Check command line
@@ -49,6 +53,7 @@ int main(int argc, char **argv)
 
   // Parse remaining parameters
   iterations = 1;
+  radius     = 0;
   while (argc > 1) {
     ok = false;
     if ((ok == false) && (strcmp(argv[1], "-iterations") == 0)) {
@@ -59,6 +64,14 @@ int main(int argc, char **argv)
       argv++;
       ok = true;
     }
+    if ((ok == false) && (strcmp(argv[1], "-radius") == 0)) {
+      argc--;
+      argv++;
+      radius = atof(argv[1]);
+      argc--;
+      argv++;
+      ok = true;
+    }
     if (ok == false) {
       cerr << "Unknown option: " << argv[1] << endl;
       usage();
@@ -66,16 +79,21 @@ int main(int argc, char **argv)
   }
 
   cout << "Closing ... "; cout.flush();
-  irtkDilation<irtkGreyPixel> dilation;
-  dilation.SetInput(&image);
-  dilation.SetOutput(&image);
-  irtkErosion<irtkGreyPixel> erosion;
-  erosion.SetInput(&image);
-  erosion.SetOutput(&image);
-  for (i = 0; i < iterations; i++) {
+  if (radius > 0) {
+    irtkBinaryMorphology<irtkGreyPixel> morphology(irtkBinaryMorphology<irtkGreyPixel>::Closing, radius);
+    morphology.SetInput(&image);
+    morphology.SetOutput(&image);
+    morphology.Run();
+  } else {
+    irtkDilation<irtkGreyPixel> dilation;
+    dilation.SetInput(&image);
+    dilation.SetOutput(&image);
+    dilation.SetIterations(iterations);
+    irtkErosion<irtkGreyPixel> erosion;
+    erosion.SetInput(&image);
+    erosion.SetOutput(&image);
+    erosion.SetIterations(iterations);
     dilation.Run();
-  } 
-  for (i = 0; i < iterations; i++) {
     erosion.Run();
   }
   cout << "done" << endl;
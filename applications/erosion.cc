@@ -14,6 +14,8 @@
 
 #include <irtkErosion.h>
 
+#include <irtkBinaryMorphology.h>
+
 char *input_name = NULL, *output_name = NULL;
 
 void usage()
@@ -23,13 +25,15 @@ void usage()
   cerr << "\t<-iterations n>    Number of iterations\n";
   cerr << "\t<-connectivity n>  Type of voxel neighbourhood connectivity. "<< endl;
   cerr << "\t                   Valid choices are 6, 18 or 26 (default)\n";
+  cerr << "\t<-radius r>        Use a sphere with radius r (in mm) on the binary image\n";
   exit(1);
 }
 
 int main(int argc, char **argv)
 {
   bool ok;
-  int i, iterations, connectivity;
+  int iterations, connectivity;
+  double radius;
   irtkGreyImage image;
 
   // Check command line
@@ -52,6 +56,7 @@ int main(int argc, char **argv)
 
   // Parse remaining parameters
   iterations = 1;
+  radius     = 0;
   while (argc > 1) {
     ok = false;
     if ((ok == false) && (strcmp(argv[1], "-iterations") == 0)) {
@@ -70,6 +75,14 @@ int main(int argc, char **argv)
       argv++;
       ok = true;
     }
+    if ((ok == false) && (strcmp(argv[1], "-radius") == 0)) {
+      argc--;
+      argv++;
+      radius = atof(argv[1]);
+      argc--;
+      argv++;
+      ok = true;
+    }
     if (ok == false) {
       cerr << "Unknown option: " << argv[1] << endl;
       usage();
@@ -97,7 +110,15 @@ int main(int argc, char **argv)
 
   erosion.SetInput(&image);
   erosion.SetOutput(&image);
-  for (i = 0; i < iterations; i++) erosion.Run();
+  if (radius > 0) {
+    irtkBinaryMorphology<irtkGreyPixel> morphology(irtkBinaryMorphology<irtkGreyPixel>::Erosion, radius);
+    morphology.SetInput(&image);
+    morphology.SetOutput(&image);
+    morphology.Run();
+  } else {
+    erosion.SetIterations(iterations);
+    erosion.Run();
+  }
   cout << "done" << endl;
 
   // Save result
@@ -12,6 +12,8 @@
 
 #include <irtkImage.h>
 
+#include <irtkTiledImage.h>
+
 #ifdef WIN32
 	#include <math.h>
 	#define isnan(x) _isnan(x)
@@ -24,9 +26,33 @@ void usage()
   cerr << "Options:" << endl;
   cerr << "  -dt <float>      Temporal resolution of sequence." << endl;
   cerr << "  -torigin <float> Temporal origin of sequence." << endl;
+  cerr << endl;
+  cerr << "Sequences in tiled format (.tiled) are written one volume at a time." << endl;
   exit(1);
 }
 
+irtkImage *NewImage(int type, const irtkImageAttributes &attr)
+{
+  switch (type) {
+    case IRTK_VOXEL_CHAR:
+      return new irtkGenericImage<char> (attr);
+    case IRTK_VOXEL_UNSIGNED_CHAR:
+      return new irtkGenericImage<unsigned char> (attr);
+    case IRTK_VOXEL_SHORT:
+      return new irtkGenericImage<short> (attr);
+    case IRTK_VOXEL_UNSIGNED_SHORT:
+      return new irtkGenericImage<unsigned short> (attr);
+    case IRTK_VOXEL_FLOAT:
+      return new irtkGenericImage<float> (attr);
+    case IRTK_VOXEL_DOUBLE:
+      return new irtkGenericImage<double> (attr);
+    default:
+      cerr << "Unknown voxel type for output format" << endl;
+      exit(1);
+  }
+  return NULL;
+}
+
 int main(int argc, char **argv)
 {
   int i, x, y, z, t;
@@ -66,6 +92,55 @@ int main(int argc, char **argv)
     exit(1);
   }
 
+  irtkImageAttributes OutputSeqAttributes = ipt0_at;
+
+  OutputSeqAttributes._t = t;
+  if (!isnan(dt))      OutputSeqAttributes._dt      = dt;
+  if (!isnan(torigin)) OutputSeqAttributes._torigin = torigin;
+
+  // Sequence in tiled format is written volume by volume, only one volume is in memory
+  if (strstr(argv[t+1], ".tiled") != NULL) {
+    irtkTiledImageWriter writer;
+    int type = input[0]->GetScalarType();
+    writer.Open(argv[t+1], OutputSeqAttributes, type);
+    for (i = 0; i < t; i++) {
+      if (i > 0) {
+        cout << "Reading " << argv[i+1] << endl;
+        input[i] = irtkImage::New(argv[i+1]);
+        iptI_at = input[i]->GetImageAttributes();
+        if (iptI_at._t > 1) {
+          cerr << "Input images may not be four-dimensional" << endl;
+          exit(1);
+        }
+        if ((ipt0_at._x!=iptI_at._x)||(ipt0_at._y!=iptI_at._y)||(ipt0_at._z!=iptI_at._z)) {
+          cerr << "Mismatch of volume geometry" << endl;
+          exit(1);
+        }
+      }
+      // Convert volume to voxel type of sequence
+      if (input[i]->GetScalarType() != type) {
+        irtkImage *volume = NewImage(type, input[i]->GetImageAttributes());
+        for (z = 0; z < volume->GetZ(); z++) {
+          for (y = 0; y < volume->GetY(); y++) {
+            for (x = 0; x < volume->GetX(); x++) {
+              volume->PutAsDouble(x, y, z, input[i]->GetAsDouble(x, y, z));
+            }
+          }
+        }
+        delete input[i];
+        input[i] = volume;
+      }
+      cout << "Writing volume " << i+1 << " to " << argv[t+1] << endl;
+      writer.WriteFrames(input[i]);
+      delete input[i];
+    }
+    writer.Close();
+    delete[] input;
+    return 0;
+  }
+
+  // Other formats are written in one go, so the sequence is held in memory
+
   // Read remaining images
   for (i = 1; i < t; i++) {
 
@@ -83,43 +158,8 @@ int main(int argc, char **argv)
     }
   }
 
-  irtkImage          *output              = NULL;
-  irtkImageAttributes OutputSeqAttributes = ipt0_at;
-
-  OutputSeqAttributes._t = t;
-  if (!isnan(dt))      OutputSeqAttributes._dt      = dt;
-  if (!isnan(torigin)) OutputSeqAttributes._torigin = torigin;
-
   // Convert image
-  switch (input[0]->GetScalarType()) {
-    case IRTK_VOXEL_CHAR: {
-        output = new irtkGenericImage<char> (OutputSeqAttributes);
-      }
-      break;
-    case IRTK_VOXEL_UNSIGNED_CHAR: {
-        output = new irtkGenericImage<unsigned char> (OutputSeqAttributes);
-      }
-      break;
-    case IRTK_VOXEL_SHORT: {
-        output = new irtkGenericImage<short> (OutputSeqAttributes);
-      }
-      break;
-    case IRTK_VOXEL_UNSIGNED_SHORT: {
-        output = new irtkGenericImage<unsigned short> (OutputSeqAttributes);
-      }
-      break;
-    case IRTK_VOXEL_FLOAT: {
-        output = new irtkGenericImage<float> (OutputSeqAttributes);
-        break;
-      }
-    case IRTK_VOXEL_DOUBLE: {
-        output = new irtkGenericImage<double> (OutputSeqAttributes);
-        break;
-      }
-    default:
-      cerr << "Unknown voxel type for output format" << endl;
-      exit(1);
-  }
+  irtkImage *output = NewImage(input[0]->GetScalarType(), OutputSeqAttributes);
 
   cout << "Inserting volumes into sequence" << endl;
   for (i = 0; i < t; i++) {
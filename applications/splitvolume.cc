@@ -12,6 +12,8 @@ Changes   : $Author$
 
 #include <irtkImage.h>
 
+#include <irtkTiledImage.h>
+
 #ifdef USE_VXL
 // need to include vxl here
 #else
@@ -25,12 +27,13 @@ void usage()
 	cerr << "Options : -ref [reference] use reference's orientation and origin" <<endl;
 	cerr << "Options : -sequence split the volume into independent time frames" <<endl;
 	cerr << "Options : -slice split the volume into independent slices (each slice can have a number of time frames)" <<endl;
+	cerr << "Input in tiled format is read one frame (or one slice of all frames) at a time" <<endl;
 	exit(1);
 }
 
 int main(int argc, char **argv)
 {
-	int t,x,y,z,ok;
+	int t,x,y,z,ok,frames;
 	int subaverage = 0;
 	int sequenceonly = 0;
 	int sliceonly = 0;
@@ -40,7 +43,20 @@ int main(int argc, char **argv)
 		usage();
 	}
 	char *output = NULL;
-	irtkGreyImage *image = new irtkGreyImage(argv[1]);
+	// Series in tiled format are read frame by frame, the first frame gives the geometry
+	irtkTiledImageReader *reader = NULL;
+	irtkGreyImage *image = NULL;
+	if (irtkTiledImageReader::CheckHeader(argv[1])) {
+		reader = new irtkTiledImageReader;
+		reader->Open(argv[1]);
+		frames = reader->GetImageAttributes()._t;
+		image = new irtkGreyImage;
+		reader->ReadFrame(*image, 0);
+	} else {
+		image = new irtkGreyImage(argv[1]);
+		frames = image->GetT();
+	}
+	irtkGreyImage *data = image, buffer;
 	argc--;
 	argv++;
 	output = argv[1];
@@ -95,17 +111,24 @@ int main(int argc, char **argv)
 						attr._y = attrt._y; attr._z = 1;
 					}else{
 						attr = image->GetImageAttributes();
-						attr._z = 1;
+						attr._z = 1; attr._t = frames;
 					}
 					image->WorldToImage(attr._xorigin,attr._yorigin,attr._zorigin);
 					attr._zorigin = attr._zorigin - image->GetZ() / 2.0 + 0.5 + z;
 					image->ImageToWorld(attr._xorigin,attr._yorigin,attr._zorigin);
 					irtkGreyImage *target = new irtkGreyImage(attr);
 					target->PutOrigin(attr._xorigin,attr._yorigin,attr._zorigin);
-					for (t = 0; t < image->GetT(); t++) {
+					// slice z of all frames
+					int dz = z;
+					if (reader != NULL) {
+						reader->Read(buffer, 0, 0, z, 0, image->GetX(), image->GetY(), z+1, frames);
+						data = &buffer;
+						dz = 0;
+					}
+					for (t = 0; t < frames; t++) {
 						for (y = 0; y < target->GetY(); y++) {
 							for (x = 0; x < target->GetX(); x++) {
-								target->Put(x, y, 0, t, image->Get(x, y, z, t));
+								target->Put(x, y, 0, t, data->Get(x, y, dz, t));
 							}
 						}
 					}
@@ -127,10 +150,17 @@ int main(int argc, char **argv)
 					delete target;
 				}
 	}else{
-		for (t = 0; t < image->GetT(); t++) {
+		for (t = 0; t < frames; t++) {
 			// Combine images
 			irtkImageAttributes attr;
 			irtkImageAttributes attrt;
+			// frame t
+			int dt = t;
+			if (reader != NULL) {
+				reader->ReadFrame(buffer, t);
+				data = &buffer;
+				dt = 0;
+			}
 			if(sequenceonly){
 				if(ref != NULL){
 					attr = ref->GetImageAttributes();
@@ -145,13 +175,7 @@ int main(int argc, char **argv)
 				}
 				irtkGreyImage *target = new irtkGreyImage(attr);
 
-				for (z = 0; z < target->GetZ(); z++) {
-					for (y = 0; y < target->GetY(); y++) {
-						for (x = 0; x < target->GetX(); x++) {
-							target->Put(x, y, z, 0, image->Get(x, y, z, t));
-						}
-					}
-				}
+				data->GetFrameView(dt).CopyTo(target->GetPointerToVoxels());
 				if ( subaverage){
 					int average = target->GetAverage();
 					for (z = 0; z < target->GetZ(); z++) {
@@ -190,11 +214,7 @@ int main(int argc, char **argv)
 					image->ImageToWorld(attr._xorigin,attr._yorigin,attr._zorigin);
 					irtkGreyImage *target = new irtkGreyImage(attr);
 					target->PutOrigin(attr._xorigin,attr._yorigin,attr._zorigin);
-					for (y = 0; y < target->GetY(); y++) {
-						for (x = 0; x < target->GetX(); x++) {
-							target->Put(x, y, 0, 0, image->Get(x, y, z, t));
-						}
-					}
+					data->GetRegionView(0, 0, z, dt, image->GetX(), image->GetY(), z+1, dt+1).CopyTo(target->GetPointerToVoxels());
 					if ( subaverage){
 						int average = target->GetAverage();
 						for (y = 0; y < target->GetY(); y++) {
@@ -215,5 +235,9 @@ int main(int argc, char **argv)
 		}
 	}
 	delete image;
+	if (reader != NULL) {
+		reader->Close();
+		delete reader;
+	}
 }
 
@@ -16,6 +16,90 @@
 
 #include <irtkCommon.h>
 
+/**
+ * Abstract allocator of large data blocks such as the voxels of an image
+ *
+ * Blocks should be aligned to 64 bytes. A different allocator, for example
+ * one drawing blocks from a pool, can be installed with SetDataAllocator().
+ * Every block is returned to the allocator which provided it.
+ */
+
+class irtkDataAllocator
+{
+public:
+
+  /// Destructor
+  virtual ~irtkDataAllocator() {}
+
+  /// Allocate block of given size in bytes
+  virtual void *Allocate(size_t) = 0;
+
+  /// Release block of given size in bytes
+  virtual void Deallocate(void *, size_t) = 0;
+
+};
+
+/**
+ * Default allocator of data blocks
+ *
+ * Blocks are aligned to 64 bytes, i.e. a cache line. Blocks of several
+ * megabytes are aligned to 2 MB so that they can be backed by huge pages.
+ */
+
+class irtkAlignedDataAllocator : public irtkDataAllocator
+{
+public:
+
+  /// Allocate block of given size in bytes
+  virtual void *Allocate(size_t);
+
+  /// Release block of given size in bytes
+  virtual void Deallocate(void *, size_t);
+
+};
+
+/**
+ * Allocator of data blocks mapped from files
+ *
+ * Map() maps part of a file copy-on-write: the block can be modified but
+ * changes never reach the file, and pages are only read from the file when
+ * first accessed. Blocks are aligned like their offset in the file. Blocks
+ * requested with Allocate() come from the default allocator, so that an
+ * image whose voxels were mapped can still reallocate them.
+ *
+ * Writers of this library call Detach() before overwriting a file, which
+ * only protects the mappings of the current process. Pages not yet accessed
+ * still change if another process rewrites the file, and accessing them
+ * raises SIGBUS if it truncates the file.
+ */
+
+class irtkMappedFileAllocator : public irtkDataAllocator
+{
+public:
+
+  /// Map given number of bytes of file from offset. Returns NULL if the file cannot be mapped
+  void *Map(const char *, size_t, size_t);
+
+  /// Replace all mappings of file by private copies of their contents
+  void Detach(const char *);
+
+  /// Allocate block of given size in bytes from the default allocator
+  virtual void *Allocate(size_t);
+
+  /// Release mapped block or block of the default allocator
+  virtual void Deallocate(void *, size_t);
+
+};
+
+/// Returns allocator of data blocks mapped from files
+irtkMappedFileAllocator *GetMappedFileAllocator();
+
+/// Install allocator used for new data blocks (NULL restores the default)
+void SetDataAllocator(irtkDataAllocator *);
+
+/// Returns allocator used for new data blocks
+irtkDataAllocator *GetDataAllocator();
+
 /// Allocate 1-dimensional array and initialize elements
 ///
 /// @code
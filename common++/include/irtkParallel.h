@@ -136,6 +136,11 @@ using namespace tbb;
     body(range);
   }
 
+  template <class Range, class Body>
+  void parallel_deterministic_reduce(const Range &range, Body &body) {
+    body(range);
+  }
+
   struct split {};
 #endif
 
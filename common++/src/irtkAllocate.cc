@@ -0,0 +1,221 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#include <irtkCommon.h>
+
+#include <sstream>
+#include <map>
+
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Alignment of all data blocks
+static const size_t _DataAlignment = 64;
+
+// Alignment of large data blocks, i.e. the size of a huge page
+static const size_t _DataHugePage = 2 * 1024 * 1024;
+
+// Size of the pieces in which mappings are replaced by private copies
+static const size_t _DataDetachChunk = 1024 * 1024;
+
+// Default allocator and allocator used for new data blocks
+static irtkAlignedDataAllocator _DefaultDataAllocator;
+static irtkDataAllocator *_CurrentDataAllocator = &_DefaultDataAllocator;
+
+// Allocator of blocks mapped from files
+static irtkMappedFileAllocator _MappedFileAllocator;
+
+#ifndef WIN32
+
+/// Mapping of part of a file
+struct irtkFileMapping {
+
+  /// Start and length of mapping, which starts at a page boundary
+  char *_Base;
+  size_t _Length;
+
+  /// File which is mapped, zero once the mapping has been detached
+  dev_t _Device;
+  ino_t _Inode;
+};
+
+// Mappings indexed by the block returned to the caller
+static std::map<void *, irtkFileMapping> _FileMappings;
+
+#ifdef HAS_TBB
+static mutex _FileMappingsMutex;
+#endif
+
+#endif
+
+void *irtkAlignedDataAllocator::Allocate(size_t n)
+{
+  void *p;
+  size_t alignment;
+
+  alignment = (n >= 2 * _DataHugePage) ? _DataHugePage : _DataAlignment;
+  if (n == 0) n = 1;
+
+#ifdef WIN32
+  p = _aligned_malloc(n, alignment);
+#else
+  if (posix_memalign(&p, alignment, n) != 0) p = NULL;
+#endif
+
+  if (p == NULL) {
+    stringstream msg;
+    msg << "irtkAlignedDataAllocator::Allocate: malloc failed for " << n << " bytes\n";
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+
+#if defined(MADV_HUGEPAGE)
+  if (alignment == _DataHugePage) madvise(p, n, MADV_HUGEPAGE);
+#endif
+
+  return p;
+}
+
+void irtkAlignedDataAllocator::Deallocate(void *p, size_t)
+{
+#ifdef WIN32
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+}
+
+void *irtkMappedFileAllocator::Map(const char *filename, size_t offset, size_t n)
+{
+#ifndef WIN32
+  int fd;
+  size_t page, start;
+  struct stat buf;
+  irtkFileMapping mapping;
+  void *base;
+
+  if (n == 0) return NULL;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) return NULL;
+  if ((fstat(fd, &buf) != 0) || (size_t(buf.st_size) < offset + n)) {
+    close(fd);
+    return NULL;
+  }
+
+  // Mappings have to start at a page boundary
+  page  = sysconf(_SC_PAGESIZE);
+  start = (offset / page) * page;
+
+  mapping._Length = offset - start + n;
+  base = mmap(NULL, mapping._Length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, start);
+  close(fd);
+  if (base == MAP_FAILED) return NULL;
+
+  mapping._Base   = static_cast<char *>(base);
+  mapping._Device = buf.st_dev;
+  mapping._Inode  = buf.st_ino;
+
+#ifdef HAS_TBB
+  mutex::scoped_lock lock(_FileMappingsMutex);
+#endif
+  _FileMappings[mapping._Base + (offset - start)] = mapping;
+
+  return mapping._Base + (offset - start);
+#else
+  return NULL;
+#endif
+}
+
+void irtkMappedFileAllocator::Detach(const char *filename)
+{
+#ifndef WIN32
+  size_t i, n;
+  struct stat buf;
+  std::map<void *, irtkFileMapping>::iterator it;
+  char *copy;
+
+  if (stat(filename, &buf) != 0) return;
+
+#ifdef HAS_TBB
+  mutex::scoped_lock lock(_FileMappingsMutex);
+#endif
+  copy = NULL;
+  for (it = _FileMappings.begin(); it != _FileMappings.end(); ++it) {
+    irtkFileMapping &mapping = it->second;
+    if ((mapping._Device != buf.st_dev) || (mapping._Inode != buf.st_ino)) continue;
+
+    // Replace mapping piece by piece with anonymous memory holding the same
+    // contents, keeping its address
+    if (copy == NULL) copy = new char[_DataDetachChunk];
+    for (i = 0; i < mapping._Length; i += _DataDetachChunk) {
+      n = (mapping._Length - i < _DataDetachChunk) ? mapping._Length - i : _DataDetachChunk;
+      memcpy(copy, mapping._Base + i, n);
+      if (mmap(mapping._Base + i, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        stringstream msg;
+        msg << "irtkMappedFileAllocator::Detach: mmap failed for " << n << " bytes\n";
+        cerr << msg.str();
+        throw irtkException(msg.str(), __FILE__, __LINE__);
+      }
+      memcpy(mapping._Base + i, copy, n);
+    }
+    mapping._Device = 0;
+    mapping._Inode  = 0;
+  }
+  delete []copy;
+#endif
+}
+
+void *irtkMappedFileAllocator::Allocate(size_t n)
+{
+  return _DefaultDataAllocator.Allocate(n);
+}
+
+void irtkMappedFileAllocator::Deallocate(void *p, size_t n)
+{
+#ifndef WIN32
+  std::map<void *, irtkFileMapping>::iterator it;
+
+  {
+#ifdef HAS_TBB
+    mutex::scoped_lock lock(_FileMappingsMutex);
+#endif
+    it = _FileMappings.find(p);
+    if (it != _FileMappings.end()) {
+      munmap(it->second._Base, it->second._Length);
+      _FileMappings.erase(it);
+      return;
+    }
+  }
+#endif
+  _DefaultDataAllocator.Deallocate(p, n);
+}
+
+irtkMappedFileAllocator *GetMappedFileAllocator()
+{
+  return &_MappedFileAllocator;
+}
+
+void SetDataAllocator(irtkDataAllocator *allocator)
+{
+  _CurrentDataAllocator = (allocator != NULL) ? allocator : &_DefaultDataAllocator;
+}
+
+irtkDataAllocator *GetDataAllocator()
+{
+  return _CurrentDataAllocator;
+}
@@ -0,0 +1,85 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKBINARYMORPHOLOGY_H
+
+#define _IRTKBINARYMORPHOLOGY_H
+
+#include <irtkImageToImage.h>
+
+/**
+ * Class for morphology of binary images with a spherical structuring element
+ *
+ * Voxels with a value greater than zero are foreground. The structuring
+ * element is a sphere whose radius is given in mm, so anisotropic voxels are
+ * handled correctly. Instead of iterating over the neighbourhood of each
+ * voxel the filter thresholds the exact Euclidean distance transform of the
+ * mask (dilation) or of its complement (erosion), which costs the same
+ * whatever the radius. Voxels outside of the image are not background, i.e.
+ * erosion does not shrink the mask from the image boundary. The output is
+ * zero for background and one for foreground.
+ */
+
+template <class VoxelType> class irtkBinaryMorphology : public irtkImageToImage<VoxelType>
+{
+
+public:
+
+  /// Morphological operation
+  enum irtkBinaryMorphologyOperation { Dilation, Erosion, Opening, Closing };
+
+protected:
+
+  /// Morphological operation
+  irtkBinaryMorphologyOperation _Operation;
+
+  /// Radius of the structuring element in mm
+  double _Radius;
+
+  /// Dilate binary mask in place
+  void Dilate(irtkRealImage &);
+
+  /// Erode binary mask in place
+  void Erode(irtkRealImage &);
+
+  /// Returns whether the filter requires buffering
+  virtual bool RequiresBuffering();
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass();
+
+public:
+
+  /// Constructor
+  irtkBinaryMorphology(irtkBinaryMorphologyOperation = Dilation, double = 1);
+
+  /// Destructor
+  ~irtkBinaryMorphology();
+
+  /// Set morphological operation
+  SetMacro(Operation, irtkBinaryMorphologyOperation);
+
+  /// Get morphological operation
+  GetMacro(Operation, irtkBinaryMorphologyOperation);
+
+  /// Set radius in mm
+  SetMacro(Radius, double);
+
+  /// Get radius in mm
+  GetMacro(Radius, double);
+
+  /// Run filter
+  virtual void Run();
+
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#include <irtkImage.h>
+
+#include <irtkBinaryMorphology.h>
+
+#include <irtkEuclideanDistanceTransform.h>
+
+// Tolerance for voxels exactly on the surface of the sphere
+static const double _BinaryMorphologyTolerance = 1e-4;
+
+template <class VoxelType> irtkBinaryMorphology<VoxelType>::irtkBinaryMorphology(irtkBinaryMorphologyOperation operation, double radius)
+{
+  _Operation = operation;
+  _Radius    = radius;
+}
+
+template <class VoxelType> irtkBinaryMorphology<VoxelType>::~irtkBinaryMorphology(void)
+{
+}
+
+template <class VoxelType> bool irtkBinaryMorphology<VoxelType>::RequiresBuffering(void)
+{
+  return false;
+}
+
+template <class VoxelType> const char *irtkBinaryMorphology<VoxelType>::NameOfClass()
+{
+  return "irtkBinaryMorphology";
+}
+
+template <class VoxelType> void irtkBinaryMorphology<VoxelType>::Dilate(irtkRealImage &mask)
+{
+  int i, n;
+  double r2;
+  irtkRealImage distance;
+  irtkRealPixel *ptr, *dist;
+
+  // Squared distance to the closest foreground voxel
+  irtkEuclideanDistanceTransform<irtkRealPixel> edt((mask.GetZ() > 1) ?
+      irtkEuclideanDistanceTransform<irtkRealPixel>::irtkDistanceTransform3D :
+      irtkEuclideanDistanceTransform<irtkRealPixel>::irtkDistanceTransform2D);
+  edt.SetInput (&mask);
+  edt.SetOutput(&distance);
+  edt.Run();
+
+  r2   = _Radius * _Radius * (1 + _BinaryMorphologyTolerance);
+  n    = mask.GetNumberOfVoxels();
+  ptr  = mask.GetPointerToVoxels();
+  dist = distance.GetPointerToVoxels();
+  for (i = 0; i < n; i++) {
+    ptr[i] = (dist[i] <= r2) ? 1 : 0;
+  }
+}
+
+template <class VoxelType> void irtkBinaryMorphology<VoxelType>::Erode(irtkRealImage &mask)
+{
+  int i, n;
+  irtkRealPixel *ptr;
+
+  // Erosion is the complement of the dilation of the complement
+  n   = mask.GetNumberOfVoxels();
+  ptr = mask.GetPointerToVoxels();
+  for (i = 0; i < n; i++) ptr[i] = 1 - ptr[i];
+  this->Dilate(mask);
+  for (i = 0; i < n; i++) ptr[i] = 1 - ptr[i];
+}
+
+template <class VoxelType> void irtkBinaryMorphology<VoxelType>::Run()
+{
+  int i, n;
+  VoxelType *in, *out;
+  irtkRealPixel *ptr;
+
+  // Do the initial set up
+  this->Initialize();
+
+  // Binary mask of foreground voxels
+  irtkRealImage mask(this->_input->GetImageAttributes());
+  n   = this->_input->GetNumberOfVoxels();
+  in  = this->_input->GetPointerToVoxels();
+  ptr = mask.GetPointerToVoxels();
+  for (i = 0; i < n; i++) {
+    ptr[i] = (in[i] > 0) ? 1 : 0;
+  }
+
+  switch (_Operation) {
+  case Dilation:
+    this->Dilate(mask);
+    break;
+  case Erosion:
+    this->Erode(mask);
+    break;
+  case Opening:
+    this->Erode(mask);
+    this->Dilate(mask);
+    break;
+  case Closing:
+    this->Dilate(mask);
+    this->Erode(mask);
+    break;
+  default:
+    cerr << "irtkBinaryMorphology<VoxelType>::Run(): Unknown operation" << endl;
+    exit(1);
+  }
+
+  out = this->_output->GetPointerToVoxels();
+  for (i = 0; i < n; i++) {
+    out[i] = static_cast<VoxelType>(ptr[i]);
+  }
+
+  // Do the final cleaning up
+  this->Finalize();
+}
+
+template class irtkBinaryMorphology<irtkBytePixel>;
+template class irtkBinaryMorphology<irtkGreyPixel>;
+template class irtkBinaryMorphology<irtkRealPixel>;
@@ -26,6 +26,9 @@
 #include <irtkVector.h>
 #include <irtkMatrix.h>
 
+// Eigen-decomposition of symmetric 3x3 matrices
+#include <irtkSymmetricEigen3x3.h>
+
 // Points and point sets
 #include <irtkPoint.h>
 #include <irtkPointSet.h>
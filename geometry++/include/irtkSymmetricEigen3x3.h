@@ -0,0 +1,45 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKSYMMETRICEIGEN3X3_H
+
+#define _IRTKSYMMETRICEIGEN3X3_H
+
+/**
+ * Eigen-decomposition of symmetric 3x3 matrices such as Hessians and
+ * diffusion tensors.
+ *
+ * A matrix is given by its six distinct entries in the order xx, xy, xz, yy,
+ * yz and zz. The eigenvalues are computed in closed form from the roots of
+ * the characteristic polynomial (trigonometric solution of the cubic) and
+ * are returned in order of increasing magnitude, i.e. |e[0]| <= |e[1]| <=
+ * |e[2]|. The eigenvectors are cross products of rows of A - eI; if two
+ * eigenvalues are too close for these to be accurate, the decomposition
+ * falls back to Jacobi rotations. The batch function takes the entries of
+ * n matrices as six separate arrays and writes three arrays of eigenvalues.
+ */
+
+/// Eigenvalues of a symmetric 3x3 matrix in order of increasing magnitude
+void irtkSymmetricEigenvalues3x3(const double m[6], double e[3]);
+
+/// Eigenvalues of n symmetric 3x3 matrices stored as arrays of xx, xy, xz, yy, yz and zz
+void irtkSymmetricEigenvalues3x3(int n, const double *xx, const double *xy, const double *xz,
+                                 const double *yy, const double *yz, const double *zz,
+                                 double *e1, double *e2, double *e3);
+
+/// Eigenvalues and unit eigenvectors (v[i] belongs to e[i]) of a symmetric 3x3 matrix
+void irtkSymmetricEigen3x3(const double m[6], double e[3], double v[3][3]);
+
+/// Eigenvalues and unit eigenvectors of a symmetric 3x3 matrix by Jacobi rotations
+void irtkSymmetricEigen3x3Jacobi(const double m[6], double e[3], double v[3][3]);
+
+#endif
@@ -0,0 +1,182 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#include <irtkGeometry.h>
+
+#include <irtkSymmetricEigen3x3.h>
+
+// Relative gap between eigenvalues below which eigenvectors use Jacobi rotations
+static const double _SymmetricEigen3x3Gap = 1e-6;
+
+// Off-diagonal magnitude relative to the diagonal at which Jacobi sweeps stop
+static const double _SymmetricEigen3x3Epsilon = 1e-16;
+
+// Maximum number of Jacobi sweeps
+static const int _SymmetricEigen3x3Sweeps = 50;
+
+/// Sort eigenvalues (and eigenvectors) by increasing magnitude
+static inline void irtkSortEigen3x3(double e[3], double v[3][3])
+{
+  int i, j, k;
+  double tmp;
+
+  for (i = 1; i < 3; i++) {
+    for (j = i; (j > 0) && (fabs(e[j-1]) > fabs(e[j])); j--) {
+      tmp = e[j-1], e[j-1] = e[j], e[j] = tmp;
+      if (v != NULL) {
+        for (k = 0; k < 3; k++) tmp = v[j-1][k], v[j-1][k] = v[j][k], v[j][k] = tmp;
+      }
+    }
+  }
+}
+
+/// Roots of the characteristic polynomial, unsorted
+static inline void irtkEigenvalues3x3(double xx, double xy, double xz, double yy, double yz, double zz, double e[3])
+{
+  double p, q, r, p1, p2, bxx, byy, bzz, phi;
+
+  p1 = xy * xy + xz * xz + yz * yz;
+  q  = (xx + yy + zz) / 3.0;
+  bxx = xx - q;
+  byy = yy - q;
+  bzz = zz - q;
+  p2 = bxx * bxx + byy * byy + bzz * bzz + 2.0 * p1;
+  if (p2 == 0) {
+    e[0] = e[1] = e[2] = q;
+    return;
+  }
+  p = sqrt(p2 / 6.0);
+
+  // Half the determinant of (A - qI) / p lies in [-1, 1]
+  r = (bxx * (byy * bzz - yz * yz) - xy * (xy * bzz - yz * xz) + xz * (xy * yz - byy * xz)) / (2.0 * p * p * p);
+  if (r < -1) r = -1;
+  if (r >  1) r =  1;
+  phi = acos(r) / 3.0;
+
+  e[0] = q + 2.0 * p * cos(phi);
+  e[2] = q + 2.0 * p * cos(phi + 2.0 * M_PI / 3.0);
+  e[1] = 3.0 * q - e[0] - e[2];
+}
+
+void irtkSymmetricEigenvalues3x3(const double m[6], double e[3])
+{
+  irtkEigenvalues3x3(m[0], m[1], m[2], m[3], m[4], m[5], e);
+  irtkSortEigen3x3(e, NULL);
+}
+
+void irtkSymmetricEigenvalues3x3(int n, const double *xx, const double *xy, const double *xz,
+                                 const double *yy, const double *yz, const double *zz,
+                                 double *e1, double *e2, double *e3)
+{
+  int i;
+  double e[3];
+
+  for (i = 0; i < n; i++) {
+    irtkEigenvalues3x3(xx[i], xy[i], xz[i], yy[i], yz[i], zz[i], e);
+    irtkSortEigen3x3(e, NULL);
+    e1[i] = e[0];
+    e2[i] = e[1];
+    e3[i] = e[2];
+  }
+}
+
+void irtkSymmetricEigen3x3(const double m[6], double e[3], double v[3][3])
+{
+  int i, j, k;
+  double norm, best, length, scale, r[3][3], c[3];
+
+  irtkEigenvalues3x3(m[0], m[1], m[2], m[3], m[4], m[5], e);
+
+  // Cross products of rows lose accuracy if eigenvalues are close
+  scale = fabs(e[0]) + fabs(e[1]) + fabs(e[2]);
+  if ((fabs(e[0] - e[1]) <= _SymmetricEigen3x3Gap * scale) ||
+      (fabs(e[0] - e[2]) <= _SymmetricEigen3x3Gap * scale) ||
+      (fabs(e[1] - e[2]) <= _SymmetricEigen3x3Gap * scale)) {
+    irtkSymmetricEigen3x3Jacobi(m, e, v);
+    return;
+  }
+
+  for (i = 0; i < 3; i++) {
+    r[0][0] = m[0] - e[i], r[0][1] = m[1],        r[0][2] = m[2];
+    r[1][0] = m[1],        r[1][1] = m[3] - e[i], r[1][2] = m[4];
+    r[2][0] = m[2],        r[2][1] = m[4],        r[2][2] = m[5] - e[i];
+
+    // Longest cross product of two rows is orthogonal to the row space
+    best = -1;
+    for (j = 0; j < 3; j++) {
+      k = (j + 1) % 3;
+      c[0] = r[j][1] * r[k][2] - r[j][2] * r[k][1];
+      c[1] = r[j][2] * r[k][0] - r[j][0] * r[k][2];
+      c[2] = r[j][0] * r[k][1] - r[j][1] * r[k][0];
+      norm = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+      if (norm > best) {
+        best = norm;
+        v[i][0] = c[0], v[i][1] = c[1], v[i][2] = c[2];
+      }
+    }
+    length = sqrt(best);
+    for (j = 0; j < 3; j++) v[i][j] /= length;
+  }
+
+  irtkSortEigen3x3(e, v);
+}
+
+void irtkSymmetricEigen3x3Jacobi(const double m[6], double e[3], double v[3][3])
+{
+  int i, j, k, p, q, sweep;
+  double a[3][3], off, theta, t, c, s, tau, apq, tmp;
+
+  a[0][0] = m[0], a[0][1] = m[1], a[0][2] = m[2];
+  a[1][0] = m[1], a[1][1] = m[3], a[1][2] = m[4];
+  a[2][0] = m[2], a[2][1] = m[4], a[2][2] = m[5];
+  for (i = 0; i < 3; i++) {
+    for (j = 0; j < 3; j++) v[i][j] = (i == j) ? 1 : 0;
+  }
+
+  for (sweep = 0; sweep < _SymmetricEigen3x3Sweeps; sweep++) {
+    off = fabs(a[0][1]) + fabs(a[0][2]) + fabs(a[1][2]);
+    if (off <= _SymmetricEigen3x3Epsilon * (fabs(a[0][0]) + fabs(a[1][1]) + fabs(a[2][2]))) break;
+    for (p = 0; p < 2; p++) {
+      for (q = p + 1; q < 3; q++) {
+        apq = a[p][q];
+        if (apq == 0) continue;
+
+        // Rotation which annihilates a[p][q]
+        theta = (a[q][q] - a[p][p]) / (2.0 * apq);
+        t     = ((theta >= 0) ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+        c     = 1.0 / sqrt(t * t + 1.0);
+        s     = t * c;
+        tau   = s / (1.0 + c);
+
+        a[p][p] -= t * apq;
+        a[q][q] += t * apq;
+        a[p][q] = a[q][p] = 0;
+        for (k = 0; k < 3; k++) {
+          if ((k == p) || (k == q)) continue;
+          tmp     = a[k][p];
+          a[k][p] = a[p][k] = tmp - s * (a[k][q] + tau * tmp);
+          a[k][q] = a[q][k] = a[k][q] + s * (tmp - tau * a[k][q]);
+        }
+
+        // Rows of v are the eigenvectors
+        for (k = 0; k < 3; k++) {
+          tmp     = v[p][k];
+          v[p][k] = tmp - s * (v[q][k] + tau * tmp);
+          v[q][k] = v[q][k] + s * (tmp - tau * v[q][k]);
+        }
+      }
+    }
+  }
+
+  for (i = 0; i < 3; i++) e[i] = a[i][i];
+  irtkSortEigen3x3(e, v);
+}
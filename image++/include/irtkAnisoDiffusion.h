@@ -10,13 +10,75 @@
 
 #include <irtkImageToImage.h>
 
+#include <vector>
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedAnisoDiffusion;
+
+#endif
+
 /**
  * Class for anisotopic diffusion filtering
+ *
+ * The semi implicit schemes work on padded float copies of the image. Each
+ * ADI step solves the tridiagonal systems of all lines along one axis,
+ * several neighbouring lines at once with their coefficients interleaved,
+ * and the lines are distributed over threads. Alternatively each virtual
+ * time step can solve the fully coupled implicit system with conjugate
+ * gradients preconditioned by its diagonal.
  */
 
 template <class VoxelType> class anisoDiffusion : public irtkImageToImage<VoxelType>
 {
+
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedAnisoDiffusion<VoxelType>;
+
+#endif
+
 protected:
+
+  /// Operations of the semi implicit schemes distributed over threads
+  enum Operation { ADILines, CGDiffusivity, CGStart, CGProduct, CGUpdate, CGDirection };
+
+  /// Dimensions of the padded work images (x, y, z and t)
+  int _NB[4];
+
+  /// Number of axes along which the image is diffused
+  int _NumberOfAxes;
+
+  /// Work images read and written by the current step
+  float *_Source, *_Destination;
+
+  /// Axis of the current ADI step
+  int _Axis;
+
+  /// Diffusivities along each axis, diagonal, residual, search direction, preconditioned residual and product of the coupled system
+  std::vector<float> _Diffusivity[4], _Diagonal, _Residual, _Direction, _Preconditioned, _Product;
+
+  /// Partial sums of the conjugate gradients for each plane
+  std::vector<double> _Sum[3];
+
+  /// Step lengths of the conjugate gradients
+  double _Alpha, _Beta;
+
+  /// Copy frame t of the input, or all frames if t is negative, into a padded work image
+  void Pad(float *, int);
+
+  /// Apply operation to lines or planes i1 to i2-1
+  void Process(int, int, int);
+
+  /// Apply operation to n lines or planes, in parallel if possible
+  void Parallel(int, int);
+
+  /// Diffuse padded work image with the semi implicit scheme, returns the buffer holding the result
+  float *Diffuse(float *, float *);
+
+  /// Solve fully coupled implicit system of one virtual time step
+  void ConjugateGradientStep();
+
   /// Returns whether the filter requires buffering
   virtual bool RequiresBuffering();
 
@@ -52,6 +114,9 @@ public:
   int ITERATIONS_NB; //number of virtual time iterations 
   bool TimeDependent;  //1 -> anisotrop filtering along the time / 0 -> otherwise
   bool SemiImplicit; //1 -> The scheme will be semi implicit (ADI) / 0 -> explicit scheme
+  bool ConjugateGradient; //1 -> semi implicit time steps solve the fully coupled system by conjugate gradients / 0 -> ADI
+  int CG_ITERATIONS_NB; //maximum number of conjugate gradient iterations per virtual time step
+  float CG_TOLERANCE; //relative residual at which the conjugate gradients stop
 };
 
 
@@ -14,6 +14,44 @@
 
 #define _IRTKBSPLINEINTERPOLATEIMAGEFUNCTION_H
 
+#ifdef HAS_TBB
+
+class irtkMultiThreadedBSplineCoefficients;
+
+#endif
+
+/**
+ * B-spline coefficients of an image
+ *
+ * The coefficients are shared read-only by all B-spline interpolators of the
+ * same image and spline degree. They are identified by the voxel buffer,
+ * attributes and voxel type of the image together with a checksum of its
+ * voxels, so that any change of the image leads to new coefficients.
+ */
+
+struct irtkBSplineCoefficients {
+
+  /// Voxel buffer, attributes and voxel type of the image
+  const void *_Data;
+  irtkImageAttributes _Attributes;
+  int _Type;
+
+  /// Degree of spline
+  int _SplineDegree;
+
+  /// Checksum of the voxels of the image
+  unsigned long long _Checksum;
+
+  /// Number of interpolators using the coefficients
+  int _References;
+
+  /// Min and max values of the image
+  double _Min, _Max;
+
+  /// Image of spline coefficients
+  irtkRealImage _Coefficients;
+};
+
 /**
  * Class for B-spline interpolation of images
  *
@@ -24,11 +62,20 @@
  * M. Unser, "Splines: A Perfect Fit for Signal and Image Processing," IEEE
  * Signal Processing Magazine, vol. 16, no. 6, pp. 22-38, November 1999.
  *
+ * The prefiltered coefficients are computed in parallel and cached, so that
+ * interpolators of an unchanged image share them instead of prefiltering the
+ * image again.
  */
 
 class irtkBSplineInterpolateImageFunction : public irtkInterpolateImageFunction
 {
 
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedBSplineCoefficients;
+
+#endif
+
 private:
 
   /// Degree of spline
@@ -55,8 +102,11 @@ private:
   /// Dimension of input image in Z-direction minus spline degree
   int _zhalf;
 
-  /// Image of spline coefficient
-  irtkRealImage _coeff;
+  /// Spline coefficients used by the interpolator
+  irtkBSplineCoefficients *_Coefficients;
+
+  /// Image of spline coefficients
+  const irtkRealImage *_coeff;
 
   /// Initialize anti-causal coefficients
   static double InitialAntiCausalCoefficient(double *, int, double z);
@@ -67,8 +117,18 @@ private:
   /// Convert voxel values to B-spline coefficients
   static void ConvertToInterpolationCoefficients(double *, int, double *, int, double);
 
-  /// Compute B-spline coefficients
-  void ComputeCoefficients();
+  /// Compute B-spline coefficients of planes p1 to p2-1 along one axis
+  static void ComputeCoefficients(irtkBaseImage *, irtkRealImage &, int, int, int, int);
+
+  /// Compute B-spline coefficients of image
+  static void ComputeCoefficients(irtkBaseImage *, irtkRealImage &, int);
+
+  /// Checksum of the voxels of an image
+  static unsigned long long Checksum(irtkBaseImage *);
+
+  /// Not copyable
+  irtkBSplineInterpolateImageFunction(const irtkBSplineInterpolateImageFunction &);
+  void operator=(const irtkBSplineInterpolateImageFunction &);
 
 public:
 
@@ -90,6 +150,15 @@ public:
   /// Gets the spline degree
   virtual int GetSplineDegree();
 
+  /// Returns coefficients of image for spline degree, computing them unless they are cached
+  static irtkBSplineCoefficients *AcquireCoefficients(irtkBaseImage *, int);
+
+  /// Releases coefficients returned by AcquireCoefficients
+  static void ReleaseCoefficients(irtkBSplineCoefficients *);
+
+  /// Deletes all cached coefficients which are not used by any interpolator
+  static void ClearCoefficients();
+
   /// Evaluate the filter at an arbitrary image location (in pixels)
   virtual double Evaluate(double, double, double, double = 0);
 
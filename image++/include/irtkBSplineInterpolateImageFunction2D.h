@@ -24,6 +24,8 @@
  * M. Unser, "Splines: A Perfect Fit for Signal and Image Processing," IEEE
  * Signal Processing Magazine, vol. 16, no. 6, pp. 22-38, November 1999.
  *
+ * The coefficients are shared with irtkBSplineInterpolateImageFunction,
+ * which computes the same coefficients for 2D images.
  */
 
 class irtkBSplineInterpolateImageFunction2D : public irtkInterpolateImageFunction
@@ -52,20 +54,15 @@ private:
   /// Dimension of input image in Y-direction minus spline degree
   int _yhalf;
 
-  /// Image of spline coefficient
-  irtkRealImage _coeff;
+  /// Spline coefficients used by the interpolator
+  irtkBSplineCoefficients *_Coefficients;
 
-  /// Initialize anti-causal coefficients
-  static double InitialAntiCausalCoefficient(double *, int, double z);
+  /// Image of spline coefficients
+  const irtkRealImage *_coeff;
 
-  /// Initialize causal coefficients
-  static double InitialCausalCoefficient(double *, int, double, double);
-
-  /// Convert voxel values to B-spline coefficients
-  static void ConvertToInterpolationCoefficients(double *, int, double *, int, double);
-
-  /// Compute B-spline coefficients
-  void ComputeCoefficients();
+  /// Not copyable
+  irtkBSplineInterpolateImageFunction2D(const irtkBSplineInterpolateImageFunction2D &);
+  void operator=(const irtkBSplineInterpolateImageFunction2D &);
 
 public:
 
@@ -0,0 +1,186 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKCONNECTEDCOMPONENTS_H
+
+#define _IRTKCONNECTEDCOMPONENTS_H
+
+#include <irtkImageToImage.h>
+
+#include <irtkNeighbourhoodOffsets.h>
+
+#include <vector>
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedConnectedComponents;
+
+#endif
+
+/// Statistics of a single connected component
+struct irtkConnectedComponent {
+
+  /// Label of the component in the output image
+  int _Label;
+
+  /// Number of voxels
+  int _Size;
+
+  /// Bounding box (inclusive voxel indices)
+  int _x1, _y1, _z1, _x2, _y2, _z2;
+
+  /// Mean intensity
+  double _Mean;
+};
+
+/**
+ * Class for labelling the connected components of an image
+ *
+ * All voxels equal to the cluster label are labelled with the number of
+ * the connected component they belong to (1, 2, ...), all other voxels are
+ * set to zero. Components are numbered in the order in which they are first
+ * met in memory order. The image is cut into slabs along z which are labelled
+ * in parallel with a union-find forest whose roots are always the smallest
+ * voxel index of a tree; the slab boundaries are merged afterwards and a
+ * final pass assigns the labels and collects size, bounding box and mean
+ * intensity of each component. The result does not depend on the number of
+ * threads. Labels beyond the range of VoxelType are saturated in the output
+ * image, GetPointerToLabels() always returns the exact labels.
+ *
+ * CONNECTIVITY_06, CONNECTIVITY_18 and CONNECTIVITY_26 label the image in 3D,
+ * CONNECTIVITY_04 labels each slice independently.
+ */
+
+template <class VoxelType> class irtkConnectedComponents : public irtkImageToImage<VoxelType>
+{
+
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedConnectedComponents<VoxelType>;
+
+#endif
+
+  /// Label used to identify voxels of interest
+  VoxelType _ClusterLabel;
+
+  /// Connectivity
+  irtkConnectivityType _Connectivity;
+
+  /// Optional image from which the mean intensities are computed
+  irtkBaseImage *_IntensityImage;
+
+  /// Union-find forest during labelling, component labels afterwards
+  std::vector<int> _Labels;
+
+  /// Statistics of the components
+  std::vector<irtkConnectedComponent> _Components;
+
+  /// Offsets of the neighbours which precede a voxel in memory order
+  int _NumberOfNeighbours;
+  int _dx[13], _dy[13], _dz[13], _Offset[13];
+
+protected:
+
+  /// Find root of the tree containing a voxel
+  int Find(int);
+
+  /// Merge the trees containing two voxels
+  void Union(int, int);
+
+  /// Build union-find forest for slices z1 to z2-1
+  void LabelSlab(int, int);
+
+  /// Merge forest across the boundary between slices z-1 and z
+  void MergeSlab(int);
+
+  /// Returns whether the filter requires buffering
+  virtual bool RequiresBuffering();
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass();
+
+public:
+
+  /// Constructor
+  irtkConnectedComponents(VoxelType = 1, irtkConnectivityType = CONNECTIVITY_06);
+
+  /// Destructor
+  ~irtkConnectedComponents();
+
+  /// Set cluster label
+  SetMacro(ClusterLabel, VoxelType);
+
+  /// Get cluster label
+  GetMacro(ClusterLabel, VoxelType);
+
+  /// Set connectivity
+  SetMacro(Connectivity, irtkConnectivityType);
+
+  /// Get connectivity
+  GetMacro(Connectivity, irtkConnectivityType);
+
+  /// Set image used for the mean intensities (default is the input)
+  SetMacro(IntensityImage, irtkBaseImage *);
+
+  /// Returns number of components found by Run()
+  int GetNumberOfComponents() const;
+
+  /// Returns statistics of component with given label (1, 2, ...)
+  const irtkConnectedComponent &GetComponent(int) const;
+
+  /// Returns label of the largest component, zero if there is none
+  int GetLargestComponent() const;
+
+  /// Returns component labels as int. Not limited by the range of VoxelType
+  const int *GetPointerToLabels() const;
+
+  /// Run filter
+  virtual void Run();
+
+};
+
+template <class VoxelType> inline int irtkConnectedComponents<VoxelType>::Find(int i)
+{
+  while (_Labels[i] != i) {
+    _Labels[i] = _Labels[_Labels[i]];
+    i = _Labels[i];
+  }
+  return i;
+}
+
+template <class VoxelType> inline void irtkConnectedComponents<VoxelType>::Union(int i, int j)
+{
+  i = this->Find(i);
+  j = this->Find(j);
+  if (i < j) {
+    _Labels[j] = i;
+  } else if (j < i) {
+    _Labels[i] = j;
+  }
+}
+
+template <class VoxelType> inline int irtkConnectedComponents<VoxelType>::GetNumberOfComponents() const
+{
+  return _Components.size();
+}
+
+template <class VoxelType> inline const irtkConnectedComponent &irtkConnectedComponents<VoxelType>::GetComponent(int label) const
+{
+  return _Components[label-1];
+}
+
+template <class VoxelType> inline const int *irtkConnectedComponents<VoxelType>::GetPointerToLabels() const
+{
+  return &(_Labels[0]);
+}
+
+#endif
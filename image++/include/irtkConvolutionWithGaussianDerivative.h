@@ -20,6 +20,8 @@
  * Class for convolution with 1st order Gaussian derivative 
  * 
  * This class defines and implements the 1st order gaussian derivative filtering of images. 
+ * Along axes where sigma is at least the recursive threshold (in voxels) the
+ * convolution is replaced by irtkRecursiveGaussian_1D.
  */
 
 template <class VoxelType> class irtkConvolutionWithGaussianDerivative : public irtkImageToImage<VoxelType> {
@@ -29,6 +31,15 @@ protected:
   /// Sigma (standard deviation of Gaussian kernel)
   double _Sigma;
 
+  /// Sigma in voxels from which the recursive filter is used
+  double _RecursiveThreshold;
+
+  /// Filter along one axis with given voxel size and order of derivative
+  void Convolve(irtkGenericImage<VoxelType> *, irtkGenericImage<VoxelType> *, int, double, int);
+
+  /// Filter along x, y and z with given orders of derivative
+  void Derivative(int, int, int);
+
   /// Returns the name of the class
   const char *NameOfClass();
 
@@ -58,6 +69,12 @@ public:
   /// Get sigma
   GetMacro(Sigma, double);
 
+  /// Set sigma in voxels from which the recursive filter is used
+  SetMacro(RecursiveThreshold, double);
+
+  /// Get sigma in voxels from which the recursive filter is used
+  GetMacro(RecursiveThreshold, double);
+
 };
 
 
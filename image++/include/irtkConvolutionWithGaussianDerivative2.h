@@ -20,6 +20,12 @@
  * Class for convolution with 2nd order Gaussian derivative 
  * 
  * This class defines and implements the 2nd order gaussian derivative filtering of images. 
+ * Along axes where sigma is at least the recursive threshold (in voxels) the
+ * convolution is replaced by irtkRecursiveGaussian_1D.
+ *
+ * Hessian() computes all six derivatives into an output with six frames
+ * (xx, xy, xz, yy, yz and zz as irtkHessianImageFilter), reusing the passes
+ * along x so that 15 instead of 18 one-dimensional filters are applied.
  */
 
 template <class VoxelType> class irtkConvolutionWithGaussianDerivative2 : public irtkImageToImage<VoxelType> {
@@ -29,6 +35,15 @@ protected:
   /// Sigma (standard deviation of Gaussian kernel)
   double _Sigma;
 
+  /// Sigma in voxels from which the recursive filter is used
+  double _RecursiveThreshold;
+
+  /// Filter along one axis with given voxel size and order of derivative
+  void Convolve(irtkGenericImage<VoxelType> *, irtkGenericImage<VoxelType> *, int, double, int);
+
+  /// Filter along x, y and z with given orders of derivative
+  void Derivative(int, int, int);
+
   /// Returns the name of the class
   const char *NameOfClass();
 
@@ -60,6 +75,9 @@ public:
 
   /// Compute derivatives
   void Iyz();
+
+  /// Compute all second derivatives (xx, xy, xz, yy, yz, zz) as frames of the output
+  void Hessian();
   
   /// Set sigma
   SetMacro(Sigma, double);
@@ -67,6 +85,12 @@ public:
   /// Get sigma
   GetMacro(Sigma, double);
 
+  /// Set sigma in voxels from which the recursive filter is used
+  SetMacro(RecursiveThreshold, double);
+
+  /// Get sigma in voxels from which the recursive filter is used
+  GetMacro(RecursiveThreshold, double);
+
 };
 
 
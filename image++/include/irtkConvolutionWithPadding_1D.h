@@ -57,6 +57,9 @@ public:
 
   /// Get the padding value
   VoxelType GetPaddingValue();
+
+  /// Run convolution along the selected axis
+  virtual void Run();
 };
 
 #endif
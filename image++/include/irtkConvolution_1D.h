@@ -14,23 +14,68 @@
 
 #define _IRTKCONVOLUTION_1D_H
 
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedConvolution_1D;
+
+#endif
+
+/// Clamp to range of voxel type and convert as irtkGenericImage::PutAsDouble
+template <class VoxelType> inline VoxelType irtkConvolutionToVoxel(double val)
+{
+  if (val > voxel_limits<VoxelType>::max()) val = voxel_limits<VoxelType>::max();
+  if (val < voxel_limits<VoxelType>::min()) val = voxel_limits<VoxelType>::min();
+  return static_cast<VoxelType>(val);
+}
+
 /**
  * Class for one-dimensional convolution.
  *
  * This class defines and implements one-dimensional convolutions of an image
- * with a filter kernel. The convolution is computed along the x-axis. This
- * class assumes that the filter kernel is one-dimensional and its size along
- * the y- and z-axis must be 1.
+ * with a filter kernel. The convolution is computed along the x-axis, or
+ * along the y-, z- or t-axis when selected with SetAxis. This class assumes
+ * that the filter kernel is one-dimensional and its size along the y- and
+ * z-axis must be 1.
+ *
+ * Run() works directly on the memory layout of the image: rows along x are
+ * filtered one at a time and convolutions along the other axes accumulate
+ * batches of contiguous voxels at once, so the image is never transposed.
+ * The result is identical to evaluating Run(x, y, z, t) for every voxel of
+ * the image with the selected axis flipped into x.
  */
 
 template <class VoxelType> class irtkConvolution_1D : public irtkConvolution<VoxelType>
 {
 
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedConvolution_1D<VoxelType>;
+
+#endif
+
 protected:
 
   /// Second input, i.e. the filter kernel
   irtkGenericImage<irtkRealPixel> *_input2;
 
+  /// Axis along which the image is convolved by Run() (0 to 3)
+  int _Axis;
+
+  /// Whether Run() ignores padded voxels
+  bool _Padded;
+
+  /// Padding value used by Run()
+  VoxelType _PaddingValue;
+
+  /// Convolve rows r1 to r2-1 along the x-axis
+  void ConvolveX(int, int);
+
+  /// Convolve batches b1 to b2-1 of contiguous voxels along the y-, z- or t-axis
+  void ConvolveAxis(int, int);
+
+  /// Convolve whole image along the selected axis
+  void Convolve();
+
   /** Returns whether the filter requires buffering. This filter requires
    *  buffering and returns 0.
    */
@@ -52,6 +97,15 @@ public:
   /// Set second input, i.e. the filter kernel
   virtual void SetInput2(irtkGenericImage<irtkRealPixel> *);
 
+  /// Set axis along which Run() convolves the image
+  SetMacro(Axis, int);
+
+  /// Get axis along which Run() convolves the image
+  GetMacro(Axis, int);
+
+  /// Run convolution along the selected axis
+  virtual void Run();
+
   /// Initialize the convolution filter
   virtual void Initialize();
 };
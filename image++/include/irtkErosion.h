@@ -16,16 +16,34 @@
 
 #include <irtkImageToImage.h>
 
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedErosion;
+
+#endif
+
 /**
  * Class for erosion of images
  *
  * This class defines and implements the morphological erosion of images.
- *
+ * Voxels on the boundary of the image are not changed. Run() applies the
+ * connectivity neighbourhood the given number of iterations. For
+ * CONNECTIVITY_26 this equals the minimum over a box with radius equal to
+ * the number of iterations, which is computed with running minima along
+ * x, y and z at constant cost per voxel (van Herk / Gil-Werman). Batches of
+ * lines which contain a single value, e.g. outside of binary masks, are
+ * copied without filtering.
  */
 
 template <class VoxelType> class irtkErosion : public irtkImageToImage<VoxelType>
 {
 
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedErosion<VoxelType>;
+
+#endif
+
 protected:
 
   /// Returns whether the filter requires buffering
@@ -43,6 +61,15 @@ protected:
   // List of voxel offsets of the neighbourhood.
   irtkNeighbourhoodOffsets _offsets;
 
+  /// Number of iterations
+  int _Iterations;
+
+  /// Erode slices s1 to s2-1 (over z and t) once with the neighbourhood
+  void Step(VoxelType *, VoxelType *, int, int);
+
+  /// Minimum over line segments along an axis for batches b1 to b2-1 of lines
+  void Box(VoxelType *, VoxelType *, int, int, int);
+
 public:
 
   /// Constructor
@@ -57,6 +84,12 @@ public:
   SetMacro(Connectivity, irtkConnectivityType);
 
   GetMacro(Connectivity, irtkConnectivityType);
+
+  /// Set number of iterations
+  SetMacro(Iterations, int);
+
+  /// Get number of iterations
+  GetMacro(Iterations, int);
 };
 
 #endif
@@ -22,6 +22,13 @@
  * This is a class which reads images in NIFTI file format and converts them
  * into images. The NIFTI file format is a file format for 3D and 4D images.
  * More information about the format can be found at http://nifti.nimh.nih.gov/nifti-1/
+ *
+ * If enabled with SetMapping(), the voxels of uncompressed files in native
+ * byte order are not read but mapped copy-on-write from the file, see
+ * irtkMappedFileAllocator. Pages are then only read when first accessed and
+ * are shared with the page cache. Pages not yet accessed still reflect the
+ * file, so mapping must only be enabled if no other process rewrites or
+ * truncates the files while their images exist; truncation raises SIGBUS.
  */
 
 class irtkFileNIFTIToImage : public irtkFileToImage
@@ -30,11 +37,20 @@ class irtkFileNIFTIToImage : public irtkFileToImage
   /// Filename of header
   char *_headername;
 
+  /// Filename of image data
+  char *_dataname;
+
 protected:
 
   /// Read header of NIFTI file
   virtual void ReadHeader();
 
+  /// Map voxels from file. Returns NULL if the file cannot be mapped
+  virtual irtkImage *MapOutput();
+
+  /// Whether voxels are mapped from files (default: false)
+  static bool _Mapping;
+
 public:
 
   /// Contructor
@@ -46,12 +62,18 @@ public:
   /// Set input
   virtual void SetInput (const char *);
 
+  /// Get output
+  virtual irtkImage *GetOutput();
+
   /// Returns name of class
   virtual const char *NameOfClass();
 
   /// Returns whether file has correct header
   static int CheckHeader(const char *);
 
+  /// Enable or disable mapping of voxels from files
+  static void SetMapping(bool);
+
   /// Print image file information
   virtual void Print();
 
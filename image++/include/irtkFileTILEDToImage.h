@@ -0,0 +1,70 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKFILETILEDTOIMAGE_H
+
+#define _IRTKFILETILEDTOIMAGE_H
+
+#include <irtkTiledImage.h>
+
+/**
+ * Class for reading images in tiled file format.
+ *
+ * This is a class which reads entire images in tiled file format, see
+ * irtkTiledImageReader. Use GetReader() to read single frames or slabs.
+ */
+
+class irtkFileTILEDToImage : public irtkFileToImage
+{
+
+  /// Filename of image
+  char *_tiledname;
+
+  /// Reader of tiles
+  irtkTiledImageReader _reader;
+
+protected:
+
+  /// Read header of tiled file
+  virtual void ReadHeader();
+
+public:
+
+  /// Contructor
+  irtkFileTILEDToImage();
+
+  /// Destructor
+  virtual ~irtkFileTILEDToImage();
+
+  /// Set input
+  virtual void SetInput (const char *);
+
+  /// Get output
+  virtual irtkImage *GetOutput();
+
+  /// Returns reader for regions of the image
+  irtkTiledImageReader *GetReader();
+
+  /// Returns name of class
+  virtual const char *NameOfClass();
+
+  /// Returns whether file has correct header
+  static int CheckHeader(const char *);
+
+};
+
+inline irtkTiledImageReader *irtkFileTILEDToImage::GetReader()
+{
+  return &_reader;
+}
+
+#endif
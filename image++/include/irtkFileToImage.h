@@ -125,5 +125,6 @@ public:
 #include <irtkFileOpenCVToImage.h>
 #endif
 #include <irtkFileANALYZEToImage.h>
+#include <irtkFileTILEDToImage.h>
 
 #endif
@@ -21,7 +21,9 @@
  *
  * This class defines and implements the Gaussian blurring of images. The
  * blurring is implemented by three successive 1D convolutions with a 1D
- * Gaussian kernel.
+ * Gaussian kernel. Along axes where sigma is at least the recursive threshold
+ * (in voxels) the convolution is replaced by irtkRecursiveGaussian_1D, whose
+ * cost does not grow with sigma.
  */
 
 template <class VoxelType> class irtkGaussianBlurring : public irtkImageToImage<VoxelType>
@@ -32,6 +34,12 @@ protected:
   /// Sigma (standard deviation of Gaussian kernel)
   double _Sigma;
 
+  /// Sigma in voxels from which the recursive filter is used
+  double _RecursiveThreshold;
+
+  /// Smooth along one axis with given voxel size
+  virtual void Convolve(irtkGenericImage<VoxelType> *, irtkGenericImage<VoxelType> *, int, double);
+
   /// Returns whether the filter requires buffering
   virtual bool RequiresBuffering();
 
@@ -58,6 +66,12 @@ public:
   /// Get sigma
   GetMacro(Sigma, double);
 
+  /// Set sigma in voxels from which the recursive filter is used
+  SetMacro(RecursiveThreshold, double);
+
+  /// Get sigma in voxels from which the recursive filter is used
+  GetMacro(RecursiveThreshold, double);
+
 };
 
 #include <irtkGaussianBlurringWithPadding.h>
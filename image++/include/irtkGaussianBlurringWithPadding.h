@@ -32,6 +32,9 @@ protected:
   /// Padding value
   VoxelType _PaddingValue;
 
+  /// Smooth along one axis with given voxel size, ignoring padded voxels
+  virtual void Convolve(irtkGenericImage<VoxelType> *, irtkGenericImage<VoxelType> *, int, double);
+
   /// Returns whether the filter requires buffering
   virtual bool RequiresBuffering();
 
@@ -43,12 +46,6 @@ public:
   /// Constructor
   irtkGaussianBlurringWithPadding(double, VoxelType);
 
-  /// Run Gaussian blurring
-  virtual void Run();
-
-  /// Run Gaussian blurring
-  virtual void RunZ();
-
   /// Set padding value
   SetMacro(PaddingValue, VoxelType);
 
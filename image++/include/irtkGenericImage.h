@@ -28,6 +28,10 @@
  * This class implements generic 2D and 3D images. It provides functions
  * for accessing, reading, writing and manipulating images. This class can
  * be used for images with arbitrary voxel types using templates.
+ *
+ * The voxels are stored in a single aligned block provided by the current
+ * irtkDataAllocator, x varying fastest and t slowest. Regions, slices and
+ * frames can be referenced without copying through irtkGenericImageView.
  */
 
 template <typename T> class irtkGenericImage : public irtkBaseImage
@@ -40,7 +44,25 @@ public:
 protected:
 
   /// Pointer to image data
-  VoxelType ****_matrix;
+  VoxelType *_data;
+
+  /// Allocator which provided the image data
+  irtkDataAllocator *_allocator;
+
+  /// Allocate image data for given number of voxels from the current allocator
+  VoxelType *AllocateData(size_t);
+
+  /// Return image data to its allocator
+  void DeallocateData(VoxelType *, size_t);
+
+  /// Number of voxels of the image data, not limited to the range of int
+  size_t NumberOfVoxels() const;
+
+  /// Index of voxel without bounds checking, not limited to the range of int
+  size_t Index(int, int, int, int = 0) const;
+
+  /// Attributes of a region as returned by GetRegion
+  irtkImageAttributes GetRegionAttributes(int, int, int, int, int, int, int, int) const;
 
 public:
 
@@ -62,6 +84,17 @@ public:
   /// Copy constructor for image of different type
   template <class TVoxel2> irtkGenericImage(const irtkGenericImage<TVoxel2> &);
 
+  /// Constructor copying the voxels of a view
+  irtkGenericImage(const irtkGenericImageView<VoxelType> &);
+
+  /// Constructor taking over voxels provided by the given allocator, which releases them with the image
+  irtkGenericImage(const irtkImageAttributes &, VoxelType *, irtkDataAllocator *);
+
+#if __cplusplus >= 201103L
+  /// Move constructor. Takes over the voxels, leaving the other image empty. Also lets std::vector grow without copying
+  irtkGenericImage(irtkGenericImage &&) noexcept;
+#endif
+
   /// Destructor
   ~irtkGenericImage(void);
 
@@ -129,6 +162,9 @@ public:
   /// Function for pixel access from via operators
   VoxelType& operator()(int, int, int, int = 0);
 
+  /// Function for pixel access from via operators
+  const VoxelType& operator()(int, int, int, int = 0) const;
+
   /// Function for image slice get access
   irtkGenericImage GetRegion(int z, int t) const;
 
@@ -141,6 +177,18 @@ public:
   /// Function for image frame get access
   irtkGenericImage GetFrame(int t) const;
 
+  /// View of the whole image
+  irtkGenericImageView<VoxelType> GetView() const;
+
+  /// View of region, without copying. Attributes are those of GetRegion
+  irtkGenericImageView<VoxelType> GetRegionView(int x1, int y1, int z1, int x2, int y2, int z2) const;
+
+  /// View of region, without copying. Attributes are those of GetRegion
+  irtkGenericImageView<VoxelType> GetRegionView(int x1, int y1, int z1, int t1, int x2, int y2, int z2, int t2) const;
+
+  /// View of image frame, without copying. Attributes are those of GetFrame
+  irtkGenericImageView<VoxelType> GetFrameView(int t) const;
+
   //
   // Operators for image arithmetics
   //
@@ -150,6 +198,11 @@ public:
   
   /// Copy operator for image
   template <class TVoxel2> irtkGenericImage<VoxelType>& operator= (const irtkGenericImage<TVoxel2> &);
+
+#if __cplusplus >= 201103L
+  /// Move operator for image. Takes over the voxels, leaving the other image empty
+  irtkGenericImage<VoxelType>& operator= (irtkGenericImage &&) noexcept;
+#endif
   
   /// Addition operator
   irtkGenericImage  operator+ (const irtkGenericImage &);
@@ -284,15 +337,26 @@ public:
 
 };
 
+/// Debugging flag for deep copies of images. If non-zero, every call of the
+/// copy constructor or copy operator is counted per call site, see
+/// PrintImageCopies().
+extern int debug_image_copies;
+
+/// Print number of deep copies and bytes copied per call site, most bytes first
+extern void PrintImageCopies(ostream & = cout);
+
+/// Forget the deep copies counted so far
+extern void ResetImageCopies();
+
 template <class VoxelType> inline void irtkGenericImage<VoxelType>::Put(int x, int y, int z, VoxelType val)
 {
 #ifdef NO_BOUNDS
-  _matrix[0][z][y][x] = val;
+  _data[this->Index(x, y, z)] = val;
 #else
   if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0)) {
     cout << "irtkGenericImage<VoxelType>::Put: parameter out of range\n";
   } else {
-    _matrix[0][z][y][x] = static_cast<VoxelType>(val);
+    _data[this->Index(x, y, z)] = static_cast<VoxelType>(val);
   }
 #endif
 }
@@ -300,12 +364,12 @@ template <class VoxelType> inline void irtkGenericImage<VoxelType>::Put(int x, i
 template <class VoxelType> inline void irtkGenericImage<VoxelType>::Put(int x, int y, int z, int t, VoxelType val)
 {
 #ifdef NO_BOUNDS
-  _matrix[t][z][y][x] = val;
+  _data[this->Index(x, y, z, t)] = val;
 #else
   if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
     cout << "irtkGenericImage<VoxelType>::Put: parameter out of range\n";
   } else {
-    _matrix[t][z][y][x] = val;
+    _data[this->Index(x, y, z, t)] = val;
   }
 #endif
 }
@@ -316,12 +380,12 @@ template <class VoxelType> inline void irtkGenericImage<VoxelType>::PutAsDouble(
   if (val < voxel_limits<VoxelType>::min()) val = voxel_limits<VoxelType>::min();  
 
 #ifdef NO_BOUNDS
-  _matrix[0][z][y][x] = static_cast<VoxelType>(val);
+  _data[this->Index(x, y, z)] = static_cast<VoxelType>(val);
 #else
   if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (_attr._t > 0)) {
     cout << "irtkGenericImage<Type>::PutAsDouble: parameter out of range\n";
   } else {
-    _matrix[0][z][y][x] = static_cast<VoxelType>(val);
+    _data[this->Index(x, y, z)] = static_cast<VoxelType>(val);
   }
 #endif
 }
@@ -332,12 +396,12 @@ template <class VoxelType> inline void irtkGenericImage<VoxelType>::PutAsDouble(
   if (val < voxel_limits<VoxelType>::min()) val = voxel_limits<VoxelType>::min();  
 
 #ifdef NO_BOUNDS
-  _matrix[t][z][y][x] = static_cast<VoxelType>(val);
+  _data[this->Index(x, y, z, t)] = static_cast<VoxelType>(val);
 #else
   if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
     cout << "irtkGenericImage<Type>::PutAsDouble: parameter out of range\n";
   } else {
-    _matrix[t][z][y][x] = static_cast<VoxelType>(val);
+    _data[this->Index(x, y, z, t)] = static_cast<VoxelType>(val);
   }
 #endif
 }
@@ -345,13 +409,13 @@ template <class VoxelType> inline void irtkGenericImage<VoxelType>::PutAsDouble(
 template <class VoxelType> inline VoxelType irtkGenericImage<VoxelType>::Get(int x, int y, int z, int t) const
 {
 #ifdef NO_BOUNDS
-  return (_matrix[t][z][y][x]);
+  return (_data[this->Index(x, y, z, t)]);
 #else
   if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
     cout << "irtkGenericImage<Type>::Get: parameter out of range\n";
     return 0;
   } else {
-    return(_matrix[t][z][y][x]);
+    return(_data[this->Index(x, y, z, t)]);
   }
 #endif
 }
@@ -359,13 +423,13 @@ template <class VoxelType> inline VoxelType irtkGenericImage<VoxelType>::Get(int
 template <class VoxelType> inline double irtkGenericImage<VoxelType>::GetAsDouble(int x, int y, int z, int t) const
 {
 #ifdef NO_BOUNDS
-  return (static_cast<double>(_matrix[t][z][y][x]));
+  return (static_cast<double>(_data[this->Index(x, y, z, t)]));
 #else
   if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
     cout << "irtkGenericImage<Type>::GetAsDouble: parameter out of range\n";
     return 0;
   } else {
-    return (static_cast<double>(_matrix[t][z][y][x]));
+    return (static_cast<double>(_data[this->Index(x, y, z, t)]));
   }
 #endif
 
@@ -374,27 +438,51 @@ template <class VoxelType> inline double irtkGenericImage<VoxelType>::GetAsDoubl
 template <class VoxelType> inline VoxelType& irtkGenericImage<VoxelType>::operator()(int x, int y, int z, int t)
 {
 #ifdef NO_BOUNDS
-  return (_matrix[t][z][y][x]);
+  return (_data[this->Index(x, y, z, t)]);
 #else
   if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
     cout << "irtkGenericImage<Type>::(): parameter out of range\n";
-    return _matrix[0][0][0][0];
+    return _data[0];
   } else {
-    return (_matrix[t][z][y][x]);
+    return (_data[this->Index(x, y, z, t)]);
   }
 #endif
 }
 
+template <class VoxelType> inline const VoxelType& irtkGenericImage<VoxelType>::operator()(int x, int y, int z, int t) const
+{
+#ifdef NO_BOUNDS
+  return (_data[this->Index(x, y, z, t)]);
+#else
+  if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
+    cout << "irtkGenericImage<Type>::(): parameter out of range\n";
+    return _data[0];
+  } else {
+    return (_data[this->Index(x, y, z, t)]);
+  }
+#endif
+}
+
+template <class VoxelType> inline size_t irtkGenericImage<VoxelType>::NumberOfVoxels() const
+{
+  return static_cast<size_t>(_attr._x) * _attr._y * _attr._z * _attr._t;
+}
+
+template <class VoxelType> inline size_t irtkGenericImage<VoxelType>::Index(int x, int y, int z, int t) const
+{
+  return ((static_cast<size_t>(t) * _attr._z + z) * _attr._y + y) * _attr._x + x;
+}
+
 template <class VoxelType> inline int irtkGenericImage<VoxelType>::VoxelToIndex(int x, int y, int z, int t) const
 {
 #ifdef NO_BOUNDS
-  return (&(_matrix[t][z][y][x]) - &(_matrix[0][0][0][0]));
+  return this->Index(x, y, z, t);
 #else
   if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
     cout << "irtkGenericImage<Type>::VoxelToIndex: parameter out of range\n";
     return 0;
   } else {
-    return (&(_matrix[t][z][y][x]) - &(_matrix[0][0][0][0]));
+    return this->Index(x, y, z, t);
   }
 #endif
 }
@@ -402,14 +490,14 @@ template <class VoxelType> inline int irtkGenericImage<VoxelType>::VoxelToIndex(
 template <class VoxelType> inline VoxelType *irtkGenericImage<VoxelType>::GetPointerToVoxels(int x, int y, int z, int t) const
 {
 #ifdef NO_BOUNDS
-  return &(_matrix[t][z][y][x]);
+  return &(_data[this->Index(x, y, z, t)]);
 #else
   if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
     cout << "irtkGenericImage<Type>::GetPointerToVoxels: parameter out of range\n";
     cout << x << " " << y << " " << z << " " << t << endl;
     return NULL;
   } else {
-    return &(_matrix[t][z][y][x]);
+    return &(_data[this->Index(x, y, z, t)]);
   }
 #endif
 }
@@ -417,14 +505,14 @@ template <class VoxelType> inline VoxelType *irtkGenericImage<VoxelType>::GetPoi
 template <class VoxelType> inline void *irtkGenericImage<VoxelType>::GetScalarPointer(int x, int y, int z, int t) const
 {
 #ifdef NO_BOUNDS
-  return &(_matrix[t][z][y][x]);
+  return &(_data[this->Index(x, y, z, t)]);
 #else
   if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
     cout << "irtkGenericImage<Type>::GetScalarPointer: parameter out of range\n";
     cout << x << " " << y << " " << z << " " << t << endl;
     return NULL;
   } else {
-    return &(_matrix[t][z][y][x]);
+    return &(_data[this->Index(x, y, z, t)]);
   }
 #endif
 }
@@ -0,0 +1,242 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKGENERICIMAGEVIEW_H
+
+#define _IRTKGENERICIMAGEVIEW_H
+
+/**
+ * Non-owning view of a region of an image
+ *
+ * A view refers to the voxels of a region of interest, a slice or a frame of
+ * an irtkGenericImage without copying them. Voxels along x are contiguous,
+ * the other axes are addressed with the strides of the image. The attributes
+ * of a view are those of the image returned by the corresponding
+ * irtkGenericImage::GetRegion(). A view is only valid as long as the image
+ * it refers to is neither destroyed nor reinitialised.
+ */
+
+template <typename T> class irtkGenericImageView
+{
+public:
+
+  /// Voxel type
+  typedef T VoxelType;
+
+protected:
+
+  /// Pointer to first voxel of the region
+  VoxelType *_data;
+
+  /// Strides between neighbouring voxels along y, z and t
+  size_t _StrideY, _StrideZ, _StrideT;
+
+  /// Attributes of the region
+  irtkImageAttributes _attr;
+
+public:
+
+  /// Default constructor (empty view)
+  irtkGenericImageView();
+
+  /// Constructor from first voxel, attributes of the region and strides along y, z and t
+  irtkGenericImageView(VoxelType *, const irtkImageAttributes &, size_t, size_t, size_t);
+
+  /// Image attributes of the region
+  const irtkImageAttributes &GetImageAttributes() const;
+
+  /// Returns the number of voxels in the x-direction
+  int GetX() const;
+
+  /// Returns the number of voxels in the y-direction
+  int GetY() const;
+
+  /// Returns the number of voxels in the z-direction
+  int GetZ() const;
+
+  /// Returns the number of voxels in the t-direction
+  int GetT() const;
+
+  /// Returns the total number of voxels
+  int GetNumberOfVoxels() const;
+
+  /// Returns whether the voxels of the region are contiguous in memory
+  bool IsContiguous() const;
+
+  /// Function to convert pixel to offset from the first voxel
+  size_t VoxelToIndex(int, int, int, int = 0) const;
+
+  /// Function for pixel access via pointers (voxels along x are contiguous)
+  VoxelType *GetPointerToVoxels(int = 0, int = 0, int = 0, int = 0) const;
+
+  /// Function for pixel get access
+  VoxelType Get(int, int, int, int = 0) const;
+
+  /// Function for pixel put access
+  void Put(int, int, int, int, VoxelType);
+
+  /// Function for pixel access via operators
+  VoxelType &operator()(int, int, int, int = 0) const;
+
+  /// Copy voxels of the region into contiguous memory
+  void CopyTo(VoxelType *) const;
+
+  /// Copy voxels from contiguous memory into the region
+  void CopyFrom(const VoxelType *) const;
+
+};
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType>::irtkGenericImageView()
+{
+  _data    = NULL;
+  _StrideY = 0;
+  _StrideZ = 0;
+  _StrideT = 0;
+  _attr._x = 0;
+  _attr._y = 0;
+  _attr._z = 0;
+  _attr._t = 0;
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType>::irtkGenericImageView(VoxelType *data, const irtkImageAttributes &attr, size_t sy, size_t sz, size_t st)
+{
+  _data    = data;
+  _attr    = attr;
+  _StrideY = sy;
+  _StrideZ = sz;
+  _StrideT = st;
+}
+
+template <class VoxelType> inline const irtkImageAttributes &irtkGenericImageView<VoxelType>::GetImageAttributes() const
+{
+  return _attr;
+}
+
+template <class VoxelType> inline int irtkGenericImageView<VoxelType>::GetX() const
+{
+  return _attr._x;
+}
+
+template <class VoxelType> inline int irtkGenericImageView<VoxelType>::GetY() const
+{
+  return _attr._y;
+}
+
+template <class VoxelType> inline int irtkGenericImageView<VoxelType>::GetZ() const
+{
+  return _attr._z;
+}
+
+template <class VoxelType> inline int irtkGenericImageView<VoxelType>::GetT() const
+{
+  return _attr._t;
+}
+
+template <class VoxelType> inline int irtkGenericImageView<VoxelType>::GetNumberOfVoxels() const
+{
+  return _attr._x * _attr._y * _attr._z * _attr._t;
+}
+
+template <class VoxelType> inline bool irtkGenericImageView<VoxelType>::IsContiguous() const
+{
+  return (((_attr._y == 1) || (_StrideY == static_cast<size_t>(_attr._x))) &&
+          ((_attr._z == 1) || (_StrideZ == static_cast<size_t>(_attr._x) * _attr._y)) &&
+          ((_attr._t == 1) || (_StrideT == static_cast<size_t>(_attr._x) * _attr._y * _attr._z)));
+}
+
+template <class VoxelType> inline size_t irtkGenericImageView<VoxelType>::VoxelToIndex(int x, int y, int z, int t) const
+{
+  return t * _StrideT + z * _StrideZ + y * _StrideY + x;
+}
+
+template <class VoxelType> inline VoxelType *irtkGenericImageView<VoxelType>::GetPointerToVoxels(int x, int y, int z, int t) const
+{
+#ifndef NO_BOUNDS
+  if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
+    cout << "irtkGenericImageView<Type>::GetPointerToVoxels: parameter out of range\n";
+    cout << x << " " << y << " " << z << " " << t << endl;
+    return NULL;
+  }
+#endif
+  return _data + this->VoxelToIndex(x, y, z, t);
+}
+
+template <class VoxelType> inline VoxelType irtkGenericImageView<VoxelType>::Get(int x, int y, int z, int t) const
+{
+#ifndef NO_BOUNDS
+  if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
+    cout << "irtkGenericImageView<Type>::Get: parameter out of range\n";
+    return 0;
+  }
+#endif
+  return _data[this->VoxelToIndex(x, y, z, t)];
+}
+
+template <class VoxelType> inline void irtkGenericImageView<VoxelType>::Put(int x, int y, int z, int t, VoxelType val)
+{
+#ifndef NO_BOUNDS
+  if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
+    cout << "irtkGenericImageView<Type>::Put: parameter out of range\n";
+    return;
+  }
+#endif
+  _data[this->VoxelToIndex(x, y, z, t)] = val;
+}
+
+template <class VoxelType> inline VoxelType &irtkGenericImageView<VoxelType>::operator()(int x, int y, int z, int t) const
+{
+#ifndef NO_BOUNDS
+  if ((x >= _attr._x) || (x < 0) || (y >= _attr._y) || (y < 0) || (z >= _attr._z) || (z < 0) || (t >= _attr._t) || (t < 0)) {
+    cout << "irtkGenericImageView<Type>::(): parameter out of range\n";
+    return _data[0];
+  }
+#endif
+  return _data[this->VoxelToIndex(x, y, z, t)];
+}
+
+template <class VoxelType> inline void irtkGenericImageView<VoxelType>::CopyTo(VoxelType *ptr) const
+{
+  int y, z, t;
+
+  if (this->IsContiguous()) {
+    memcpy(ptr, _data, static_cast<size_t>(_attr._x) * _attr._y * _attr._z * _attr._t * sizeof(VoxelType));
+    return;
+  }
+  for (t = 0; t < _attr._t; t++) {
+    for (z = 0; z < _attr._z; z++) {
+      for (y = 0; y < _attr._y; y++) {
+        memcpy(ptr, _data + this->VoxelToIndex(0, y, z, t), _attr._x * sizeof(VoxelType));
+        ptr += _attr._x;
+      }
+    }
+  }
+}
+
+template <class VoxelType> inline void irtkGenericImageView<VoxelType>::CopyFrom(const VoxelType *ptr) const
+{
+  int y, z, t;
+
+  if (this->IsContiguous()) {
+    memcpy(_data, ptr, static_cast<size_t>(_attr._x) * _attr._y * _attr._z * _attr._t * sizeof(VoxelType));
+    return;
+  }
+  for (t = 0; t < _attr._t; t++) {
+    for (z = 0; z < _attr._z; z++) {
+      for (y = 0; y < _attr._y; y++) {
+        memcpy(_data + this->VoxelToIndex(0, y, z, t), ptr, _attr._x * sizeof(VoxelType));
+        ptr += _attr._x;
+      }
+    }
+  }
+}
+
+#endif
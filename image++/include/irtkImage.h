@@ -24,6 +24,7 @@ template <class Type> class irtkGenericImage;
 #include <irtkGeometry.h>
 
 #include <irtkBaseImage.h>
+#include <irtkGenericImageView.h>
 #include <irtkGenericImage.h>
 
 /// Unsigned char image
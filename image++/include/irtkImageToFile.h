@@ -88,6 +88,7 @@ public:
 #include <irtkImageToFileVTK.h>
 #include <irtkImageToFileGIPL.h>
 #include <irtkImageToFileANALYZE.h>
+#include <irtkImageToFileTILED.h>
 #ifdef HAS_NIFTI
 #include <irtkImageToFileNIFTI.h>
 #endif
@@ -22,7 +22,8 @@
  * Class for image to NIFTI file writer.
  *
  * This is a class which takes an image as input and produces an image file
- * in NIFTI file format.
+ * in NIFTI file format. Uncompressed files are preallocated and the voxels
+ * are copied into a shared mapping of the file.
  */
 
 class irtkImageToFileNIFTI : public irtkImageToFile
@@ -42,6 +43,9 @@ protected:
   /// Finalize filter (empty, overrides parent method).
   virtual void Finalize();
 
+  /// Write uncompressed file via a mapping. Returns false if the file cannot be mapped
+  virtual bool WriteMapped();
+
 public:
 
   /// Constructor
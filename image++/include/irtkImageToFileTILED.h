@@ -0,0 +1,39 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKIMAGETOFILETILED_H
+
+#define _IRTKIMAGETOFILETILED_H
+
+#include <irtkTiledImage.h>
+
+/**
+ * Class for image to tiled file filter.
+ *
+ * This is a class which takes an image as input and produces an image file
+ * in tiled file format with the default tile size, see irtkTiledImageWriter.
+ */
+
+class irtkImageToFileTILED : public irtkImageToFile
+{
+
+public:
+
+  /// Write entire image
+  virtual void Run();
+
+  /// Returns name of class
+  virtual const char *NameOfClass();
+
+};
+
+#endif
@@ -20,16 +20,14 @@
  * Class for extracting the largest connected component from a labelled image
  *
  * This class defines and implements the extraction of the largest connected component
- * from a labelled image.
+ * from a labelled image. The components are found with irtkConnectedComponents using
+ * 6-connectivity, or 4-connectivity within each slice in 2D mode.
  *
  */
 
 template <class VoxelType> class irtkLargestConnectedComponent : public irtkImageToImage<VoxelType>
 {
 
-  /// Size of current cluster
-  int _currentClusterSize;
-
   /// Size of largest cluster
   int _largestClusterSize;
 
@@ -41,12 +39,6 @@ template <class VoxelType> class irtkLargestConnectedComponent : public irtkImag
 
 protected:
 
-  /// Recursive region growing
-  void Grow2D(int, int, int, int);
-
-  /// Recursive region growing
-  void Grow3D(int, int, int, int);
-
   /// Returns whether the filter requires buffering
   virtual bool RequiresBuffering();
 
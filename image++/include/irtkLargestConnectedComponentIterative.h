@@ -20,9 +20,10 @@
  * Class for extracting the largest connected component from a labelled image
  *
  * This class defines and implements the extraction of the largest
- * connected component from a labelled image.  Uses an iterative method so
- * takes longer than the class irtkLargestConnectedComponent.  The stack
- * size needed, however, is lower.
+ * connected component from a labelled image. The components are found with
+ * irtkConnectedComponents using 6-connectivity, or 4-connectivity in 2D
+ * mode. In all clusters mode the output contains the labels 1, 2, ... of
+ * all components in the order in which they are met in memory.
  *
  */
 
@@ -51,18 +52,6 @@ template <class VoxelType> class irtkLargestConnectedComponentIterative : public
 
 protected:
 
-  /// Run filter
-  virtual void Run3D();
-  virtual void Run2D();
-
-  // Helper functions
-  virtual void ResetMarks();
-
-  virtual void SelectLargestCluster();
-
-  int CheckAdjacency2D(VoxelType& markA, VoxelType& markB);
-  int CheckAdjacency3D(VoxelType& markA, VoxelType& markB);
-
   /// Returns whether the filter requires buffering
   virtual bool RequiresBuffering();
 
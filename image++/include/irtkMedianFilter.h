@@ -14,14 +14,36 @@
 
 #include <irtkImageToImage.h>
 
+#include <vector>
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedMedianFilter;
+
+#endif
+
 /**
  * Class for median filtering an image
  *
+ * Each voxel is replaced by the median of the voxels inside the mask within
+ * a cube of the given kernel radius; voxels closer than the radius to the
+ * boundary are copied. The intensities are first mapped to histogram bins,
+ * i.e. offsets from the minimum for integer valued images and ranks of the
+ * distinct values otherwise, so the result is exact. The cube is moved along
+ * x by removing and adding one plane of voxels from a histogram whose median
+ * is tracked incrementally (Huang et al.), which costs O(r^2) instead of
+ * O(r^3 log r) per voxel. Slabs of slices are filtered in parallel.
  */
 
 template <class VoxelType> class irtkMedianFilter : public irtkImageToImage<VoxelType>
 {
 
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedMedianFilter<VoxelType>;
+
+#endif
+
 protected:
 
   /// Returns whether the filter requires buffering
@@ -38,6 +60,15 @@ protected:
 
   irtkRealImage* _mask;
 
+  /// Histogram bin of each voxel, -1 outside of the mask
+  std::vector<int> _Bins;
+
+  /// Intensity of each histogram bin
+  std::vector<VoxelType> _Values;
+
+  /// Filter slices s1 to s2-1 (over z and t)
+  void Filter(int, int);
+
 public:
 
   /// Constructor
@@ -46,10 +77,10 @@ public:
   /// Destructor
   ~irtkMedianFilter();
 
-  /// Run dilation
+  /// Run median filter
   virtual void Run();
 
-  /// Set input image for filter
+  /// Set mask, voxels where the mask is zero are ignored (default is none)
   void SetMask (irtkRealImage*);
 
   SetMacro(kernelRadius, int);
@@ -5,15 +5,32 @@
 
 #include <irtkImageToImage.h>
 
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedModeFilter;
+
+#endif
+
 /**
  * Class for applying mode filter to what should be label images.
  *
  * Assign to each voxel, the modal label of those within a neighbourhood.
+ * Voxels on the boundary of the image are copied. The labels are counted in
+ * a table indexed by label, which is reset by visiting only the labels which
+ * occur. Ties are broken by a pseudo-random choice which depends only on
+ * the position of the voxel, so the result does not depend on the number of
+ * threads. Slabs of slices are filtered in parallel.
  */
 
 template <class VoxelType> class irtkModeFilter : public irtkImageToImage<VoxelType>
 {
 
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedModeFilter<VoxelType>;
+
+#endif
+
 protected:
 
   /// Returns whether the filter requires buffering
@@ -31,6 +48,12 @@ protected:
   // List of voxel offsets of the neighbourhood.
   irtkNeighbourhoodOffsets _offsets;
 
+  /// Smallest label and number of possible labels
+  int _MinLabel, _NumberOfLabels;
+
+  /// Filter slices s1 to s2-1 (over z and t)
+  void Filter(int, int);
+
 public:
 
   /// Constructor
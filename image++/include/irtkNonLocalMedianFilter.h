@@ -16,6 +16,12 @@
 
 #include <irtkImageToImage.h>
 
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedNonLocalMedianFilter;
+
+#endif
+
 /**
  * Class for non local median filter of images
  *
@@ -24,11 +30,20 @@
  * based denoising. Commun. Math. Sci., 7(3):741–753, 2009.
  * The non local weight is a Gaussian function of 4D distance where intensity is
  * considered as the fourth dimension
+ *
+ * Slices are filtered in parallel, each thread with its own buffers for the
+ * neighbours and weights of a voxel.
  */
 
 template <class VoxelType> class irtkNonLocalMedianFilter : public irtkImageToImage<VoxelType>
 {
 
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedNonLocalMedianFilter<VoxelType>;
+
+#endif
+
 protected:
 
   /// Sigma (standard deviation of Gaussian kernel)
@@ -72,6 +87,12 @@ protected:
   */
   virtual double Run(int, int, int, int);
 
+  /// Filter voxel using the given buffers for neighbours and weights
+  double Filter(int, int, int, int, float *, float *);
+
+  /// Filter slices z1 to z2-1 of frame t
+  void Filter(int, int, int);
+
   /// Returns whether the filter requires buffering
   virtual bool RequiresBuffering();
 
@@ -0,0 +1,146 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKRECURSIVEGAUSSIAN_1D_H
+
+#define _IRTKRECURSIVEGAUSSIAN_1D_H
+
+#include <irtkImageToImage.h>
+
+#include <vector>
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedRecursiveGaussian_1D;
+
+#endif
+
+/**
+ * Class for one-dimensional recursive Gaussian filtering.
+ *
+ * This class filters an image along one axis with the fourth order recursive
+ * approximation of the Gaussian by Deriche, i.e. the sum of a causal and an
+ * anti-causal recursive filter. Each voxel costs the same number of
+ * operations whatever the value of sigma, which makes the filter much faster
+ * than a convolution for large sigmas.
+ *
+ * The image is extended with zeros beyond its boundaries like the truncated
+ * kernels of irtkConvolution_1D, so both recursions start from zero and
+ * normalisation divides by the response to a line of ones. The result
+ * approximates irtkConvolution_1D with a Gaussian kernel everywhere.
+ *
+ * Derivatives (order 1 and 2) use the derivatives of the approximation with
+ * the same recursions, scaled and oriented like the kernels built from
+ * irtkScalarGaussianDx and irtkScalarGaussianDxDx. Sigma is given in voxels
+ * and should be larger than about two voxels for an accurate approximation.
+ */
+
+template <class VoxelType> class irtkRecursiveGaussian_1D : public irtkImageToImage<VoxelType>
+{
+
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedRecursiveGaussian_1D<VoxelType>;
+
+#endif
+
+protected:
+
+  /// Sigma (standard deviation of Gaussian in voxels)
+  double _Sigma;
+
+  /// Order of derivative (0, 1 or 2)
+  int _Order;
+
+  /// Axis along which the image is filtered (0 to 3)
+  int _Axis;
+
+  /// Whether smoothing is normalised near the boundaries
+  bool _Normalization;
+
+  /// Whether voxels smaller or equal to the padding value are ignored
+  bool _Padded;
+
+  /// Padding value
+  VoxelType _PaddingValue;
+
+  /// Coefficients of causal part (n0 to n3), anti-causal part (n1 to n4) and denominator (d1 to d4)
+  double _Causal[4], _AntiCausal[4], _Denominator[4];
+
+  /// Scaling of the approximated Gaussian and correction of the centre sample
+  double _Scale, _Centre;
+
+  /// Response to a line of ones, used for normalisation
+  std::vector<double> _Weights;
+
+  /// Filter lines stored in rows 4 to N+3 of first buffer into second, using third as work space
+  void Recurse(double *, double *, double *, int, int);
+
+  /// Filter batches b1 to b2-1 of lines along the selected axis
+  void Filter(int, int);
+
+  /// Returns whether the filter requires buffering
+  virtual bool RequiresBuffering();
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass();
+
+public:
+
+  /// Constructor
+  irtkRecursiveGaussian_1D(double, int = 0);
+
+  /// Destructor
+  ~irtkRecursiveGaussian_1D();
+
+  /// Set sigma in voxels
+  SetMacro(Sigma, double);
+
+  /// Get sigma in voxels
+  GetMacro(Sigma, double);
+
+  /// Set order of derivative
+  SetMacro(Order, int);
+
+  /// Get order of derivative
+  GetMacro(Order, int);
+
+  /// Set axis along which the image is filtered
+  SetMacro(Axis, int);
+
+  /// Get axis along which the image is filtered
+  GetMacro(Axis, int);
+
+  /// Set normalisation on/off
+  SetMacro(Normalization, bool);
+
+  /// Get normalisation
+  GetMacro(Normalization, bool);
+
+  /// Set whether padded voxels are ignored
+  SetMacro(Padded, bool);
+
+  /// Get whether padded voxels are ignored
+  GetMacro(Padded, bool);
+
+  /// Set padding value
+  SetMacro(PaddingValue, VoxelType);
+
+  /// Get padding value
+  GetMacro(PaddingValue, VoxelType);
+
+  /// Run filter
+  virtual void Run();
+
+};
+
+#endif
@@ -14,11 +14,42 @@
 
 #define _IRTKSINCINTERPOLATEIMAGEFUNCTION_H
 
+#include <vector>
+
+/// Sinc interpolation of a row along x, cached per thread
+struct irtkSincInterpolateRow {
+
+  /// Initialization, location and frame of the row
+  int _Stamp, _l;
+  double _y, _z;
+
+  /// Weights along y and z (2 * SINC_KERNEL_SIZE + 1), their support and the product of their sums
+  double _wy[13], _wz[13];
+  int _j1, _j2, _k1, _k2;
+  double _Sum;
+
+  /// Range of columns which have been interpolated along y and z
+  int _i1, _i2;
+  std::vector<double> _Column;
+
+  /// Constructor
+  irtkSincInterpolateRow() : _Stamp(0) {}
+};
+
 /**
  * Class for sinc interpolation of images
  *
  * This class defines and implements the sinc interpolation of
  * images.
+ *
+ * The windowed sinc kernel is separable, so the image is first interpolated
+ * along y and z for each column of the kernel support and the result is then
+ * interpolated along x. The columns are cached per thread for the current
+ * row, so that samples with the same y, z and t, e.g. along a row of an
+ * axis-aligned resampling, only cost the interpolation along x. Call
+ * Initialize() again after the voxels of the input have been modified.
+ * Without C++11 (thread_local) the rows are not cached and each sample
+ * interpolates all columns of its support.
  */
 
 class irtkSincInterpolateImageFunction : public irtkInterpolateImageFunction
@@ -35,6 +66,15 @@ private:
   /// Dimension of input image in Z-direction
   int _z;
 
+  /// Unique number of last initialization, selects the rows cached for this function
+  int _Stamp;
+
+  /// Update row to y, z and t with columns i1 to i2-1 interpolated
+  void GetRow(irtkSincInterpolateRow &, double, double, int, int, int);
+
+  /// Interpolate columns i1 to i2-1 of row along y and z
+  void InterpolateColumns(irtkSincInterpolateRow &, int, int);
+
 public:
 
   /// Constructor
@@ -46,7 +86,7 @@ public:
   /// Returns the name of the class
   virtual const char *NameOfClass();
 
-  /// Initialize
+  /// Initialize. Must be called again whenever the voxels of the input change
   virtual void Initialize();
 
   /// Evaluate the filter at an arbitrary image location (in pixels)
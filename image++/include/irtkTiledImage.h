@@ -0,0 +1,219 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKTILEDIMAGE_H
+
+#define _IRTKTILEDIMAGE_H
+
+#include <irtkImage.h>
+
+#include <vector>
+
+#ifdef HAS_TBB
+
+class irtkMultiThreadedTiledImageReader;
+class irtkMultiThreadedTiledImageWriter;
+
+#endif
+
+/**
+ * Reader for images in tiled file format.
+ *
+ * The tiled file format (extension .tiled) cuts an image into tiles along
+ * x, y, z and t. Each tile is compressed independently with zlib at its
+ * fastest level and a table at the start of the file gives the position of
+ * every tile. Any region of the image can therefore be read by decoding only
+ * the tiles which it overlaps, so that long 4D series can be processed frame
+ * by frame or slab by slab in bounded memory. The tiles of a region are read
+ * one after the other and decompressed in parallel.
+ *
+ * Regions have the same attributes as the corresponding irtkGenericImage
+ * regions and voxels are converted to the voxel type of the output image.
+ */
+
+class irtkTiledImageReader : public irtkObject
+{
+
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedTiledImageReader;
+
+#endif
+
+protected:
+
+  /// File pointer
+  FILE *_file;
+
+  /// Image attributes
+  irtkImageAttributes _attr;
+
+  /// Voxel type and number of bytes per voxel
+  int _type, _bytes;
+
+  /// Tile size and number of tiles along x, y, z and t
+  int _tile[4], _tiles[4];
+
+  /// Flag whether file is swapped
+  int _swapped;
+
+  /// Position and compressed size of each tile
+  std::vector<long long> _offset, _size;
+
+  /// Region which is read, tiles which overlap it and their compressed data
+  int _region[8];
+  std::vector<int> _list;
+  std::vector<std::vector<char> > _buffer;
+
+  /// Voxels of region which is read
+  char *_data;
+
+  /// Decompress tiles n1 to n2-1 of list into region
+  void Decode(int, int);
+
+  /// Read voxels of region x1, y1, z1, t1 (inclusive) to x2, y2, z2, t2 (exclusive) in voxel type of file
+  void ReadVoxels(void *, int, int, int, int, int, int, int, int);
+
+  /// Attributes of region
+  irtkImageAttributes GetRegionAttributes(int, int, int, int, int, int, int, int) const;
+
+public:
+
+  /// Constructor
+  irtkTiledImageReader();
+
+  /// Destructor
+  virtual ~irtkTiledImageReader();
+
+  /// Returns whether file has correct header
+  static int CheckHeader(const char *);
+
+  /// Open file and read header
+  void Open(const char *);
+
+  /// Close file
+  void Close();
+
+  /// Returns image attributes
+  const irtkImageAttributes &GetImageAttributes() const;
+
+  /// Returns voxel type of file
+  int GetScalarType() const;
+
+  /// Returns tile size along axis (0 to 3)
+  int GetTileSize(int) const;
+
+  /// Read region x1, y1, z1, t1 (inclusive) to x2, y2, z2, t2 (exclusive)
+  template <class VoxelType> void Read(irtkGenericImage<VoxelType> &, int, int, int, int, int, int, int, int);
+
+  /// Read slices z1 (inclusive) to z2 (exclusive) of frame
+  template <class VoxelType> void ReadSlab(irtkGenericImage<VoxelType> &, int, int, int);
+
+  /// Read frame
+  template <class VoxelType> void ReadFrame(irtkGenericImage<VoxelType> &, int);
+
+  /// Read entire image in voxel type of file
+  irtkImage *ReadImage();
+
+};
+
+/**
+ * Writer for images in tiled file format.
+ *
+ * The image is written in blocks of frames, so that a 4D series can be
+ * produced frame by frame without holding it in memory. Each block must
+ * contain a multiple of the tile size along t frames, except the last one.
+ * The tiles of a block are compressed in parallel and written in order.
+ */
+
+class irtkTiledImageWriter : public irtkObject
+{
+
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedTiledImageWriter;
+
+#endif
+
+protected:
+
+  /// File pointer
+  FILE *_file;
+
+  /// Image attributes
+  irtkImageAttributes _attr;
+
+  /// Voxel type and number of bytes per voxel
+  int _type, _bytes;
+
+  /// Tile size and number of tiles along x, y, z and t
+  int _tile[4], _tiles[4];
+
+  /// Position and compressed size of each tile
+  std::vector<long long> _offset, _size;
+
+  /// Number of frames written so far
+  int _frames;
+
+  /// Block of frames which is written and compressed data of its tiles
+  const char *_data;
+  int _block;
+  std::vector<std::vector<char> > _buffer;
+
+  /// Compress tiles n1 to n2-1 of block
+  void Encode(int, int);
+
+public:
+
+  /// Constructor
+  irtkTiledImageWriter();
+
+  /// Destructor
+  virtual ~irtkTiledImageWriter();
+
+  /// Create file for image with given attributes, voxel type and tile size along x, y, z and t
+  void Open(const char *, const irtkImageAttributes &, int, int = 64, int = 64, int = 16, int = 1);
+
+  /// Write next frames. Image must have the attributes and voxel type of the file
+  void WriteFrames(irtkImage *);
+
+  /// Write table of tiles and close file. All frames must have been written
+  void Close();
+
+};
+
+inline const irtkImageAttributes &irtkTiledImageReader::GetImageAttributes() const
+{
+  return _attr;
+}
+
+inline int irtkTiledImageReader::GetScalarType() const
+{
+  return _type;
+}
+
+inline int irtkTiledImageReader::GetTileSize(int axis) const
+{
+  return _tile[axis];
+}
+
+template <class VoxelType> inline void irtkTiledImageReader::ReadSlab(irtkGenericImage<VoxelType> &image, int z1, int z2, int t)
+{
+  this->Read(image, 0, 0, z1, t, _attr._x, _attr._y, z2, t+1);
+}
+
+template <class VoxelType> inline void irtkTiledImageReader::ReadFrame(irtkGenericImage<VoxelType> &image, int t)
+{
+  this->Read(image, 0, 0, 0, t, _attr._x, _attr._y, _attr._z, t+1);
+}
+
+#endif
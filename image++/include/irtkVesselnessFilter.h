@@ -0,0 +1,134 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKVESSELNESSFILTER_H
+
+#define _IRTKVESSELNESSFILTER_H
+
+#include <irtkImageToImage.h>
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedVesselnessFilter;
+
+#endif
+
+/**
+ * Class for multi-scale vesselness filtering of images
+ *
+ * This class implements the vesselness measure of Frangi et al. (MICCAI
+ * 1998), i.e. the maximum over a range of scales of a function of the
+ * eigenvalues of the scale-normalised Hessian. At each scale the Hessian is
+ * computed by irtkConvolutionWithGaussianDerivative2::Hessian() and its
+ * eigenvalues in closed form by irtkSymmetricEigenvalues3x3() for rows of
+ * voxels, in parallel over slices. For single slices the 2D measure is used.
+ * If C is not positive, half of the maximum Frobenius norm of the Hessian at
+ * each scale is used. Only implemented for images with t = 1.
+ */
+
+template <class VoxelType> class irtkVesselnessFilter : public irtkImageToImage<VoxelType>
+{
+
+#ifdef HAS_TBB
+
+  friend class irtkMultiThreadedVesselnessFilter<VoxelType>;
+
+#endif
+
+protected:
+
+  /// Smallest and largest sigma in mm
+  double _SigmaMin, _SigmaMax;
+
+  /// Number of scales between smallest and largest sigma (logarithmic)
+  int _NumberOfScales;
+
+  /// Sensitivity to plate-like (alpha) and blob-like (beta) structures
+  double _Alpha, _Beta;
+
+  /// Sensitivity to second order structure, automatic if not positive
+  double _C;
+
+  /// Whether vessels are brighter than the background
+  bool _BrightVessels;
+
+  /// Optional output of the sigma with maximum response
+  irtkGenericImage<VoxelType> *_ScaleImage;
+
+  /// Update vesselness of slices z1 to z2-1 with the given Hessian, sigma and c
+  void Vesselness(int, int, irtkGenericImage<VoxelType> *, double, double, bool);
+
+  /// Returns whether the filter requires buffering
+  virtual bool RequiresBuffering();
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass();
+
+public:
+
+  /// Constructor
+  irtkVesselnessFilter(double = 1, double = 1, int = 1);
+
+  /// Destructor
+  ~irtkVesselnessFilter();
+
+  /// Set smallest sigma in mm
+  SetMacro(SigmaMin, double);
+
+  /// Get smallest sigma in mm
+  GetMacro(SigmaMin, double);
+
+  /// Set largest sigma in mm
+  SetMacro(SigmaMax, double);
+
+  /// Get largest sigma in mm
+  GetMacro(SigmaMax, double);
+
+  /// Set number of scales
+  SetMacro(NumberOfScales, int);
+
+  /// Get number of scales
+  GetMacro(NumberOfScales, int);
+
+  /// Set alpha
+  SetMacro(Alpha, double);
+
+  /// Get alpha
+  GetMacro(Alpha, double);
+
+  /// Set beta
+  SetMacro(Beta, double);
+
+  /// Get beta
+  GetMacro(Beta, double);
+
+  /// Set c
+  SetMacro(C, double);
+
+  /// Get c
+  GetMacro(C, double);
+
+  /// Set whether vessels are brighter than the background
+  SetMacro(BrightVessels, bool);
+
+  /// Get whether vessels are brighter than the background
+  GetMacro(BrightVessels, bool);
+
+  /// Set image for the sigma with maximum response (default is none)
+  SetMacro(ScaleImage, irtkGenericImage<VoxelType> *);
+
+  /// Run filter
+  virtual void Run();
+
+};
+
+#endif
@@ -8,6 +8,33 @@
 #include <irtkImage.h>
 #include <irtkAnisoDiffusion.h>
 
+// Number of lines whose tridiagonal systems are solved together
+static const int _AnisoDiffusionLines = 16;
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedAnisoDiffusion
+{
+
+  /// Pointer to filter
+  anisoDiffusion<VoxelType> *_filter;
+
+  /// Operation applied to the lines or planes
+  int _operation;
+
+public:
+
+  irtkMultiThreadedAnisoDiffusion(anisoDiffusion<VoxelType> *filter, int operation) {
+    _filter    = filter;
+    _operation = operation;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    _filter->Process(_operation, r.begin(), r.end());
+  }
+};
+
+#endif
 
 template <class VoxelType> anisoDiffusion<VoxelType>::anisoDiffusion(){
   //default parameters
@@ -23,6 +50,9 @@ template <class VoxelType> anisoDiffusion<VoxelType>::anisoDiffusion(){
   ITERATIONS_NB=5;
   TimeDependent=false;
   SemiImplicit=true;
+  ConjugateGradient=false;
+  CG_ITERATIONS_NB=100;
+  CG_TOLERANCE=0.0001;
 }
 
 template <class VoxelType> anisoDiffusion<VoxelType>::~anisoDiffusion(void)
@@ -39,479 +69,344 @@ template <class VoxelType> const char *anisoDiffusion<VoxelType>::NameOfClass()
 }
 
 
-template <class VoxelType> void anisoDiffusion<VoxelType>::Run_3D_semiImplicit(){
-	int i, j, x, y, z, t;
-	double  ax,ay,az,at,dx,dy,dz,dt;
-	float dTau;
-	float*** imageE;
-	float*** imageO;
-	int NBX,NBY,NBZ,NBT;
-	double dIdx,dIdy,dIdz;
-	float DivDgradI;
-	float *Va;
-	float *Vb; 
-	float *Vc;
-	float *Vd;
-	float *Vx;
-	int n;
-	int ITERATIONS_NB;
-	float Dxx_div_dxSq,Dyy_div_dySq,Dzz_div_dzSq;
-	int iteration;
-	float DivPowDxSqu,DivPowDySqu,DivPowDzSqu,DivPowDtSqu;
+template <class VoxelType> void anisoDiffusion<VoxelType>::Pad(float *image, int t){
+	int i, x, y, z, l, X, Y, Z, T;
 	
-	//1) INITIALISATION
-	
-	// Do the initial set up
-	this->Initialize();
+	X=this->_input->GetX();
+	Y=this->_input->GetY();
+	Z=this->_input->GetZ();
+	T=this->_input->GetT();
 	
-	//variables definition
-	ax=this->ax;
-	ay=this->ay;
-	az=this->az;
-	at=this->at;
-	dx=this->dx;
-	dy=this->dy;
-	dz=this->dz;
-	dt=this->dt;
-	dTau=this->dTau;
-	ITERATIONS_NB=this->ITERATIONS_NB;
-	NBX=this->_input->GetX()+2;  //for boundary effects
-	NBY=this->_input->GetY()+2;  //for boundary effects
-	NBZ=this->_input->GetZ()+2;  //for boundary effects
-	NBT=this->_input->GetT();
-	cout << "Image size: " << (NBX-2) <<  " , "  <<  (NBY-2)  <<  " , "  << (NBZ-2)  <<  " , " << NBT  << " + boundaries \n";
+	//the boundaries replicate the nearest voxel of the image
+	i=0;
+	for (l = 0; l < _NB[3]; l++) for (z = 0; z < _NB[2]; z++) for (y = 0; y < _NB[1]; y++) for (x = 0; x < _NB[0]; x++, i++)
+		image[i]=static_cast<float>(this->_input->Get(max(0, min(x-1, X-1)), max(0, min(y-1, Y-1)), max(0, min(z-1, Z-1)),
+		                                              (t < 0) ? max(0, min(l-1, T-1)) : t));
+}
+
+template <class VoxelType> void anisoDiffusion<VoxelType>::Process(int operation, int i1, int i2){
+	int i, j, k, l, m, n, a, p, q, N, B, lanes, first, base, planes;
+	int stride[4], lo[4], hi[4], other[2], coord[4];
+	double alpha[4], delta[4], dI, id, step, c, diagonal, product, sum[3];
+	float inverse[4], D, r;
+	float *src, *dst, *g;
 	
-	//temporary input and output images
-	imageE= (float***) malloc (NBZ*sizeof(float**));
-	for (i=0;i<NBZ;i++) imageE[i]= (float**) malloc (NBY*sizeof(float*));
-	for (i=0;i<NBZ;i++) for (j=0;j<NBY;j++) imageE[i][j]= (float*) malloc (NBX*sizeof(float));
+	src=_Source;
+	dst=_Destination;
+	step=this->dTau/static_cast<double>(_NumberOfAxes);
 	
-	imageO= (float***) malloc (NBZ*sizeof(float**));
-	for (i=0;i<NBZ;i++) imageO[i]= (float**) malloc (NBY*sizeof(float*));
-	for (i=0;i<NBZ;i++) for (j=0;j<NBY;j++) imageO[i][j]= (float*) malloc (NBX*sizeof(float));
+	//interior of the padded work images (images without time padding have a single frame)
+	stride[0]=1;
+	for (k = 1; k < 4; k++) stride[k]=stride[k-1]*_NB[k-1];
+	for (k = 0; k < 4; k++){
+		lo[k]=(_NB[k] > 1) ? 1 : 0;
+		hi[k]=(_NB[k] > 1) ? _NB[k]-1 : 1;
+	}
 	
-	//precomputed values
-	DivPowDxSqu=1./pow(dx,2);
-	DivPowDySqu=1./pow(dy,2);
-	DivPowDzSqu=1./pow(dz,2);
-	DivPowDtSqu=1./pow(dt,2);
+	alpha[0]=this->ax; alpha[1]=this->ay; alpha[2]=this->az; alpha[3]=this->at;
+	delta[0]=this->dx; delta[1]=this->dy; delta[2]=this->dz; delta[3]=this->dt;
+	inverse[0]=1./pow(delta[0],2);
+	inverse[1]=1./pow(delta[1],2);
+	inverse[2]=1./pow(delta[2],2);
+	inverse[3]=1./pow(delta[3],2);
 	
-	//temporary variables dedicated to the semi implicit scheme (+4 is to avoid boundary effects)
-	n=max(max(max(NBX,NBY),NBZ),NBT)+4; //for boundary effects
-	Va=(float*)malloc(n*sizeof(float));
-	Vb=(float*)malloc(n*sizeof(float));
-	Vc=(float*)malloc(n*sizeof(float));
-	Vd=(float*)malloc(n*sizeof(float));
-	Vx=(float*)malloc(n*sizeof(float));
-
-	//2) ANISOTROPIC DIFFUSION
-	for (t = 0; t < NBT; t++) {
-		cout << "Image " << t+1 << " / " << NBT << "\n";
-		//2.1) convert the values of the input image at time t in double in a temporary 3D image
-		for (z = 0; z < NBZ-2; z++)  for (y = 0; y < NBY-2; y++) for (x = 0; x < NBX-2; x++)
-			imageE[z+1][y+1][x+1]=static_cast<float>(this->_input->Get(x, y, z, t));
-		
-		for (z = 0; z < NBZ-2; z++)  for (y = 0; y < NBY-2; y++) for (x = 0; x < NBX-2; x++)
-			imageO[z+1][y+1][x+1]=static_cast<float>(this->_input->Get(x, y, z, t));
-		
-		//image extension to avoid boundary effects
-		for (z = 0; z < NBZ; z++) for (y = 0; y < NBY; y++) imageE[z][y][0]=imageE[z][y][1];
-		for (z = 0; z < NBZ; z++) for (y = 0; y < NBY; y++) imageE[z][y][NBX-1]=imageE[z][y][NBX-2];
-		for (z = 0; z < NBZ; z++) for (y = 0; y < NBY; y++) imageO[z][y][0]=imageO[z][y][1];
-		for (z = 0; z < NBZ; z++) for (y = 0; y < NBY; y++) imageO[z][y][NBX-1]=imageO[z][y][NBX-2];
+	if (operation == ADILines){
+		//lines along _Axis are solved in batches of neighbouring lines along x, or along y for the lines along x
+		a=_Axis;
+		l=(a == 0) ? 1 : 0;
+		n=0;
+		for (k = 0; k < 4; k++) if ((k != a) && (k != l)) other[n++]=k;
+		N=_NB[a];
+		B=_AnisoDiffusionLines;
 		
-		for (z = 0; z < NBZ; z++) for (x = 0; x < NBX; x++) imageE[z][0][x]=imageE[z][1][x];
-		for (z = 0; z < NBZ; z++) for (x = 0; x < NBX; x++) imageE[z][NBY-1][x]=imageE[z][NBY-2][x];
-		for (z = 0; z < NBZ; z++) for (x = 0; x < NBX; x++) imageO[z][0][x]=imageO[z][1][x];
-		for (z = 0; z < NBZ; z++) for (x = 0; x < NBX; x++) imageO[z][NBY-1][x]=imageO[z][NBY-2][x];
+		//coefficients of the tridiagonal systems, line k of a batch stores entry j at j*B+k
+		std::vector<float> Va((N+2)*B), Vb((N+2)*B), Vc((N+2)*B), Vd((N+2)*B);
 		
-		for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageE[0][y][x]=imageE[1][y][x];
-		for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageE[NBZ-1][y][x]=imageE[NBZ-2][y][x];
-		for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageO[0][y][x]=imageO[1][y][x];
-		for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageO[NBZ-1][y][x]=imageO[NBZ-2][y][x];
-		
-		//2.2) diffusion in the temporary 3D image - ADI semi implicit scheme
-		for (iteration=0 ; iteration<ITERATIONS_NB; iteration++){
-			cout << "| Iteration " << iteration+1 << " / " << ITERATIONS_NB << "\n";
-			
-			//2.2.2) diffusion - x implicit / y,z explicit
-			//2.2.2.1) explicit part
-			for (z = 1; z < NBZ-1; z++) for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-				dIdy=(imageE[z][y+1][x]-imageE[z][y-1][x])/(2*dy);
-				Dyy_div_dySq=static_cast<float>((1-exp(-3.314/pow((dIdy/ay),4)))*DivPowDySqu);
-				dIdz=(imageE[z+1][y][x]-imageE[z-1][y][x])/(2*dz);
-				Dzz_div_dzSq=static_cast<float>((1-exp(-3.314/pow((dIdz/az),4)))*DivPowDzSqu);
-				//new value of the voxel
-				DivDgradI=(imageE[z][y+1][x]-2*imageE[z][y][x]+imageE[z][y-1][x])*Dyy_div_dySq+
-					(imageE[z+1][y][x]-2*imageE[z][y][x]+imageE[z-1][y][x])*Dzz_div_dzSq;
+		for (i = i1; i < i2; i++){
+			base=(lo[other[0]]+i%(hi[other[0]]-lo[other[0]]))*stride[other[0]]+(lo[other[1]]+i/(hi[other[0]]-lo[other[0]]))*stride[other[1]];
+			for (first = lo[l]; first < hi[l]; first += B){
+				lanes=min(B, hi[l]-first);
 				
-				imageO[z][y][x]=imageE[z][y][x]+(dTau/3.)*DivDgradI;
-			}
+				for (j = 1; j < N-1; j++){
+					p=base+j*stride[a]+first*stride[l];
+					for (k = 0; k < lanes; k++, p += stride[l]){
+						dI=(src[p+stride[a]]-src[p-stride[a]])/(2*delta[a]);
+						D=static_cast<float>((1-exp(-3.314/pow((dI/alpha[a]),4)))*inverse[a]);
+						m=(j+1)*B+k;
+						Va[m]=step*D;
+						Vb[m]=-1-2*step*D;
+						Vc[m]=step*D;
+						Vd[m]=src[p];
+					}
+				}
+				for (k = 0; k < lanes; k++){ //to avoid boundary effects
+					Va[B+k]=Va[3*B+k]; Va[k]=Va[4*B+k]; Va[N*B+k]=Va[(N-2)*B+k]; Va[(N+1)*B+k]=Va[(N-3)*B+k];
+					Vb[B+k]=Vb[3*B+k]; Vb[k]=Vb[4*B+k]; Vb[N*B+k]=Vb[(N-2)*B+k]; Vb[(N+1)*B+k]=Vb[(N-3)*B+k];
+					Vc[B+k]=Vc[3*B+k]; Vc[k]=Vc[4*B+k]; Vc[N*B+k]=Vc[(N-2)*B+k]; Vc[(N+1)*B+k]=Vc[(N-3)*B+k];
+					Vd[B+k]=Vd[3*B+k]; Vd[k]=Vd[4*B+k]; Vd[N*B+k]=Vd[(N-2)*B+k]; Vd[(N+1)*B+k]=Vd[(N-3)*B+k];
+				}
 				
-			//2.2.2.2) implicit part
-			for (z = 1; z < NBZ-1; z++) for (y = 1; y < NBY-1; y++) {
-				for (x = 1; x < NBX-1; x++){
-					dIdx=(imageE[z][y][x+1]-imageE[z][y][x-1])/(2*dx);
-					Dxx_div_dxSq=static_cast<float>((1-exp(-3.314/pow((dIdx/ax),4)))*DivPowDxSqu);
-					Va[x+1]=(dTau/3.)*Dxx_div_dxSq;
-					Vb[x+1]=-1-2*(dTau/3.)*Dxx_div_dxSq;
-					Vc[x+1]=(dTau/3.)*Dxx_div_dxSq;
-                                        Vd[x+1]=imageE[z][y][x]; //why not imageO ???
+				//same elimination as TridiagonalSolveFloat for all lines of the batch, the solution overwrites Vd
+				for (k = 0; k < lanes; k++){
+					Vc[k]/=Vb[k];
+					Vd[k]/=Vb[k];
+				}
+				for (j = 1; j < N+2; j++){
+					for (k = 0; k < lanes; k++){
+						m=j*B+k;
+						id=(Vb[m]-Vc[m-B]*Va[m]);
+						Vc[m]/=id;
+						Vd[m]=(Vd[m]-Vd[m-B]*Va[m])/id;
+					}
+				}
+				for (j = N; j >= 2; j--){
+					for (k = 0; k < lanes; k++){
+						m=j*B+k;
+						Vd[m]=Vd[m]-Vc[m]*Vd[m+B];
+					}
 				}
-				Va[1]=Va[3]; Va[0]=Va[4]; Va[NBX]=Va[NBX-2]; Va[NBX+1]=Va[NBX-3]; //to avoid boundary effects
-				Vb[1]=Vb[3]; Vb[0]=Vb[4]; Vb[NBX]=Vb[NBX-2]; Vb[NBX+1]=Vb[NBX-3]; //to avoid boundary effects
-				Vc[1]=Vc[3]; Vc[0]=Vc[4]; Vc[NBX]=Vc[NBX-2]; Vc[NBX+1]=Vc[NBX-3]; //to avoid boundary effects
-				Vd[1]=Vd[3]; Vd[0]=Vd[4]; Vd[NBX]=Vd[NBX-2]; Vd[NBX+1]=Vd[NBX-3]; //to avoid boundary effects
-				TridiagonalSolveFloat(Va,Vb,Vc,Vd,Vx,NBX+2);
-				for (x = 1; x < NBX-1; x++) imageO[z][y][x]=-Vx[x+1];
-			}
-			
-			//2.2.3) diffusion - y implicit / x,z explicit
-			//2.2.3.1) explicit part
-			for (z = 1; z < NBZ-1; z++) for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-				dIdx=(imageO[z][y][x+1]-imageO[z][y][x-1])/(2*dx);
-				Dxx_div_dxSq=static_cast<float>((1-exp(-3.314/pow((dIdx/ax),4)))*DivPowDxSqu);
-				dIdz=(imageO[z+1][y][x]-imageO[z-1][y][x])/(2*dz);
-				Dzz_div_dzSq=static_cast<float>((1-exp(-3.314/pow((dIdz/az),4)))*DivPowDzSqu);
-				//new value of the voxel
-				DivDgradI=(imageO[z][y][x+1]-2*imageO[z][y][x]+imageO[z][y][x-1])*Dxx_div_dxSq+
-						(imageO[z+1][y][x]-2*imageO[z][y][x]+imageO[z-1][y][x])*Dzz_div_dzSq;
 				
-				imageE[z][y][x]=imageO[z][y][x]+(dTau/3.)*DivDgradI;
-			}
-			
-			//2.2.3.2) implicit part
-			for (z = 1; z < NBZ-1; z++) for (x = 1; x < NBX-1; x++){
-				for (y = 1; y < NBY-1; y++){
-					dIdy=(imageO[z][y+1][x]-imageO[z][y-1][x])/(2*dy);
-					Dyy_div_dySq=static_cast<float>((1-exp(-3.314/pow((dIdy/ay),4)))*DivPowDySqu);
-					Va[y+1]=(dTau/3.)*Dyy_div_dySq;
-					Vb[y+1]=-1-2*(dTau/3.)*Dyy_div_dySq;
-					Vc[y+1]=(dTau/3.)*Dyy_div_dySq;
-					Vd[y+1]=imageO[z][y][x];
+				for (j = 1; j < N-1; j++){
+					p=base+j*stride[a]+first*stride[l];
+					for (k = 0; k < lanes; k++, p += stride[l]) dst[p]=-Vd[(j+1)*B+k];
 				}
-				Va[1]=Va[3]; Va[0]=Va[4]; Va[NBY]=Va[NBY-2]; Va[NBY+1]=Va[NBY-3]; //to avoid boundary effects
-				Vb[1]=Vb[3]; Vb[0]=Vb[4]; Vb[NBY]=Vb[NBY-2]; Vb[NBY+1]=Vb[NBY-3]; //to avoid boundary effects
-				Vc[1]=Vc[3]; Vc[0]=Vc[4]; Vc[NBY]=Vc[NBY-2]; Vc[NBY+1]=Vc[NBY-3]; //to avoid boundary effects
-				Vd[1]=Vd[3]; Vd[0]=Vd[4]; Vd[NBY]=Vd[NBY-2]; Vd[NBY+1]=Vd[NBY-3]; //to avoid boundary effects
-				TridiagonalSolveFloat(Va,Vb,Vc,Vd,Vx,NBY+2);
-				for (y = 1; y < NBY-1; y++) imageE[z][y][x]=-Vx[y+1];
-			}
-		
-			//2.2.4) diffusion - z implicit / x,y explicit
-			//2.2.4.1) explicit part
-			for (z = 1; z < NBZ-1; z++) for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-				dIdx=(imageE[z][y][x+1]-imageE[z][y][x-1])/(2*dx);
-				Dxx_div_dxSq=static_cast<float>((1-exp(-3.314/pow((dIdx/ax),4)))*DivPowDxSqu);
-				dIdy=(imageE[z][y+1][x]-imageE[z][y-1][x])/(2*dy);
-				Dyy_div_dySq=static_cast<float>((1-exp(-3.314/pow((dIdy/ay),4)))*DivPowDySqu);
-				//new value of the voxel
-				DivDgradI=(imageE[z][y][x+1]-2*imageE[z][y][x]+imageE[z][y][x-1])*Dxx_div_dxSq+
-					(imageE[z][y+1][x]-2*imageE[z][y][x]+imageE[z][y-1][x])*Dyy_div_dySq;
-					
-				imageO[z][y][x]=imageE[z][y][x]+(dTau/3.)*DivDgradI;
 			}
+		}
+		return;
+	}
+	
+	//conjugate gradients on the planes of constant z and t
+	planes=hi[2]-lo[2];
+	for (i = i1; i < i2; i++){
+		coord[2]=lo[2]+i%planes;
+		coord[3]=lo[3]+i/planes;
+		sum[0]=sum[1]=sum[2]=0;
+		for (coord[1] = lo[1]; coord[1] < hi[1]; coord[1]++) for (coord[0] = lo[0]; coord[0] < hi[0]; coord[0]++){
+			p=coord[0]+coord[1]*stride[1]+coord[2]*stride[2]+coord[3]*stride[3];
 			
-			//2.2.4.2) implicit part
-			for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-				for (z = 1; z < NBZ-1; z++){
-					dIdz=(imageE[z+1][y][x]-imageE[z-1][y][x])/(2*dz);
-					Dzz_div_dzSq=static_cast<float>((1-exp(-3.314/pow((dIdz/az),4)))*DivPowDzSqu);
-					Va[z+1]=(dTau/3.)*Dzz_div_dzSq;
-					Vb[z+1]=-1-2*(dTau/3.)*Dzz_div_dzSq;
-					Vc[z+1]=(dTau/3.)*Dzz_div_dzSq;
-					Vd[z+1]=imageE[z][y][x];
+			if (operation == CGDiffusivity){
+				for (a = 0; a < 4; a++){
+					if (hi[a]-lo[a] < 2) continue;
+					dI=(src[p+stride[a]]-src[p-stride[a]])/(2*delta[a]);
+					_Diffusivity[a][p]=static_cast<float>((1-exp(-3.314/pow((dI/alpha[a]),4)))*inverse[a]);
 				}
-				Va[1]=Va[3]; Va[0]=Va[4]; Va[NBZ]=Va[NBZ-2]; Va[NBZ+1]=Va[NBZ-3]; //to avoid boundary effects
-				Vb[1]=Vb[3]; Vb[0]=Vb[4]; Vb[NBZ]=Vb[NBZ-2]; Vb[NBZ+1]=Vb[NBZ-3]; //to avoid boundary effects
-				Vc[1]=Vc[3]; Vc[0]=Vc[4]; Vc[NBZ]=Vc[NBZ-2]; Vc[NBZ+1]=Vc[NBZ-3]; //to avoid boundary effects
-				Vd[1]=Vd[3]; Vd[0]=Vd[4]; Vd[NBZ]=Vd[NBZ-2]; Vd[NBZ+1]=Vd[NBZ-3]; //to avoid boundary effects
-				TridiagonalSolveFloat(Va,Vb,Vc,Vd,Vx,NBZ+2);
-				for (z = 1; z < NBZ-1; z++) imageO[z][y][x]=-Vx[z+1];
 			}
-			
-			/*for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-				for (z = 1; z < NBZ-1; z++){
-					dIdz=(imageE[z+1][y][x]-imageE[z-1][y][x])/(2*dz);
-					Dzz_div_dzSq=static_cast<float>((1-exp(-3.314/pow((dIdz/az),4)))*DivPowDzSqu);
-					Va[z-1]=(dTau/3.)*Dzz_div_dzSq;
-					Vb[z-1]=-1-2*(dTau/3.)*Dzz_div_dzSq;
-					Vc[z-1]=(dTau/3.)*Dzz_div_dzSq;
-					Vd[z-1]=imageE[z][y][x];
+			else if ((operation == CGStart) || (operation == CGProduct)){
+				//product with the coupled system, diffusivities between voxels are averaged and vanish at the boundaries
+				const float *v=(operation == CGStart) ? src : &(_Direction[0]);
+				diagonal=1;
+				product=v[p];
+				for (a = 0; a < 4; a++){
+					if (hi[a]-lo[a] < 2) continue;
+					g=&(_Diffusivity[a][0]);
+					q=stride[a];
+					if (coord[a] > lo[a]){
+						c=step*0.5*(g[p]+g[p-q]);
+						diagonal+=c;
+						product+=c*(v[p]-v[p-q]);
+					}
+					if (coord[a] < hi[a]-1){
+						c=step*0.5*(g[p]+g[p+q]);
+						diagonal+=c;
+						product+=c*(v[p]-v[p+q]);
+					}
 				}
-				TridiagonalSolveFloat(Va,Vb,Vc,Vd,Vx,NBZ-2);
-				for (z = 1; z < NBZ-1; z++) imageO[z][y][x]=-Vx[z-1];
-			}*/
-		
-			//2.2.5) temporary output image is reinjected in temporary input image
-			for (z = 0; z < NBZ; z++) for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++)
-				imageE[z][y][x]=imageO[z][y][x];
-				
+				if (operation == CGStart){
+					_Diagonal[p]=diagonal;
+					r=src[p]-product;
+					_Residual[p]=r;
+					_Preconditioned[p]=r/diagonal;
+					_Direction[p]=_Preconditioned[p];
+					sum[0]+=r*_Preconditioned[p];
+					sum[1]+=r*r;
+					sum[2]+=src[p]*src[p];
+				}
+				else{
+					_Product[p]=product;
+					sum[0]+=_Direction[p]*product;
+				}
+			}
+			else if (operation == CGUpdate){
+				dst[p]+=_Alpha*_Direction[p];
+				_Residual[p]-=_Alpha*_Product[p];
+				_Preconditioned[p]=_Residual[p]/_Diagonal[p];
+				sum[0]+=_Residual[p]*_Preconditioned[p];
+				sum[1]+=_Residual[p]*_Residual[p];
+			}
+			else if (operation == CGDirection){
+				_Direction[p]=_Preconditioned[p]+_Beta*_Direction[p];
+			}
 		}
-		//2.3) save the filtered temporary 3D image in VoxelType in the  output image at time t
-		for (z = 0; z < NBZ-2; z++) for (y = 0; y < NBY-2; y++) for (x = 0; x < NBX-2; x++) 
-			this->_output->Put(x, y, z, t, static_cast<VoxelType>(imageE[z+1][y+1][x+1]));
+		for (k = 0; k < 3; k++) _Sum[k][i]=sum[k];
 	}
-	
-	//3) END OF THE FUNCTION
-	// Do the final cleaning up
-	this->Finalize();
 }
 
+template <class VoxelType> void anisoDiffusion<VoxelType>::Parallel(int operation, int n){
+#ifdef HAS_TBB
+	parallel_for(blocked_range<int>(0, n, 1), irtkMultiThreadedAnisoDiffusion<VoxelType>(this, operation));
+#else
+	this->Process(operation, 0, n);
+#endif
+}
 
+template <class VoxelType> void anisoDiffusion<VoxelType>::ConjugateGradientStep(){
+	int i, k, n, planes;
+	double sum[3], rz;
+	
+	n=_NB[0]*_NB[1]*_NB[2]*_NB[3];
+	planes=((_NB[2] > 1) ? _NB[2]-2 : 1)*((_NB[3] > 1) ? _NB[3]-2 : 1);
+	for (k = 0; k < 3; k++) _Sum[k].resize(planes);
+	
+	//the current image is the right hand side and the initial solution
+	memcpy(_Destination, _Source, n*sizeof(float));
+	this->Parallel(CGDiffusivity, planes);
+	
+	//partial sums are added in the order of the planes so that the result does not depend on the threads
+	this->Parallel(CGStart, planes);
+	sum[0]=sum[1]=sum[2]=0;
+	for (i = 0; i < planes; i++) for (k = 0; k < 3; k++) sum[k]+=_Sum[k][i];
+	rz=sum[0];
+	
+	for (i = 0; (i < this->CG_ITERATIONS_NB) && (sum[1] > this->CG_TOLERANCE*this->CG_TOLERANCE*sum[2]); i++){
+		this->Parallel(CGProduct, planes);
+		sum[0]=0;
+		for (k = 0; k < planes; k++) sum[0]+=_Sum[0][k];
+		if (sum[0] <= 0) break;
+		_Alpha=rz/sum[0];
+		
+		this->Parallel(CGUpdate, planes);
+		sum[0]=sum[1]=0;
+		for (k = 0; k < planes; k++){
+			sum[0]+=_Sum[0][k];
+			sum[1]+=_Sum[1][k];
+		}
+		_Beta=sum[0]/rz;
+		rz=sum[0];
+		
+		this->Parallel(CGDirection, planes);
+	}
+}
 
-template <class VoxelType> void anisoDiffusion<VoxelType>::Run_4D_semiImplicit(){
-	int i, j, x, y, z, t;
-	double  ax,ay,az,at,dx,dy,dz,dt;
-	float dTau;
-	float**** imageE;
-	float**** imageO;
-	int NBX,NBY,NBZ,NBT;
-	double dIdx,dIdy,dIdz,dIdt;
-	float DivDgradI;
-	float *Va;
-	float *Vb; 
-	float *Vc;
-	float *Vd;
-	float *Vx;
-	int n;
-	int ITERATIONS_NB;
-	float Dxx_div_dxSq,Dyy_div_dySq,Dzz_div_dzSq,Dtt_div_dtSq;
-	int iteration;
-	float DivPowDxSqu,DivPowDySqu,DivPowDzSqu,DivPowDtSqu;
+template <class VoxelType> float *anisoDiffusion<VoxelType>::Diffuse(float *imageE, float *imageO){
+	int a, k, n, lines, iteration;
+	float *swap;
 	
-	//1) INITIALISATION
+	n=_NB[0]*_NB[1]*_NB[2]*_NB[3];
+	if (this->ConjugateGradient==true){
+		for (a = 0; a < 4; a++) _Diffusivity[a].resize(n);
+		_Diagonal.resize(n);
+		_Residual.resize(n);
+		_Direction.resize(n);
+		_Preconditioned.resize(n);
+		_Product.resize(n);
+	}
+	
+	for (iteration=0 ; iteration<this->ITERATIONS_NB; iteration++){
+		cout << "| Iteration " << iteration+1 << " / " << this->ITERATIONS_NB << "\n";
+		
+		if (this->ConjugateGradient==true){
+			_Source=imageE;
+			_Destination=imageO;
+			this->ConjugateGradientStep();
+			swap=imageE; imageE=imageO; imageO=swap;
+			continue;
+		}
+		
+		//ADI: diffusion implicit along one axis after the other. Each step reads the result of the previous one.
+		for (a = 0; a < _NumberOfAxes; a++){
+			if (_NB[a] < 5) continue; //at least three voxels are needed along the axis
+			lines=1;
+			for (k = 0; k < 4; k++) if ((k != a) && (k != ((a == 0) ? 1 : 0)) && (_NB[k] > 1)) lines*=_NB[k]-2;
+			_Source=imageE;
+			_Destination=imageO;
+			_Axis=a;
+			this->Parallel(ADILines, lines);
+			swap=imageE; imageE=imageO; imageO=swap;
+		}
+	}
+	return imageE;
+}
+
+template <class VoxelType> void anisoDiffusion<VoxelType>::Run_3D_semiImplicit(){
+	int i, n, x, y, z, t;
+	float *image;
 	
 	// Do the initial set up
 	this->Initialize();
 	
-	//variables definition
-	ax=this->ax;
-	ay=this->ay;
-	az=this->az;
-	at=this->at;
-	dx=this->dx;
-	dy=this->dy;
-	dz=this->dz;
-	dt=this->dt;
-	dTau=this->dTau;
-	ITERATIONS_NB=this->ITERATIONS_NB;
-	NBX=this->_input->GetX()+2;
-	NBY=this->_input->GetY()+2;
-	NBZ=this->_input->GetZ()+2;
-	NBT=this->_input->GetT()+2;
-	cout << "Image size: " << (NBX-2) <<  " , "  <<  (NBY-2)  <<  " , "  << (NBZ-2)  <<  " , " << (NBT-2)  << " + boundaries \n";
+	_NB[0]=this->_input->GetX()+2;  //for boundary effects
+	_NB[1]=this->_input->GetY()+2;  //for boundary effects
+	_NB[2]=this->_input->GetZ()+2;  //for boundary effects
+	_NB[3]=1;
+	_NumberOfAxes=3;
+	cout << "Image size: " << (_NB[0]-2) <<  " , "  <<  (_NB[1]-2)  <<  " , "  << (_NB[2]-2)  <<  " , " << this->_input->GetT()  << " + boundaries \n";
 	
 	//temporary input and output images
-	imageE= (float****) malloc (NBT*sizeof(float***));
-	for (t=0;t<NBT;t++) imageE[t]= (float***) malloc (NBZ*sizeof(float**));
-	for (t=0;t<NBT;t++) for (i=0;i<NBZ;i++) imageE[t][i]= (float**) malloc (NBY*sizeof(float*));
-	for (t=0;t<NBT;t++) for (i=0;i<NBZ;i++) for (j=0;j<NBY;j++) imageE[t][i][j]= (float*) malloc (NBX*sizeof(float));
+	n=_NB[0]*_NB[1]*_NB[2];
+	std::vector<float> imageE(n), imageO(n);
 	
-	imageO= (float****) malloc (NBT*sizeof(float***));
-	for (t=0;t<NBT;t++) imageO[t]= (float***) malloc (NBZ*sizeof(float**));
-	for (t=0;t<NBT;t++) for (i=0;i<NBZ;i++) imageO[t][i]= (float**) malloc (NBY*sizeof(float*));
-	for (t=0;t<NBT;t++) for (i=0;i<NBZ;i++) for (j=0;j<NBY;j++) imageO[t][i][j]= (float*) malloc (NBX*sizeof(float));
+#ifdef HAS_TBB
+	task_scheduler_init init(tbb_no_threads);
+#endif
 	
-	//precomputed values
-	DivPowDxSqu=1./pow(dx,2);
-	DivPowDySqu=1./pow(dy,2);
-	DivPowDzSqu=1./pow(dz,2);
-	DivPowDtSqu=1./pow(dt,2);
-	
-	//temporary variables dedicated to the semi implicit scheme
-	n=max(max(max(NBX,NBY),NBZ),NBT)+4; //for boundary effects
-	Va=(float*)malloc(n*sizeof(float));
-	Vb=(float*)malloc(n*sizeof(float));
-	Vc=(float*)malloc(n*sizeof(float));
-	Vd=(float*)malloc(n*sizeof(float));
-	Vx=(float*)malloc(n*sizeof(float));
-
-	//2) ANISOTROPIC DIFFUSION
+	for (t = 0; t < this->_input->GetT(); t++) {
+		cout << "Image " << t+1 << " / " << this->_input->GetT() << "\n";
+		this->Pad(&(imageE[0]), t);
+		imageO=imageE;
 		
-	//2.1) convert the values of the input image at time t in double in a temporary 3D image
-	for (t = 0; t < NBT-2; t++) for (z = 0; z < NBZ-2; z++)  for (y = 0; y < NBY-2; y++) for (x = 0; x < NBX-2; x++)
-		imageE[t+1][z+1][y+1][x+1]=static_cast<float>(this->_input->Get(x, y, z, t));
+		image=this->Diffuse(&(imageE[0]), &(imageO[0]));
+		
+		for (z = 0; z < _NB[2]-2; z++) for (y = 0; y < _NB[1]-2; y++) {
+			i=((z+1)*_NB[1]+y+1)*_NB[0]+1;
+			for (x = 0; x < _NB[0]-2; x++, i++) this->_output->Put(x, y, z, t, static_cast<VoxelType>(image[i]));
+		}
+	}
 	
-	for (t = 0; t < NBT-2; t++) for (z = 0; z < NBZ-2; z++)  for (y = 0; y < NBY-2; y++) for (x = 0; x < NBX-2; x++)
-		imageO[t+1][z+1][y+1][x+1]=static_cast<float>(this->_input->Get(x, y, z, t));
+#ifdef HAS_TBB
+	init.terminate();
+#endif
 	
-	for (t = 0; t < NBT; t++)  for (z = 0; z < NBZ; z++) for (y = 0; y < NBY; y++) imageE[t][z][y][0]=imageE[t][z][y][1];
-	for (t = 0; t < NBT; t++)  for (z = 0; z < NBZ; z++) for (y = 0; y < NBY; y++) imageE[t][z][y][NBX-1]=imageE[t][z][y][NBX-2];
-	for (t = 0; t < NBT; t++)  for (z = 0; z < NBZ; z++) for (y = 0; y < NBY; y++) imageO[t][z][y][0]=imageO[t][z][y][1];
-	for (t = 0; t < NBT; t++)  for (z = 0; z < NBZ; z++) for (y = 0; y < NBY; y++) imageO[t][z][y][NBX-1]=imageO[t][z][y][NBX-2];
+	// Do the final cleaning up
+	this->Finalize();
+}
+
+template <class VoxelType> void anisoDiffusion<VoxelType>::Run_4D_semiImplicit(){
+	int i, n, x, y, z, t;
+	float *image;
 	
-	for (t = 0; t < NBT; t++)  for (z = 0; z < NBZ; z++) for (x = 0; x < NBX; x++) imageE[t][z][0][x]=imageE[t][z][1][x];
-	for (t = 0; t < NBT; t++)  for (z = 0; z < NBZ; z++) for (x = 0; x < NBX; x++) imageE[t][z][NBY-1][x]=imageE[t][z][NBY-2][x];
-	for (t = 0; t < NBT; t++)  for (z = 0; z < NBZ; z++) for (x = 0; x < NBX; x++) imageO[t][z][0][x]=imageO[t][z][1][x];
-	for (t = 0; t < NBT; t++)  for (z = 0; z < NBZ; z++) for (x = 0; x < NBX; x++) imageO[t][z][NBY-1][x]=imageO[t][z][NBY-2][x];
+	// Do the initial set up
+	this->Initialize();
 	
+	_NB[0]=this->_input->GetX()+2;
+	_NB[1]=this->_input->GetY()+2;
+	_NB[2]=this->_input->GetZ()+2;
+	_NB[3]=this->_input->GetT()+2;
+	_NumberOfAxes=4;
+	cout << "Image size: " << (_NB[0]-2) <<  " , "  <<  (_NB[1]-2)  <<  " , "  << (_NB[2]-2)  <<  " , " << (_NB[3]-2)  << " + boundaries \n";
 	
-	for (t = 0; t < NBT; t++)  for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageE[t][0][y][x]=imageE[t][1][y][x];
-	for (t = 0; t < NBT; t++)  for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageE[t][NBZ-1][y][x]=imageE[t][NBZ-2][y][x];
-	for (t = 0; t < NBT; t++)  for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageO[t][0][y][x]=imageO[t][1][y][x];
-	for (t = 0; t < NBT; t++)  for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageO[t][NBZ-1][y][x]=imageO[t][NBZ-2][y][x];
-
-	for (z = 0; z < NBZ; z++)  for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageE[0][z][y][x]=imageE[0][z][y][x];
-	for (z = 0; z < NBZ; z++)  for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageE[NBT-1][z][y][x]=imageE[NBT-1][z][y][x];
-	for (z = 0; z < NBZ; z++)  for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageO[0][z][y][x]=imageO[0][z][y][x];
-	for (z = 0; z < NBZ; z++)  for (y = 0; y < NBY; y++) for (x = 0; x < NBX; x++) imageO[NBT-1][z][y][x]=imageO[NBT-1][z][y][x];
-
+	//temporary input and output images
+	n=_NB[0]*_NB[1]*_NB[2]*_NB[3];
+	std::vector<float> imageE(n), imageO(n);
+	this->Pad(&(imageE[0]), -1);
+	imageO=imageE;
 	
-	//2.2) DIFFUSION
-	//2.2) diffusion in the temporary 4D image - ADI semi implicit scheme
-	for (iteration=0 ; iteration<ITERATIONS_NB; iteration++){
-		cout << "| Iteration " << iteration+1 << " / " << ITERATIONS_NB << "\n";
-		
-		//2.2.1) diffusion - x implicit / y,z,t explicit
-		//2.2.1.1) explicit part
-		for (t = 1; t < NBT-1; t++) for (z = 1; z < NBZ-1; z++) for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-			dIdy=(imageE[t][z][y+1][x]-imageE[t][z][y-1][x])/(2*dy);
-			Dyy_div_dySq=static_cast<float>((1-exp(-3.314/pow((dIdy/ay),4)))*DivPowDySqu);
-			dIdz=(imageE[t][z+1][y][x]-imageE[t][z-1][y][x])/(2*dz);
-			Dzz_div_dzSq=static_cast<float>((1-exp(-3.314/pow((dIdz/az),4)))*DivPowDzSqu);
-			dIdt=(imageE[t+1][z][y][x]-imageE[t-1][z][y][x])/(2*dt);
-			Dtt_div_dtSq=static_cast<float>((1-exp(-3.314/pow((dIdt/at),4)))*DivPowDzSqu);
-			//new value of the voxel
-			DivDgradI=(imageE[t][z][y+1][x]-2*imageE[t][z][y][x]+imageE[t][z][y-1][x])*Dyy_div_dySq+
-					(imageE[t][z+1][y][x]-2*imageE[t][z][y][x]+imageE[t][z-1][y][x])*Dzz_div_dzSq+
-					(imageE[t+1][z][y][x]-2*imageE[t][z][y][x]+imageE[t-1][z][y][x])*Dtt_div_dtSq;
-
-			imageO[t][z][y][x]=imageE[t][z][y][x]+(dTau/4.)*DivDgradI;
-		}
-		
-		//2.2.1.2) implicit part
-		for (t = 1; t < NBT-1; t++) for (z = 1; z < NBZ-1; z++) for (y = 1; y < NBY-1; y++) {
-			for (x = 1; x < NBX-1; x++){
-				dIdx=(imageE[t][z][y][x+1]-imageE[t][z][y][x-1])/(2*dx);
-				Dxx_div_dxSq=static_cast<float>((1-exp(-3.314/pow((dIdx/ax),4)))*DivPowDxSqu);
-				Va[x+1]=(dTau/4.)*Dxx_div_dxSq;
-				Vb[x+1]=-1-2*(dTau/4.)*Dxx_div_dxSq;
-				Vc[x+1]=(dTau/4.)*Dxx_div_dxSq;
-				Vd[x+1]=imageE[t][z][y][x];
-			}
-			Va[1]=Va[3]; Va[0]=Va[4]; Va[NBX]=Va[NBX-2]; Va[NBX+1]=Va[NBX-3]; //to avoid boundary effects
-			Vb[1]=Vb[3]; Vb[0]=Vb[4]; Vb[NBX]=Vb[NBX-2]; Vb[NBX+1]=Vb[NBX-3]; //to avoid boundary effects
-			Vc[1]=Vc[3]; Vc[0]=Vc[4]; Vc[NBX]=Vc[NBX-2]; Vc[NBX+1]=Vc[NBX-3]; //to avoid boundary effects
-			Vd[1]=Vd[3]; Vd[0]=Vd[4]; Vd[NBX]=Vd[NBX-2]; Vd[NBX+1]=Vd[NBX-3]; //to avoid boundary effects
-			TridiagonalSolveFloat(Va,Vb,Vc,Vd,Vx,NBX+2);
-			for (x = 1; x < NBX-1; x++) imageO[t][z][y][x]=-Vx[x+1];
-		}
-		
-		//2.2.2) diffusion - y implicit / x,z,t explicit
-		//2.2.2.1) explicit part
-		for (t = 1; t < NBT-1; t++) for (z = 1; z < NBZ-1; z++) for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-			dIdx=(imageO[t][z][y][x+1]-imageO[t][z][y][x-1])/(2*dx);
-			Dxx_div_dxSq=static_cast<float>((1-exp(-3.314/pow((dIdx/ax),4)))*DivPowDxSqu);
-			dIdz=(imageO[t][z+1][y][x]-imageO[t][z-1][y][x])/(2*dz);
-			Dzz_div_dzSq=static_cast<float>((1-exp(-3.314/pow((dIdz/az),4)))*DivPowDzSqu);
-			dIdt=(imageO[t+1][z][y][x]-imageO[t-1][z][y][x])/(2*dt);
-			Dtt_div_dtSq=static_cast<float>((1-exp(-3.314/pow((dIdt/at),4)))*DivPowDzSqu);
-			//new value of the voxel
-			DivDgradI=(imageO[t][z][y][x+1]-2*imageO[t][z][y][x]+imageO[t][z][y][x-1])*Dxx_div_dxSq+
-					(imageO[t][z+1][y][x]-2*imageO[t][z][y][x]+imageO[t][z-1][y][x])*Dzz_div_dzSq+
-					(imageO[t+1][z][y][x]-2*imageO[t][z][y][x]+imageO[t-1][z][y][x])*Dtt_div_dtSq;
-			
-			imageE[t][z][y][x]=imageO[t][z][y][x]+(dTau/4.)*DivDgradI;
-		}
-		
-		//2.2.2.2) implicit part
-		for (t = 1; t < NBT-1; t++) for (z = 1; z < NBZ-1; z++) for (x = 1; x < NBX-1; x++){
-			for (y = 1; y < NBY-1; y++){
-				dIdy=(imageO[t][z][y+1][x]-imageO[t][z][y-1][x])/(2*dy);
-				Dyy_div_dySq=static_cast<float>((1-exp(-3.314/pow((dIdy/ay),4)))*DivPowDySqu);
-				Va[y+1]=(dTau/4.)*Dyy_div_dySq;
-				Vb[y+1]=-1-2*(dTau/4.)*Dyy_div_dySq;
-				Vc[y+1]=(dTau/4.)*Dyy_div_dySq;
-				Vd[y+1]=imageO[t][z][y][x];
-			}
-			Va[1]=Va[3]; Va[0]=Va[4]; Va[NBY]=Va[NBY-2]; Va[NBY+1]=Va[NBY-3]; //to avoid boundary effects
-			Vb[1]=Vb[3]; Vb[0]=Vb[4]; Vb[NBY]=Vb[NBY-2]; Vb[NBY+1]=Vb[NBY-3]; //to avoid boundary effects
-			Vc[1]=Vc[3]; Vc[0]=Vc[4]; Vc[NBY]=Vc[NBY-2]; Vc[NBY+1]=Vc[NBY-3]; //to avoid boundary effects
-			Vd[1]=Vd[3]; Vd[0]=Vd[4]; Vd[NBY]=Vd[NBY-2]; Vd[NBY+1]=Vd[NBY-3]; //to avoid boundary effects
-			TridiagonalSolveFloat(Va,Vb,Vc,Vd,Vx,NBY+2);
-			for (y = 1; y < NBY-1; y++) imageE[t][z][y][x]=-Vx[y+1];
-		}
+#ifdef HAS_TBB
+	task_scheduler_init init(tbb_no_threads);
+#endif
 	
-		//2.2.3) diffusion - z implicit / x,y,t explicit
-		//2.2.3.1) explicit part
-		for (t = 1; t < NBT-1; t++) for (z = 1; z < NBZ-1; z++) for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-			dIdx=(imageE[t][z][y][x+1]-imageE[t][z][y][x-1])/(2*dx);
-			Dxx_div_dxSq=static_cast<float>((1-exp(-3.314/pow((dIdx/ax),4)))*DivPowDxSqu);
-			dIdy=(imageE[t][z][y+1][x]-imageE[t][z][y-1][x])/(2*dy);
-			Dyy_div_dySq=static_cast<float>((1-exp(-3.314/pow((dIdy/ay),4)))*DivPowDySqu);
-			dIdt=(imageE[t+1][z][y][x]-imageE[t-1][z][y][x])/(2*dt);
-			Dtt_div_dtSq=static_cast<float>((1-exp(-3.314/pow((dIdt/at),4)))*DivPowDzSqu);
-			//new value of the voxel
-			DivDgradI=(imageE[t][z][y][x+1]-2*imageE[t][z][y][x]+imageE[t][z][y][x-1])*Dxx_div_dxSq+
-					(imageE[t][z][y+1][x]-2*imageE[t][z][y][x]+imageE[t][z][y-1][x])*Dyy_div_dySq+
-					(imageE[t+1][z][y][x]-2*imageE[t][z][y][x]+imageE[t-1][z][y][x])*Dtt_div_dtSq;
+	image=this->Diffuse(&(imageE[0]), &(imageO[0]));
 	
-			imageO[t][z][y][x]=imageE[t][z][y][x]+(dTau/4.)*DivDgradI;
-		}
-		
-		//2.2.3.2) implicit part
-		for (t = 1; t < NBT-1; t++) for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-			for (z = 1; z < NBZ-1; z++){
-				dIdz=(imageE[t][z+1][y][x]-imageE[t][z-1][y][x])/(2*dz);
-				Dzz_div_dzSq=static_cast<float>((1-exp(-3.314/pow((dIdz/az),4)))*DivPowDzSqu);
-				Va[z+1]=(dTau/4.)*Dzz_div_dzSq;
-				Vb[z+1]=-1-2*(dTau/4.)*Dzz_div_dzSq;
-				Vc[z+1]=(dTau/4.)*Dzz_div_dzSq;
-				Vd[z+1]=imageE[t][z][y][x];
-			}
-			Va[1]=Va[3]; Va[0]=Va[4]; Va[NBZ]=Va[NBZ-2]; Va[NBZ+1]=Va[NBZ-3]; //to avoid boundary effects
-			Vb[1]=Vb[3]; Vb[0]=Vb[4]; Vb[NBZ]=Vb[NBZ-2]; Vb[NBZ+1]=Vb[NBZ-3]; //to avoid boundary effects
-			Vc[1]=Vc[3]; Vc[0]=Vc[4]; Vc[NBZ]=Vc[NBZ-2]; Vc[NBZ+1]=Vc[NBZ-3]; //to avoid boundary effects
-			Vd[1]=Vd[3]; Vd[0]=Vd[4]; Vd[NBZ]=Vd[NBZ-2]; Vd[NBZ+1]=Vd[NBZ-3]; //to avoid boundary effects
-			TridiagonalSolveFloat(Va,Vb,Vc,Vd,Vx,NBZ+2);
-			for (z = 1; z < NBZ-1; z++) imageO[t][z][y][x]=-Vx[z+1];
-		}
-		
-		//2.2.4) diffusion - t implicit / x,y,z explicit
-		//2.2.4.1) explicit part
-		for (t = 1; t < NBT-1; t++) for (z = 1; z < NBZ-1; z++) for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-			dIdx=(imageO[t][z][y][x+1]-imageO[t][z][y][x-1])/(2*dx);
-			Dxx_div_dxSq=static_cast<float>((1-exp(-3.314/pow((dIdx/ax),4)))*DivPowDxSqu);
-			dIdy=(imageO[t][z][y+1][x]-imageO[t][z][y-1][x])/(2*dy);
-			Dyy_div_dySq=static_cast<float>((1-exp(-3.314/pow((dIdy/ay),4)))*DivPowDySqu);
-			dIdz=(imageO[t][z+1][y][x]-imageO[t][z-1][y][x])/(2*dz);
-			Dzz_div_dzSq=static_cast<float>((1-exp(-3.314/pow((dIdz/az),4)))*DivPowDzSqu);
-			//new value of the voxel
-			DivDgradI=(imageO[t][z][y][x+1]-2*imageO[t][z][y][x]+imageO[t][z][y][x-1])*Dxx_div_dxSq+
-					(imageO[t][z][y+1][x]-2*imageO[t][z][y][x]+imageO[t][z][y-1][x])*Dyy_div_dySq+
-					(imageO[t][z+1][y][x]-2*imageO[t][z][y][x]+imageO[t][z-1][y][x])*Dzz_div_dzSq;
+#ifdef HAS_TBB
+	init.terminate();
+#endif
 	
-			imageE[t][z][y][x]=imageO[t][z][y][x]+(dTau/4.)*DivDgradI;
-		}
-		
-		//2.2.4.2) implicit part
-		for (z = 1; z < NBZ-1; z++) for (y = 1; y < NBY-1; y++) for (x = 1; x < NBX-1; x++) {
-			for (t = 1; t < NBT-1; t++){
-				dIdt=(imageO[t+1][z][y][x]-imageO[t-1][z][y][x])/(2*dt);
-				Dtt_div_dtSq=static_cast<float>((1-exp(-3.314/pow((dIdt/at),4)))*DivPowDzSqu);
-				Va[t+1]=(dTau/4.)*Dtt_div_dtSq;
-				Vb[t+1]=-1-2*(dTau/4.)*Dtt_div_dtSq;
-				Vc[t+1]=(dTau/4.)*Dtt_div_dtSq;
-				Vd[t+1]=imageO[t][z][y][x];
-			}
-			Va[1]=Va[3]; Va[0]=Va[4]; Va[NBT]=Va[NBT-2]; Va[NBT+1]=Va[NBT-3]; //to avoid boundary effects
-			Vb[1]=Vb[3]; Vb[0]=Vb[4]; Vb[NBT]=Vb[NBT-2]; Vb[NBT+1]=Vb[NBT-3]; //to avoid boundary effects
-			Vc[1]=Vc[3]; Vc[0]=Vc[4]; Vc[NBT]=Vc[NBT-2]; Vc[NBT+1]=Vc[NBT-3]; //to avoid boundary effects
-			Vd[1]=Vd[3]; Vd[0]=Vd[4]; Vd[NBT]=Vd[NBT-2]; Vd[NBT+1]=Vd[NBT-3]; //to avoid boundary effects
-			TridiagonalSolveFloat(Va,Vb,Vc,Vd,Vx,NBT+2);
-			for (t = 1; t < NBT-1; t++) imageE[t][z][y][x]=-Vx[t+1];
-		}
+	for (t = 0; t < _NB[3]-2; t++) for (z = 0; z < _NB[2]-2; z++) for (y = 0; y < _NB[1]-2; y++) {
+		i=(((t+1)*_NB[2]+z+1)*_NB[1]+y+1)*_NB[0]+1;
+		for (x = 0; x < _NB[0]-2; x++, i++) this->_output->Put(x, y, z, t, static_cast<VoxelType>(image[i]));
 	}
 	
-	//2.3) save the filtered temporary 3D image in VoxelType in the  output image at time t
-	for (t = 0; t < NBT-2; t++) for (z = 0; z < NBZ-2; z++) for (y = 0; y < NBY-2; y++) for (x = 0; x < NBX-2; x++) 
-		this->_output->Put(x, y, z, t, static_cast<VoxelType>(imageE[t+1][z+1][y+1][x+1]));
-	
-	
-	//3) END OF THE FUNCTION
 	// Do the final cleaning up
-	this->Finalize();	
+	this->Finalize();
 }
 
 
@@ -607,13 +502,13 @@ template <class VoxelType> void anisoDiffusion<VoxelType>::Run_4D_Explicit(){
 			dIdz=(imageE[t][z+1][y][x]-imageE[t][z-1][y][x])/(2*dz);
 			Dzz_div_dzSq=static_cast<float>((1-exp(-3.314/pow((dIdz/az),4)))*DivPowDzSqu);
 			dIdt=(imageE[t+1][z][y][x]-imageE[t-1][z][y][x])/(2*dt);
-			Dtt_div_dtSq=static_cast<float>((1-exp(-3.314/pow((dIdt/at),4)))*DivPowDzSqu);
+			Dtt_div_dtSq=static_cast<float>((1-exp(-3.314/pow((dIdt/at),4)))*DivPowDtSqu);
 			
 			//new value of the voxel
 			DivDgradI=(imageE[t][z][y][x+1]-2*imageE[t][z][y][x]+imageE[t][z][y][x-1])*Dxx_div_dxSq+
 					(imageE[t][z][y+1][x]-2*imageE[t][z][y][x]+imageE[t][z][y-1][x])*Dyy_div_dySq+
 					(imageE[t][z+1][y][x]-2*imageE[t][z][y][x]+imageE[t][z-1][y][x])*Dzz_div_dzSq+
-					(imageE[t+1][z][y][x]-2*imageE[t][z][y][x]+imageE[t-1][z][y][x])*Dzz_div_dzSq;
+					(imageE[t+1][z][y][x]-2*imageE[t][z][y][x]+imageE[t-1][z][y][x])*Dtt_div_dtSq;
 			
 			imageO[t][z][y][x]=imageE[t][z][y][x]+(dTau)*DivDgradI;
 		}
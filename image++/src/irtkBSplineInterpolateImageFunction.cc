@@ -14,6 +14,37 @@
 
 #include <irtkImageFunction.h>
 
+// Coefficients of all images, at most one of them not used by any interpolator
+static vector<irtkBSplineCoefficients *> _BSplineCoefficients;
+
+#ifdef HAS_TBB
+
+static tbb::mutex _BSplineCoefficientsMutex;
+
+class irtkMultiThreadedBSplineCoefficients
+{
+
+  /// Input image, coefficients, spline degree and axis
+  irtkBaseImage *_input;
+  irtkRealImage *_coeff;
+  int _degree, _axis;
+
+public:
+
+  irtkMultiThreadedBSplineCoefficients(irtkBaseImage *input, irtkRealImage *coeff, int degree, int axis) {
+    _input  = input;
+    _coeff  = coeff;
+    _degree = degree;
+    _axis   = axis;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    irtkBSplineInterpolateImageFunction::ComputeCoefficients(_input, *_coeff, _degree, _axis, r.begin(), r.end());
+  }
+};
+
+#endif
+
 irtkBSplineInterpolateImageFunction::irtkBSplineInterpolateImageFunction(int SplineDegree)
 {
   if ((SplineDegree < 2) || (SplineDegree > 5)) {
@@ -21,10 +52,14 @@ irtkBSplineInterpolateImageFunction::irtkBSplineInterpolateImageFunction(int Spl
     exit(1);
   }
   _SplineDegree = SplineDegree;
+  _Coefficients = NULL;
+  _coeff        = NULL;
 }
 
 irtkBSplineInterpolateImageFunction::~irtkBSplineInterpolateImageFunction(void)
-{}
+{
+  if (_Coefficients != NULL) ReleaseCoefficients(_Coefficients);
+}
 
 const char *irtkBSplineInterpolateImageFunction::NameOfClass()
 {
@@ -55,14 +90,15 @@ void irtkBSplineInterpolateImageFunction::Initialize()
   this->_y2 = this->_input->GetY() - round(_SplineDegree/2.0 + 1);
   this->_z2 = this->_input->GetZ() - round(_SplineDegree/2.0 + 1);
 
-  // Compute min and max values
-  this->_input->GetMinMaxAsDouble(&this->_min, &this->_max);
-
-  // Allocate coefficient image
-  this->_coeff = irtkRealImage(this->_x, this->_y, this->_z, this->_t);
+  // Get B-Spline interpolation coefficients, computing them unless they are cached
+  irtkBSplineCoefficients *coefficients = AcquireCoefficients(this->_input, this->_SplineDegree);
+  if (this->_Coefficients != NULL) ReleaseCoefficients(this->_Coefficients);
+  this->_Coefficients = coefficients;
+  this->_coeff = &(coefficients->_Coefficients);
 
-  // Compute B-Spline interpolation coefficients
-  this->ComputeCoefficients();
+  // Min and max values
+  this->_min = coefficients->_Min;
+  this->_max = coefficients->_Max;
 }
 
 double irtkBSplineInterpolateImageFunction::InitialAntiCausalCoefficient(double c[], int DataLength, double z)
@@ -143,15 +179,15 @@ void irtkBSplineInterpolateImageFunction::ConvertToInterpolationCoefficients(dou
   }
 }
 
-void irtkBSplineInterpolateImageFunction::ComputeCoefficients()
+void irtkBSplineInterpolateImageFunction::ComputeCoefficients(irtkBaseImage *input, irtkRealImage &coeff, int degree, int axis, int p1, int p2)
 {
-  double *data;
   double Pole[2];
   int NbPoles;
-  int x, y, z, t;
+  int n, p, x, y, z, t;
+  irtkRealPixel *ptr;
 
   /* recover the poles from a lookup table */
-  switch (_SplineDegree) {
+  switch (degree) {
   case 2:
     NbPoles = 1;
     Pole[0] = sqrt(8.0) - 3.0;
@@ -177,58 +213,243 @@ void irtkBSplineInterpolateImageFunction::ComputeCoefficients()
     exit(1);
   }
 
-  /* convert the image samples into interpolation coefficients */
-
-  /* in-place separable process, along x */
-  data = new double[_x];
-  for (t = 0; t < this->_t; t++) {
-    for (z = 0; z < this->_z; z++) {
-      for (y = 0; y < this->_y; y++) {
-        for (x = 0; x < this->_x; x++) {
-          data[x] = this->_input->GetAsDouble(x, y, z, t);
+  int X = coeff.GetX();
+  int Y = coeff.GetY();
+  int Z = coeff.GetZ();
+
+  /* in-place separable process, planes are xy for x and y and xz for z */
+  n = (axis == 0) ? X : ((axis == 1) ? Y : Z);
+  vector<double> data(X * n);
+
+  for (p = p1; p < p2; p++) {
+    if (axis == 0) {
+      t = p / Z;
+      z = p % Z;
+      for (y = 0; y < Y; y++) {
+        for (x = 0; x < X; x++) {
+          data[x] = input->GetAsDouble(x, y, z, t);
         }
-        ConvertToInterpolationCoefficients(data, this->_x, Pole, NbPoles, DBL_EPSILON);
-        for (x = 0; x < this->_x; x++) {
-          _coeff(x, y, z, t) = data[x];
+        ConvertToInterpolationCoefficients(&data[0], X, Pole, NbPoles, DBL_EPSILON);
+        ptr = coeff.GetPointerToVoxels(0, y, z, t);
+        for (x = 0; x < X; x++) {
+          ptr[x] = data[x];
         }
       }
-    }
-  }
-  delete []data;
-
-  /* in-place separable process, along y */
-  data = new double[_y];
-  for (t = 0; t < this->_t; t++) {
-    for (z = 0; z < this->_z; z++) {
-      for (x = 0; x < this->_x; x++) {
-        for (y = 0; y < this->_y; y++) {
-          data[y] = this->_coeff(x, y, z, t);
+    } else if (axis == 1) {
+      t = p / Z;
+      z = p % Z;
+      for (y = 0; y < Y; y++) {
+        ptr = coeff.GetPointerToVoxels(0, y, z, t);
+        for (x = 0; x < X; x++) {
+          data[x * Y + y] = ptr[x];
         }
-        ConvertToInterpolationCoefficients(data, this->_y, Pole, NbPoles, DBL_EPSILON);
-        for (y = 0; y < this->_y; y++) {
-          _coeff(x, y, z, t) = data[y];
+      }
+      for (x = 0; x < X; x++) {
+        ConvertToInterpolationCoefficients(&data[x * Y], Y, Pole, NbPoles, DBL_EPSILON);
+      }
+      for (y = 0; y < Y; y++) {
+        ptr = coeff.GetPointerToVoxels(0, y, z, t);
+        for (x = 0; x < X; x++) {
+          ptr[x] = data[x * Y + y];
         }
       }
-    }
-  }
-  delete []data;
-
-  /* in-place separable process, along z */
-  data = new double[_z];
-  for (t = 0; t < this->_t; t++) {
-    for (y = 0; y < this->_y; y++) {
-      for (x = 0; x < this->_x; x++) {
-        for (z = 0; z < this->_z; z++) {
-          data[z] = this->_coeff(x, y, z, t);
+    } else {
+      t = p / Y;
+      y = p % Y;
+      for (z = 0; z < Z; z++) {
+        ptr = coeff.GetPointerToVoxels(0, y, z, t);
+        for (x = 0; x < X; x++) {
+          data[x * Z + z] = ptr[x];
         }
-        ConvertToInterpolationCoefficients(data, this->_z, Pole, NbPoles, DBL_EPSILON);
-        for (z = 0; z < this->_z; z++) {
-          _coeff(x, y, z, t) = data[z];
+      }
+      for (x = 0; x < X; x++) {
+        ConvertToInterpolationCoefficients(&data[x * Z], Z, Pole, NbPoles, DBL_EPSILON);
+      }
+      for (z = 0; z < Z; z++) {
+        ptr = coeff.GetPointerToVoxels(0, y, z, t);
+        for (x = 0; x < X; x++) {
+          ptr[x] = data[x * Z + z];
         }
       }
     }
   }
-  delete []data;
+}
+
+void irtkBSplineInterpolateImageFunction::ComputeCoefficients(irtkBaseImage *input, irtkRealImage &coeff, int degree)
+{
+  int axis, planes;
+
+  coeff = irtkRealImage(input->GetX(), input->GetY(), input->GetZ(), input->GetT());
+
+  /* convert the image samples into interpolation coefficients */
+  for (axis = 0; axis < 3; axis++) {
+    if ((axis == 1) && (coeff.GetY() == 1)) continue;
+    if ((axis == 2) && (coeff.GetZ() == 1)) continue;
+    planes = (axis == 2) ? coeff.GetT() * coeff.GetY() : coeff.GetT() * coeff.GetZ();
+#ifdef HAS_TBB
+    task_scheduler_init init(tbb_no_threads);
+    parallel_for(blocked_range<int>(0, planes), irtkMultiThreadedBSplineCoefficients(input, &coeff, degree, axis));
+    init.terminate();
+#else
+    ComputeCoefficients(input, coeff, degree, axis, 0, planes);
+#endif
+  }
+}
+
+// Finalizer of MurmurHash3, every input bit affects every output bit
+static inline unsigned long long ChecksumMix(unsigned long long w)
+{
+  w ^= w >> 33;
+  w *= 0xff51afd7ed558ccdULL;
+  w ^= w >> 33;
+  w *= 0xc4ceb9fe1a85ec53ULL;
+  w ^= w >> 33;
+  return w;
+}
+
+unsigned long long irtkBSplineInterpolateImageFunction::Checksum(irtkBaseImage *input)
+{
+  size_t i, n, bytes;
+  unsigned long long h, w;
+  const unsigned char *ptr;
+
+  switch (input->GetScalarType()) {
+  case IRTK_VOXEL_CHAR:
+  case IRTK_VOXEL_UNSIGNED_CHAR:
+    bytes = 1;
+    break;
+  case IRTK_VOXEL_SHORT:
+  case IRTK_VOXEL_UNSIGNED_SHORT:
+    bytes = 2;
+    break;
+  case IRTK_VOXEL_INT:
+  case IRTK_VOXEL_UNSIGNED_INT:
+  case IRTK_VOXEL_FLOAT:
+    bytes = 4;
+    break;
+  default:
+    bytes = 8;
+    break;
+  }
+  n   = bytes * input->GetNumberOfVoxels();
+  ptr = static_cast<const unsigned char *>(input->GetScalarPointer());
+
+  // FNV-1a over 64-bit words, each mixed first so that a change in any bit,
+  // e.g. the sign of a double, changes all bits of the word which is added.
+  // The remaining bytes form a last word
+  h = 14695981039346656037ULL;
+  for (i = 0; i + 8 <= n; i += 8) {
+    memcpy(&w, ptr + i, 8);
+    h = (h ^ ChecksumMix(w)) * 1099511628211ULL;
+  }
+  if (i < n) {
+    w = 0;
+    memcpy(&w, ptr + i, n - i);
+    h = (h ^ ChecksumMix(w)) * 1099511628211ULL;
+  }
+  return ChecksumMix(h ^ n);
+}
+
+irtkBSplineCoefficients *irtkBSplineInterpolateImageFunction::AcquireCoefficients(irtkBaseImage *input, int degree)
+{
+  unsigned int i;
+  irtkBSplineCoefficients *coefficients;
+
+  unsigned long long checksum = Checksum(input);
+  irtkImageAttributes attr = input->GetImageAttributes();
+
+  {
+#ifdef HAS_TBB
+    tbb::mutex::scoped_lock lock(_BSplineCoefficientsMutex);
+#endif
+    for (i = 0; i < _BSplineCoefficients.size(); i++) {
+      coefficients = _BSplineCoefficients[i];
+      if ((coefficients->_Data == input->GetScalarPointer()) && (coefficients->_Attributes == attr) &&
+          (coefficients->_Type == input->GetScalarType()) && (coefficients->_SplineDegree == degree) &&
+          (coefficients->_Checksum == checksum)) {
+        coefficients->_References++;
+        return coefficients;
+      }
+    }
+  }
+
+  // Compute coefficients without holding the lock
+  coefficients = new irtkBSplineCoefficients;
+  coefficients->_Data         = input->GetScalarPointer();
+  coefficients->_Attributes   = attr;
+  coefficients->_Type         = input->GetScalarType();
+  coefficients->_SplineDegree = degree;
+  coefficients->_Checksum     = checksum;
+  coefficients->_References   = 1;
+  input->GetMinMaxAsDouble(&coefficients->_Min, &coefficients->_Max);
+  ComputeCoefficients(input, coefficients->_Coefficients, degree);
+
+  {
+#ifdef HAS_TBB
+    tbb::mutex::scoped_lock lock(_BSplineCoefficientsMutex);
+#endif
+    vector<irtkBSplineCoefficients *> cache;
+    for (i = 0; i < _BSplineCoefficients.size(); i++) {
+      irtkBSplineCoefficients *other = _BSplineCoefficients[i];
+      if ((other->_Data == coefficients->_Data) && (other->_Attributes == attr) &&
+          (other->_Type == coefficients->_Type) && (other->_SplineDegree == degree) &&
+          (other->_Checksum == checksum)) {
+        // Computed by another thread in the meantime
+        other->_References++;
+        delete coefficients;
+        return other;
+      }
+      // Unused coefficients of the same voxel buffer are out of date
+      if ((other->_References == 0) && (other->_Data == coefficients->_Data)) {
+        delete other;
+      } else {
+        cache.push_back(other);
+      }
+    }
+    cache.push_back(coefficients);
+    _BSplineCoefficients.swap(cache);
+  }
+  return coefficients;
+}
+
+void irtkBSplineInterpolateImageFunction::ReleaseCoefficients(irtkBSplineCoefficients *coefficients)
+{
+  unsigned int i;
+
+#ifdef HAS_TBB
+  tbb::mutex::scoped_lock lock(_BSplineCoefficientsMutex);
+#endif
+  coefficients->_References--;
+  if (coefficients->_References > 0) return;
+
+  // Keep only the most recently released coefficients which are not used
+  vector<irtkBSplineCoefficients *> cache;
+  for (i = 0; i < _BSplineCoefficients.size(); i++) {
+    if ((_BSplineCoefficients[i]->_References == 0) && (_BSplineCoefficients[i] != coefficients)) {
+      delete _BSplineCoefficients[i];
+    } else {
+      cache.push_back(_BSplineCoefficients[i]);
+    }
+  }
+  _BSplineCoefficients.swap(cache);
+}
+
+void irtkBSplineInterpolateImageFunction::ClearCoefficients()
+{
+  unsigned int i;
+
+#ifdef HAS_TBB
+  tbb::mutex::scoped_lock lock(_BSplineCoefficientsMutex);
+#endif
+  vector<irtkBSplineCoefficients *> cache;
+  for (i = 0; i < _BSplineCoefficients.size(); i++) {
+    if (_BSplineCoefficients[i]->_References == 0) {
+      delete _BSplineCoefficients[i];
+    } else {
+      cache.push_back(_BSplineCoefficients[i]);
+    }
+  }
+  _BSplineCoefficients.swap(cache);
 }
 
 double irtkBSplineInterpolateImageFunction::Evaluate(double x, double y, double z, double time)
@@ -419,7 +640,7 @@ double irtkBSplineInterpolateImageFunction::Evaluate(double x, double y, double
   for (k = 0; k <= this->_SplineDegree; k++) {
     for (j = 0; j <= this->_SplineDegree; j++) {
       for (i = 0; i <= this->_SplineDegree; i++) {
-        value += xWeight[i] * yWeight[j] * zWeight[k] * this->_coeff(xIndex[i], yIndex[j], zIndex[k], l);
+        value += xWeight[i] * yWeight[j] * zWeight[k] * (*this->_coeff)(xIndex[i], yIndex[j], zIndex[k], l);
       }
     }
   }
@@ -604,7 +825,7 @@ double irtkBSplineInterpolateImageFunction::EvaluateInside(double x, double y, d
   for (k = 0; k <= this->_SplineDegree; k++) {
     for (j = 0; j <= this->_SplineDegree; j++) {
       for (i = 0; i <= this->_SplineDegree; i++) {
-        value += xWeight[i] * yWeight[j] * zWeight[k] * this->_coeff(xIndex[i], yIndex[j], zIndex[k], l);
+        value += xWeight[i] * yWeight[j] * zWeight[k] * (*this->_coeff)(xIndex[i], yIndex[j], zIndex[k], l);
       }
     }
   }
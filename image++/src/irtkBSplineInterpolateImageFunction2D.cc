@@ -21,10 +21,14 @@ irtkBSplineInterpolateImageFunction2D::irtkBSplineInterpolateImageFunction2D(int
     exit(1);
   }
   _SplineDegree = SplineDegree;
+  _Coefficients = NULL;
+  _coeff        = NULL;
 }
 
 irtkBSplineInterpolateImageFunction2D::~irtkBSplineInterpolateImageFunction2D(void)
-{}
+{
+  if (_Coefficients != NULL) irtkBSplineInterpolateImageFunction::ReleaseCoefficients(_Coefficients);
+}
 
 const char *irtkBSplineInterpolateImageFunction2D::NameOfClass()
 {
@@ -58,164 +62,15 @@ void irtkBSplineInterpolateImageFunction2D::Initialize()
   this->_x2 = this->_input->GetX() - round(_SplineDegree/2.0 + 1);
   this->_y2 = this->_input->GetY() - round(_SplineDegree/2.0 + 1);
 
-  // Compute min and max values
-  this->_input->GetMinMaxAsDouble(&this->_min, &this->_max);
-
-  // Allocate coefficient image
-  this->_coeff = irtkRealImage(this->_x, this->_y, 1, this->_t);
-
-  // Compute B-Spline interpolation coefficients
-  this->ComputeCoefficients();
-}
-
-double irtkBSplineInterpolateImageFunction2D::InitialAntiCausalCoefficient(double c[], int DataLength, double z)
-{
-  /* this initialization corresponds to mirror boundaries */
-  return((z / (z * z - 1.0)) * (z * c[DataLength - 2] + c[DataLength - 1]));
-}
-
-double irtkBSplineInterpolateImageFunction2D::InitialCausalCoefficient(double c[], int DataLength, double z, double Tolerance)
-{
-  double Sum, zn, z2n, iz;
-  int n, Horizon;
-
-  /* this initialization corresponds to mirror boundaries */
-  Horizon = DataLength;
-  if (Tolerance > 0.0) {
-    Horizon = (int)ceil(log(Tolerance) / log(fabs(z)));
-  }
-  if (Horizon < DataLength) {
-    /* accelerated loop */
-    zn = z;
-    Sum = c[0];
-    for (n = 1; n < Horizon; n++) {
-      Sum += zn * c[n];
-      zn *= z;
-    }
-    return(Sum);
-  } else {
-    /* full loop */
-    zn = z;
-    iz = 1.0 / z;
-    z2n = pow(z, (double)(DataLength - 1));
-    Sum = c[0] + z2n * c[DataLength - 1];
-    z2n *= z2n * iz;
-    for (n = 1; n <= DataLength - 2; n++) {
-      Sum += (zn + z2n) * c[n];
-      zn *= z;
-      z2n *= iz;
-    }
-    return(Sum / (1.0 - zn * zn));
-  }
-}
-
-void irtkBSplineInterpolateImageFunction2D::ConvertToInterpolationCoefficients(double *c, int DataLength, double *z, int NbPoles, double Tolerance)
-{
-  double Lambda = 1.0;
-  int n, k;
-
-  /* special case required by mirror boundaries */
-  if (DataLength == 1) {
-    return;
-  }
-
-  /* compute the overall gain */
-  for (k = 0; k < NbPoles; k++) {
-    Lambda = Lambda * (1.0 - z[k]) * (1.0 - 1.0 / z[k]);
-  }
-
-  /* apply the gain */
-  for (n = 0; n < DataLength; n++) {
-    c[n] *= Lambda;
-  }
-
-  /* loop over all poles */
-  for (k = 0; k < NbPoles; k++) {
-    /* causal initialization */
-    c[0] = InitialCausalCoefficient(c, DataLength, z[k], Tolerance);
-    /* causal recursion */
-    for (n = 1; n < DataLength; n++) {
-      c[n] += z[k] * c[n - 1];
-    }
-    /* anticausal initialization */
-    c[DataLength - 1] = InitialAntiCausalCoefficient(c, DataLength, z[k]);
-    /* anticausal recursion */
-    for (n = DataLength - 2; 0 <= n; n--) {
-      c[n] = z[k] * (c[n + 1] - c[n]);
-    }
-  }
-}
-
-void irtkBSplineInterpolateImageFunction2D::ComputeCoefficients()
-{
-  double *data;
-  double Pole[2];
-  int NbPoles;
-  int x, y, z, t;
-
-  /* recover the poles from a lookup table */
-  switch (_SplineDegree) {
-  case 2:
-    NbPoles = 1;
-    Pole[0] = sqrt(8.0) - 3.0;
-    break;
-  case 3:
-    NbPoles = 1;
-    Pole[0] = sqrt(3.0) - 2.0;
-    break;
-  case 4:
-    NbPoles = 2;
-    Pole[0] = sqrt(664.0 - sqrt(438976.0)) + sqrt(304.0) - 19.0;
-    Pole[1] = sqrt(664.0 + sqrt(438976.0)) - sqrt(304.0) - 19.0;
-    break;
-  case 5:
-    NbPoles = 2;
-    Pole[0] = sqrt(135.0 / 2.0 - sqrt(17745.0 / 4.0)) + sqrt(105.0 / 4.0)
-              - 13.0 / 2.0;
-    Pole[1] = sqrt(135.0 / 2.0 + sqrt(17745.0 / 4.0)) - sqrt(105.0 / 4.0)
-              - 13.0 / 2.0;
-    break;
-  default:
-    cerr << "Invalid spline degree" << endl;
-    exit(1);
-  }
-
-  /* convert the image samples into interpolation coefficients */
-
-  // Set z to fixed value.
-  z = 0;
-  
-  /* in-place separable process, along x */
-  data = new double[_x];
-  for (t = 0; t < this->_t; t++) {
-      for (y = 0; y < this->_y; y++) {
-        for (x = 0; x < this->_x; x++) {
-          data[x] = this->_input->GetAsDouble(x, y, z, t);
-        }
-        ConvertToInterpolationCoefficients(data, this->_x, Pole, NbPoles, DBL_EPSILON);
-        for (x = 0; x < this->_x; x++) {
-          this->_coeff(x, y, z, t) = data[x];
-        }
-      }
-  }
-  delete []data;
-
-  /* in-place separable process, along y */
-  data = new double[_y];
-  for (t = 0; t < this->_t; t++) {
-      for (x = 0; x < this->_x; x++) {
-        for (y = 0; y < this->_y; y++) {
-          data[y] = this->_coeff(x, y, z, t);
-        }
-        ConvertToInterpolationCoefficients(data, this->_y, Pole, NbPoles, DBL_EPSILON);
-        for (y = 0; y < this->_y; y++) {
-          this->_coeff(x, y, z, t) = data[y];
-        }
-      }
-  }
-
-  delete []data;
+  // Get B-Spline interpolation coefficients, computing them unless they are cached
+  irtkBSplineCoefficients *coefficients = irtkBSplineInterpolateImageFunction::AcquireCoefficients(this->_input, this->_SplineDegree);
+  if (this->_Coefficients != NULL) irtkBSplineInterpolateImageFunction::ReleaseCoefficients(this->_Coefficients);
+  this->_Coefficients = coefficients;
+  this->_coeff = &(coefficients->_Coefficients);
 
+  // Min and max values
+  this->_min = coefficients->_Min;
+  this->_max = coefficients->_Max;
 }
 
 double irtkBSplineInterpolateImageFunction2D::Evaluate(double x, double y, double z, double time)
@@ -357,7 +212,7 @@ double irtkBSplineInterpolateImageFunction2D::Evaluate(double x, double y, doubl
   value = 0.0;
   for (j = 0; j <= this->_SplineDegree; j++) {
     for (i = 0; i <= this->_SplineDegree; i++) {
-      value += xWeight[i] * yWeight[j] * this->_coeff(xIndex[i], yIndex[j], k, l);
+      value += xWeight[i] * yWeight[j] * (*this->_coeff)(xIndex[i], yIndex[j], k, l);
     }
   }
 
@@ -497,7 +352,7 @@ double irtkBSplineInterpolateImageFunction2D::EvaluateInside(double x, double y,
 
   for (j = 0; j <= this->_SplineDegree; j++) {
     for (i = 0; i <= this->_SplineDegree; i++) {
-      value += xWeight[i] * yWeight[j] * this->_coeff(xIndex[i], yIndex[j], k, l);
+      value += xWeight[i] * yWeight[j] * (*this->_coeff)(xIndex[i], yIndex[j], k, l);
     }
   }
 
@@ -0,0 +1,268 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#include <irtkImage.h>
+
+#include <irtkConnectedComponents.h>
+
+// Maximum number of slabs labelled independently
+static const int _ConnectedComponentsSlabs = 32;
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedConnectedComponents
+{
+
+  /// Pointer to filter
+  irtkConnectedComponents<VoxelType> *_filter;
+
+  /// First slice of each slab
+  const int *_slab;
+
+public:
+
+  irtkMultiThreadedConnectedComponents(irtkConnectedComponents<VoxelType> *filter, const int *slab) {
+    _filter = filter;
+    _slab   = slab;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    for (int s = r.begin(); s != r.end(); s++) {
+      _filter->LabelSlab(_slab[s], _slab[s+1]);
+    }
+  }
+};
+
+#endif
+
+template <class VoxelType> irtkConnectedComponents<VoxelType>::irtkConnectedComponents(VoxelType ClusterLabel, irtkConnectivityType Connectivity)
+{
+  _ClusterLabel       = ClusterLabel;
+  _Connectivity       = Connectivity;
+  _IntensityImage     = NULL;
+  _NumberOfNeighbours = 0;
+}
+
+template <class VoxelType> irtkConnectedComponents<VoxelType>::~irtkConnectedComponents(void)
+{}
+
+template <class VoxelType> bool irtkConnectedComponents<VoxelType>::RequiresBuffering(void)
+{
+  return true;
+}
+
+template <class VoxelType> const char *irtkConnectedComponents<VoxelType>::NameOfClass()
+{
+  return "irtkConnectedComponents";
+}
+
+template <class VoxelType> int irtkConnectedComponents<VoxelType>::GetLargestComponent() const
+{
+  int i, label;
+
+  label = 0;
+  for (i = 0; i < int(_Components.size()); i++) {
+    if ((label == 0) || (_Components[i]._Size > _Components[label-1]._Size)) label = i + 1;
+  }
+  return label;
+}
+
+template <class VoxelType> void irtkConnectedComponents<VoxelType>::LabelSlab(int z1, int z2)
+{
+  int i, j, n, x, y, z, nx, ny, nz, X, Y;
+  VoxelType *ptr;
+
+  X   = this->_input->GetX();
+  Y   = this->_input->GetY();
+  ptr = this->_input->GetPointerToVoxels(0, 0, z1);
+  i   = z1 * X * Y;
+
+  for (z = z1; z < z2; z++) {
+    for (y = 0; y < Y; y++) {
+      for (x = 0; x < X; x++, i++, ptr++) {
+        if (*ptr != _ClusterLabel) {
+          _Labels[i] = -1;
+          continue;
+        }
+        _Labels[i] = i;
+
+        // Only neighbours in this slab which have already been visited
+        for (n = 0; n < _NumberOfNeighbours; n++) {
+          nx = x + _dx[n];
+          ny = y + _dy[n];
+          nz = z + _dz[n];
+          if ((nx < 0) || (nx >= X) || (ny < 0) || (ny >= Y) || (nz < z1)) continue;
+          j = i + _Offset[n];
+          if (_Labels[j] >= 0) this->Union(i, j);
+        }
+      }
+    }
+  }
+}
+
+template <class VoxelType> void irtkConnectedComponents<VoxelType>::MergeSlab(int z)
+{
+  int i, j, n, x, y, nx, ny, X, Y;
+
+  X = this->_input->GetX();
+  Y = this->_input->GetY();
+  i = z * X * Y;
+
+  for (y = 0; y < Y; y++) {
+    for (x = 0; x < X; x++, i++) {
+      if (_Labels[i] < 0) continue;
+      for (n = 0; n < _NumberOfNeighbours; n++) {
+        if (_dz[n] == 0) continue;
+        nx = x + _dx[n];
+        ny = y + _dy[n];
+        if ((nx < 0) || (nx >= X) || (ny < 0) || (ny >= Y)) continue;
+        j = i + _Offset[n];
+        if (_Labels[j] >= 0) this->Union(i, j);
+      }
+    }
+  }
+}
+
+template <class VoxelType> void irtkConnectedComponents<VoxelType>::Run()
+{
+  int i, n, p, s, x, y, z, dx, dy, dz, X, Y, Z, slabs, label;
+  double max;
+  int slab[_ConnectedComponentsSlabs+1];
+  irtkConnectedComponent component;
+  VoxelType *in, *out;
+
+  // Do the initial set up
+  this->Initialize();
+
+  // Check if the input is 4D
+  if (this->_input->GetT() > 1) {
+    cerr << "irtkConnectedComponents<VoxelType>::Run(): 4D images not yet supported\n" << endl;
+    exit(1);
+  }
+
+  X = this->_input->GetX();
+  Y = this->_input->GetY();
+  Z = this->_input->GetZ();
+
+  if ((_IntensityImage != NULL) && ((_IntensityImage->GetX() != X) || (_IntensityImage->GetY() != Y) || (_IntensityImage->GetZ() != Z))) {
+    cerr << "irtkConnectedComponents<VoxelType>::Run(): Intensity image has wrong dimensions" << endl;
+    exit(1);
+  }
+
+  // Neighbours which precede a voxel in memory order
+  _NumberOfNeighbours = 0;
+  for (dz = -1; dz <= 0; dz++) {
+    for (dy = -1; dy <= 1; dy++) {
+      for (dx = -1; dx <= 1; dx++) {
+        if ((dz == 0) && ((dy > 0) || ((dy == 0) && (dx >= 0)))) continue;
+        n = abs(dx) + abs(dy) + abs(dz);
+        switch (_Connectivity) {
+        case CONNECTIVITY_04:
+          if ((dz != 0) || (n > 1)) continue;
+          break;
+        case CONNECTIVITY_06:
+          if (n > 1) continue;
+          break;
+        case CONNECTIVITY_18:
+          if (n > 2) continue;
+          break;
+        case CONNECTIVITY_26:
+          break;
+        default:
+          cerr << "irtkConnectedComponents<VoxelType>::Run(): Unknown connectivity" << endl;
+          exit(1);
+        }
+        _dx[_NumberOfNeighbours]     = dx;
+        _dy[_NumberOfNeighbours]     = dy;
+        _dz[_NumberOfNeighbours]     = dz;
+        _Offset[_NumberOfNeighbours] = (dz * Y + dy) * X + dx;
+        _NumberOfNeighbours++;
+      }
+    }
+  }
+
+  // Split image into slabs of whole slices
+  slabs = (Z < _ConnectedComponentsSlabs) ? Z : _ConnectedComponentsSlabs;
+  for (s = 0; s <= slabs; s++) slab[s] = (s * Z) / slabs;
+
+  _Labels.resize(this->_input->GetNumberOfVoxels());
+
+#ifdef HAS_TBB
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, slabs, 1), irtkMultiThreadedConnectedComponents<VoxelType>(this, slab));
+  init.terminate();
+#else
+  for (s = 0; s < slabs; s++) this->LabelSlab(slab[s], slab[s+1]);
+#endif
+
+  // Slices are independent for 2D connectivity
+  if (_Connectivity != CONNECTIVITY_04) {
+    for (s = 1; s < slabs; s++) this->MergeSlab(slab[s]);
+  }
+
+  // Replace trees by labels and collect statistics. Every voxel points to
+  // a voxel with smaller index whose label is already known.
+  _Components.clear();
+  max = this->_output->GetScalarTypeMax();
+  in  = this->_input->GetPointerToVoxels();
+  out = this->_output->GetPointerToVoxels();
+  i   = 0;
+  for (z = 0; z < Z; z++) {
+    for (y = 0; y < Y; y++) {
+      for (x = 0; x < X; x++, i++) {
+        p = _Labels[i];
+        if (p < 0) {
+          _Labels[i] = 0;
+          out[i]     = 0;
+          continue;
+        }
+        if (p == i) {
+          component._Label = _Components.size() + 1;
+          component._Size  = 0;
+          component._x1 = component._x2 = x;
+          component._y1 = component._y2 = y;
+          component._z1 = component._z2 = z;
+          component._Mean = 0;
+          _Components.push_back(component);
+          label = component._Label;
+        } else {
+          label = _Labels[p];
+        }
+        _Labels[i] = label;
+        out[i]     = (label < max) ? label : max;
+
+        irtkConnectedComponent &c = _Components[label-1];
+        c._Size++;
+        if (x < c._x1) c._x1 = x;
+        if (x > c._x2) c._x2 = x;
+        if (y < c._y1) c._y1 = y;
+        if (y > c._y2) c._y2 = y;
+        if (z > c._z2) c._z2 = z;
+        if (_IntensityImage != NULL) {
+          c._Mean += _IntensityImage->GetAsDouble(x, y, z);
+        } else {
+          c._Mean += in[i];
+        }
+      }
+    }
+  }
+  for (n = 0; n < int(_Components.size()); n++) {
+    _Components[n]._Mean /= _Components[n]._Size;
+  }
+
+  // Do the final cleaning up
+  this->Finalize();
+}
+
+template class irtkConnectedComponents<irtkBytePixel>;
+template class irtkConnectedComponents<irtkGreyPixel>;
+template class irtkConnectedComponents<irtkRealPixel>;
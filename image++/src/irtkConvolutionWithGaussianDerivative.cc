@@ -17,11 +17,14 @@
 #include <irtkScalarGaussianDx.h>
 #include <irtkScalarGaussianDy.h>
 #include <irtkScalarGaussianDz.h>
+#include <irtkScalarGaussianDxDx.h>
+#include <irtkRecursiveGaussian_1D.h>
 #include <irtkConvolutionWithGaussianDerivative.h>
 
 template <class VoxelType> irtkConvolutionWithGaussianDerivative<VoxelType>::irtkConvolutionWithGaussianDerivative(double Sigma)
 {
-  _Sigma = Sigma;
+  _Sigma              = Sigma;
+  _RecursiveThreshold = 4;
 }
 
 template <class VoxelType> irtkConvolutionWithGaussianDerivative<VoxelType>::~irtkConvolutionWithGaussianDerivative()
@@ -37,93 +40,58 @@ template <class VoxelType> bool irtkConvolutionWithGaussianDerivative<VoxelType>
   return true;
 }
 
-template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>::Ix()
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>::Convolve(irtkGenericImage<VoxelType> *input, irtkGenericImage<VoxelType> *output, int axis, double size, int order)
 {
-  double xsize, ysize, zsize;
-  
-  // Do the initial set up
-  this->Initialize();
-
-  // Get voxel dimensions
-  this->_input->GetPixelSize(&xsize, &ysize, &zsize);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in X
-  irtkScalarGaussianDx gaussianDx(this->_Sigma/xsize, 1, 1, 0, 0, 0);
-  // Create filter kernel for 1D Gaussian function in X
-  irtkGenericImage<irtkRealPixel> kernelX(2*round(4*this->_Sigma/xsize)+1, 1, 1);
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceX;
-  gaussianSourceX.SetInput (&gaussianDx);
-  gaussianSourceX.SetOutput(&kernelX);
-  gaussianSourceX.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
-  convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in Y
-  irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
-
-  // Create filter kernel for 1D Gaussian function in Y
-  irtkGenericImage<irtkRealPixel> kernelY(2*round(4*this->_Sigma/ysize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceY;
-  gaussianSourceY.SetInput (&gaussianY);
-  gaussianSourceY.SetOutput(&kernelY);
-  gaussianSourceY.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
-  convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianZ);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+  irtkScalarFunction *gaussian;
+
+  if (this->_Sigma/size >= _RecursiveThreshold) {
+    // Do recursive filtering
+    irtkRecursiveGaussian_1D<VoxelType> recursive(this->_Sigma/size, order);
+    recursive.SetInput (input);
+    recursive.SetOutput(output);
+    recursive.SetAxis(axis);
+    recursive.SetNormalization(order == 0);
+    recursive.Run();
+    return;
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
+  // Create scalar function which corresponds to a 1D Gaussian function or its derivative
+  switch (order) {
+  case 0:
+    gaussian = new irtkScalarGaussian(this->_Sigma/size, 1, 1, 0, 0, 0);
+    break;
+  case 1:
+    gaussian = new irtkScalarGaussianDx(this->_Sigma/size, 1, 1, 0, 0, 0);
+    break;
+  default:
+    gaussian = new irtkScalarGaussianDxDx(this->_Sigma/size, 1, 1, 0, 0, 0);
+    break;
+  }
 
-  // Do the final cleaning up
-  this->Finalize();
+  // Create filter kernel for 1D Gaussian function
+  irtkGenericImage<irtkRealPixel> kernel(2*round(4*this->_Sigma/size)+1, 1, 1);
 
+  // Do conversion from  scalar function to filter kernel
+  irtkScalarFunctionToImage<irtkRealPixel> gaussianSource;
+  gaussianSource.SetInput (gaussian);
+  gaussianSource.SetOutput(&kernel);
+  gaussianSource.Run();
+  delete gaussian;
+
+  // Do convolution, only smoothing is normalized
+  irtkConvolution_1D<VoxelType> convolution;
+  convolution.SetInput (input);
+  convolution.SetInput2(&kernel);
+  convolution.SetOutput(output);
+  convolution.SetAxis(axis);
+  convolution.SetNormalization(order == 0);
+  convolution.Run();
 }
 
-template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>::Iy()
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>::Derivative(int ox, int oy, int oz)
 {
   double xsize, ysize, zsize;
+  irtkGenericImage<VoxelType> tmp, *first, *second;
 
   // Do the initial set up
   this->Initialize();
@@ -131,164 +99,39 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
-
-  // Create scalar function which corresponds to a 1D Gaussian function in X
-  irtkScalarGaussian gaussianX(this->_Sigma/xsize, 1, 1, 0, 0, 0);
-  // Create filter kernel for 1D Gaussian function in X
-  irtkGenericImage<irtkRealPixel> kernelX(2*round(4*this->_Sigma/xsize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceX;
-  gaussianSourceX.SetInput (&gaussianX);
-  gaussianSourceX.SetOutput(&kernelX);
-  gaussianSourceX.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
-  convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in Y
-  irtkScalarGaussianDx gaussianDy(this->_Sigma/ysize, 1, 1, 0, 0, 0);
-
-  // Create filter kernel for 1D Gaussian function in Y
-  irtkGenericImage<irtkRealPixel> kernelY(2*round(4*this->_Sigma/ysize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceY;
-  gaussianSourceY.SetInput (&gaussianDy);
-  gaussianSourceY.SetOutput(&kernelY);
-  gaussianSourceY.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
-  convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianZ);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+  // Filter along x, y and z without reordering the image. The passes
+  // alternate between output and buffer so that the last one writes the output
+  if (this->_input->GetZ() != 1) {
+    first  = this->_output;
+    second = &tmp;
+  } else {
+    first  = &tmp;
+    second = this->_output;
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
+  this->Convolve(this->_input, first, 0, xsize, ox);
+  this->Convolve(first, second, 1, ysize, oy);
+  if (this->_input->GetZ() != 1) {
+    this->Convolve(second, this->_output, 2, zsize, oz);
+  }
 
   // Do the final cleaning up
   this->Finalize();
 }
 
-template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>::Iz()
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>::Ix()
 {
-  double xsize, ysize, zsize;
-
-  // Do the initial set up
-  this->Initialize();
-
-  // Get voxel dimensions
-  this->_input->GetPixelSize(&xsize, &ysize, &zsize);
-
-
-  // Create scalar function which corresponds to a 1D Gaussian function in X
-  irtkScalarGaussian gaussianX(this->_Sigma/xsize, 1, 1, 0, 0, 0);
-  // Create filter kernel for 1D Gaussian function in X
-  irtkGenericImage<irtkRealPixel> kernelX(2*round(4*this->_Sigma/xsize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceX;
-  gaussianSourceX.SetInput (&gaussianX);
-  gaussianSourceX.SetOutput(&kernelX);
-  gaussianSourceX.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
-  convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in Y
-  irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
-
-  // Create filter kernel for 1D Gaussian function in Y
-  irtkGenericImage<irtkRealPixel> kernelY(2*round(4*this->_Sigma/ysize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceY;
-  gaussianSourceY.SetInput (&gaussianY);
-  gaussianSourceY.SetOutput(&kernelY);
-  gaussianSourceY.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
-  convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussianDx gaussianDz(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianDz);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
-  }
+  this->Derivative(1, 0, 0);
+}
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>::Iy()
+{
+  this->Derivative(0, 1, 0);
+}
 
-  // Do the final cleaning up
-  this->Finalize();
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>::Iz()
+{
+  this->Derivative(0, 0, 1);
 }
 
 
@@ -24,11 +24,13 @@
 #include <irtkScalarGaussianDyDz.h>
 #include <irtkScalarGaussianDxDy.h>
 
+#include <irtkRecursiveGaussian_1D.h>
 #include <irtkConvolutionWithGaussianDerivative2.h>
 
 template <class VoxelType> irtkConvolutionWithGaussianDerivative2<VoxelType>::irtkConvolutionWithGaussianDerivative2(double Sigma)
 {
-  _Sigma = Sigma;
+  _Sigma              = Sigma;
+  _RecursiveThreshold = 4;
 }
 
 template <class VoxelType> irtkConvolutionWithGaussianDerivative2<VoxelType>::~irtkConvolutionWithGaussianDerivative2()
@@ -44,94 +46,58 @@ template <class VoxelType> bool irtkConvolutionWithGaussianDerivative2<VoxelType
   return true;
 }
 
-template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Ixx()
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Convolve(irtkGenericImage<VoxelType> *input, irtkGenericImage<VoxelType> *output, int axis, double size, int order)
 {
-
-  double xsize, ysize, zsize;
-
-
-  // Do the initial set up
-  this->Initialize();
-
-  // Get voxel dimensions
-  this->_input->GetPixelSize(&xsize, &ysize, &zsize);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in X
-  irtkScalarGaussianDxDx gaussianDxDx(this->_Sigma/xsize, 1, 1, 0, 0, 0);
-  // Create filter kernel for 1D Gaussian function in X
-  irtkGenericImage<irtkRealPixel> kernelX(2*round(4*this->_Sigma/xsize)+1, 1, 1);
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceX;
-  gaussianSourceX.SetInput (&gaussianDxDx);
-  gaussianSourceX.SetOutput(&kernelX);
-  gaussianSourceX.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
-  convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in Y
-  irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
-
-  // Create filter kernel for 1D Gaussian function in Y
-  irtkGenericImage<irtkRealPixel> kernelY(2*round(4*this->_Sigma/ysize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceY;
-  gaussianSourceY.SetInput (&gaussianY);
-  gaussianSourceY.SetOutput(&kernelY);
-  gaussianSourceY.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
-  convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianZ);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+  irtkScalarFunction *gaussian;
+
+  if (this->_Sigma/size >= _RecursiveThreshold) {
+    // Do recursive filtering
+    irtkRecursiveGaussian_1D<VoxelType> recursive(this->_Sigma/size, order);
+    recursive.SetInput (input);
+    recursive.SetOutput(output);
+    recursive.SetAxis(axis);
+    recursive.SetNormalization(order == 0);
+    recursive.Run();
+    return;
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
+  // Create scalar function which corresponds to a 1D Gaussian function or its derivative
+  switch (order) {
+  case 0:
+    gaussian = new irtkScalarGaussian(this->_Sigma/size, 1, 1, 0, 0, 0);
+    break;
+  case 1:
+    gaussian = new irtkScalarGaussianDx(this->_Sigma/size, 1, 1, 0, 0, 0);
+    break;
+  default:
+    gaussian = new irtkScalarGaussianDxDx(this->_Sigma/size, 1, 1, 0, 0, 0);
+    break;
+  }
 
-  // Do the final cleaning up
-  this->Finalize();
+  // Create filter kernel for 1D Gaussian function
+  irtkGenericImage<irtkRealPixel> kernel(2*round(4*this->_Sigma/size)+1, 1, 1);
 
+  // Do conversion from  scalar function to filter kernel
+  irtkScalarFunctionToImage<irtkRealPixel> gaussianSource;
+  gaussianSource.SetInput (gaussian);
+  gaussianSource.SetOutput(&kernel);
+  gaussianSource.Run();
+  delete gaussian;
+
+  // Do convolution, only smoothing is normalized
+  irtkConvolution_1D<VoxelType> convolution;
+  convolution.SetInput (input);
+  convolution.SetInput2(&kernel);
+  convolution.SetOutput(output);
+  convolution.SetAxis(axis);
+  convolution.SetNormalization(order == 0);
+  convolution.Run();
 }
 
-template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Ixy()
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Derivative(int ox, int oy, int oz)
 {
   double xsize, ysize, zsize;
+  irtkGenericImage<VoxelType> tmp, *first, *second;
 
   // Do the initial set up
   this->Initialize();
@@ -139,417 +105,109 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
-  // Create scalar function which corresponds to a 1D Gaussian function in X
-  irtkScalarGaussianDx gaussianDx(this->_Sigma/xsize, 1, 1, 0, 0, 0);
-  // Create filter kernel for 1D Gaussian function in X
-  irtkGenericImage<irtkRealPixel> kernelX(2*round(4*this->_Sigma/xsize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceX;
-  gaussianSourceX.SetInput (&gaussianDx);
-  gaussianSourceX.SetOutput(&kernelX);
-  gaussianSourceX.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
-  convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in Y
-  irtkScalarGaussianDx gaussianDy(this->_Sigma/ysize, 1, 1, 0, 0, 0);
-
-  // Create filter kernel for 1D Gaussian function in Y
-  irtkGenericImage<irtkRealPixel> kernelY(2*round(4*this->_Sigma/ysize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceY;
-  gaussianSourceY.SetInput (&gaussianDy);
-  gaussianSourceY.SetOutput(&kernelY);
-  gaussianSourceY.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
-  convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianZ);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+  // Filter along x, y and z without reordering the image. The passes
+  // alternate between output and buffer so that the last one writes the output
+  if (this->_input->GetZ() != 1) {
+    first  = this->_output;
+    second = &tmp;
+  } else {
+    first  = &tmp;
+    second = this->_output;
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
+  this->Convolve(this->_input, first, 0, xsize, ox);
+  this->Convolve(first, second, 1, ysize, oy);
+  if (this->_input->GetZ() != 1) {
+    this->Convolve(second, this->_output, 2, zsize, oz);
+  }
 
   // Do the final cleaning up
   this->Finalize();
-
 }
 
-template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Ixz()
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Ixx()
 {
-  double xsize, ysize, zsize;
-
-  // Do the initial set up
-  this->Initialize();
-
-  // Get voxel dimensions
-  this->_input->GetPixelSize(&xsize, &ysize, &zsize);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in X
-  irtkScalarGaussianDx gaussianDx(this->_Sigma/xsize, 1, 1, 0, 0, 0);
-  // Create filter kernel for 1D Gaussian function in X
-  irtkGenericImage<irtkRealPixel> kernelX(2*round(4*this->_Sigma/xsize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceX;
-  gaussianSourceX.SetInput (&gaussianDx);
-  gaussianSourceX.SetOutput(&kernelX);
-  gaussianSourceX.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
-  convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in Y
-  irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
-
-  // Create filter kernel for 1D Gaussian function in Y
-  irtkGenericImage<irtkRealPixel> kernelY(2*round(4*this->_Sigma/ysize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceY;
-  gaussianSourceY.SetInput (&gaussianY);
-  gaussianSourceY.SetOutput(&kernelY);
-  gaussianSourceY.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
-  convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussianDx gaussianDz(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianDz);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
-  }
-
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
-  // Do the final cleaning up
-  this->Finalize();
+  this->Derivative(2, 0, 0);
 }
 
 template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Iyy()
 {
-  double xsize, ysize, zsize;
-
-  // Do the initial set up
-  this->Initialize();
-
-  // Get voxel dimensions
-  this->_input->GetPixelSize(&xsize, &ysize, &zsize);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in X
-  irtkScalarGaussian gaussianX(this->_Sigma/xsize, 1, 1, 0, 0, 0);
-  // Create filter kernel for 1D Gaussian function in X
-  irtkGenericImage<irtkRealPixel> kernelX(2*round(4*this->_Sigma/xsize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceX;
-  gaussianSourceX.SetInput (&gaussianX);
-  gaussianSourceX.SetOutput(&kernelX);
-  gaussianSourceX.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
-  convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in Y
-  irtkScalarGaussianDxDx gaussianDyDy(this->_Sigma/ysize, 1, 1, 0, 0, 0);
-
-  // Create filter kernel for 1D Gaussian function in Y
-  irtkGenericImage<irtkRealPixel> kernelY(2*round(4*this->_Sigma/ysize)+1, 1, 1);
+  this->Derivative(0, 2, 0);
+}
 
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceY;
-  gaussianSourceY.SetInput (&gaussianDyDy);
-  gaussianSourceY.SetOutput(&kernelY);
-  gaussianSourceY.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
-  convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianZ);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
-  }
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Izz()
+{
+  this->Derivative(0, 0, 2);
+}
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Ixy()
+{
+  this->Derivative(1, 1, 0);
+}
 
-  // Do the final cleaning up
-  this->Finalize();
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Ixz()
+{
+  this->Derivative(1, 0, 1);
 }
 
 template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Iyz()
 {
-  double xsize, ysize, zsize;
-
-  // Do the initial set up
-  this->Initialize();
-
-  // Get voxel dimensions
-  this->_input->GetPixelSize(&xsize, &ysize, &zsize);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in X
-  irtkScalarGaussian gaussianX(this->_Sigma/xsize, 1, 1, 0, 0, 0);
-  
-  // Create filter kernel for 1D Gaussian function in X
-  irtkGenericImage<irtkRealPixel> kernelX(2*round(4*this->_Sigma/xsize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceX;
-  gaussianSourceX.SetInput (&gaussianX);
-  gaussianSourceX.SetOutput(&kernelX);
-  gaussianSourceX.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
-  convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in Y
-  irtkScalarGaussianDx gaussianDy(this->_Sigma/ysize, 1, 1, 0, 0, 0);
-
-  // Create filter kernel for 1D Gaussian function in Y
-  irtkGenericImage<irtkRealPixel> kernelY(2*round(4*this->_Sigma/ysize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceY;
-  gaussianSourceY.SetInput (&gaussianDy);
-  gaussianSourceY.SetOutput(&kernelY);
-  gaussianSourceY.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
-  convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetZ() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussianDx gaussianDz(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianDz);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
-  }
-
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
-  // Do the final cleaning up
-  this->Finalize();
+  this->Derivative(0, 1, 1);
 }
 
-template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Izz()
+
+template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType>::Hessian()
 {
+  int i, j, n, ox;
   double xsize, ysize, zsize;
+  VoxelType *ptr, *frame;
+  irtkGenericImage<VoxelType> first, second, third;
+
+  // Orders of derivative along x, y and z and output frame, grouped by order along x
+  static const int order[6][4] = {{2, 0, 0, 0}, {1, 1, 0, 1}, {1, 0, 1, 2}, {0, 2, 0, 3}, {0, 1, 1, 4}, {0, 0, 2, 5}};
 
   // Do the initial set up
   this->Initialize();
 
-  // Get voxel dimensions
-  this->_input->GetPixelSize(&xsize, &ysize, &zsize);
-
-  // Create scalar function which corresponds to a 1D Gaussian function in X
-  irtkScalarGaussian gaussianX(this->_Sigma/xsize, 1, 1, 0, 0, 0);
-  
-  // Create filter kernel for 1D Gaussian function in X
-  irtkGenericImage<irtkRealPixel> kernelX(2*round(4*this->_Sigma/xsize)+1, 1, 1);
-
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceX;
-  gaussianSourceX.SetInput (&gaussianX);
-  gaussianSourceX.SetOutput(&kernelX);
-  gaussianSourceX.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
-  convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  if (this->_input->GetT() > 1) {
+    cerr << this->NameOfClass() << "::Hessian: Only implemented for images with t = 1" << endl;
+    exit(1);
+  }
 
-  // Create scalar function which corresponds to a 1D Gaussian function in Y
-  irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
+  irtkImageAttributes attr = this->_input->GetImageAttributes();
+  attr._t = 6;
+  this->_output->Initialize(attr);
 
-  // Create filter kernel for 1D Gaussian function in Y
-  irtkGenericImage<irtkRealPixel> kernelY(2*round(4*this->_Sigma/ysize)+1, 1, 1);
+  // Get voxel dimensions
+  this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceY;
-  gaussianSourceY.SetInput (&gaussianY);
-  gaussianSourceY.SetOutput(&kernelY);
-  gaussianSourceY.Run();
-
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
-  convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussianDxDx gaussianDzDz(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianDzDz);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+  n  = this->_input->GetNumberOfVoxels();
+  ox = -1;
+  for (i = 0; i < 6; i++) {
+    if (order[i][0] != ox) {
+      ox = order[i][0];
+      this->Convolve(this->_input, &first, 0, xsize, ox);
+    }
+    this->Convolve(&first, &second, 1, ysize, order[i][1]);
+
+    // Derivatives along z vanish for single slices
+    frame = this->_output->GetPointerToVoxels(0, 0, 0, order[i][3]);
+    if (this->_input->GetZ() != 1) {
+      this->Convolve(&second, &third, 2, zsize, order[i][2]);
+      ptr = third.GetPointerToVoxels();
+      for (j = 0; j < n; j++) frame[j] = ptr[j];
+    } else if (order[i][2] == 0) {
+      ptr = second.GetPointerToVoxels();
+      for (j = 0; j < n; j++) frame[j] = ptr[j];
+    } else {
+      for (j = 0; j < n; j++) frame[j] = 0;
+    }
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 }
 
-
 template class irtkConvolutionWithGaussianDerivative2<irtkBytePixel>;
 template class irtkConvolutionWithGaussianDerivative2<irtkGreyPixel>;
 template class irtkConvolutionWithGaussianDerivative2<irtkRealPixel>;
@@ -120,6 +120,13 @@ template <class VoxelType> double irtkConvolutionWithPadding_1D<VoxelType>::Run(
   }
 }
 
+template <class VoxelType> void irtkConvolutionWithPadding_1D<VoxelType>::Run()
+{
+  this->_Padded       = true;
+  this->_PaddingValue = _padding;
+  this->Convolve();
+}
+
 template class irtkConvolutionWithPadding_1D<unsigned char>;
 template class irtkConvolutionWithPadding_1D<short>;
 template class irtkConvolutionWithPadding_1D<unsigned short>;
@@ -14,9 +14,42 @@
 
 #include <irtkConvolution.h>
 
+// Number of contiguous voxels convolved together along the y-, z- and t-axis
+static const int _ConvolutionBatch = 256;
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedConvolution_1D
+{
+
+  /// Pointer to filter
+  irtkConvolution_1D<VoxelType> *_filter;
+
+public:
+
+  irtkMultiThreadedConvolution_1D(irtkConvolution_1D<VoxelType> *filter) {
+    _filter = filter;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    if (_filter->_Axis == 0) {
+      _filter->ConvolveX(r.begin(), r.end());
+    } else {
+      _filter->ConvolveAxis(r.begin(), r.end());
+    }
+  }
+};
+
+#endif
+
 template <class VoxelType> irtkConvolution_1D<VoxelType>::irtkConvolution_1D(bool Normalization) :
     irtkConvolution<VoxelType>(Normalization)
-{}
+{
+  _input2       = NULL;
+  _Axis         = 0;
+  _Padded       = false;
+  _PaddingValue = 0;
+}
 
 template <class VoxelType> bool irtkConvolution_1D<VoxelType>::RequiresBuffering(void)
 {
@@ -117,6 +150,198 @@ template <class VoxelType> double irtkConvolution_1D<VoxelType>::Run(int x, int
   }
 }
 
+template <class VoxelType> void irtkConvolution_1D<VoxelType>::ConvolveX(int r1, int r2)
+{
+  int i, k, k1, k2, x, x1, X, K;
+  bool padded;
+  irtkRealPixel *ptr2;
+  VoxelType *in, *out, v, padding;
+  double val, sum;
+
+  X       = this->_input->GetX();
+  K       = this->_input2->GetX();
+  ptr2    = this->_input2->GetPointerToVoxels();
+  padded  = _Padded;
+  padding = _PaddingValue;
+
+  for (i = r1; i < r2; i++) {
+    in  = this->_input->GetPointerToVoxels()  + i * X;
+    out = this->_output->GetPointerToVoxels() + i * X;
+    for (x = 0; x < X; x++) {
+      if ((padded == true) && (in[x] <= padding)) {
+        out[x] = padding;
+        continue;
+      }
+
+      // Kernel elements inside the image
+      x1 = x - K/2;
+      k1 = (x1 < 0) ? -x1 : 0;
+      k2 = (x1 + K > X) ? X - x1 : K;
+
+      val = 0;
+      sum = 0;
+      if (padded == false) {
+        for (k = k1; k < k2; k++) {
+          val += ptr2[k] * in[x1+k];
+          sum += ptr2[k];
+        }
+      } else {
+        for (k = k1; k < k2; k++) {
+          v = in[x1+k];
+          if (v > padding) {
+            val += ptr2[k] * v;
+            sum += ptr2[k];
+          }
+        }
+      }
+
+      if (this->_Normalization == true) {
+        out[x] = irtkConvolutionToVoxel<VoxelType>((sum > 0) ? val / sum : 0);
+      } else {
+        out[x] = irtkConvolutionToVoxel<VoxelType>(val);
+      }
+    }
+  }
+}
+
+template <class VoxelType> void irtkConvolution_1D<VoxelType>::ConvolveAxis(int b1, int b2)
+{
+  int b, i, k, k1, k2, l, n, o, L, S, N, K, batches;
+  irtkRealPixel *ptr2, w;
+  VoxelType *in, *out, *ptr;
+  double val[_ConvolutionBatch], sum[_ConvolutionBatch], total;
+
+  // Voxels along the axis are S apart, the S voxels in between are contiguous
+  switch (_Axis) {
+  case 1:
+    S = this->_input->GetX();
+    N = this->_input->GetY();
+    break;
+  case 2:
+    S = this->_input->GetX() * this->_input->GetY();
+    N = this->_input->GetZ();
+    break;
+  default:
+    S = this->_input->GetX() * this->_input->GetY() * this->_input->GetZ();
+    N = this->_input->GetT();
+    break;
+  }
+  K       = this->_input2->GetX();
+  ptr2    = this->_input2->GetPointerToVoxels();
+  batches = (S + _ConvolutionBatch - 1) / _ConvolutionBatch;
+
+  for (b = b1; b < b2; b++) {
+    i = b % batches;
+    n = (b / batches) % N;
+    o = b / (batches * N);
+    L = (i == batches - 1) ? S - i * _ConvolutionBatch : _ConvolutionBatch;
+    in  = this->_input->GetPointerToVoxels()  + o * S * N + i * _ConvolutionBatch;
+    out = this->_output->GetPointerToVoxels() + o * S * N + n * S + i * _ConvolutionBatch;
+
+    // Kernel elements inside the image
+    k1 = (n < K/2) ? K/2 - n : 0;
+    k2 = (n - K/2 + K > N) ? N - n + K/2 : K;
+
+    for (l = 0; l < L; l++) {
+      val[l] = 0;
+      sum[l] = 0;
+    }
+
+    if (_Padded == false) {
+      total = 0;
+      for (k = k1; k < k2; k++) {
+        w   = ptr2[k];
+        ptr = in + (n - K/2 + k) * S;
+        for (l = 0; l < L; l++) {
+          val[l] += w * ptr[l];
+        }
+        total += w;
+      }
+      for (l = 0; l < L; l++) {
+        if (this->_Normalization == true) {
+          out[l] = irtkConvolutionToVoxel<VoxelType>((total > 0) ? val[l] / total : 0);
+        } else {
+          out[l] = irtkConvolutionToVoxel<VoxelType>(val[l]);
+        }
+      }
+    } else {
+      for (k = k1; k < k2; k++) {
+        w   = ptr2[k];
+        ptr = in + (n - K/2 + k) * S;
+        for (l = 0; l < L; l++) {
+          if (ptr[l] > _PaddingValue) {
+            val[l] += w * ptr[l];
+            sum[l] += w;
+          }
+        }
+      }
+      ptr = in + n * S;
+      for (l = 0; l < L; l++) {
+        if (ptr[l] <= _PaddingValue) {
+          out[l] = _PaddingValue;
+        } else if (this->_Normalization == true) {
+          out[l] = irtkConvolutionToVoxel<VoxelType>((sum[l] > 0) ? val[l] / sum[l] : 0);
+        } else {
+          out[l] = irtkConvolutionToVoxel<VoxelType>(val[l]);
+        }
+      }
+    }
+  }
+}
+
+template <class VoxelType> void irtkConvolution_1D<VoxelType>::Convolve()
+{
+  int n;
+
+  // Do the initial set up
+  this->Initialize();
+
+  if ((_Axis < 0) || (_Axis > 3)) {
+    cerr << this->NameOfClass() << "::Run: Axis must be between 0 and 3" << endl;
+    exit(1);
+  }
+
+  // Number of rows along x, or of batches of contiguous voxels otherwise
+  switch (_Axis) {
+  case 0:
+    n = this->_input->GetY() * this->_input->GetZ() * this->_input->GetT();
+    break;
+  case 1:
+    n = this->_input->GetY() * this->_input->GetZ() * this->_input->GetT() *
+        ((this->_input->GetX() + _ConvolutionBatch - 1) / _ConvolutionBatch);
+    break;
+  case 2:
+    n = this->_input->GetZ() * this->_input->GetT() *
+        ((this->_input->GetX() * this->_input->GetY() + _ConvolutionBatch - 1) / _ConvolutionBatch);
+    break;
+  default:
+    n = this->_input->GetT() *
+        ((this->_input->GetX() * this->_input->GetY() * this->_input->GetZ() + _ConvolutionBatch - 1) / _ConvolutionBatch);
+    break;
+  }
+
+#ifdef HAS_TBB
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, n), irtkMultiThreadedConvolution_1D<VoxelType>(this));
+  init.terminate();
+#else
+  if (_Axis == 0) {
+    this->ConvolveX(0, n);
+  } else {
+    this->ConvolveAxis(0, n);
+  }
+#endif
+
+  // Do the final cleaning up
+  this->Finalize();
+}
+
+template <class VoxelType> void irtkConvolution_1D<VoxelType>::Run()
+{
+  _Padded = false;
+  this->Convolve();
+}
+
 template <class VoxelType> void irtkConvolution_1D<VoxelType>::Initialize()
 {
   // Check kernel
@@ -14,10 +14,48 @@
 
 #include <irtkDilation.h>
 
+// Number of lines filtered together by the running maximum
+static const int _DilationBatch = 64;
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedDilation
+{
+
+  /// Pointer to filter
+  irtkDilation<VoxelType> *_filter;
+
+  /// Input and output of this pass
+  VoxelType *_in, *_out;
+
+  /// Axis of running maximum, or -1 for one step with the neighbourhood
+  int _axis;
+
+public:
+
+  irtkMultiThreadedDilation(irtkDilation<VoxelType> *filter, VoxelType *in, VoxelType *out, int axis) {
+    _filter = filter;
+    _in     = in;
+    _out    = out;
+    _axis   = axis;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    if (_axis < 0) {
+      _filter->Step(_in, _out, r.begin(), r.end());
+    } else {
+      _filter->Box(_in, _out, _axis, r.begin(), r.end());
+    }
+  }
+};
+
+#endif
+
 template <class VoxelType> irtkDilation<VoxelType>::irtkDilation()
 {
 	// Default connectivity.
 	this->_Connectivity = CONNECTIVITY_26;
+	this->_Iterations   = 1;
 }
 
 template <class VoxelType> irtkDilation<VoxelType>::~irtkDilation(void)
@@ -42,38 +80,211 @@ template <class VoxelType> void irtkDilation<VoxelType>::Initialize()
   this->_offsets.Initialize(this->_input, this->_Connectivity);
 }
 
+template <class VoxelType> void irtkDilation<VoxelType>::Step(VoxelType *in, VoxelType *out, int s1, int s2)
+{
+  int i, j, s, x, y, z, X, Y, Z, maskSize;
+  VoxelType value, *ptr;
+
+  X = this->_input->GetX();
+  Y = this->_input->GetY();
+  Z = this->_input->GetZ();
+  maskSize = this->_offsets.GetSize();
+
+  for (s = s1; s < s2; s++) {
+    z = s % Z;
+    j = s * X * Y;
+    for (y = 0; y < Y; y++) {
+      for (x = 0; x < X; x++, j++) {
+        if ((x == 0) || (x == X-1) || (y == 0) || (y == Y-1) || (z == 0) || (z == Z-1)) {
+          out[j] = in[j];
+        } else {
+          ptr   = in + j;
+          value = *ptr;
+          for (i = 0; i < maskSize; ++i) {
+            if (ptr[this->_offsets(i)] > value) value = ptr[this->_offsets(i)];
+          }
+          out[j] = value;
+        }
+      }
+    }
+  }
+}
+
+template <class VoxelType> void irtkDilation<VoxelType>::Box(VoxelType *in, VoxelType *out, int axis, int b1, int b2)
+{
+  int b, i, l, n, o, p, L, M, N, R, S, W, stepN, stepL, batches;
+  bool constant;
+  VoxelType *src, *dst, value, padding;
+
+  // Lines along x are X apart, lines along the other axes are contiguous
+  switch (axis) {
+  case 0:
+    S = this->_input->GetY() * this->_input->GetZ() * this->_input->GetT();
+    N = this->_input->GetX();
+    break;
+  case 1:
+    S = this->_input->GetX();
+    N = this->_input->GetY();
+    break;
+  default:
+    S = this->_input->GetX() * this->_input->GetY();
+    N = this->_input->GetZ();
+    break;
+  }
+  batches = (S + _DilationBatch - 1) / _DilationBatch;
+
+  // Lines are padded by R on both sides and up to a multiple of the window W
+  R = this->_Iterations;
+  W = 2 * R + 1;
+  M = ((N + 2 * R + W - 1) / W) * W;
+  padding = voxel_limits<VoxelType>::min();
+  std::vector<VoxelType> f(M * _DilationBatch), g(M * _DilationBatch), h(M * _DilationBatch);
+
+  for (b = b1; b < b2; b++) {
+    i = b % batches;
+    o = b / batches;
+    L = (i == batches - 1) ? S - i * _DilationBatch : _DilationBatch;
+    if (axis == 0) {
+      src   = in  + i * _DilationBatch * N;
+      dst   = out + i * _DilationBatch * N;
+      stepN = 1;
+      stepL = N;
+    } else {
+      src   = in  + o * S * N + i * _DilationBatch;
+      dst   = out + o * S * N + i * _DilationBatch;
+      stepN = S;
+      stepL = 1;
+    }
+
+    // Copy lines into buffer
+    constant = true;
+    value    = src[0];
+    for (n = 0; n < N; n++) {
+      for (l = 0; l < L; l++) {
+        f[(n+R)*L+l] = src[n*stepN+l*stepL];
+        if (f[(n+R)*L+l] != value) constant = false;
+      }
+    }
+
+    // Lines with a single value do not change
+    if (constant == true) {
+      for (n = 0; n < N; n++) {
+        for (l = 0; l < L; l++) dst[n*stepN+l*stepL] = value;
+      }
+      continue;
+    }
+
+    for (l = 0; l < R * L; l++) f[l] = padding;
+    for (l = (N + R) * L; l < M * L; l++) f[l] = padding;
+
+    // Maxima from the start and from the end of each block of W values
+    for (p = 0; p < M; p++) {
+      for (l = 0; l < L; l++) {
+        if ((p % W == 0) || (f[p*L+l] > g[(p-1)*L+l])) {
+          g[p*L+l] = f[p*L+l];
+        } else {
+          g[p*L+l] = g[(p-1)*L+l];
+        }
+      }
+    }
+    for (p = M - 1; p >= 0; p--) {
+      for (l = 0; l < L; l++) {
+        if ((p % W == W - 1) || (f[p*L+l] > h[(p+1)*L+l])) {
+          h[p*L+l] = f[p*L+l];
+        } else {
+          h[p*L+l] = h[(p+1)*L+l];
+        }
+      }
+    }
+
+    // Each window of W values covers the end of one block and the start of the next
+    for (n = 0; n < N; n++) {
+      for (l = 0; l < L; l++) {
+        dst[n*stepN+l*stepL] = (h[n*L+l] > g[(n+W-1)*L+l]) ? h[n*L+l] : g[(n+W-1)*L+l];
+      }
+    }
+  }
+}
+
 template <class VoxelType> void irtkDilation<VoxelType>::Run()
 {
-  int i, x, y, z, t, maskSize;
-  VoxelType value;
-  VoxelType *ptr2current, *ptr2offset;
+  int i, n, x, y, z, X, Y, Z, T, slices;
+  VoxelType *in, *out, *src, *dst;
 
   // Do the initial set up
   this->Initialize();
 
-  maskSize = this->_offsets.GetSize();
+  X = this->_input->GetX();
+  Y = this->_input->GetY();
+  Z = this->_input->GetZ();
+  T = this->_input->GetT();
+  slices = Z * T;
+
+  irtkGenericImage<VoxelType> tmp;
+  if ((this->_Connectivity == CONNECTIVITY_26) || (this->_Iterations > 1)) {
+    tmp.Initialize(this->_input->GetImageAttributes());
+  }
+  in  = this->_input->GetPointerToVoxels();
+  out = this->_output->GetPointerToVoxels();
+
+  if ((this->_Connectivity == CONNECTIVITY_26) && (this->_Iterations > 0)) {
 
-  for (t = 0; t < this->_input->GetT(); t++) {
-    for (z = 0; z < this->_input->GetZ(); z++) {
-      for (y = 0; y < this->_input->GetY(); y++) {
-        for (x = 0; x < this->_input->GetX(); x++) {
-          if ((x == 0) || (x == this->_input->GetX()-1) ||
-              (y == 0) || (y == this->_input->GetY()-1) ||
-              (z == 0) || (z == this->_input->GetZ()-1)) {
-            this->_output->Put(x, y, z, t, this->_input->Get(x, y, z, t));
-          } else {
-            value = this->_input->Get(x, y, z, t);
-          	ptr2current = this->_input->GetPointerToVoxels(x, y, z, t);
-            for (i = 0; i < maskSize; ++i) {
-          		ptr2offset = ptr2current + this->_offsets(i);
-            	if (*ptr2offset > value)
-            		value = *ptr2offset;
-            }
-            this->_output->Put(x, y, z, t, value);
+    // Iterations with the 26-neighbourhood dilate with a box. Voxels on the
+    // boundary are never changed and the others reach them without crossing
+    // the boundary, so the box is only truncated by the image.
+    for (i = 0; i < 3; i++) {
+      src = (i == 1) ? out  : ((i == 2) ? tmp.GetPointerToVoxels() : in);
+      dst = (i == 1) ? tmp.GetPointerToVoxels() : out;
+      switch (i) {
+      case 0:
+        n = (Y * Z * T + _DilationBatch - 1) / _DilationBatch;
+        break;
+      case 1:
+        n = Z * T * ((X + _DilationBatch - 1) / _DilationBatch);
+        break;
+      default:
+        n = T * ((X * Y + _DilationBatch - 1) / _DilationBatch);
+        break;
+      }
+#ifdef HAS_TBB
+      task_scheduler_init init(tbb_no_threads);
+      parallel_for(blocked_range<int>(0, n), irtkMultiThreadedDilation<VoxelType>(this, src, dst, i));
+      init.terminate();
+#else
+      this->Box(src, dst, i, 0, n);
+#endif
+    }
+
+    // Restore boundary
+    n = 0;
+    for (i = 0; i < slices; i++) {
+      z = i % Z;
+      for (y = 0; y < Y; y++) {
+        for (x = 0; x < X; x++, n++) {
+          if ((x == 0) || (x == X-1) || (y == 0) || (y == Y-1) || (z == 0) || (z == Z-1)) {
+            out[n] = in[n];
           }
         }
       }
     }
+
+  } else if (this->_Iterations > 0) {
+
+    // Alternate between output and buffer so that the last step writes the output
+    for (i = 0; i < this->_Iterations; i++) {
+      dst = ((this->_Iterations - i) % 2 == 1) ? out : tmp.GetPointerToVoxels();
+      src = (i == 0) ? in : ((dst == out) ? tmp.GetPointerToVoxels() : out);
+#ifdef HAS_TBB
+      task_scheduler_init init(tbb_no_threads);
+      parallel_for(blocked_range<int>(0, slices), irtkMultiThreadedDilation<VoxelType>(this, src, dst, -1));
+      init.terminate();
+#else
+      this->Step(src, dst, 0, slices);
+#endif
+    }
+
+  } else {
+    for (n = 0; n < X * Y * Z * T; n++) out[n] = in[n];
   }
 
   // Do the final cleaning up
@@ -38,11 +38,13 @@ mat33 nifti_mat44_to_mat33(mat44 x)
 irtkFileNIFTIToImage::irtkFileNIFTIToImage()
 {
   _headername = NULL;
+  _dataname   = NULL;
 }
 
 irtkFileNIFTIToImage::~irtkFileNIFTIToImage()
 {
   if (this->_headername != NULL) free(this->_headername);
+  if (this->_dataname != NULL) free(this->_dataname);
 }
 
 const char *irtkFileNIFTIToImage::NameOfClass()
@@ -92,14 +94,17 @@ void irtkFileNIFTIToImage::SetInput(const char *filename)
   // Close file
   from.Close();
 
-  // Delete old file name
+  // Delete old file names
   if (this->_headername != NULL) free(this->_headername);
+  if (this->_dataname != NULL) free(this->_dataname);
+  this->_dataname = NULL;
 
   // Copy new file name
   this->_headername = strdup(filename);
 
   // Check magic no
   if (strcmp(magic_number, "n+1") == 0) {
+    this->_dataname = strdup(filename);
     this->irtkFileToImage::SetInput(filename);
     return;
   } else {
@@ -164,9 +169,80 @@ void irtkFileNIFTIToImage::SetInput(const char *filename)
                            __LINE__ );
     }
   }
+  this->_dataname = strdup(imagename);
   this->irtkFileToImage::SetInput(imagename);
 }
 
+irtkImage *irtkFileNIFTIToImage::GetOutput()
+{
+  irtkImage *output;
+
+  // Read voxels if they cannot be mapped
+  output = this->MapOutput();
+  if (output == NULL) return this->irtkFileToImage::GetOutput();
+
+  // Reflect if necessary
+  if (this->_reflectX == true) output->ReflectX();
+  if (this->_reflectY == true) output->ReflectY();
+  if (this->_reflectZ == true) output->ReflectZ();
+
+  return output;
+}
+
+bool irtkFileNIFTIToImage::_Mapping = false;
+
+void irtkFileNIFTIToImage::SetMapping(bool mapping)
+{
+  _Mapping = mapping;
+}
+
+irtkImage *irtkFileNIFTIToImage::MapOutput()
+{
+  FILE *fp;
+  size_t n;
+  unsigned char magic[2];
+  void *data;
+  irtkMappedFileAllocator *allocator;
+
+  if (_Mapping == false) return NULL;
+
+  // Voxels must be stored uncompressed, aligned and in native byte order
+  if ((this->_swapped) || (this->_start % this->_bytes != 0)) return NULL;
+  fp = fopen(this->_dataname, "rb");
+  if (fp == NULL) return NULL;
+  n = fread(magic, 1, 2, fp);
+  fclose(fp);
+  if ((n != 2) || ((magic[0] == 0x1f) && ((magic[1] == 0x8b) || (magic[1] == 0x9d)))) return NULL;
+
+  // Map voxels
+  n = size_t(this->_attr._x) * this->_attr._y * this->_attr._z * this->_attr._t;
+  allocator = GetMappedFileAllocator();
+  data = allocator->Map(this->_dataname, this->_start, n * this->_bytes);
+  if (data == NULL) return NULL;
+
+  switch (this->_type) {
+  case IRTK_VOXEL_CHAR:
+    return new irtkGenericImage<char>(this->_attr, static_cast<char *>(data), allocator);
+  case IRTK_VOXEL_UNSIGNED_CHAR:
+    return new irtkGenericImage<unsigned char>(this->_attr, static_cast<unsigned char *>(data), allocator);
+  case IRTK_VOXEL_SHORT:
+    return new irtkGenericImage<short>(this->_attr, static_cast<short *>(data), allocator);
+  case IRTK_VOXEL_UNSIGNED_SHORT:
+    return new irtkGenericImage<unsigned short>(this->_attr, static_cast<unsigned short *>(data), allocator);
+  case IRTK_VOXEL_INT:
+    return new irtkGenericImage<int>(this->_attr, static_cast<int *>(data), allocator);
+  case IRTK_VOXEL_UNSIGNED_INT:
+    return new irtkGenericImage<unsigned int>(this->_attr, static_cast<unsigned int *>(data), allocator);
+  case IRTK_VOXEL_FLOAT:
+    return new irtkGenericImage<float>(this->_attr, static_cast<float *>(data), allocator);
+  case IRTK_VOXEL_DOUBLE:
+    return new irtkGenericImage<double>(this->_attr, static_cast<double *>(data), allocator);
+  default:
+    allocator->Deallocate(data, n * this->_bytes);
+    return NULL;
+  }
+}
+
 void irtkFileNIFTIToImage::ReadHeader()
 {
   int i, order;
@@ -0,0 +1,75 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#include <irtkImage.h>
+
+#include <irtkFileToImage.h>
+
+irtkFileTILEDToImage::irtkFileTILEDToImage()
+{
+  _tiledname = NULL;
+}
+
+irtkFileTILEDToImage::~irtkFileTILEDToImage()
+{
+  if (_tiledname != NULL) free(_tiledname);
+  _tiledname = NULL;
+}
+
+int irtkFileTILEDToImage::CheckHeader(const char *filename)
+{
+  return irtkTiledImageReader::CheckHeader(filename);
+}
+
+void irtkFileTILEDToImage::SetInput(const char *filename)
+{
+  // Copy new file name
+  if (_tiledname != NULL) free(_tiledname);
+  _tiledname = strdup(filename);
+
+  this->irtkFileToImage::SetInput(_tiledname);
+}
+
+void irtkFileTILEDToImage::ReadHeader()
+{
+  _reader.Open(_tiledname);
+
+  _attr  = _reader.GetImageAttributes();
+  _type  = _reader.GetScalarType();
+  _start = 0;
+  switch (_type) {
+  case IRTK_VOXEL_CHAR:
+  case IRTK_VOXEL_UNSIGNED_CHAR:
+    _bytes = 1;
+    break;
+  case IRTK_VOXEL_SHORT:
+  case IRTK_VOXEL_UNSIGNED_SHORT:
+    _bytes = 2;
+    break;
+  case IRTK_VOXEL_DOUBLE:
+    _bytes = 8;
+    break;
+  default:
+    _bytes = 4;
+    break;
+  }
+}
+
+irtkImage *irtkFileTILEDToImage::GetOutput()
+{
+  return _reader.ReadImage();
+}
+
+const char *irtkFileTILEDToImage::NameOfClass()
+{
+  return "irtkFileTILEDToImage";
+}
@@ -62,6 +62,13 @@ irtkFileToImage *irtkFileToImage::New(const char *imagename)
   }
 #endif
 
+  // Check format for tiled images
+  if (irtkFileTILEDToImage::CheckHeader(imagename)) {
+    reader = new irtkFileTILEDToImage;
+    reader->SetInput(imagename);
+    return reader;
+  }
+
   // Check format for ANALYZE
   if (irtkFileANALYZEToImage::CheckHeader(imagename)) {
     reader = new irtkFileANALYZEToImage;
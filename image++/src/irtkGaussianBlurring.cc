@@ -18,9 +18,12 @@
 
 #include <irtkScalarFunctionToImage.h>
 
+#include <irtkRecursiveGaussian_1D.h>
+
 template <class VoxelType> irtkGaussianBlurring<VoxelType>::irtkGaussianBlurring(double Sigma)
 {
-  _Sigma = Sigma;
+  _Sigma              = Sigma;
+  _RecursiveThreshold = 4;
 }
 
 template <class VoxelType> irtkGaussianBlurring<VoxelType>::~irtkGaussianBlurring(void)
@@ -37,87 +40,67 @@ template <class VoxelType> const char *irtkGaussianBlurring<VoxelType>::NameOfCl
   return "irtkGaussianBlurring";
 }
 
-template <class VoxelType> void irtkGaussianBlurring<VoxelType>::Run()
+template <class VoxelType> void irtkGaussianBlurring<VoxelType>::Convolve(irtkGenericImage<VoxelType> *input, irtkGenericImage<VoxelType> *output, int axis, double size)
 {
-  double xsize, ysize, zsize;
-
-  // Do the initial set up
-  this->Initialize();
-
-  // Get voxel dimensions
-  this->_input->GetPixelSize(&xsize, &ysize, &zsize);
+  if (this->_Sigma/size >= _RecursiveThreshold) {
+    // Do recursive filtering
+    irtkRecursiveGaussian_1D<VoxelType> recursive(this->_Sigma/size);
+    recursive.SetInput (input);
+    recursive.SetOutput(output);
+    recursive.SetAxis(axis);
+    recursive.SetNormalization(true);
+    recursive.Run();
+    return;
+  }
 
-  // Create scalar function which corresponds to a 1D Gaussian function in X
-  irtkScalarGaussian gaussianX(this->_Sigma/xsize, 1, 1, 0, 0, 0);
+  // Create scalar function which corresponds to a 1D Gaussian function
+  irtkScalarGaussian gaussian(this->_Sigma/size, 1, 1, 0, 0, 0);
 
-  // Create filter kernel for 1D Gaussian function in X
-  irtkGenericImage<irtkRealPixel> kernelX(2*round(4*this->_Sigma/xsize)+1, 1, 1);
+  // Create filter kernel for 1D Gaussian function
+  irtkGenericImage<irtkRealPixel> kernel(2*round(4*this->_Sigma/size)+1, 1, 1);
 
   // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceX;
-  gaussianSourceX.SetInput (&gaussianX);
-  gaussianSourceX.SetOutput(&kernelX);
-  gaussianSourceX.Run();
+  irtkScalarFunctionToImage<irtkRealPixel> gaussianSource;
+  gaussianSource.SetInput (&gaussian);
+  gaussianSource.SetOutput(&kernel);
+  gaussianSource.Run();
 
   // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
-  convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  irtkConvolution_1D<VoxelType> convolution;
+  convolution.SetInput (input);
+  convolution.SetInput2(&kernel);
+  convolution.SetOutput(output);
+  convolution.SetAxis(axis);
+  convolution.SetNormalization(true);
+  convolution.Run();
+}
 
-  // Create scalar function which corresponds to a 1D Gaussian function in Y
-  irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
+template <class VoxelType> void irtkGaussianBlurring<VoxelType>::Run()
+{
+  double xsize, ysize, zsize;
+  irtkGenericImage<VoxelType> tmp, *first, *second;
 
-  // Create filter kernel for 1D Gaussian function in Y
-  irtkGenericImage<irtkRealPixel> kernelY(2*round(4*this->_Sigma/ysize)+1, 1, 1);
+  // Do the initial set up
+  this->Initialize();
 
-  // Do conversion from  scalar function to filter kernel
-  irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceY;
-  gaussianSourceY.SetInput (&gaussianY);
-  gaussianSourceY.SetOutput(&kernelY);
-  gaussianSourceY.Run();
+  // Get voxel dimensions
+  this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
-  // Do convolution
-  irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
-  convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianZ);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+  // Convolve along x, y and z without reordering the image. The passes
+  // alternate between output and buffer so that the last one writes the output
+  if (this->_input->GetZ() != 1) {
+    first  = this->_output;
+    second = &tmp;
+  } else {
+    first  = &tmp;
+    second = this->_output;
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
+  this->Convolve(this->_input, first, 0, xsize);
+  this->Convolve(first, second, 1, ysize);
+  if (this->_input->GetZ() != 1) {
+    this->Convolve(second, this->_output, 2, zsize);
+  }
 
   // Do the final cleaning up
   this->Finalize();
@@ -133,38 +116,12 @@ template <class VoxelType> void irtkGaussianBlurring<VoxelType>::RunZ()
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
-    // Create scalar function which corresponds to a 1D Gaussian function in Z
-    irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
-
-    // Create filter kernel for 1D Gaussian function in Z
-    irtkGenericImage<irtkRealPixel> kernelZ(2*round(4*this->_Sigma/zsize)+1, 1, 1);
-
-    // Do conversion from  scalar function to filter kernel
-    irtkScalarFunctionToImage<irtkRealPixel> gaussianSourceZ;
-    gaussianSourceZ.SetInput (&gaussianZ);
-    gaussianSourceZ.SetOutput(&kernelZ);
-    gaussianSourceZ.Run();
-
-    // Do convolution
-    irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
-    convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+  if (this->_input->GetZ() != 1) {
+    this->Convolve(this->_input, this->_output, 2, zsize);
+  } else if (this->_input != this->_output) {
+    *this->_output = *this->_input;
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 }
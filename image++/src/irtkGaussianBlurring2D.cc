@@ -34,6 +34,7 @@ template <class VoxelType> const char *irtkGaussianBlurring2D<VoxelType>::NameOf
 template <class VoxelType> void irtkGaussianBlurring2D<VoxelType>::Run()
 {
   double xsize, ysize, zsize;
+  irtkGenericImage<VoxelType> tmp;
 
   // Do the initial set up
   this->Initialize();
@@ -57,12 +58,9 @@ template <class VoxelType> void irtkGaussianBlurring2D<VoxelType>::Run()
   irtkConvolution_1D<VoxelType> convolutionX;
   convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
+  convolutionX.SetOutput(&tmp);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run();
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -78,14 +76,12 @@ template <class VoxelType> void irtkGaussianBlurring2D<VoxelType>::Run()
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
+  convolutionY.SetInput (&tmp);
   convolutionY.SetInput2(&kernelY);
   convolutionY.SetOutput(this->_output);
+  convolutionY.SetAxis(1);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip image back (x and y axis)
-  this->_output->FlipXY(1);
+  convolutionY.Run();
 
   // Do the final cleaning up
   this->Finalize();
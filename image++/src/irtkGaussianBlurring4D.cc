@@ -40,6 +40,7 @@ template <class VoxelType> const char *irtkGaussianBlurring4D<VoxelType>::NameOf
 template <class VoxelType> void irtkGaussianBlurring4D<VoxelType>::Run()
 {
   double xsize, ysize, zsize, tsize;
+  irtkGenericImage<VoxelType> tmp, *first, *second;
 
   // Do the initial set up
   this->Initialize();
@@ -59,16 +60,24 @@ template <class VoxelType> void irtkGaussianBlurring4D<VoxelType>::Run()
   gaussianSourceX.SetOutput(&kernelX);
   gaussianSourceX.Run();
 
+  // Convolve along x, y, z and t without reordering the image. The passes
+  // alternate between output and buffer so that the last one writes the output
+  if (this->_input->GetZ() != 1) {
+    first  = &tmp;
+    second = this->_output;
+  } else {
+    first  = this->_output;
+    second = &tmp;
+  }
+
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
   convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
+  convolutionX.SetOutput(first);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
+  convolutionX.Run();
 
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -84,16 +93,15 @@ template <class VoxelType> void irtkGaussianBlurring4D<VoxelType>::Run()
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
+  convolutionY.SetInput (first);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
+  convolutionY.SetOutput(second);
+  convolutionY.SetAxis(1);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
+  convolutionY.Run();
 
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
 
-  if (this->_output->GetX() != 1) {
+  if (this->_input->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -108,15 +116,15 @@ template <class VoxelType> void irtkGaussianBlurring4D<VoxelType>::Run()
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
+    convolutionZ.SetInput (second);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
+    convolutionZ.SetOutput(first);
+    convolutionZ.SetAxis(2);
     convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run();
+    second = first;
   }
 
-  // Flip x and t axis of image
-  this->_output->FlipXT(1);
 
   // Create scalar function which corresponds to a 1D Gaussian function in T
   irtkScalarGaussian gaussianT(this->_Sigma/tsize, 1, 1, 0, 0, 0);
@@ -132,16 +140,13 @@ template <class VoxelType> void irtkGaussianBlurring4D<VoxelType>::Run()
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionT;
-  convolutionT.SetInput (this->_output);
+  convolutionT.SetInput (second);
   convolutionT.SetInput2(&kernelT);
   convolutionT.SetOutput(this->_output);
+  convolutionT.SetAxis(3);
   convolutionT.SetNormalization(true);
-  convolutionT.irtkImageToImage<VoxelType>::Run();
+  convolutionT.Run();
 
-  // Flip image back, first t and z axis, then x and z axis and finally x and y axis
-  this->_output->FlipXT(1);
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
 
   // Do the final cleaning up
   this->Finalize();
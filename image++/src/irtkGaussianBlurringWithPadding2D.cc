@@ -30,6 +30,7 @@ template <class VoxelType> const char *irtkGaussianBlurringWithPadding2D<VoxelTy
 template <class VoxelType> void irtkGaussianBlurringWithPadding2D<VoxelType>::Run()
 {
   double xsize, ysize, zsize;
+  irtkGenericImage<VoxelType> tmp;
 
   // Do the initial set up
   this->Initialize();
@@ -53,12 +54,9 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding2D<VoxelType>::Ru
   irtkConvolutionWithPadding_1D<VoxelType> convolutionX(this->_PaddingValue);
   convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
+  convolutionX.SetOutput(&tmp);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run();
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -74,14 +72,12 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding2D<VoxelType>::Ru
 
   // Do convolution
   irtkConvolutionWithPadding_1D<VoxelType> convolutionY(this->_PaddingValue);
-  convolutionY.SetInput (this->_output);
+  convolutionY.SetInput (&tmp);
   convolutionY.SetInput2(&kernelY);
   convolutionY.SetOutput(this->_output);
+  convolutionY.SetAxis(1);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip image back (x and y axis)
-  this->_output->FlipXY(1);
+  convolutionY.Run();
 
   // Do the final cleaning up
   this->Finalize();
@@ -17,6 +17,80 @@
 #include <irtkFileToImage.h>
 #include <irtkImageToFile.h>
 
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#if defined(__GNUC__) && !defined(WIN32)
+#  include <execinfo.h>
+#  define IRTK_IMAGE_COPY_SITE __builtin_return_address(0)
+#else
+#  define IRTK_IMAGE_COPY_SITE NULL
+#endif
+
+int debug_image_copies = 0;
+
+/// Deep copies per call site (number of copies, bytes copied)
+typedef std::pair<void *, std::pair<long, double> > irtkImageCopySite;
+typedef std::map<void *, std::pair<long, double> > irtkImageCopySites;
+
+static irtkImageCopySites &ImageCopySites()
+{
+  static irtkImageCopySites sites;
+  return sites;
+}
+
+#ifdef HAS_TBB
+static mutex _ImageCopyMutex;
+#endif
+
+static void RecordImageCopy(void *site, double bytes)
+{
+#ifdef HAS_TBB
+  mutex::scoped_lock lock(_ImageCopyMutex);
+#endif
+  std::pair<long, double> &count = ImageCopySites()[site];
+  count.first++;
+  count.second += bytes;
+}
+
+static bool CompareImageCopies(const irtkImageCopySite &a, const irtkImageCopySite &b)
+{
+  return a.second.second > b.second.second;
+}
+
+void PrintImageCopies(ostream &os)
+{
+#ifdef HAS_TBB
+  mutex::scoped_lock lock(_ImageCopyMutex);
+#endif
+  std::vector<irtkImageCopySite> sites(ImageCopySites().begin(), ImageCopySites().end());
+  std::sort(sites.begin(), sites.end(), CompareImageCopies);
+
+  os << "Deep copies of images per call site:" << endl;
+  for (unsigned int i = 0; i < sites.size(); i++) {
+    os << "  " << sites[i].second.first << " copies, " << sites[i].second.second / 1048576.0 << " MB from ";
+#if defined(__GNUC__) && !defined(WIN32)
+    void *address = sites[i].first;
+    char **symbol = backtrace_symbols(&address, 1);
+    if (symbol != NULL) {
+      os << symbol[0] << endl;
+      free(symbol);
+      continue;
+    }
+#endif
+    os << sites[i].first << endl;
+  }
+}
+
+void ResetImageCopies()
+{
+#ifdef HAS_TBB
+  mutex::scoped_lock lock(_ImageCopyMutex);
+#endif
+  ImageCopySites().clear();
+}
+
 template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(void) : irtkBaseImage()
 {
   _attr._x = 0;
@@ -25,7 +99,8 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(void) :
   _attr._t = 0;
 
   // Initialize data
-  _matrix  = NULL;
+  _data      = NULL;
+  _allocator = NULL;
 }
 
 template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(int x, int y, int z, int t) : irtkBaseImage()
@@ -38,7 +113,8 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(int x,
   attr._t = t;
 
   // Initialize data
-  _matrix = NULL;
+  _data      = NULL;
+  _allocator = NULL;
 
   // Initialize rest of class
   this->Initialize(attr);
@@ -47,7 +123,8 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(int x,
 template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(char *filename)
 {
   // Initialize data
-  _matrix = NULL;
+  _data      = NULL;
+  _allocator = NULL;
 
   // Read image
   this->Read(filename);
@@ -56,7 +133,8 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(char *f
 template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(const irtkImageAttributes &attr) : irtkBaseImage()
 {
   // Initialize data
-  _matrix  = NULL;
+  _data      = NULL;
+  _allocator = NULL;
 
   // Initialize rest of class
   this->Initialize(attr);
@@ -68,7 +146,8 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(const i
   VoxelType *ptr1, *ptr2;
 
   // Initialize data
-  _matrix = NULL;
+  _data      = NULL;
+  _allocator = NULL;
 
   // Initialize rest of class
   this->Initialize(image._attr);
@@ -79,6 +158,8 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(const i
   for (i = 0; i < n; i++) {
     ptr1[i] = ptr2[i];
   }
+
+  if (debug_image_copies) RecordImageCopy(IRTK_IMAGE_COPY_SITE, double(n) * sizeof(VoxelType));
 }
 
 template <class VoxelType> template <class VoxelType2> irtkGenericImage<VoxelType>::irtkGenericImage(const irtkGenericImage<VoxelType2> &image)
@@ -88,7 +169,8 @@ template <class VoxelType> template <class VoxelType2> irtkGenericImage<VoxelTyp
   VoxelType2 *ptr2;
 
   // Initialize data
-  _matrix = NULL;
+  _data      = NULL;
+  _allocator = NULL;
 
   // Initialize rest of class
   this->Initialize(image.GetImageAttributes());
@@ -101,11 +183,52 @@ template <class VoxelType> template <class VoxelType2> irtkGenericImage<VoxelTyp
   }
 }
 
+template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(const irtkGenericImageView<VoxelType> &view) : irtkBaseImage()
+{
+  // Initialize data
+  _data      = NULL;
+  _allocator = NULL;
+
+  // Initialize rest of class
+  this->Initialize(view.GetImageAttributes());
+
+  // Copy voxels
+  view.CopyTo(_data);
+}
+
+template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(const irtkImageAttributes &attr, VoxelType *data, irtkDataAllocator *allocator) : irtkBaseImage()
+{
+  // Take over data without initializing voxels
+  _data      = data;
+  _allocator = allocator;
+
+  // Initialize base class
+  this->irtkBaseImage::Update(attr);
+}
+
+#if __cplusplus >= 201103L
+
+template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(irtkGenericImage &&image) noexcept : irtkBaseImage(image)
+{
+  // Take over data
+  _data      = image._data;
+  _allocator = image._allocator;
+
+  // Leave other image empty
+  image._data    = NULL;
+  image._attr._x = 0;
+  image._attr._y = 0;
+  image._attr._z = 0;
+  image._attr._t = 0;
+}
+
+#endif
+
 template <class VoxelType> irtkGenericImage<VoxelType>::~irtkGenericImage(void)
 {
-  if (_matrix != NULL) {
-    Deallocate<VoxelType>(_matrix);
-    _matrix = NULL;
+  if (_data != NULL) {
+    this->DeallocateData(_data, this->NumberOfVoxels());
+    _data = NULL;
   }
   _attr._x = 0;
   _attr._y = 0;
@@ -153,17 +276,28 @@ template <> const char *irtkGenericImage<double>::NameOfClass()
   return "irtkGenericImage<double>";
 }
 
+template <class VoxelType> VoxelType *irtkGenericImage<VoxelType>::AllocateData(size_t n)
+{
+  return static_cast<VoxelType *>(_allocator->Allocate(n * sizeof(VoxelType)));
+}
+
+template <class VoxelType> void irtkGenericImage<VoxelType>::DeallocateData(VoxelType *data, size_t n)
+{
+  _allocator->Deallocate(data, n * sizeof(VoxelType));
+}
+
 template <class VoxelType> void irtkGenericImage<VoxelType>::Initialize(const irtkImageAttributes &attr)
 {
   // Free memory
   if ((_attr._x != attr._x) || (_attr._y != attr._y) || (_attr._z != attr._z) || (_attr._t != attr._t)) {
     // Free old memory
-    if (_matrix != NULL) Deallocate<VoxelType>(_matrix);
+    if (_data != NULL) this->DeallocateData(_data, this->NumberOfVoxels());
     // Allocate new memory
-    if (attr._x*attr._y*attr._z*attr._t > 0) {
-      _matrix = Allocate(_matrix, attr._x, attr._y, attr._z, attr._t);
+    _allocator = GetDataAllocator();
+    if ((attr._x > 0) && (attr._y > 0) && (attr._z > 0) && (attr._t > 0)) {
+      _data = this->AllocateData(static_cast<size_t>(attr._x) * attr._y * attr._z * attr._t);
     } else {
-      _matrix = NULL;
+      _data = NULL;
     }
   }
 
@@ -176,9 +310,9 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::Initialize(const ir
 
 template <class VoxelType> void irtkGenericImage<VoxelType>::Clear()
 {
-	// Free memory
-	if (_matrix != NULL)
-		Deallocate<VoxelType>(_matrix);
+  // Free memory
+  if (_data != NULL) this->DeallocateData(_data, this->NumberOfVoxels());
+  _data = NULL;
 
   _attr._x = 0;
   _attr._y = 0;
@@ -197,8 +331,14 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::Read(const char *fi
   // Get output
   image = reader->GetOutput();
 
-  // Convert image
-  switch (reader->GetDataType()) {
+  // Take over voxels of the same type, convert all others
+  if (dynamic_cast<irtkGenericImage<VoxelType> *>(image) != NULL) {
+#if __cplusplus >= 201103L
+    *this = std::move(*(dynamic_cast<irtkGenericImage<VoxelType> *>(image)));
+#else
+    *this = *(dynamic_cast<irtkGenericImage<VoxelType> *>(image));
+#endif
+  } else switch (reader->GetDataType()) {
           
   case IRTK_VOXEL_CHAR: { *this = *(dynamic_cast<irtkGenericImage<char> *>(image)); } break;
 
@@ -220,7 +360,8 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::Read(const char *fi
       cout << "irtkGenericImage::GetOutput: Unknown voxel type" << endl;
   }
 
-  if (reader->GetSlope() != 0) {
+  // Skip identity scaling, which would touch every voxel
+  if ((reader->GetSlope() != 0) && ((reader->GetSlope() != 1) || (reader->GetIntercept() != 0))) {
       switch (this->GetScalarType()) {
 
       case IRTK_VOXEL_FLOAT: {
@@ -558,7 +699,6 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::Quantiles( vector<d
 
 template <class VoxelType> irtkGenericImage<VoxelType> irtkGenericImage<VoxelType>::GetRegion(int k, int m) const
 {
-  int i, j;
   double x1, y1, z1, t1, x2, y2, z2, t2;
 
   if ((k < 0) || (k >= _attr._z) || (m < 0) || (m >= _attr._t)) {
@@ -598,52 +738,24 @@ template <class VoxelType> irtkGenericImage<VoxelType> irtkGenericImage<VoxelTyp
   image.PutOrigin(x1 - x2, y1 - y2, z1 - z2, t1 - t2);
 
   // Copy region
-  for (j = 0; j < _attr._y; j++) {
-    for (i = 0; i < _attr._x; i++) {
-      image._matrix[0][0][j][i] = _matrix[m][k][j][i];
-    }
-  }
+  this->GetRegionView(0, 0, k, m, _attr._x, _attr._y, k+1, m+1).CopyTo(image._data);
   return image;
 }
 
 template <class VoxelType> irtkGenericImage<VoxelType> irtkGenericImage<VoxelType>::GetFrame(int l) const
 {
-  int i, j, k;
-
-  if ((l < 0) || (l >= _attr._t)) {
-      stringstream msg;
-      msg << "irtkGenericImage<VoxelType>::GetRegion: Parameter out of range\n";
-      cerr << msg.str();
-      throw irtkException( msg.str(),
-                           __FILE__,
-                           __LINE__ );
-  }
-
-  // Initialize
-  irtkImageAttributes attr = this->_attr;
-  attr._t = 1;
-  irtkGenericImage<VoxelType> image(attr);
-
-  // Copy region
-  for (k = 0; k < _attr._z; k++) {
-    for (j = 0; j < _attr._y; j++) {
-      for (i = 0; i < _attr._x; i++) {
-        image._matrix[0][k][j][i] = _matrix[l][k][j][i];
-      }
-    }
-  }
-  return image;
+  return irtkGenericImage<VoxelType>(this->GetFrameView(l));
 }
 
-template <class VoxelType> irtkGenericImage<VoxelType> irtkGenericImage<VoxelType>::GetRegion(int i1, int j1, int k1, int i2, int j2, int k2) const
+template <class VoxelType> irtkImageAttributes irtkGenericImage<VoxelType>::GetRegionAttributes(int i1, int j1, int k1, int l1, int i2, int j2, int k2, int l2) const
 {
-  int i, j, k, l;
   double x1, y1, z1, x2, y2, z2;
 
   if ((i1 < 0) || (i1 >= i2) ||
       (j1 < 0) || (j1 >= j2) ||
       (k1 < 0) || (k1 >= k2) ||
-      (i2 > _attr._x) || (j2 > _attr._y) || (k2 > _attr._z)) {
+      (l1 < 0) || (l1 >= l2) ||
+      (i2 > _attr._x) || (j2 > _attr._y) || (k2 > _attr._z) || (l2 > _attr._t)) {
       stringstream msg;
       msg << "irtkGenericImage<VoxelType>::GetRegion: Parameter out of range\n";
       cerr << msg.str();
@@ -657,10 +769,10 @@ template <class VoxelType> irtkGenericImage<VoxelType> irtkGenericImage<VoxelTyp
   attr._x = i2 - i1;
   attr._y = j2 - j1;
   attr._z = k2 - k1;
+  attr._t = l2 - l1;
   attr._xorigin = 0;
   attr._yorigin = 0;
   attr._zorigin = 0;
-  irtkGenericImage<VoxelType> image(attr);
 
   // Calculate position of first voxel in roi in original image
   x1 = i1;
@@ -669,37 +781,49 @@ template <class VoxelType> irtkGenericImage<VoxelType> irtkGenericImage<VoxelTyp
   this->ImageToWorld(x1, y1, z1);
 
   // Calculate position of first voxel in roi in new image
-  x2 = 0;
-  y2 = 0;
-  z2 = 0;
-  image.ImageToWorld(x2, y2, z2);
+  irtkMatrix m = irtkBaseImage::GetImageToWorldMatrix(attr);
+  x2 = m(0, 3);
+  y2 = m(1, 3);
+  z2 = m(2, 3);
 
   // Shift origin of new image accordingly
-  image.PutOrigin(x1 - x2, y1 - y2, z1 - z2);
+  attr._xorigin = x1 - x2;
+  attr._yorigin = y1 - y2;
+  attr._zorigin = z1 - z2;
 
-  // Copy region
-  for (l = 0; l < _attr._t; l++) {
-    for (k = k1; k < k2; k++) {
-      for (j = j1; j < j2; j++) {
-        for (i = i1; i < i2; i++) {
-          image._matrix[l][k-k1][j-j1][i-i1] = _matrix[l][k][j][i];
-        }
-      }
-    }
-  }
-  return image;
+  return attr;
+}
+
+template <class VoxelType> irtkGenericImage<VoxelType> irtkGenericImage<VoxelType>::GetRegion(int i1, int j1, int k1, int i2, int j2, int k2) const
+{
+  return irtkGenericImage<VoxelType>(this->GetRegionView(i1, j1, k1, i2, j2, k2));
 }
 
 template <class VoxelType> irtkGenericImage<VoxelType> irtkGenericImage<VoxelType>::GetRegion(int i1, int j1, int k1, int l1, int i2, int j2, int k2, int l2) const
 {
-  int i, j, k, l;
-  double x1, y1, z1, x2, y2, z2;
+  return irtkGenericImage<VoxelType>(this->GetRegionView(i1, j1, k1, l1, i2, j2, k2, l2));
+}
 
-  if ((i1 < 0) || (i1 >= i2) ||
-      (j1 < 0) || (j1 >= j2) ||
-      (k1 < 0) || (k1 >= k2) ||
-      (l1 < 0) || (l1 >= l2) ||
-      (i2 > _attr._x) || (j2 > _attr._y) || (k2 > _attr._z) || (l2 > _attr._t)) {
+template <class VoxelType> irtkGenericImageView<VoxelType> irtkGenericImage<VoxelType>::GetView() const
+{
+  return irtkGenericImageView<VoxelType>(_data, _attr, this->Index(0, 1, 0, 0), this->Index(0, 0, 1, 0), this->Index(0, 0, 0, 1));
+}
+
+template <class VoxelType> irtkGenericImageView<VoxelType> irtkGenericImage<VoxelType>::GetRegionView(int i1, int j1, int k1, int i2, int j2, int k2) const
+{
+  return this->GetRegionView(i1, j1, k1, 0, i2, j2, k2, _attr._t);
+}
+
+template <class VoxelType> irtkGenericImageView<VoxelType> irtkGenericImage<VoxelType>::GetRegionView(int i1, int j1, int k1, int l1, int i2, int j2, int k2, int l2) const
+{
+  irtkImageAttributes attr = this->GetRegionAttributes(i1, j1, k1, l1, i2, j2, k2, l2);
+
+  return irtkGenericImageView<VoxelType>(_data + this->Index(i1, j1, k1, l1), attr, this->Index(0, 1, 0, 0), this->Index(0, 0, 1, 0), this->Index(0, 0, 0, 1));
+}
+
+template <class VoxelType> irtkGenericImageView<VoxelType> irtkGenericImage<VoxelType>::GetFrameView(int l) const
+{
+  if ((l < 0) || (l >= _attr._t)) {
       stringstream msg;
       msg << "irtkGenericImage<VoxelType>::GetRegion: Parameter out of range\n";
       cerr << msg.str();
@@ -708,43 +832,10 @@ template <class VoxelType> irtkGenericImage<VoxelType> irtkGenericImage<VoxelTyp
                            __LINE__ );
   }
 
-  // Initialize
   irtkImageAttributes attr = this->_attr;
-  attr._x = i2 - i1;
-  attr._y = j2 - j1;
-  attr._z = k2 - k1;
-  attr._t = l2 - l1;
-  attr._xorigin = 0;
-  attr._yorigin = 0;
-  attr._zorigin = 0;
-  irtkGenericImage<VoxelType> image(attr);
-
-  // Calculate position of first voxel in roi in original image
-  x1 = i1;
-  y1 = j1;
-  z1 = k1;
-  this->ImageToWorld(x1, y1, z1);
-
-  // Calculate position of first voxel in roi in new image
-  x2 = 0;
-  y2 = 0;
-  z2 = 0;
-  image.ImageToWorld(x2, y2, z2);
-
-  // Shift origin of new image accordingly
-  image.PutOrigin(x1 - x2, y1 - y2, z1 - z2);
+  attr._t = 1;
 
-  // Copy region
-  for (l = l1; l < l2; l++) {
-    for (k = k1; k < k2; k++) {
-      for (j = j1; j < j2; j++) {
-        for (i = i1; i < i2; i++) {
-          image._matrix[l-l1][k-k1][j-j1][i-i1] = _matrix[l][k][j][i];
-        }
-      }
-    }
-  }
-  return image;
+  return irtkGenericImageView<VoxelType>(_data + this->Index(0, 0, 0, l), attr, this->Index(0, 1, 0, 0), this->Index(0, 0, 1, 0), this->Index(0, 0, 0, 1));
 }
 
 template <class VoxelType> irtkGenericImage<VoxelType>& irtkGenericImage<VoxelType>::operator=(const irtkGenericImage<VoxelType> &image)
@@ -761,9 +852,38 @@ template <class VoxelType> irtkGenericImage<VoxelType>& irtkGenericImage<VoxelTy
   for (i = 0; i < n; i++) {
     ptr1[i] = ptr2[i];
   }
+
+  if (debug_image_copies) RecordImageCopy(IRTK_IMAGE_COPY_SITE, double(n) * sizeof(VoxelType));
+
+  return *this;
+}
+
+#if __cplusplus >= 201103L
+
+template <class VoxelType> irtkGenericImage<VoxelType>& irtkGenericImage<VoxelType>::operator=(irtkGenericImage<VoxelType> &&image) noexcept
+{
+  if (this == &image) return *this;
+
+  // Free old memory
+  if (_data != NULL) this->DeallocateData(_data, this->NumberOfVoxels());
+
+  // Take over data and attributes
+  _data      = image._data;
+  _allocator = image._allocator;
+  this->irtkBaseImage::Update(image._attr);
+
+  // Leave other image empty
+  image._data    = NULL;
+  image._attr._x = 0;
+  image._attr._y = 0;
+  image._attr._z = 0;
+  image._attr._t = 0;
+
   return *this;
 }
 
+#endif
+
 template <class VoxelType> template <class VoxelType2> irtkGenericImage<VoxelType>& irtkGenericImage<VoxelType>::operator=(const irtkGenericImage<VoxelType2> &image)
 {
   int i, n;
@@ -1104,7 +1224,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::ReflectX()
     for (z = 0; z < _attr._z; z++) {
       for (y = 0; y < _attr._y; y++) {
         for (x = 0; x < _attr._x / 2; x++) {
-          swap(_matrix[t][z][y][x], _matrix[t][z][y][_attr._x-(x+1)]);
+          swap(_data[this->Index(x, y, z, t)], _data[this->Index(_attr._x-(x+1), y, z, t)]);
         }
       }
     }
@@ -1119,7 +1239,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::ReflectY()
     for (z = 0; z < _attr._z; z++) {
       for (y = 0; y < _attr._y / 2; y++) {
         for (x = 0; x < _attr._x; x++) {
-          swap(_matrix[t][z][y][x], _matrix[t][z][_attr._y-(y+1)][x]);
+          swap(_data[this->Index(x, y, z, t)], _data[this->Index(x, _attr._y-(y+1), z, t)]);
         }
       }
     }
@@ -1134,7 +1254,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::ReflectZ()
     for (z = 0; z < _attr._z / 2; z++) {
       for (y = 0; y < _attr._y; y++) {
         for (x = 0; x < _attr._x; x++) {
-          swap(_matrix[t][z][y][x], _matrix[t][_attr._z-(z+1)][y][x]);
+          swap(_data[this->Index(x, y, z, t)], _data[this->Index(x, y, _attr._z-(z+1), t)]);
         }
       }
     }
@@ -1144,26 +1264,27 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::ReflectZ()
 template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXY(int modifyOrigin)
 {
   int i, j, k, m;
-  VoxelType ****matrix = NULL;
+  VoxelType *data, *ptr;
 
   // Allocate memory
-  matrix = Allocate(matrix, _attr._y, _attr._x, _attr._z, _attr._t);
+  data = this->AllocateData(this->GetNumberOfVoxels());
+  ptr  = _data;
 
   for (m = 0; m < _attr._t; m++) {
     for (k = 0; k < _attr._z; k++) {
       for (j = 0; j < _attr._y; j++) {
         for (i = 0; i < _attr._x; i++) {
-          matrix[m][k][i][j] = _matrix[m][k][j][i];
+          data[((m*_attr._z + k)*_attr._x + i)*_attr._y + j] = *ptr++;
         }
       }
     }
   }
 
   // Swap pointers
-  swap(matrix, _matrix);
+  swap(data, _data);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->DeallocateData(data, this->GetNumberOfVoxels());
 
   // Swap image dimensions
   swap(_attr._x, _attr._y);
@@ -1184,26 +1305,27 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXY(int modifyOr
 template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXZ(int modifyOrigin)
 {
   int i, j, k, l;
-  VoxelType ****matrix = NULL;
+  VoxelType *data, *ptr;
 
   // Allocate memory
-  matrix = Allocate(matrix, _attr._z, _attr._y, _attr._x, _attr._t);
+  data = this->AllocateData(this->GetNumberOfVoxels());
+  ptr  = _data;
 
   for (l = 0; l < _attr._t; l++) {
     for (k = 0; k < _attr._z; k++) {
       for (j = 0; j < _attr._y; j++) {
         for (i = 0; i < _attr._x; i++) {
-          matrix[l][i][j][k] = _matrix[l][k][j][i];
+          data[((l*_attr._x + i)*_attr._y + j)*_attr._z + k] = *ptr++;
         }
       }
     }
   }
 
   // Swap pointers
-  swap(matrix, _matrix);
+  swap(data, _data);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->DeallocateData(data, this->GetNumberOfVoxels());
 
   // Swap image dimensions
   swap(_attr._x, _attr._z);
@@ -1223,26 +1345,27 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXZ(int modifyOr
 template <class VoxelType> void irtkGenericImage<VoxelType>::FlipYZ(int modifyOrigin)
 {
   int i, j, k, l;
-  VoxelType ****matrix = NULL;
+  VoxelType *data, *ptr;
 
   // Allocate memory
-  matrix = Allocate(matrix, _attr._x, _attr._z, _attr._y, _attr._t);
+  data = this->AllocateData(this->GetNumberOfVoxels());
+  ptr  = _data;
 
   for (l = 0; l < _attr._t; l++) {
     for (k = 0; k < _attr._z; k++) {
       for (j = 0; j < _attr._y; j++) {
         for (i = 0; i < _attr._x; i++) {
-          matrix[l][j][k][i] = _matrix[l][k][j][i];
+          data[((l*_attr._y + j)*_attr._z + k)*_attr._x + i] = *ptr++;
         }
       }
     }
   }
 
   // Swap pointers
-  swap(matrix, _matrix);
+  swap(data, _data);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->DeallocateData(data, this->GetNumberOfVoxels());
 
   // Swap image dimensions
   swap(_attr._y, _attr._z);
@@ -1262,26 +1385,27 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipYZ(int modifyOr
 template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXT(int modifyOrigin)
 {
   int i, j, k, m;
-  VoxelType ****matrix = NULL;
+  VoxelType *data, *ptr;
 
   // Allocate memory
-  matrix = Allocate(matrix, _attr._t, _attr._y, _attr._z, _attr._x);
+  data = this->AllocateData(this->GetNumberOfVoxels());
+  ptr  = _data;
 
   for (m = 0; m < _attr._t; m++) {
     for (k = 0; k < _attr._z; k++) {
       for (j = 0; j < _attr._y; j++) {
         for (i = 0; i < _attr._x; i++) {
-          matrix[i][k][j][m] = _matrix[m][k][j][i];
+          data[((i*_attr._z + k)*_attr._y + j)*_attr._t + m] = *ptr++;
         }
       }
     }
   }
 
   // Swap pointers
-  swap(matrix, _matrix);
+  swap(data, _data);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->DeallocateData(data, this->GetNumberOfVoxels());
 
   // Swap image dimensions
   swap(_attr._x, _attr._t);
@@ -1302,26 +1426,27 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXT(int modifyOr
 template <class VoxelType> void irtkGenericImage<VoxelType>::FlipYT(int modifyOrigin)
 {
   int i, j, k, m;
-  VoxelType ****matrix = NULL;
+  VoxelType *data, *ptr;
 
   // Allocate memory
-  matrix = Allocate(matrix, _attr._x, _attr._t, _attr._z, _attr._y);
+  data = this->AllocateData(this->GetNumberOfVoxels());
+  ptr  = _data;
 
   for (m = 0; m < _attr._t; m++) {
     for (k = 0; k < _attr._z; k++) {
       for (j = 0; j < _attr._y; j++) {
         for (i = 0; i < _attr._x; i++) {
-          matrix[j][k][m][i] = _matrix[m][k][j][i];
+          data[((j*_attr._z + k)*_attr._t + m)*_attr._x + i] = *ptr++;
         }
       }
     }
   }
 
   // Swap pointers
-  swap(matrix, _matrix);
+  swap(data, _data);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->DeallocateData(data, this->GetNumberOfVoxels());
 
   // Swap image dimensions
   swap(_attr._y, _attr._t);
@@ -1342,26 +1467,27 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipYT(int modifyOr
 template <class VoxelType> void irtkGenericImage<VoxelType>::FlipZT(int modifyOrigin)
 {
   int i, j, k, m;
-  VoxelType ****matrix = NULL;
+  VoxelType *data, *ptr;
 
   // Allocate memory
-  matrix = Allocate(matrix, _attr._x, _attr._y, _attr._t, _attr._z);
+  data = this->AllocateData(this->GetNumberOfVoxels());
+  ptr  = _data;
 
   for (m = 0; m < _attr._t; m++) {
     for (k = 0; k < _attr._z; k++) {
       for (j = 0; j < _attr._y; j++) {
         for (i = 0; i < _attr._x; i++) {
-          matrix[k][m][j][i] = _matrix[m][k][j][i];
+          data[((k*_attr._t + m)*_attr._y + j)*_attr._x + i] = *ptr++;
         }
       }
     }
   }
 
   // Swap pointers
-  swap(matrix, _matrix);
+  swap(data, _data);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->DeallocateData(data, this->GetNumberOfVoxels());
 
   // Swap image dimensions
   swap(_attr._z, _attr._t);
@@ -78,6 +78,12 @@ irtkImageToFile *irtkImageToFile::New(const char *imagename)
   }
 #endif
 
+  // Check format for tiled images
+  if (strstr(imagename, ".tiled") != NULL) {
+    writer = new irtkImageToFileTILED;
+    writer->SetOutput(imagename);
+  }
+
   // Check for default file format
   if (writer == NULL) {
     writer = new irtkImageToFileGIPL;
@@ -140,6 +146,9 @@ void irtkImageToFile::Initialize()
                            __LINE__ );
   }
 
+  // Images mapped from the file must not see it change
+  GetMappedFileAllocator()->Detach(_output);
+
   // Open file for writing
   this->Open(_output);
 
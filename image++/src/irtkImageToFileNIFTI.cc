@@ -18,6 +18,13 @@
 
 #include <irtkNIFTI.h>
 
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 irtkImageToFileNIFTI::irtkImageToFileNIFTI() : irtkImageToFile()
 {
 	this->_headername = NULL;
@@ -138,11 +145,63 @@ void irtkImageToFileNIFTI::Run()
 	/// Set data pointer in nifti image struct
 	_hdr.nim->data = this->_input->GetScalarPointer();
 
+	// Images mapped from this file must not see it change
+	GetMappedFileAllocator()->Detach(this->_output);
+
 	// Write hdr and data
-	nifti_image_write(_hdr.nim);
+	if (this->WriteMapped() == false) nifti_image_write(_hdr.nim);
 
 	// Finalize filter
 	this->Finalize();
 }
 
+bool irtkImageToFileNIFTI::WriteMapped()
+{
+#ifndef WIN32
+	int fd;
+	size_t n, offset, page, start, length;
+	znzFile fp;
+	void *base;
+
+	if ((_hdr.nim->nifti_type != NIFTI_FTYPE_NIFTI1_1) || nifti_is_gzfile(_hdr.nim->fname)) return false;
+
+	// Write hdr and extensions only, this sets the offset of the data
+	fp = nifti_image_write_hdr_img(_hdr.nim, 0, "wb");
+	if (fp != NULL) znzclose(fp);
+	n      = nifti_get_volsize(_hdr.nim);
+	offset = _hdr.nim->iname_offset;
+
+	// Preallocate file, so that running out of space is an error here and not
+	// a signal when the mapping is written
+	fd = open(_hdr.nim->fname, O_RDWR);
+	if (fd < 0) return false;
+#ifdef __linux__
+	if (posix_fallocate(fd, 0, offset + n) != 0) {
+		close(fd);
+		return false;
+	}
+#endif
+	if (ftruncate(fd, offset + n) != 0) {
+		close(fd);
+		return false;
+	}
+
+	// Mappings have to start at a page boundary
+	page   = sysconf(_SC_PAGESIZE);
+	start  = (offset / page) * page;
+	length = offset - start + n;
+	base   = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, start);
+	close(fd);
+	if (base == MAP_FAILED) return false;
+
+	// Copy data
+	memcpy(static_cast<char *>(base) + (offset - start), _hdr.nim->data, n);
+	munmap(base, length);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
 #endif
@@ -0,0 +1,29 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#include <irtkImage.h>
+
+#include <irtkImageToFile.h>
+
+const char *irtkImageToFileTILED::NameOfClass()
+{
+  return "irtkImageToFileTILED";
+}
+
+void irtkImageToFileTILED::Run()
+{
+  irtkTiledImageWriter writer;
+
+  writer.Open(_output, _input->GetImageAttributes(), _input->GetScalarType());
+  writer.WriteFrames(_input);
+  writer.Close();
+}
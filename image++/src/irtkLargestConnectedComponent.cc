@@ -12,11 +12,12 @@
 
 #include <irtkImage.h>
 
+#include <irtkConnectedComponents.h>
+
 #include <irtkLargestConnectedComponent.h>
 
 template <class VoxelType> irtkLargestConnectedComponent<VoxelType>::irtkLargestConnectedComponent(VoxelType ClusterLabel)
 {
-  _currentClusterSize = 0;
   _largestClusterSize = 0;
   _Mode2D = false;
   _ClusterLabel = ClusterLabel;
@@ -35,41 +36,11 @@ template <class VoxelType> const char *irtkLargestConnectedComponent<VoxelType>:
   return "irtkLargestConnectedComponent";
 }
 
-template <class VoxelType> void irtkLargestConnectedComponent<VoxelType>::Grow2D(int x, int y, int z, int t)
-{
-  if ((x >= 0) && (x < this->_input->GetX()) && (y >= 0) && (y < this->_input->GetY()) &&
-      (z >= 0) && (z < this->_input->GetZ()) && (t >= 0) && (t < this->_input->GetT())) {
-    if ((this->_input->Get(x, y, z, t) == this->_ClusterLabel) && (this->_output->Get(x, y, z, t) == 0)) {
-      this->_output->Put(x, y, z, t, 1);
-      this->_currentClusterSize++;
-      this->Grow2D(x-1, y  , z, t);
-      this->Grow2D(x+1, y  , z, t);
-      this->Grow2D(x  , y-1, z, t);
-      this->Grow2D(x  , y+1, z, t);
-    }
-  }
-}
-
-template <class VoxelType> void irtkLargestConnectedComponent<VoxelType>::Grow3D(int x, int y, int z, int t)
-{
-  if ((x >= 0) && (x < this->_input->GetX()) && (y >= 0) && (y < this->_input->GetY()) &&
-      (z >= 0) && (z < this->_input->GetZ()) && (t >= 0) && (t < this->_input->GetT())) {
-    if ((this->_input->Get(x, y, z, t) == this->_ClusterLabel) && (this->_output->Get(x, y, z, t) == 0)) {
-      this->_output->Put(x, y, z, t, 1);
-      this->_currentClusterSize++;
-      this->Grow3D(x-1, y  , z  , t);
-      this->Grow3D(x+1, y  , z  , t);
-      this->Grow3D(x  , y-1, z  , t);
-      this->Grow3D(x  , y+1, z  , t);
-      this->Grow3D(x  , y  , z-1, t);
-      this->Grow3D(x  , y  , z+1, t);
-    }
-  }
-}
-
 template <class VoxelType> void irtkLargestConnectedComponent<VoxelType>::Run()
 {
-  int x, y, z, t = 0, largestClusterSeed_x, largestClusterSeed_y, largestClusterSeed_z;
+  int i, x, y, z, label;
+  const int *labels;
+  VoxelType *ptr;
 
   // Do the initial set up
   this->Initialize();
@@ -81,72 +52,41 @@ template <class VoxelType> void irtkLargestConnectedComponent<VoxelType>::Run()
   }
 
   // Do conneted component analysis
-  for (z = 0; z < this->_input->GetZ(); z++) {
-    for (y = 0; y < this->_input->GetY(); y++) {
-      for (x = 0; x < this->_input->GetX(); x++) {
-        this->_output->Put(x, y, z, t, 0);
-      }
-    }
-  }
+  irtkConnectedComponents<VoxelType> components(this->_ClusterLabel, (this->_Mode2D == true) ? CONNECTIVITY_04 : CONNECTIVITY_06);
+  components.SetInput(this->_input);
+  components.SetOutput(this->_output);
+  components.Run();
 
+  // Largest component of each slice in 2D mode, of the image otherwise
+  vector<int> largest(this->_input->GetZ(), 0);
   if (this->_Mode2D == true) {
-
-    for (z = 0; z < this->_input->GetZ(); z++) {
-      largestClusterSeed_x = 0;
-      largestClusterSeed_y = 0;
-      largestClusterSeed_z = z;
-
-      for (y = 0; y < this->_input->GetY(); y++) {
-        for (x = 0; x < this->_input->GetX(); x++) {
-          this->_currentClusterSize = 0;
-          this->Grow2D(x, y, z, t);
-          if (this->_currentClusterSize > this->_largestClusterSize) {
-            this->_largestClusterSize   = this->_currentClusterSize;
-            largestClusterSeed_x = x;
-            largestClusterSeed_y = y;
-            largestClusterSeed_z = z;
-          }
-        }
+    for (label = 1; label <= components.GetNumberOfComponents(); label++) {
+      z = components.GetComponent(label)._z1;
+      if ((largest[z] == 0) || (components.GetComponent(label)._Size > components.GetComponent(largest[z])._Size)) {
+        largest[z] = label;
       }
-
-      for (y = 0; y < this->_input->GetY(); y++) {
-        for (x = 0; x < this->_input->GetX(); x++) {
-          this->_output->Put(x, y, z, t, 0);
-        }
-      }
-
-      this->Grow2D(largestClusterSeed_x, largestClusterSeed_y, largestClusterSeed_z, t);
     }
   } else {
+    label = components.GetLargestComponent();
+    for (z = 0; z < this->_input->GetZ(); z++) largest[z] = label;
+  }
 
-    largestClusterSeed_x = 0;
-    largestClusterSeed_y = 0;
-    largestClusterSeed_z = 0;
-
-    for (z = 0; z < this->_input->GetZ(); z++) {
-      for (y = 0; y < this->_input->GetY(); y++) {
-        for (x = 0; x < this->_input->GetX(); x++) {
-          this->_currentClusterSize = 0;
-          this->Grow3D(x, y, z, t);
-          if (this->_currentClusterSize > this->_largestClusterSize) {
-            this->_largestClusterSize   = this->_currentClusterSize;
-            largestClusterSeed_x = x;
-            largestClusterSeed_y = y;
-            largestClusterSeed_z = z;
-          }
-        }
-      }
+  this->_largestClusterSize = 0;
+  for (z = 0; z < this->_input->GetZ(); z++) {
+    if ((largest[z] > 0) && (components.GetComponent(largest[z])._Size > this->_largestClusterSize)) {
+      this->_largestClusterSize = components.GetComponent(largest[z])._Size;
     }
+  }
 
-    for (z = 0; z < this->_input->GetZ(); z++) {
-      for (y = 0; y < this->_input->GetY(); y++) {
-        for (x = 0; x < this->_input->GetX(); x++) {
-          this->_output->Put(x, y, z, t, 0);
-        }
+  labels = components.GetPointerToLabels();
+  ptr    = this->_output->GetPointerToVoxels();
+  i      = 0;
+  for (z = 0; z < this->_input->GetZ(); z++) {
+    for (y = 0; y < this->_input->GetY(); y++) {
+      for (x = 0; x < this->_input->GetX(); x++, i++) {
+        ptr[i] = ((labels[i] > 0) && (labels[i] == largest[z])) ? 1 : 0;
       }
     }
-
-    this->Grow3D(largestClusterSeed_x, largestClusterSeed_y, largestClusterSeed_z, t);
   }
 
   // Do the final cleaning up
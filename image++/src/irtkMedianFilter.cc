@@ -12,7 +12,112 @@
 #include <irtkMedianFilter.h>
 #include <vector>
 #include <algorithm>
-#include <set>
+
+// Maximum number of slabs filtered independently
+static const int _MedianFilterSlabs = 32;
+
+// Number of bins summarised by one coarse bin of the histogram
+static const int _MedianFilterBlock = 64;
+
+// Largest range of integer values whose offsets are used as bins
+static const double _MedianFilterMaxRange = 1 << 20;
+
+/// Two-level histogram whose median is tracked incrementally
+class irtkMedianHistogram
+{
+
+  /// Counts of single bins and of blocks of bins
+  vector<int> _Fine, _Coarse;
+
+  /// Number of values, current median bin and number of values below it
+  int _Total, _Median, _Below;
+
+public:
+
+  irtkMedianHistogram(int bins) {
+    bins = (bins / _MedianFilterBlock + 1) * _MedianFilterBlock;
+    _Fine.assign(bins, 0);
+    _Coarse.assign(bins / _MedianFilterBlock, 0);
+    _Total  = 0;
+    _Median = 0;
+    _Below  = 0;
+  }
+
+  int GetTotal() const {
+    return _Total;
+  }
+
+  void Add(int b) {
+    if (b < 0) return;
+    _Fine[b]++;
+    _Coarse[b / _MedianFilterBlock]++;
+    _Total++;
+    if (b < _Median) _Below++;
+  }
+
+  void Remove(int b) {
+    if (b < 0) return;
+    _Fine[b]--;
+    _Coarse[b / _MedianFilterBlock]--;
+    _Total--;
+    if (b < _Median) _Below--;
+  }
+
+  /// Returns bin of the value with rank total/2. Requires at least one value
+  int Median() {
+    int k = _Total / 2;
+
+    // Move down, skipping whole blocks where possible
+    while (_Below > k) {
+      if ((_Median % _MedianFilterBlock == 0) && (_Below - _Coarse[_Median / _MedianFilterBlock - 1] > k)) {
+        _Median -= _MedianFilterBlock;
+        _Below  -= _Coarse[_Median / _MedianFilterBlock];
+      } else {
+        _Median--;
+        _Below  -= _Fine[_Median];
+      }
+    }
+
+    // Move up, skipping whole blocks where possible
+    while (_Below + _Fine[_Median] <= k) {
+      if ((_Median % _MedianFilterBlock == 0) && (_Below + _Coarse[_Median / _MedianFilterBlock] <= k)) {
+        _Below  += _Coarse[_Median / _MedianFilterBlock];
+        _Median += _MedianFilterBlock;
+      } else {
+        _Below  += _Fine[_Median];
+        _Median++;
+      }
+    }
+    return _Median;
+  }
+};
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedMedianFilter
+{
+
+  /// Pointer to filter
+  irtkMedianFilter<VoxelType> *_filter;
+
+  /// First slice of each slab
+  const int *_slab;
+
+public:
+
+  irtkMultiThreadedMedianFilter(irtkMedianFilter<VoxelType> *filter, const int *slab) {
+    _filter = filter;
+    _slab   = slab;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    for (int s = r.begin(); s != r.end(); s++) {
+      _filter->Filter(_slab[s], _slab[s+1]);
+    }
+  }
+};
+
+#endif
 
 template <class VoxelType> irtkMedianFilter<VoxelType>::irtkMedianFilter()
 {
@@ -53,49 +158,135 @@ template <class VoxelType> void irtkMedianFilter<VoxelType>::SetMask(irtkRealIma
   }
 }
 
-template <class VoxelType> void irtkMedianFilter<VoxelType>::Run()
+template <class VoxelType> void irtkMedianFilter<VoxelType>::Filter(int s1, int s2)
 {
-  int x, y, z, t;
+  int i, r, s, x, y, z, X, Y, Z, XY, row, plane, offsets;
+  const int *bin;
+  VoxelType *in, *out;
 
-  //int dim = 2*_kernelRadius + 1;
+  X  = this->_input->GetX();
+  Y  = this->_input->GetY();
+  Z  = this->_input->GetZ();
+  XY = X * Y;
+  r  = _kernelRadius;
 
-  // Do the initial set up
-  this->Initialize();
+  // Offsets of the voxels of a plane of the cube orthogonal to x
+  vector<int> offset;
+  for (z = -r; z <= r; z++) {
+    for (y = -r; y <= r; y++) {
+      offset.push_back(z * XY + y * X);
+    }
+  }
+  offsets = offset.size();
+
+  irtkMedianHistogram histogram(_Values.size());
+
+  for (s = s1; s < s2; s++) {
+    z   = s % Z;
+    in  = this->_input->GetPointerToVoxels() + s * XY;
+    out = this->_output->GetPointerToVoxels() + s * XY;
+    bin = &(_Bins[s * XY]);
+
+    if ((z < r) || (z > Z - 1 - r)) {
+      for (i = 0; i < XY; i++) out[i] = in[i];
+      continue;
+    }
 
-  multiset<VoxelType> voxels;
-
-  for (t = 0; t < this->_input->GetT(); t++) {
-    for (z = 0; z < this->_input->GetZ(); z++) {
-      for (y = 0; y < this->_input->GetY(); y++) {
-        for (x = 0; x < this->_input->GetX(); x++) {
-          if ((x < _kernelRadius) || (x > this->_input->GetX() - 1 - _kernelRadius) ||
-              (y < _kernelRadius) || (y > this->_input->GetY() - 1 - _kernelRadius) ||
-              (z < _kernelRadius) || (z > this->_input->GetZ() - 1 - _kernelRadius)) {
-            this->_output->Put(x, y, z, t, this->_input->Get(x, y, z, t));
-          } else {
-        	  vector<VoxelType> voxels;
-        	  for( int zz = z - _kernelRadius; zz <= z + _kernelRadius; ++zz )
-        	  {
-        		  for( int yy = y - _kernelRadius; yy <= y + _kernelRadius; ++yy )
-        		  {
-        			  for( int xx = x - _kernelRadius; xx <= x + _kernelRadius; ++xx )
-        			  {
-        				  if( this->_mask->Get(xx,yy,zz,t) ) {
-        					  voxels.push_back( this->_input->Get(xx,yy,zz,t) );
-        				  }
-        			  }
-        		  }
-        	  }
-        	  if( voxels.size() )
-        	  {
-        		  sort(voxels.begin(), voxels.end());
-        		  this->_output->Put(x, y, z, t, voxels[voxels.size()/2]);
-        	  }
-          }
+    for (y = 0; y < Y; y++) {
+      row = y * X;
+      if ((y < r) || (y > Y - 1 - r) || (X <= 2 * r)) {
+        for (x = 0; x < X; x++) out[row+x] = in[row+x];
+        continue;
+      }
+      for (x = 0; x < r; x++) out[row+x] = in[row+x];
+      for (x = X - r; x < X; x++) out[row+x] = in[row+x];
+
+      // Cube around the first voxel of the row
+      for (x = 0; x <= 2 * r; x++) {
+        for (i = 0; i < offsets; i++) histogram.Add(bin[row+x+offset[i]]);
+      }
+
+      for (x = r; x < X - r; x++) {
+        if (x > r) {
+          plane = row + x - r - 1;
+          for (i = 0; i < offsets; i++) histogram.Remove(bin[plane+offset[i]]);
+          plane = row + x + r;
+          for (i = 0; i < offsets; i++) histogram.Add(bin[plane+offset[i]]);
         }
+        if (histogram.GetTotal() > 0) out[row+x] = _Values[histogram.Median()];
+      }
+
+      // Empty histogram for the next row
+      for (x = X - 1 - 2 * r; x < X; x++) {
+        for (i = 0; i < offsets; i++) histogram.Remove(bin[row+x+offset[i]]);
       }
     }
   }
+}
+
+template <class VoxelType> void irtkMedianFilter<VoxelType>::Run()
+{
+  int i, n, m, s, slices, slabs;
+  double min, max;
+  bool integral;
+  int slab[_MedianFilterSlabs+1];
+  VoxelType *ptr;
+  irtkRealPixel *mask;
+
+  // Do the initial set up
+  this->Initialize();
+
+  if ((_mask != NULL) && ((_mask->GetX() != this->_input->GetX()) ||
+                          (_mask->GetY() != this->_input->GetY()) ||
+                          (_mask->GetZ() != this->_input->GetZ()))) {
+    cerr << "irtkMedianFilter<VoxelType>::Run(): Mask has wrong dimensions" << endl;
+    exit(1);
+  }
+
+  // Map intensities to histogram bins
+  n   = this->_input->GetNumberOfVoxels();
+  ptr = this->_input->GetPointerToVoxels();
+  this->_input->GetMinMaxAsDouble(&min, &max);
+  integral = (max - min < _MedianFilterMaxRange);
+  for (i = 0; (i < n) && integral; i++) {
+    integral = (ptr[i] == floor(double(ptr[i])));
+  }
+  _Bins.resize(n);
+  if (integral) {
+    _Values.resize(int(max - min) + 1);
+    for (i = 0; i < int(_Values.size()); i++) _Values[i] = static_cast<VoxelType>(min + i);
+    for (i = 0; i < n; i++) _Bins[i] = int(ptr[i] - min);
+  } else {
+    _Values.assign(ptr, ptr + n);
+    sort(_Values.begin(), _Values.end());
+    _Values.erase(unique(_Values.begin(), _Values.end()), _Values.end());
+    for (i = 0; i < n; i++) _Bins[i] = lower_bound(_Values.begin(), _Values.end(), ptr[i]) - _Values.begin();
+  }
+
+  // Voxels outside of the mask are ignored. A 3D mask is used for all frames
+  if (_mask != NULL) {
+    m    = _mask->GetNumberOfVoxels();
+    mask = _mask->GetPointerToVoxels();
+    for (i = 0; i < n; i++) {
+      if (mask[i % m] == 0) _Bins[i] = -1;
+    }
+  }
+
+  // Split image into slabs of whole slices
+  slices = this->_input->GetZ() * this->_input->GetT();
+  slabs  = (slices < _MedianFilterSlabs) ? slices : _MedianFilterSlabs;
+  for (s = 0; s <= slabs; s++) slab[s] = (s * slices) / slabs;
+
+#ifdef HAS_TBB
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, slabs, 1), irtkMultiThreadedMedianFilter<VoxelType>(this, slab));
+  init.terminate();
+#else
+  for (s = 0; s < slabs; s++) this->Filter(slab[s], slab[s+1]);
+#endif
+
+  vector<int>().swap(_Bins);
+  vector<VoxelType>().swap(_Values);
 
   // Do the final cleaning up
   this->Finalize();
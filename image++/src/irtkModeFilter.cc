@@ -1,18 +1,39 @@
 
 #include <irtkImage.h>
-#include <nr.h>
 
 #include <irtkModeFilter.h>
 
-#include <map>
+#include <vector>
 
-#ifdef WIN32
-#include <time.h>
-#else
-#include <sys/time.h>
-#endif
+// Maximum number of slabs filtered independently
+static const int _ModeFilterSlabs = 32;
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedModeFilter
+{
+
+  /// Pointer to filter
+  irtkModeFilter<VoxelType> *_filter;
 
+  /// First slice of each slab
+  const int *_slab;
 
+public:
+
+  irtkMultiThreadedModeFilter(irtkModeFilter<VoxelType> *filter, const int *slab) {
+    _filter = filter;
+    _slab   = slab;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    for (int s = r.begin(); s != r.end(); s++) {
+      _filter->Filter(_slab[s], _slab[s+1]);
+    }
+  }
+};
+
+#endif
 
 template <class VoxelType> irtkModeFilter<VoxelType>::irtkModeFilter()
 {
@@ -44,107 +65,92 @@ template <class VoxelType> void irtkModeFilter<VoxelType>::Initialize()
 
 
 
-template <class VoxelType> void irtkModeFilter<VoxelType>::Run()
+template <class VoxelType> void irtkModeFilter<VoxelType>::Filter(int s1, int s2)
 {
-  int i, x, y, z, t, maskSize;
-  VoxelType value;
-  VoxelType *ptr2current, *ptr2offset;
-
-  map<short, short> labelCount;
-  map<short, short>::iterator iter;
-  int ties, maxCount;
-  short mode = 0;
-  double inputMin, inputMax;
-
-  int *tiedLabels;
-
-  int randChoice;
-  long ran2Seed;
-  long ran2initialSeed;
-
-  // Do the initial set up
-  this->Initialize();
-
-
-  // Get ready for random stuff.
-  time_t tv;
-  tv = time(NULL);
-
-  ran2Seed = tv;
-  ran2initialSeed = -1 * ran2Seed;
-  (void) ran2(&ran2initialSeed);
-
-
-  this->_input->GetMinMaxAsDouble(&inputMin, &inputMax);
-  tiedLabels = new int[(int) inputMax];
-
-  maskSize = this->_offsets.GetSize();
-
-  for (t = 0; t < this->_input->GetT(); t++) {
-
-    for (z = 0; z < this->_input->GetZ(); z++) {
-      for (y = 0; y < this->_input->GetY(); y++) {
-        this->_output->Put(0, y, z, t, this->_input->Get(0, y, z, t));
-      }
-    }
-
-    for (z = 0; z < this->_input->GetZ(); z++) {
-      for (x = 0; x < this->_input->GetX(); x++) {
-        this->_output->Put(x, 0, z, t, this->_input->Get(x, 0, z, t));
-      }
-    }
-
-    for (y = 0; y < this->_input->GetY(); y++) {
-      for (x = 0; x < this->_input->GetX(); x++) {
-        this->_output->Put(x, y, 0, t, this->_input->Get(x, y, 0, t));
-      }
-    }
-
-    for (z = 1; z < this->_input->GetZ() - 1; z++) {
-      for (y = 1; y < this->_input->GetY() - 1; y++) {
-        for (x = 1; x < this->_input->GetX() - 1; x++) {
-
-          labelCount.clear();
-
-          ptr2current = this->_input->GetPointerToVoxels(x, y, z, t);
-
-          // Collect labels from neighbourhood.
-          for (i = 0; i < maskSize; ++i) {
-            ptr2offset = ptr2current + this->_offsets(i);
-            labelCount[*ptr2offset]++;
-          }
-
-          // Seek modal label (but there may be ties for the mode)
-          maxCount = 0;
-          for (iter = labelCount.begin(); iter != labelCount.end(); ++iter){
-            if (iter->second > maxCount){
-              maxCount = iter->second;
-              mode     = iter->first;
-            }
-          }
+  int i, j, k, l, n, s, x, y, z, X, Y, Z, ties, maxCount;
+  unsigned int hash;
+  int label[26], tiedLabels[26];
+  VoxelType *in, *out;
+
+  X = this->_input->GetX();
+  Y = this->_input->GetY();
+  Z = this->_input->GetZ();
+  n = this->_offsets.GetSize();
+
+  // Count of each label, zero for labels which do not occur
+  vector<int> labelCount(_NumberOfLabels, 0);
+
+  for (s = s1; s < s2; s++) {
+    z   = s % Z;
+    in  = this->_input->GetPointerToVoxels() + s * X * Y;
+    out = this->_output->GetPointerToVoxels() + s * X * Y;
+    for (y = 0, i = 0; y < Y; y++) {
+      for (x = 0; x < X; x++, i++) {
+        if ((x == 0) || (x == X - 1) || (y == 0) || (y == Y - 1) || (z == 0) || (z == Z - 1)) {
+          out[i] = in[i];
+          continue;
+        }
 
-          ties = 0;
-          for (iter = labelCount.begin(); iter != labelCount.end(); ++iter){
-            if (iter->second == maxCount){
-              tiedLabels[ties] = iter->first;
-              ++ties;
-            }
-          }
+        // Collect labels from neighbourhood.
+        l = 0;
+        for (k = 0; k < n; k++) {
+          j = int(in[i + this->_offsets(k)]) - _MinLabel;
+          if (labelCount[j]++ == 0) label[l++] = j;
+        }
 
-          if (ties > 1){
-            randChoice = (int) floor( ran2(&ran2Seed) * ties );
-            value = tiedLabels[ randChoice ];
-          } else {
-            value = mode;
+        // Seek modal label (but there may be ties for the mode)
+        maxCount = 0;
+        for (k = 0; k < l; k++) {
+          if (labelCount[label[k]] > maxCount) maxCount = labelCount[label[k]];
+        }
+        ties = 0;
+        for (k = 0; k < l; k++) {
+          if (labelCount[label[k]] == maxCount) {
+            // Keep tied labels sorted
+            for (j = ties; (j > 0) && (tiedLabels[j-1] > label[k]); j--) tiedLabels[j] = tiedLabels[j-1];
+            tiedLabels[j] = label[k];
+            ties++;
           }
+          labelCount[label[k]] = 0;
+        }
 
-          this->_output->Put(x, y, z, t, value);
+        if (ties > 1) {
+          hash = (unsigned int)(s * X * Y + i) * 2654435761u;
+          j    = (hash >> 16) % ties;
+        } else {
+          j    = 0;
         }
+        out[i] = static_cast<VoxelType>(tiedLabels[j] + _MinLabel);
       }
     }
   }
+}
 
-  delete [] tiedLabels;
+template <class VoxelType> void irtkModeFilter<VoxelType>::Run()
+{
+  int s, slices, slabs;
+  double inputMin, inputMax;
+  int slab[_ModeFilterSlabs+1];
+
+  // Do the initial set up
+  this->Initialize();
+
+  this->_input->GetMinMaxAsDouble(&inputMin, &inputMax);
+  _MinLabel       = int(inputMin);
+  _NumberOfLabels = int(inputMax) - _MinLabel + 1;
+
+  // Split image into slabs of whole slices
+  slices = this->_input->GetZ() * this->_input->GetT();
+  slabs  = (slices < _ModeFilterSlabs) ? slices : _ModeFilterSlabs;
+  for (s = 0; s <= slabs; s++) slab[s] = (s * slices) / slabs;
+
+#ifdef HAS_TBB
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, slabs, 1), irtkMultiThreadedModeFilter<VoxelType>(this, slab));
+  init.terminate();
+#else
+  for (s = 0; s < slabs; s++) this->Filter(slab[s], slab[s+1]);
+#endif
 
   // Do the final cleaning up
   this->Finalize();
@@ -18,6 +18,31 @@ Changes   : $Author$
 
 #include <nr.h>
 
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedNonLocalMedianFilter
+{
+
+  /// Pointer to filter
+  irtkNonLocalMedianFilter<VoxelType> *_filter;
+
+  /// Frame
+  int _t;
+
+public:
+
+  irtkMultiThreadedNonLocalMedianFilter(irtkNonLocalMedianFilter<VoxelType> *filter, int t) {
+    _filter = filter;
+    _t      = t;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    _filter->Filter(r.begin(), r.end(), _t);
+  }
+};
+
+#endif
+
 template <class VoxelType> irtkNonLocalMedianFilter<VoxelType>::irtkNonLocalMedianFilter(
     int Sigma, irtkGenericImage<irtkGreyPixel>* input2, irtkGenericImage<irtkRealPixel>* input3
     , irtkGenericImage<VoxelType>* input4)
@@ -59,7 +84,11 @@ template <class VoxelType> const char *irtkNonLocalMedianFilter<VoxelType>::Name
 }
 
 template <class VoxelType> double irtkNonLocalMedianFilter<VoxelType>::Run(int x, int y, int z, int t){
-    double distancev,currentv,sumofweight;
+    return this->Filter(x, y, z, t, _localneighbor, _localweight);
+}
+
+template <class VoxelType> double irtkNonLocalMedianFilter<VoxelType>::Filter(int x, int y, int z, int t, float *localneighbor, float *localweight){
+    double distancev,currentv,sumofweight,scalev;
     int x1,y1,z1,x2,y2,z2,i,j,k,i1,j1,k1,index;
 
     // if edge use orignal size or use smaller window size
@@ -91,6 +120,11 @@ template <class VoxelType> double irtkNonLocalMedianFilter<VoxelType>::Run(int x
     else
        currentv = this->_input4->GetAsDouble(x,y,z,t);
 
+    if(this->_input2 != NULL)
+        scalev = this->_input2->GetAsDouble(x,y,z);
+    else
+        scalev = 0;
+
     index = 1;
     sumofweight = 0;
     // do the job find neighbor and weight
@@ -122,21 +156,21 @@ template <class VoxelType> double irtkNonLocalMedianFilter<VoxelType>::Run(int x
                         distancev = (i-x)*(i-x)*_dx*_dx
                             + (j-y)*(j-y)*_dy*_dy + (k-z)*(k-z)*_dz*_dz;
                         if(this->_input2 != NULL)
-                            distancev += (this->_input2->GetAsDouble(i1,j1,k1)-this->_input2->GetAsDouble(x,y,z))
-                            * (this->_input2->GetAsDouble(i1,j1,k1)-this->_input2->GetAsDouble(x,y,z))*_ds;
+                            distancev += (this->_input2->GetAsDouble(i1,j1,k1)-scalev)
+                            * (this->_input2->GetAsDouble(i1,j1,k1)-scalev)*_ds;
 
                         distancev = this->EvaluateWeight(distancev);
 
                         if(distancev > 0 && distancev < 1){
-                            _localneighbor[index] = this->_input->GetAsDouble(i1,j1,k1,t);
+                            localneighbor[index] = this->_input->GetAsDouble(i1,j1,k1,t);
 
-                            _localweight[index] = distancev;
+                            localweight[index] = distancev;
 
                             if(this->_input3 != NULL)
-                                _localweight[index] = _localweight[index]*this->_input3->GetAsDouble(i1,j1,k1);
+                                localweight[index] = localweight[index]*this->_input3->GetAsDouble(i1,j1,k1);
 
                             //accumulate sum of weight
-                            sumofweight += _localweight[index];
+                            sumofweight += localweight[index];
                             //index
                             index++;
                         }
@@ -147,16 +181,36 @@ template <class VoxelType> double irtkNonLocalMedianFilter<VoxelType>::Run(int x
 
     // normalize weight
     for(i = 1; i < index; i++){
-        _localweight[i] /= sumofweight;
+        localweight[i] /= sumofweight;
     }
 
     if(index > 1)
-        return weightedmedian(index,_Lambda,currentv,_localneighbor,_localweight);
+        return weightedmedian(index,_Lambda,currentv,localneighbor,localweight);
     else
         return this->_input->GetAsDouble(x,y,z,t);
 
 }
 
+template <class VoxelType> void irtkNonLocalMedianFilter<VoxelType>::Filter(int z1, int z2, int t)
+{
+    int x,y,z;
+
+    // Buffers of this thread
+    float *localweight = new float[_Sigma*_Sigma*_Sigma+1];
+    float *localneighbor = new float[_Sigma*_Sigma*_Sigma*2+2];
+
+    for(z = z1; z < z2; z++){
+        for(y = 0; y < this->_input->GetY(); y++){
+            for(x = 0; x < this->_input->GetX(); x++){
+                this->_output->PutAsDouble(x,y,z,t,this->Filter(x,y,z,t,localneighbor,localweight));
+            }
+        }
+    }
+
+    delete []localweight;
+    delete []localneighbor;
+}
+
 template <class VoxelType> void irtkNonLocalMedianFilter<VoxelType>::Initialize()
 {
 
@@ -231,9 +285,29 @@ template <class VoxelType> void irtkNonLocalMedianFilter<VoxelType>::Initialize(
 
 template <class VoxelType> void irtkNonLocalMedianFilter<VoxelType>::Run()
 {
-    //Finalize
-    this->irtkImageToImage<VoxelType>::Run();
+    int t;
+
+    // Do the initial set up
+    this->Initialize();
+
+#ifdef HAS_TBB
+    task_scheduler_init init(tbb_no_threads);
+#endif
+
+    for(t = 0; t < this->_input->GetT(); t++){
+#ifdef HAS_TBB
+        parallel_for(blocked_range<int>(0, this->_input->GetZ(), 1), irtkMultiThreadedNonLocalMedianFilter<VoxelType>(this, t));
+#else
+        this->Filter(0, this->_input->GetZ(), t);
+#endif
+    }
+
+#ifdef HAS_TBB
+    init.terminate();
+#endif
 
+    // Do the final cleaning up
+    this->Finalize();
 }
 
 template <class VoxelType> void irtkNonLocalMedianFilter<VoxelType>::Finalize()
@@ -14,6 +14,10 @@
 
 #include <irtkImageFunction.h>
 
+#if __cplusplus >= 201103L
+#include <atomic>
+#endif
+
 #define SINC_KERNEL_SIZE  6
 #define SINC_EPSILON      0.000001
 #define SINC_LUTSIZE      1000000
@@ -49,8 +53,41 @@ inline double sinc(double x)
   return SINC_LUT[round(fabs(x)*SINC_LUTSIZE)];
 }
 
+#if __cplusplus >= 201103L
+
+// Number of last initialization of any sinc interpolation, functions may be
+// initialized concurrently and must never share a number
+static std::atomic<int> _SincInterpolateStamp(0);
+
+// Rows cached by each thread, a few functions can be evaluated alternately
+static const int _SincInterpolateRows = 4;
+static thread_local irtkSincInterpolateRow _SincInterpolateRow[_SincInterpolateRows];
+
+#endif
+
+template <class VoxelType> static void SincColumns(const VoxelType *data, int x, int y, int z, irtkSincInterpolateRow &row, int i1, int i2)
+{
+  int i, j, k;
+  double w, *column;
+  const VoxelType *ptr;
+
+  column = &(row._Column[0]);
+  for (i = i1; i < i2; i++) column[i] = 0;
+  for (k = row._k1; k < row._k2; k++) {
+    for (j = row._j1; j < row._j2; j++) {
+      w   = row._wz[k - row._k1] * row._wy[j - row._j1];
+      ptr = data + ((size_t(row._l) * z + k) * y + j) * x;
+      for (i = i1; i < i2; i++) {
+        column[i] += w * ptr[i];
+      }
+    }
+  }
+}
+
 irtkSincInterpolateImageFunction::irtkSincInterpolateImageFunction()
-{}
+{
+  _Stamp = 0;
+}
 
 irtkSincInterpolateImageFunction::~irtkSincInterpolateImageFunction(void)
 {}
@@ -79,76 +116,100 @@ void irtkSincInterpolateImageFunction::Initialize()
 
   // Compute min and max values
   this->_input->GetMinMaxAsDouble(&this->_min, &this->_max);
-}
-
-// Truncated sinc using Hanning window, H(dx/R)*sinc(dx), R=6 where
-// sinc(dx) = sin(pi*dx)/(pi*dx), H(dx/R) = 0.5*(1+cos(pi*dx/R))
-double irtkSincInterpolateImageFunction::Evaluate(double x, double y, double z, double t)
-{
-  int i, j, k, l;
-
-  i = round(x);
-  j = round(y);
-  k = round(z);
-  l = round(t);
 
-  // Check whether there is anything to interpolate
-  if ((fabs(x-i) > SINC_EPSILON) ||
-      (fabs(y-j) > SINC_EPSILON) ||
-      (fabs(z-k) > SINC_EPSILON )) {
+  // Fill lookup table before any concurrent evaluation
+  sinc(0);
 
-    int i1, i2, i3, j1, j2, j3, k1, k2, k3;
-    double wx, wy, wz, w, val, sum;
+#if __cplusplus >= 201103L
+  // Invalidate rows cached by all threads
+  _Stamp = ++_SincInterpolateStamp;
+#else
+  // Rows are not cached without thread-local storage, every row is computed
+  _Stamp = 1;
+#endif
+}
 
-    i1  = i - SINC_KERNEL_SIZE;
-    i2  = i + SINC_KERNEL_SIZE + 1;
-    j1  = j - SINC_KERNEL_SIZE;
-    j2  = j + SINC_KERNEL_SIZE + 1;
-    k1  = k - SINC_KERNEL_SIZE;
-    k2  = k + SINC_KERNEL_SIZE + 1;
-    val = 0;
-    sum = 0;
-    for (i3 = i1; i3 < i2; i3++) {
-      if ((i3 >= 0) && (i3 < this->_x)) {
-        wx = sinc(i3 - x);
-        for (j3 = j1; j3 < j2; j3++) {
-          if ((j3 >= 0) && (j3 < this->_y)) {
-            wy = sinc(j3 - y);
-            for (k3 = k1; k3 < k2; k3++) {
-              if ((k3 >= 0) && (k3 < this->_z)) {
-                wz   = sinc(k3 - z);
-                w    = wx*wy*wz;
-                val += w*this->_input->GetAsDouble(i3, j3, k3, l);
-                sum += w;
-              }
-            }
-          }
-        }
-      }
+void irtkSincInterpolateImageFunction::GetRow(irtkSincInterpolateRow &row, double y, double z, int l, int i1, int i2)
+{
+  int j, k;
+  double sum;
+
+  // Compute weights along y and z for new row
+  if ((row._Stamp != _Stamp) || (row._y != y) || (row._z != z) || (row._l != l)) {
+    row._Stamp = _Stamp;
+    row._y     = y;
+    row._z     = z;
+    row._l     = l;
+    j = round(y);
+    k = round(z);
+    row._j1 = (j - SINC_KERNEL_SIZE > 0) ? j - SINC_KERNEL_SIZE : 0;
+    row._j2 = (j + SINC_KERNEL_SIZE + 1 < _y) ? j + SINC_KERNEL_SIZE + 1 : _y;
+    row._k1 = (k - SINC_KERNEL_SIZE > 0) ? k - SINC_KERNEL_SIZE : 0;
+    row._k2 = (k + SINC_KERNEL_SIZE + 1 < _z) ? k + SINC_KERNEL_SIZE + 1 : _z;
+    row._Sum = 0;
+    for (j = row._j1; j < row._j2; j++) {
+      row._wy[j - row._j1] = sinc(j - y);
+      row._Sum += row._wy[j - row._j1];
     }
-
-    if (sum != 0) {
-      val /= sum;
-    } else {
-      val = 0;
+    sum = 0;
+    for (k = row._k1; k < row._k2; k++) {
+      row._wz[k - row._k1] = sinc(k - z);
+      sum += row._wz[k - row._k1];
     }
+    row._Sum *= sum;
+    row._Column.resize(_x);
+    row._i1 = 0;
+    row._i2 = 0;
+  }
 
-    if (this->_clamped) {
-      if (val > this->_max) return this->_max;
-      if (val < this->_min) return this->_min;
-    }
+  // Start new range of columns unless it overlaps or touches the cached one
+  if (i1 >= i2) return;
+  if ((i2 < row._i1) || (i1 > row._i2) || (row._i1 >= row._i2)) {
+    row._i1 = i1;
+    row._i2 = i1;
+  }
 
-    return(val);
+  // Interpolate missing columns along y and z
+  if (i1 < row._i1) {
+    this->InterpolateColumns(row, i1, row._i1);
+    row._i1 = i1;
+  }
+  if (i2 > row._i2) {
+    this->InterpolateColumns(row, row._i2, i2);
+    row._i2 = i2;
+  }
+}
 
-  } else {
-    // Return nearest neighbour
-    return this->_input->GetAsDouble(i, j, k, l);
+void irtkSincInterpolateImageFunction::InterpolateColumns(irtkSincInterpolateRow &row, int i1, int i2)
+{
+  switch (this->_input->GetScalarType()) {
+  case IRTK_VOXEL_CHAR:
+    SincColumns(static_cast<const char *>(this->_input->GetScalarPointer()), _x, _y, _z, row, i1, i2); break;
+  case IRTK_VOXEL_UNSIGNED_CHAR:
+    SincColumns(static_cast<const unsigned char *>(this->_input->GetScalarPointer()), _x, _y, _z, row, i1, i2); break;
+  case IRTK_VOXEL_SHORT:
+    SincColumns(static_cast<const short *>(this->_input->GetScalarPointer()), _x, _y, _z, row, i1, i2); break;
+  case IRTK_VOXEL_UNSIGNED_SHORT:
+    SincColumns(static_cast<const unsigned short *>(this->_input->GetScalarPointer()), _x, _y, _z, row, i1, i2); break;
+  case IRTK_VOXEL_INT:
+    SincColumns(static_cast<const int *>(this->_input->GetScalarPointer()), _x, _y, _z, row, i1, i2); break;
+  case IRTK_VOXEL_UNSIGNED_INT:
+    SincColumns(static_cast<const unsigned int *>(this->_input->GetScalarPointer()), _x, _y, _z, row, i1, i2); break;
+  case IRTK_VOXEL_FLOAT:
+    SincColumns(static_cast<const float *>(this->_input->GetScalarPointer()), _x, _y, _z, row, i1, i2); break;
+  case IRTK_VOXEL_DOUBLE:
+    SincColumns(static_cast<const double *>(this->_input->GetScalarPointer()), _x, _y, _z, row, i1, i2); break;
+  default:
+    stringstream msg;
+    msg << "irtkSincInterpolateImageFunction::Evaluate: Unknown voxel type" << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
   }
 }
 
 // Truncated sinc using Hanning window, H(dx/R)*sinc(dx), R=6 where
 // sinc(dx) = sin(pi*dx)/(pi*dx), H(dx/R) = 0.5*(1+cos(pi*dx/R))
-double irtkSincInterpolateImageFunction::EvaluateInside(double x, double y, double z, double t)
+double irtkSincInterpolateImageFunction::Evaluate(double x, double y, double z, double t)
 {
   int i, j, k, l;
 
@@ -162,29 +223,27 @@ double irtkSincInterpolateImageFunction::EvaluateInside(double x, double y, doub
       (fabs(y-j) > SINC_EPSILON) ||
       (fabs(z-k) > SINC_EPSILON )) {
 
-    int i1, i2, i3, j1, j2, j3, k1, k2, k3;
-    double wx, wy, wz, w, val, sum;
+    int i1, i2, i3;
+    double wx, val, sum;
 
-    i1  = i - SINC_KERNEL_SIZE;
-    i2  = i + SINC_KERNEL_SIZE + 1;
-    j1  = j - SINC_KERNEL_SIZE;
-    j2  = j + SINC_KERNEL_SIZE + 1;
-    k1  = k - SINC_KERNEL_SIZE;
-    k2  = k + SINC_KERNEL_SIZE + 1;
+    i1  = (i - SINC_KERNEL_SIZE > 0) ? i - SINC_KERNEL_SIZE : 0;
+    i2  = (i + SINC_KERNEL_SIZE + 1 < this->_x) ? i + SINC_KERNEL_SIZE + 1 : this->_x;
+
+    // Interpolate along y and z, then along x
+#if __cplusplus >= 201103L
+    irtkSincInterpolateRow &row = _SincInterpolateRow[_Stamp % _SincInterpolateRows];
+#else
+    irtkSincInterpolateRow row;
+#endif
+    this->GetRow(row, y, z, l, i1, i2);
     val = 0;
     sum = 0;
     for (i3 = i1; i3 < i2; i3++) {
-      wx = sinc(i3 - x);
-      for (j3 = j1; j3 < j2; j3++) {
-        wy = sinc(j3 - y);
-        for (k3 = k1; k3 < k2; k3++) {
-          wz   = sinc(k3 - z);
-          w    = wx*wy*wz;
-          val += w*this->_input->GetAsDouble(i3, j3, k3, l);
-          sum += w;
-        }
-      }
+      wx   = sinc(i3 - x);
+      val += wx*row._Column[i3];
+      sum += wx;
     }
+    sum *= row._Sum;
 
     if (sum != 0) {
       val /= sum;
@@ -201,7 +260,12 @@ double irtkSincInterpolateImageFunction::EvaluateInside(double x, double y, doub
 
   } else {
     // Return nearest neighbour
-    return this->_input->GetAsDouble(round(t), i, j, k);
+    return this->_input->GetAsDouble(i, j, k, l);
   }
 }
 
+// The separable evaluation costs the same inside the image domain
+double irtkSincInterpolateImageFunction::EvaluateInside(double x, double y, double z, double t)
+{
+  return this->Evaluate(x, y, z, t);
+}
@@ -0,0 +1,767 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#include <irtkImage.h>
+
+#include <irtkTiledImage.h>
+
+// Magic number of tiled files
+static const char _TiledImageMagic[8] = { 'I', 'R', 'T', 'K', 'T', 'I', 'L', 'E' };
+
+// Size of header: magic number, 10 integers and 17 doubles
+static const int _TiledImageHeaderSize = 8 + 10 * 4 + 17 * 8;
+
+#ifdef HAS_TBB
+
+class irtkMultiThreadedTiledImageReader
+{
+
+  /// Pointer to reader
+  irtkTiledImageReader *_reader;
+
+public:
+
+  irtkMultiThreadedTiledImageReader(irtkTiledImageReader *reader) {
+    _reader = reader;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    _reader->Decode(r.begin(), r.end());
+  }
+};
+
+class irtkMultiThreadedTiledImageWriter
+{
+
+  /// Pointer to writer
+  irtkTiledImageWriter *_writer;
+
+public:
+
+  irtkMultiThreadedTiledImageWriter(irtkTiledImageWriter *writer) {
+    _writer = writer;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    _writer->Encode(r.begin(), r.end());
+  }
+};
+
+#endif
+
+static int TiledImageBytes(int type)
+{
+  switch (type) {
+  case IRTK_VOXEL_CHAR:
+  case IRTK_VOXEL_UNSIGNED_CHAR:
+    return 1;
+  case IRTK_VOXEL_SHORT:
+  case IRTK_VOXEL_UNSIGNED_SHORT:
+    return 2;
+  case IRTK_VOXEL_INT:
+  case IRTK_VOXEL_UNSIGNED_INT:
+  case IRTK_VOXEL_FLOAT:
+    return 4;
+  case IRTK_VOXEL_DOUBLE:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+static void SeekTiledImage(FILE *fp, long long offset)
+{
+  int error;
+
+#ifdef WIN32
+  error = _fseeki64(fp, offset, SEEK_SET);
+#else
+  error = fseeko(fp, offset, SEEK_SET);
+#endif
+  if (error != 0) {
+    stringstream msg;
+    msg << "irtkTiledImage: Can't seek to position " << offset << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+}
+
+static long long TellTiledImage(FILE *fp)
+{
+#ifdef WIN32
+  return _ftelli64(fp);
+#else
+  return ftello(fp);
+#endif
+}
+
+static long long LengthOfTiledImage(FILE *fp)
+{
+  long long position, length;
+
+  position = TellTiledImage(fp);
+#ifdef WIN32
+  _fseeki64(fp, 0, SEEK_END);
+#else
+  fseeko(fp, 0, SEEK_END);
+#endif
+  length = TellTiledImage(fp);
+  SeekTiledImage(fp, position);
+  return length;
+}
+
+static void ReadTiledImage(FILE *fp, void *data, size_t n)
+{
+  if ((n > 0) && (fread(data, 1, n, fp) != n)) {
+    stringstream msg;
+    msg << "irtkTiledImageReader: Can't read " << n << " bytes, file is truncated" << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+}
+
+static void WriteTiledImage(FILE *fp, const void *data, size_t n)
+{
+  if ((n > 0) && (fwrite(data, 1, n, fp) != n)) {
+    stringstream msg;
+    msg << "irtkTiledImageWriter: Can't write " << n << " bytes" << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+}
+
+/// Extent of tile l along an axis of given size
+static void TileExtent(int l, int tile, int size, int &i1, int &i2)
+{
+  i1 = l * tile;
+  i2 = (i1 + tile < size) ? i1 + tile : size;
+}
+
+template <class VoxelType1, class VoxelType2> static void ConvertTiledImage(const VoxelType1 *in, VoxelType2 *out, int n)
+{
+  for (int i = 0; i < n; i++) out[i] = static_cast<VoxelType2>(in[i]);
+}
+
+template <class VoxelType> static void ConvertTiledImage(const char *in, int type, VoxelType *out, int n)
+{
+  switch (type) {
+  case IRTK_VOXEL_CHAR:
+    ConvertTiledImage(reinterpret_cast<const char *>(in), out, n); break;
+  case IRTK_VOXEL_UNSIGNED_CHAR:
+    ConvertTiledImage(reinterpret_cast<const unsigned char *>(in), out, n); break;
+  case IRTK_VOXEL_SHORT:
+    ConvertTiledImage(reinterpret_cast<const short *>(in), out, n); break;
+  case IRTK_VOXEL_UNSIGNED_SHORT:
+    ConvertTiledImage(reinterpret_cast<const unsigned short *>(in), out, n); break;
+  case IRTK_VOXEL_INT:
+    ConvertTiledImage(reinterpret_cast<const int *>(in), out, n); break;
+  case IRTK_VOXEL_UNSIGNED_INT:
+    ConvertTiledImage(reinterpret_cast<const unsigned int *>(in), out, n); break;
+  case IRTK_VOXEL_FLOAT:
+    ConvertTiledImage(reinterpret_cast<const float *>(in), out, n); break;
+  case IRTK_VOXEL_DOUBLE:
+    ConvertTiledImage(reinterpret_cast<const double *>(in), out, n); break;
+  }
+}
+
+irtkTiledImageReader::irtkTiledImageReader()
+{
+  _file    = NULL;
+  _type    = IRTK_VOXEL_UNKNOWN;
+  _bytes   = 0;
+  _swapped = false;
+  _data    = NULL;
+  for (int i = 0; i < 4; i++) _tile[i] = _tiles[i] = 0;
+}
+
+irtkTiledImageReader::~irtkTiledImageReader()
+{
+  this->Close();
+}
+
+int irtkTiledImageReader::CheckHeader(const char *filename)
+{
+  char magic_number[8];
+  FILE *fp;
+
+  fp = fopen(filename, "rb");
+  if (fp == NULL) return false;
+  if (fread(magic_number, 1, 8, fp) != 8) {
+    fclose(fp);
+    return false;
+  }
+  fclose(fp);
+
+  return (memcmp(magic_number, _TiledImageMagic, 8) == 0);
+}
+
+void irtkTiledImageReader::Open(const char *filename)
+{
+  int i, n, header[10];
+  long long tiles, length;
+  double attr[17];
+  char magic_number[8];
+
+  this->Close();
+
+  _file = fopen(filename, "rb");
+  if (_file == NULL) {
+    stringstream msg;
+    msg << "irtkTiledImageReader::Open: Can't open file " << filename << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+
+  // Read header
+  ReadTiledImage(_file, magic_number, 8);
+  ReadTiledImage(_file, header, sizeof(header));
+  ReadTiledImage(_file, attr, sizeof(attr));
+  if (memcmp(magic_number, _TiledImageMagic, 8) != 0) {
+    this->Close();
+    stringstream msg;
+    msg << "irtkTiledImageReader::Open: File format is not tiled" << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+
+  // First integer is one in the byte order of the writer
+  _swapped = (header[0] != 1);
+  if (_swapped) {
+    swap32(reinterpret_cast<char *>(header), reinterpret_cast<char *>(header), 10);
+    swap64(reinterpret_cast<char *>(attr), reinterpret_cast<char *>(attr), 17);
+  }
+
+  _type  = header[1];
+  _bytes = TiledImageBytes(_type);
+  if ((header[0] != 1) || (_bytes == 0)) {
+    this->Close();
+    stringstream msg;
+    msg << "irtkTiledImageReader::Open: Invalid header" << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+
+  // Writers never use tiles larger than the image
+  for (i = 0; i < 4; i++) {
+    if ((header[2+i] < 1) || (header[6+i] < 1) || (header[6+i] > header[2+i])) {
+      this->Close();
+      stringstream msg;
+      msg << "irtkTiledImageReader::Open: Invalid image or tile size" << endl;
+      cerr << msg.str();
+      throw irtkException(msg.str(), __FILE__, __LINE__);
+    }
+  }
+
+  _attr._x = header[2];
+  _attr._y = header[3];
+  _attr._z = header[4];
+  _attr._t = header[5];
+  for (i = 0; i < 4; i++) {
+    _tile[i]  = header[6+i];
+  }
+  _tiles[0] = (_attr._x + _tile[0] - 1) / _tile[0];
+  _tiles[1] = (_attr._y + _tile[1] - 1) / _tile[1];
+  _tiles[2] = (_attr._z + _tile[2] - 1) / _tile[2];
+  _tiles[3] = (_attr._t + _tile[3] - 1) / _tile[3];
+
+  _attr._dx      = attr[0];
+  _attr._dy      = attr[1];
+  _attr._dz      = attr[2];
+  _attr._dt      = attr[3];
+  _attr._xorigin = attr[4];
+  _attr._yorigin = attr[5];
+  _attr._zorigin = attr[6];
+  _attr._torigin = attr[7];
+  for (i = 0; i < 3; i++) {
+    _attr._xaxis[i] = attr[8+i];
+    _attr._yaxis[i] = attr[11+i];
+    _attr._zaxis[i] = attr[14+i];
+  }
+
+  // Table of tiles and tiles must lie within the file
+  length = LengthOfTiledImage(_file);
+  tiles  = (long long)_tiles[0] * _tiles[1] * _tiles[2] * _tiles[3];
+  if ((tiles > INT_MAX / 2) || (_TiledImageHeaderSize + tiles * 2 * (long long)sizeof(long long) > length)) {
+    this->Close();
+    stringstream msg;
+    msg << "irtkTiledImageReader::Open: Invalid header" << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+
+  // Read table of tiles
+  n = tiles;
+  std::vector<long long> table(2 * n);
+  ReadTiledImage(_file, &(table[0]), 2 * n * sizeof(long long));
+  if (_swapped) swap64(reinterpret_cast<char *>(&(table[0])), reinterpret_cast<char *>(&(table[0])), 2 * n);
+  _offset.resize(n);
+  _size.resize(n);
+  for (i = 0; i < n; i++) {
+    _offset[i] = table[2*i];
+    _size[i]   = table[2*i+1];
+    if ((_offset[i] < _TiledImageHeaderSize) || (_size[i] < 0) || (_size[i] > length - _offset[i])) {
+      this->Close();
+      stringstream msg;
+      msg << "irtkTiledImageReader::Open: Invalid position of tile " << i << endl;
+      cerr << msg.str();
+      throw irtkException(msg.str(), __FILE__, __LINE__);
+    }
+  }
+}
+
+void irtkTiledImageReader::Close()
+{
+  if (_file != NULL) fclose(_file);
+  _file = NULL;
+  _offset.clear();
+  _size.clear();
+}
+
+irtkImageAttributes irtkTiledImageReader::GetRegionAttributes(int i1, int j1, int k1, int l1, int i2, int j2, int k2, int l2) const
+{
+  if ((i1 < 0) || (i1 >= i2) ||
+      (j1 < 0) || (j1 >= j2) ||
+      (k1 < 0) || (k1 >= k2) ||
+      (l1 < 0) || (l1 >= l2) ||
+      (i2 > _attr._x) || (j2 > _attr._y) || (k2 > _attr._z) || (l2 > _attr._t)) {
+    stringstream msg;
+    msg << "irtkTiledImageReader::Read: Parameter out of range\n";
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+
+  // Initialize
+  irtkImageAttributes attr = _attr;
+  attr._x = i2 - i1;
+  attr._y = j2 - j1;
+  attr._z = k2 - k1;
+  attr._t = l2 - l1;
+  attr._xorigin = 0;
+  attr._yorigin = 0;
+  attr._zorigin = 0;
+
+  // Shift origin so that first voxel of region keeps its position
+  irtkMatrix m1 = irtkBaseImage::GetImageToWorldMatrix(_attr);
+  irtkMatrix m2 = irtkBaseImage::GetImageToWorldMatrix(attr);
+  attr._xorigin = m1(0, 0) * i1 + m1(0, 1) * j1 + m1(0, 2) * k1 + m1(0, 3) - m2(0, 3);
+  attr._yorigin = m1(1, 0) * i1 + m1(1, 1) * j1 + m1(1, 2) * k1 + m1(1, 3) - m2(1, 3);
+  attr._zorigin = m1(2, 0) * i1 + m1(2, 1) * j1 + m1(2, 2) * k1 + m1(2, 3) - m2(2, 3);
+
+  return attr;
+}
+
+void irtkTiledImageReader::Decode(int n1, int n2)
+{
+  int i, n, y, z, t, x0, y0, z0, t0, x1, y1, z1, t1, x2, y2, z2, t2, X, Y, Z, rx, ry, rz, row;
+  size_t raw;
+
+  for (i = n1; i < n2; i++) {
+    n = _list[i];
+
+    // Extent of tile
+    TileExtent(n % _tiles[0], _tile[0], _attr._x, x1, x2);
+    TileExtent((n / _tiles[0]) % _tiles[1], _tile[1], _attr._y, y1, y2);
+    TileExtent((n / (_tiles[0] * _tiles[1])) % _tiles[2], _tile[2], _attr._z, z1, z2);
+    TileExtent(n / (_tiles[0] * _tiles[1] * _tiles[2]), _tile[3], _attr._t, t1, t2);
+    X = x2 - x1;
+    Y = y2 - y1;
+    Z = z2 - z1;
+    raw = size_t(X) * Y * Z * (t2 - t1) * _bytes;
+
+    // Decompress tile unless it is stored uncompressed
+    std::vector<char> tile(raw);
+    if (size_t(_size[n]) == raw) {
+      memcpy(&(tile[0]), &(_buffer[i][0]), raw);
+    } else {
+#ifdef HAS_ZLIB
+      uLongf length = raw;
+      if ((uncompress(reinterpret_cast<Bytef *>(&(tile[0])), &length, reinterpret_cast<const Bytef *>(&(_buffer[i][0])), _size[n]) != Z_OK) || (length != raw)) {
+        stringstream msg;
+        msg << "irtkTiledImageReader::Read: Tile " << n << " is corrupt" << endl;
+        cerr << msg.str();
+        throw irtkException(msg.str(), __FILE__, __LINE__);
+      }
+#else
+      stringstream msg;
+      msg << "irtkTiledImageReader::Read: Compressed tiles need zlib" << endl;
+      cerr << msg.str();
+      throw irtkException(msg.str(), __FILE__, __LINE__);
+#endif
+    }
+
+    // Free compressed data as soon as possible
+    std::vector<char>().swap(_buffer[i]);
+
+    if (_swapped) {
+      switch (_bytes) {
+      case 2:
+        swap16(&(tile[0]), &(tile[0]), raw / 2); break;
+      case 4:
+        swap32(&(tile[0]), &(tile[0]), raw / 4); break;
+      case 8:
+        swap64(&(tile[0]), &(tile[0]), raw / 8); break;
+      }
+    }
+
+    // Copy part of tile which overlaps region
+    x0  = x1;
+    y0  = y1;
+    z0  = z1;
+    t0  = t1;
+    x1  = (x1 > _region[0]) ? x1 : _region[0];
+    y1  = (y1 > _region[1]) ? y1 : _region[1];
+    z1  = (z1 > _region[2]) ? z1 : _region[2];
+    t1  = (t1 > _region[3]) ? t1 : _region[3];
+    x2  = (x2 < _region[4]) ? x2 : _region[4];
+    y2  = (y2 < _region[5]) ? y2 : _region[5];
+    z2  = (z2 < _region[6]) ? z2 : _region[6];
+    t2  = (t2 < _region[7]) ? t2 : _region[7];
+    rx  = _region[4] - _region[0];
+    ry  = _region[5] - _region[1];
+    rz  = _region[6] - _region[2];
+    row = (x2 - x1) * _bytes;
+    for (t = t1; t < t2; t++) {
+      for (z = z1; z < z2; z++) {
+        for (y = y1; y < y2; y++) {
+          memcpy(_data + ((((size_t(t - _region[3]) * rz + z - _region[2]) * ry + y - _region[1]) * rx + x1 - _region[0]) * _bytes),
+                 &(tile[(((size_t(t - t0) * Z + z - z0) * Y + y - y0) * X + x1 - x0) * _bytes]), row);
+        }
+      }
+    }
+  }
+}
+
+void irtkTiledImageReader::ReadVoxels(void *data, int x1, int y1, int z1, int t1, int x2, int y2, int z2, int t2)
+{
+  int i, n, lx, ly, lz, lt;
+
+  if (_file == NULL) {
+    stringstream msg;
+    msg << "irtkTiledImageReader::Read: No file open" << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+
+  _region[0] = x1;
+  _region[1] = y1;
+  _region[2] = z1;
+  _region[3] = t1;
+  _region[4] = x2;
+  _region[5] = y2;
+  _region[6] = z2;
+  _region[7] = t2;
+  _data      = static_cast<char *>(data);
+
+  // Tiles which overlap region in the order in which they are stored
+  _list.clear();
+  for (lt = t1 / _tile[3]; lt <= (t2 - 1) / _tile[3]; lt++) {
+    for (lz = z1 / _tile[2]; lz <= (z2 - 1) / _tile[2]; lz++) {
+      for (ly = y1 / _tile[1]; ly <= (y2 - 1) / _tile[1]; ly++) {
+        for (lx = x1 / _tile[0]; lx <= (x2 - 1) / _tile[0]; lx++) {
+          _list.push_back(((lt * _tiles[2] + lz) * _tiles[1] + ly) * _tiles[0] + lx);
+        }
+      }
+    }
+  }
+
+  // Read compressed tiles
+  _buffer.resize(_list.size());
+  for (i = 0; i < int(_list.size()); i++) {
+    n = _list[i];
+    _buffer[i].resize(_size[n]);
+    SeekTiledImage(_file, _offset[n]);
+    ReadTiledImage(_file, &(_buffer[i][0]), _size[n]);
+  }
+
+  // Decompress tiles
+#ifdef HAS_TBB
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, _list.size(), 1), irtkMultiThreadedTiledImageReader(this));
+  init.terminate();
+#else
+  this->Decode(0, _list.size());
+#endif
+
+  _buffer.clear();
+  _data = NULL;
+}
+
+template <class VoxelType> void irtkTiledImageReader::Read(irtkGenericImage<VoxelType> &image, int x1, int y1, int z1, int t1, int x2, int y2, int z2, int t2)
+{
+  image.Initialize(this->GetRegionAttributes(x1, y1, z1, t1, x2, y2, z2, t2));
+
+  if (image.GetScalarType() == _type) {
+    this->ReadVoxels(image.GetPointerToVoxels(), x1, y1, z1, t1, x2, y2, z2, t2);
+  } else {
+    std::vector<char> buffer(size_t(image.GetNumberOfVoxels()) * _bytes);
+    this->ReadVoxels(&(buffer[0]), x1, y1, z1, t1, x2, y2, z2, t2);
+    ConvertTiledImage(&(buffer[0]), _type, image.GetPointerToVoxels(), image.GetNumberOfVoxels());
+  }
+}
+
+irtkImage *irtkTiledImageReader::ReadImage()
+{
+  switch (_type) {
+  case IRTK_VOXEL_CHAR: {
+      irtkGenericImage<char> *image = new irtkGenericImage<char>;
+      this->Read(*image, 0, 0, 0, 0, _attr._x, _attr._y, _attr._z, _attr._t);
+      return image;
+    }
+  case IRTK_VOXEL_UNSIGNED_CHAR: {
+      irtkGenericImage<unsigned char> *image = new irtkGenericImage<unsigned char>;
+      this->Read(*image, 0, 0, 0, 0, _attr._x, _attr._y, _attr._z, _attr._t);
+      return image;
+    }
+  case IRTK_VOXEL_SHORT: {
+      irtkGenericImage<short> *image = new irtkGenericImage<short>;
+      this->Read(*image, 0, 0, 0, 0, _attr._x, _attr._y, _attr._z, _attr._t);
+      return image;
+    }
+  case IRTK_VOXEL_UNSIGNED_SHORT: {
+      irtkGenericImage<unsigned short> *image = new irtkGenericImage<unsigned short>;
+      this->Read(*image, 0, 0, 0, 0, _attr._x, _attr._y, _attr._z, _attr._t);
+      return image;
+    }
+  case IRTK_VOXEL_INT: {
+      irtkGenericImage<int> *image = new irtkGenericImage<int>;
+      this->Read(*image, 0, 0, 0, 0, _attr._x, _attr._y, _attr._z, _attr._t);
+      return image;
+    }
+  case IRTK_VOXEL_UNSIGNED_INT: {
+      irtkGenericImage<unsigned int> *image = new irtkGenericImage<unsigned int>;
+      this->Read(*image, 0, 0, 0, 0, _attr._x, _attr._y, _attr._z, _attr._t);
+      return image;
+    }
+  case IRTK_VOXEL_FLOAT: {
+      irtkGenericImage<float> *image = new irtkGenericImage<float>;
+      this->Read(*image, 0, 0, 0, 0, _attr._x, _attr._y, _attr._z, _attr._t);
+      return image;
+    }
+  case IRTK_VOXEL_DOUBLE: {
+      irtkGenericImage<double> *image = new irtkGenericImage<double>;
+      this->Read(*image, 0, 0, 0, 0, _attr._x, _attr._y, _attr._z, _attr._t);
+      return image;
+    }
+  default:
+    return NULL;
+  }
+}
+
+irtkTiledImageWriter::irtkTiledImageWriter()
+{
+  _file   = NULL;
+  _type   = IRTK_VOXEL_UNKNOWN;
+  _bytes  = 0;
+  _frames = 0;
+  _data   = NULL;
+  _block  = 0;
+  for (int i = 0; i < 4; i++) _tile[i] = _tiles[i] = 0;
+}
+
+irtkTiledImageWriter::~irtkTiledImageWriter()
+{
+  if (_file != NULL) this->Close();
+}
+
+void irtkTiledImageWriter::Open(const char *filename, const irtkImageAttributes &attr, int type, int tx, int ty, int tz, int tt)
+{
+  int i, header[10];
+  double a[17];
+
+  if (_file != NULL) this->Close();
+
+  _attr    = attr;
+  _type    = type;
+  _bytes   = TiledImageBytes(type);
+  _tile[0] = (tx < attr._x) ? tx : attr._x;
+  _tile[1] = (ty < attr._y) ? ty : attr._y;
+  _tile[2] = (tz < attr._z) ? tz : attr._z;
+  _tile[3] = (tt < attr._t) ? tt : attr._t;
+  if ((_bytes == 0) || (_tile[0] < 1) || (_tile[1] < 1) || (_tile[2] < 1) || (_tile[3] < 1)) {
+    stringstream msg;
+    msg << "irtkTiledImageWriter::Open: Unsupported voxel type or tile size" << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+  _tiles[0] = (attr._x + _tile[0] - 1) / _tile[0];
+  _tiles[1] = (attr._y + _tile[1] - 1) / _tile[1];
+  _tiles[2] = (attr._z + _tile[2] - 1) / _tile[2];
+  _tiles[3] = (attr._t + _tile[3] - 1) / _tile[3];
+  _frames   = 0;
+
+  // Images mapped from the file must not see it change
+  GetMappedFileAllocator()->Detach(filename);
+
+  _file = fopen(filename, "wb");
+  if (_file == NULL) {
+    stringstream msg;
+    msg << "irtkTiledImageWriter::Open: Can't open file " << filename << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+
+  // Write header
+  header[0] = 1;
+  header[1] = _type;
+  header[2] = attr._x;
+  header[3] = attr._y;
+  header[4] = attr._z;
+  header[5] = attr._t;
+  for (i = 0; i < 4; i++) header[6+i] = _tile[i];
+  a[0] = attr._dx;
+  a[1] = attr._dy;
+  a[2] = attr._dz;
+  a[3] = attr._dt;
+  a[4] = attr._xorigin;
+  a[5] = attr._yorigin;
+  a[6] = attr._zorigin;
+  a[7] = attr._torigin;
+  for (i = 0; i < 3; i++) {
+    a[8+i]  = attr._xaxis[i];
+    a[11+i] = attr._yaxis[i];
+    a[14+i] = attr._zaxis[i];
+  }
+  WriteTiledImage(_file, _TiledImageMagic, 8);
+  WriteTiledImage(_file, header, sizeof(header));
+  WriteTiledImage(_file, a, sizeof(a));
+
+  // Reserve table of tiles, which is written by Close()
+  _offset.assign(_tiles[0] * _tiles[1] * _tiles[2] * _tiles[3], 0);
+  _size.assign(_offset.size(), 0);
+  std::vector<long long> table(2 * _offset.size(), 0);
+  WriteTiledImage(_file, &(table[0]), table.size() * sizeof(long long));
+}
+
+void irtkTiledImageWriter::Encode(int n1, int n2)
+{
+  int i, n, y, z, t, x1, y1, z1, t1, x2, y2, z2, t2, row;
+  size_t raw;
+
+  for (i = n1; i < n2; i++) {
+    n = _block + i;
+
+    // Extent of tile
+    TileExtent(n % _tiles[0], _tile[0], _attr._x, x1, x2);
+    TileExtent((n / _tiles[0]) % _tiles[1], _tile[1], _attr._y, y1, y2);
+    TileExtent((n / (_tiles[0] * _tiles[1])) % _tiles[2], _tile[2], _attr._z, z1, z2);
+    TileExtent(n / (_tiles[0] * _tiles[1] * _tiles[2]), _tile[3], _attr._t, t1, t2);
+    raw = size_t(x2 - x1) * (y2 - y1) * (z2 - z1) * (t2 - t1) * _bytes;
+
+    // Gather voxels of tile, frames are relative to the block
+    std::vector<char> tile(raw);
+    char *ptr = &(tile[0]);
+    row = (x2 - x1) * _bytes;
+    for (t = t1; t < t2; t++) {
+      for (z = z1; z < z2; z++) {
+        for (y = y1; y < y2; y++) {
+          memcpy(ptr, _data + ((((size_t(t - _frames) * _attr._z + z) * _attr._y + y) * _attr._x + x1) * _bytes), row);
+          ptr += row;
+        }
+      }
+    }
+
+    // Compress tile, store it uncompressed if that does not save space
+#ifdef HAS_ZLIB
+    uLongf length = compressBound(raw);
+    _buffer[i].resize(length);
+    if ((compress2(reinterpret_cast<Bytef *>(&(_buffer[i][0])), &length, reinterpret_cast<const Bytef *>(&(tile[0])), raw, Z_BEST_SPEED) == Z_OK) && (length < raw)) {
+      _buffer[i].resize(length);
+    } else {
+      _buffer[i].swap(tile);
+    }
+#else
+    _buffer[i].swap(tile);
+#endif
+  }
+}
+
+void irtkTiledImageWriter::WriteFrames(irtkImage *image)
+{
+  int i, n, T;
+
+  if (_file == NULL) {
+    stringstream msg;
+    msg << "irtkTiledImageWriter::WriteFrames: No file open" << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+
+  T = image->GetT();
+  if ((image->GetX() != _attr._x) || (image->GetY() != _attr._y) || (image->GetZ() != _attr._z) ||
+      (image->GetScalarType() != _type) || (_frames + T > _attr._t) ||
+      ((T % _tile[3] != 0) && (_frames + T != _attr._t))) {
+    stringstream msg;
+    msg << "irtkTiledImageWriter::WriteFrames: Frames do not match file" << endl;
+    cerr << msg.str();
+    throw irtkException(msg.str(), __FILE__, __LINE__);
+  }
+  if (T == 0) return;
+
+  // Tiles of block of frames
+  n      = _tiles[0] * _tiles[1] * _tiles[2];
+  _block = (_frames / _tile[3]) * n;
+  n      = ((_frames + T - 1) / _tile[3] + 1) * n - _block;
+  _data  = static_cast<const char *>(image->GetScalarPointer());
+  _buffer.resize(n);
+
+  // Compress tiles
+#ifdef HAS_TBB
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, n, 1), irtkMultiThreadedTiledImageWriter(this));
+  init.terminate();
+#else
+  this->Encode(0, n);
+#endif
+
+  // Append tiles to file
+  for (i = 0; i < n; i++) {
+    _offset[_block+i] = TellTiledImage(_file);
+    _size[_block+i]   = _buffer[i].size();
+    WriteTiledImage(_file, &(_buffer[i][0]), _buffer[i].size());
+  }
+
+  _buffer.clear();
+  _data    = NULL;
+  _frames += T;
+}
+
+void irtkTiledImageWriter::Close()
+{
+  int i;
+  FILE *fp;
+
+  fp    = _file;
+  _file = NULL;
+
+  if (_frames != _attr._t) {
+    cerr << "irtkTiledImageWriter::Close: Only " << _frames << " of " << _attr._t << " frames written" << endl;
+  }
+
+  // Write table of tiles
+  std::vector<long long> table(2 * _offset.size());
+  for (i = 0; i < int(_offset.size()); i++) {
+    table[2*i]   = _offset[i];
+    table[2*i+1] = _size[i];
+  }
+  SeekTiledImage(fp, _TiledImageHeaderSize);
+  WriteTiledImage(fp, &(table[0]), table.size() * sizeof(long long));
+  fclose(fp);
+}
+
+template void irtkTiledImageReader::Read(irtkGenericImage<char> &, int, int, int, int, int, int, int, int);
+template void irtkTiledImageReader::Read(irtkGenericImage<unsigned char> &, int, int, int, int, int, int, int, int);
+template void irtkTiledImageReader::Read(irtkGenericImage<short> &, int, int, int, int, int, int, int, int);
+template void irtkTiledImageReader::Read(irtkGenericImage<unsigned short> &, int, int, int, int, int, int, int, int);
+template void irtkTiledImageReader::Read(irtkGenericImage<int> &, int, int, int, int, int, int, int, int);
+template void irtkTiledImageReader::Read(irtkGenericImage<unsigned int> &, int, int, int, int, int, int, int, int);
+template void irtkTiledImageReader::Read(irtkGenericImage<float> &, int, int, int, int, int, int, int, int);
+template void irtkTiledImageReader::Read(irtkGenericImage<double> &, int, int, int, int, int, int, int, int);
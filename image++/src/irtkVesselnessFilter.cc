@@ -0,0 +1,201 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#include <irtkImage.h>
+
+#include <irtkConvolutionWithGaussianDerivative2.h>
+#include <irtkVesselnessFilter.h>
+
+#include <vector>
+
+#ifdef HAS_TBB
+
+template <class VoxelType> class irtkMultiThreadedVesselnessFilter
+{
+
+  /// Pointer to filter
+  irtkVesselnessFilter<VoxelType> *_filter;
+
+  /// Hessian of current scale
+  irtkGenericImage<VoxelType> *_hessian;
+
+  /// Sigma and c of current scale
+  double _sigma, _c;
+
+  /// Whether this is the first scale
+  bool _first;
+
+public:
+
+  irtkMultiThreadedVesselnessFilter(irtkVesselnessFilter<VoxelType> *filter, irtkGenericImage<VoxelType> *hessian, double sigma, double c, bool first) {
+    _filter  = filter;
+    _hessian = hessian;
+    _sigma   = sigma;
+    _c       = c;
+    _first   = first;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    _filter->Vesselness(r.begin(), r.end(), _hessian, _sigma, _c, _first);
+  }
+};
+
+#endif
+
+template <class VoxelType> irtkVesselnessFilter<VoxelType>::irtkVesselnessFilter(double sigmaMin, double sigmaMax, int scales)
+{
+  _SigmaMin       = sigmaMin;
+  _SigmaMax       = sigmaMax;
+  _NumberOfScales = scales;
+  _Alpha          = 0.5;
+  _Beta           = 0.5;
+  _C              = 0;
+  _BrightVessels  = true;
+  _ScaleImage     = NULL;
+}
+
+template <class VoxelType> irtkVesselnessFilter<VoxelType>::~irtkVesselnessFilter(void)
+{
+}
+
+template <class VoxelType> bool irtkVesselnessFilter<VoxelType>::RequiresBuffering(void)
+{
+  return true;
+}
+
+template <class VoxelType> const char *irtkVesselnessFilter<VoxelType>::NameOfClass()
+{
+  return "irtkVesselnessFilter";
+}
+
+template <class VoxelType> void irtkVesselnessFilter<VoxelType>::Vesselness(int z1, int z2, irtkGenericImage<VoxelType> *hessian, double sigma, double c, bool first)
+{
+  int i, j, y, z, X, Y, Z;
+  double l1, l2, l3, ra, rb, s, v, a2, b2, c2, norm;
+  VoxelType *out, *scale, *h[6];
+
+  X  = this->_input->GetX();
+  Y  = this->_input->GetY();
+  Z  = this->_input->GetZ();
+  a2 = 2 * _Alpha * _Alpha;
+  b2 = 2 * _Beta  * _Beta;
+  c2 = 2 * c * c;
+
+  // Scale-normalised Hessian and eigenvalues of a row of voxels
+  norm = sigma * sigma;
+  vector<double> m(6 * X), e(3 * X);
+
+  for (z = z1; z < z2; z++) {
+    for (y = 0; y < Y; y++) {
+      for (j = 0; j < 6; j++) {
+        h[j] = hessian->GetPointerToVoxels(0, y, z, j);
+        for (i = 0; i < X; i++) m[j*X+i] = norm * h[j][i];
+      }
+      irtkSymmetricEigenvalues3x3(X, &m[0], &m[X], &m[2*X], &m[3*X], &m[4*X], &m[5*X], &e[0], &e[X], &e[2*X]);
+
+      out   = this->_output->GetPointerToVoxels(0, y, z);
+      scale = (_ScaleImage != NULL) ? _ScaleImage->GetPointerToVoxels(0, y, z) : NULL;
+      for (i = 0; i < X; i++) {
+        l1 = e[i];
+        l2 = e[X+i];
+        l3 = e[2*X+i];
+
+        // Vessels have large eigenvalues of the sign given by their contrast
+        if ((l3 == 0) || ((_BrightVessels == true) && ((l2 > 0) || (l3 > 0))) ||
+                         ((_BrightVessels == false) && ((l2 < 0) || (l3 < 0)))) {
+          v = 0;
+        } else if (Z == 1) {
+          // Eigenvalue in z is zero, i.e. l1
+          rb = l2 / l3;
+          s  = l2 * l2 + l3 * l3;
+          v  = exp(- rb * rb / b2) * (1 - exp(- s / c2));
+        } else {
+          ra = l2 / l3;
+          rb = l1 * l1 / fabs(l2 * l3);
+          s  = l1 * l1 + l2 * l2 + l3 * l3;
+          v  = (1 - exp(- ra * ra / a2)) * exp(- rb / b2) * (1 - exp(- s / c2));
+        }
+
+        if ((first == true) || (v > out[i])) {
+          out[i] = static_cast<VoxelType>(v);
+          if (scale != NULL) scale[i] = static_cast<VoxelType>(sigma);
+        }
+      }
+    }
+  }
+}
+
+template <class VoxelType> void irtkVesselnessFilter<VoxelType>::Run()
+{
+  int i, n, s;
+  double sigma, c, norm;
+  VoxelType *h[6];
+  irtkGenericImage<VoxelType> hessian;
+
+  // Do the initial set up
+  this->Initialize();
+
+  if (this->_input->GetT() > 1) {
+    cerr << this->NameOfClass() << "::Run: Only implemented for images with t = 1" << endl;
+    exit(1);
+  }
+
+  if ((_NumberOfScales < 1) || (_SigmaMin <= 0) || (_SigmaMax < _SigmaMin)) {
+    cerr << this->NameOfClass() << "::Run: Invalid range of scales" << endl;
+    exit(1);
+  }
+
+  if (_ScaleImage != NULL) _ScaleImage->Initialize(this->_input->GetImageAttributes());
+
+  n = this->_input->GetNumberOfVoxels();
+
+  for (s = 0; s < _NumberOfScales; s++) {
+    if (_NumberOfScales > 1) {
+      sigma = _SigmaMin * pow(_SigmaMax / _SigmaMin, s / double(_NumberOfScales - 1));
+    } else {
+      sigma = _SigmaMin;
+    }
+
+    // Hessian at this scale
+    irtkConvolutionWithGaussianDerivative2<VoxelType> derivative(sigma);
+    derivative.SetInput (this->_input);
+    derivative.SetOutput(&hessian);
+    derivative.Hessian();
+
+    // Half of the maximum Frobenius norm of the scale-normalised Hessian
+    c = _C;
+    if (c <= 0) {
+      for (i = 0; i < 6; i++) h[i] = hessian.GetPointerToVoxels(0, 0, 0, i);
+      c = 0;
+      for (i = 0; i < n; i++) {
+        norm = h[0][i] * h[0][i] + h[3][i] * h[3][i] + h[5][i] * h[5][i] +
+               2 * (h[1][i] * h[1][i] + h[2][i] * h[2][i] + h[4][i] * h[4][i]);
+        if (norm > c) c = norm;
+      }
+      c = 0.5 * sigma * sigma * sqrt(c);
+      if (c == 0) c = 1;
+    }
+
+#ifdef HAS_TBB
+    task_scheduler_init init(tbb_no_threads);
+    parallel_for(blocked_range<int>(0, this->_input->GetZ(), 1), irtkMultiThreadedVesselnessFilter<VoxelType>(this, &hessian, sigma, c, s == 0));
+    init.terminate();
+#else
+    this->Vesselness(0, this->_input->GetZ(), &hessian, sigma, c, s == 0);
+#endif
+  }
+
+  // Do the final cleaning up
+  this->Finalize();
+}
+
+template class irtkVesselnessFilter<irtkRealPixel>;
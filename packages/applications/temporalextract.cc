@@ -18,6 +18,8 @@
 
 #include <irtkTransformation.h>
 
+#include <irtkTiledImage.h>
+
 // Default filenames
 char *from_name = NULL, *target_name = NULL, *output_name = NULL;
 char *trans_name  = NULL;
@@ -43,8 +45,9 @@ int main(int argc, char **argv)
 {
   irtkTransformation *transformation = NULL;
   irtkInterpolateImageFunction *interpolator = NULL;
-  irtkRealPixel target_min, target_max, source_min, source_max;
-  int ok, x, y, z, t;
+  irtkTiledImageReader *reader = NULL;
+  irtkRealPixel target_min, target_max, source_min, source_max, min, max;
+  int ok, x, y, z, t, frames;
   double x1, y1, z1, x2, y2, z2, widthx, widthy, val;
 
   // Check command line
@@ -63,9 +66,17 @@ int main(int argc, char **argv)
   argc--;
   argv++;
 
-  // Read target and target image
+  // Read target and target image. Series in tiled format are read frame by frame
   irtkRealImage target(target_name);
-  irtkRealImage from(from_name);
+  irtkRealImage from, frame;
+  if (irtkTiledImageReader::CheckHeader(from_name)) {
+    reader = new irtkTiledImageReader;
+    reader->Open(from_name);
+    frames = reader->GetImageAttributes()._t;
+  } else {
+    from.Read(from_name);
+    frames = from.GetT();
+  }
 
   // Fix no. of bins;
   nbins_x = 0;
@@ -129,7 +140,16 @@ int main(int argc, char **argv)
 
 
   // Set min and max of histogram
-  from.GetMinMax(&target_min, &target_max);
+  if (reader != NULL) {
+    for (t = 0; t < frames; t++) {
+      reader->ReadFrame(frame, t);
+      frame.GetMinMax(&min, &max);
+      if ((t == 0) || (min < target_min)) target_min = min;
+      if ((t == 0) || (max > target_max)) target_max = max;
+    }
+  } else {
+    from.GetMinMax(&target_min, &target_max);
+  }
   target.GetMinMax(&source_min, &source_max);
 
   // Calculate number of bins to use
@@ -186,16 +206,19 @@ int main(int argc, char **argv)
   maxphase = 0;
 
   // Fill histogram
-  for (t = 0; t < from.GetT(); t++){
-	  for (z = 0; z < from.GetZ(); z++) {
-		  for (y = 0; y < from.GetY(); y++) {
-			  for (x = 0; x < from.GetX(); x++) {
-
-				  val = from(x, y, z, t);
+  for (t = 0; t < frames; t++){
+	  if (reader != NULL) {
+		  reader->ReadFrame(frame, t);
+	  } else {
+		  frame = from.GetFrame(t);
+	  }
+	  for (z = 0; z < frame.GetZ(); z++) {
+		  for (y = 0; y < frame.GetY(); y++) {
+			  for (x = 0; x < frame.GetX(); x++) {
 
 				  irtkPoint p(x, y, z);
 				  // Transform point into world coordinates
-				  from.ImageToWorld(p);
+				  frame.ImageToWorld(p);
 				  // Transform point
 				  transformation->Transform(p);
 				  // Transform point into image coordinates
@@ -225,7 +248,7 @@ int main(int argc, char **argv)
 
 				  val = interpolator->EvaluateInside(p._x, p._y, p._z);
 
-				  histogram.AddSample(from(x, y, z, t), val);
+				  histogram.AddSample(frame(x, y, z), val);
 
 			  }
 		  }
@@ -240,14 +263,22 @@ int main(int argc, char **argv)
 
   //extract maxphase to output
   irtkRealImage output;
-  irtkImageAttributes attr = from.GetImageAttributes();
+  irtkImageAttributes attr;
+  if (reader != NULL) {
+	  reader->ReadFrame(frame, maxphase);
+	  attr = reader->GetImageAttributes();
+	  delete reader;
+  } else {
+	  frame = from.GetFrame(maxphase);
+	  attr = from.GetImageAttributes();
+  }
   attr._t = 1; attr._dt = 1;
   output.Initialize(attr);
 
-  for (z = 0; z < from.GetZ(); z++) {
-	  for (y = 0; y < from.GetY(); y++) {
-		  for (x = 0; x < from.GetX(); x++) {
-			  output.PutAsDouble(x,y,z,from.GetAsDouble(x,y,z,maxphase));
+  for (z = 0; z < frame.GetZ(); z++) {
+	  for (y = 0; y < frame.GetY(); y++) {
+		  for (x = 0; x < frame.GetX(); x++) {
+			  output.PutAsDouble(x,y,z,frame.GetAsDouble(x,y,z));
 		  }
 	  }
   }
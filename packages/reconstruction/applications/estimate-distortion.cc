@@ -62,6 +62,10 @@ void usage()
                                        tab-sparated columns."<<endl;
   cerr << "\t-log_prefix [prefix]      Prefix for the log file."<<endl;
   cerr << "\t-debug                    Debug mode - save intermediate results."<<endl;
+  cerr << "\t-deterministic            Results do not depend on the number of threads."<<endl;
+  cerr << "\t-fused_em                 Simulate slices and compute robust statistics in one pass,"<<endl;
+  cerr << "\t                          keeping simulated slices in compact form. Less memory,"<<endl;
+  cerr << "\t                          results differ slightly due to single precision."<<endl;
   cerr << "\t" << endl;
   cerr << "\t" << endl;
   exit(1);
@@ -141,6 +145,8 @@ int main(int argc, char **argv)
   irtkRealImage b0_mask,T2_mask;
   int iterations = 2;
   bool debug = false;
+  bool deterministic = false;
+  bool fused_em = false;
   double sigma=20;
   double resolution = 0.75;
   double lambda = 0.02;
@@ -479,6 +485,22 @@ int main(int argc, char **argv)
       debug=true;
       ok = true;
     }
+
+    //Reproducible reductions
+    if ((ok == false) && (strcmp(argv[1], "-deterministic") == 0)){
+      argc--;
+      argv++;
+      deterministic=true;
+      ok = true;
+    }
+
+    //Fused simulation and robust statistics
+    if ((ok == false) && (strcmp(argv[1], "-fused_em") == 0)){
+      argc--;
+      argv++;
+      fused_em=true;
+      ok = true;
+    }
     
     //Read transformations from this folder
     if ((ok == false) && (strcmp(argv[1], "-log_prefix") == 0)){
@@ -675,6 +697,8 @@ int main(int argc, char **argv)
   //Set debug mode
   if (debug) reconstruction.DebugOn();
   else reconstruction.DebugOff();
+  if (deterministic) reconstruction.DeterministicOn();
+  if (fused_em) reconstruction.FusedEMOn();
   
   //Set B-spline control point spacing for field map
   reconstruction.SetFieldMapSpacing(fieldMapSpacing/2);
@@ -916,6 +940,7 @@ int main(int argc, char **argv)
       if (debug)
         fieldmap_mask.Write("fieldmap_mask_larger.nii.gz");
       irtkLaplacianSmoothing smoothing;
+      smoothing.SetDebug(debug);
       smoothing.SetInput(fieldmap);
       smoothing.SetMask(fieldmap_mask);
       irtkRealImage fieldmap_smooth = smoothing.RunGD();
@@ -1151,14 +1176,20 @@ int main(int argc, char **argv)
 
       // Simulate slices (needs to be done
       // after the update of the reconstructed volume)
-      reconstruction.SimulateSlices();
-      
-      if(robust_statistics) 
-	reconstruction.MStep(i+1);
+      //optionally simulation, M-step and E-step in one pass over the slices
+      if(robust_statistics && fused_em)
+        reconstruction.EMStep(i+1);
+      else
+      {
+        reconstruction.SimulateSlices();
+            
+        if(robust_statistics)
+          reconstruction.MStep(i+1);
       
-      //E-step
-      if(robust_statistics)
-        reconstruction.EStep();
+        //E-step
+        if(robust_statistics)
+          reconstruction.EStep();
+      }
       
       //Save intermediate reconstructed image
       if (debug)
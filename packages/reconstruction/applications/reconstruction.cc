@@ -12,6 +12,7 @@
 #include <vector>
 #include <string>
 #include <irtkImage.h>
+#include <irtkFileToImage.h>
 #include <irtkTransformation.h>
 #include <irtkReconstruction.h>
 
@@ -65,6 +66,12 @@ void usage()
   cerr << "\t-info [filename]          Filename for slice information in\
                                        tab-sparated columns."<<endl;
   cerr << "\t-debug                    Debug mode - save intermediate results."<<endl;
+  cerr << "\t-deterministic            Results do not depend on the number of threads."<<endl;
+  cerr << "\t-map_inputs               Map uncompressed NIfTI input stacks from their files instead of"<<endl;
+  cerr << "\t                          reading them. The files must not be modified while running."<<endl;
+  cerr << "\t-fused_em                 Simulate slices and compute robust statistics in one pass,"<<endl;
+  cerr << "\t                          keeping simulated slices in compact form. Less memory,"<<endl;
+  cerr << "\t                          results differ slightly due to single precision."<<endl;
   cerr << "\t-no_log                   Do not redirect cout and cerr to log files."<<endl;
   cerr << "\t" << endl;
   cerr << "\t" << endl;
@@ -102,6 +109,8 @@ int main(int argc, char **argv)
   irtkRealImage *mask=NULL;
   int iterations = 3;
   bool debug = false;
+  bool deterministic = false;
+  bool fused_em = false;
   double sigma=15;
   double resolution = 0.75;
   double lambda = 0.02;
@@ -157,6 +166,14 @@ int main(int argc, char **argv)
   argv++;
   cout<<"Number 0f stacks ... "<<nStacks<<endl;
 
+#ifdef HAS_NIFTI
+  //map uncompressed NIfTI inputs copy-on-write instead of reading them
+  //(option -map_inputs, needs to be known before the stacks are read)
+  for (i=1;i<argc;i++)
+    if (strcmp(argv[i], "-map_inputs") == 0)
+      irtkFileNIFTIToImage::SetMapping(true);
+#endif
+
   // Read stacks 
   for (i=0;i<nStacks;i++)
   {
@@ -383,6 +400,29 @@ int main(int argc, char **argv)
       debug=true;
       ok = true;
     }
+
+    //Reproducible reductions
+    if ((ok == false) && (strcmp(argv[1], "-deterministic") == 0)){
+      argc--;
+      argv++;
+      deterministic=true;
+      ok = true;
+    }
+
+    //Map input stacks, handled before the stacks are read
+    if ((ok == false) && (strcmp(argv[1], "-map_inputs") == 0)){
+      argc--;
+      argv++;
+      ok = true;
+    }
+
+    //Fused simulation and robust statistics
+    if ((ok == false) && (strcmp(argv[1], "-fused_em") == 0)){
+      argc--;
+      argv++;
+      fused_em=true;
+      ok = true;
+    }
     
     //Prefix for log files
     if ((ok == false) && (strcmp(argv[1], "-log_prefix") == 0)){
@@ -513,6 +553,8 @@ int main(int argc, char **argv)
   //Set debug mode
   if (debug) reconstruction.DebugOn();
   else reconstruction.DebugOff();
+  if (deterministic) reconstruction.DeterministicOn();
+  if (fused_em) reconstruction.FusedEMOn();
 
   if(recon_1D)
   reconstruction.Set1DRecon();
@@ -860,14 +902,20 @@ int main(int argc, char **argv)
 
       // Simulate slices (needs to be done
       // after the update of the reconstructed volume)
-      reconstruction.SimulateSlices();
+      //optionally simulation, M-step and E-step in one pass over the slices
+      if(robust_statistics && fused_em)
+        reconstruction.EMStep(i+1);
+      else
+      {
+        reconstruction.SimulateSlices();
             
-      if(robust_statistics)
-        reconstruction.MStep(i+1);
+        if(robust_statistics)
+          reconstruction.MStep(i+1);
       
-      //E-step
-      if(robust_statistics)
-        reconstruction.EStep();
+        //E-step
+        if(robust_statistics)
+          reconstruction.EStep();
+      }
       
     //Save intermediate reconstructed image
     if (debug)
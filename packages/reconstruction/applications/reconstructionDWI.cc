@@ -12,6 +12,7 @@
 #include <vector>
 #include <string>
 #include <irtkImage.h>
+#include <irtkFileToImage.h>
 #include <irtkTransformation.h>
 #include <irtkReconstruction.h>
 #include <irtkReconstructionDTI.h>
@@ -71,9 +72,17 @@ void usage()
   cerr << "\t-bspline                  Use multi-level bspline interpolation instead of super-resolution."<<endl;
   cerr << "\t-no_motion                Switch off volumetric registration."<<endl;
   cerr << "\t-log_prefix [prefix]      Prefix for the log file."<<endl;
+  cerr << "\t-checkpoint [file]        Save state after every SH iteration to restart from it."<<endl;
+  cerr << "\t-resume [file]            Restart SH iterations from checkpoint, skipping registration."<<endl;
   cerr << "\t-info [filename]          Filename for slice information in\
                                        tab-sparated columns."<<endl;
   cerr << "\t-debug                    Debug mode - save intermediate results."<<endl;
+  cerr << "\t-deterministic            Results do not depend on the number of threads."<<endl;
+  cerr << "\t-map_inputs               Map uncompressed NIfTI input stacks from their files instead of"<<endl;
+  cerr << "\t                          reading them. The files must not be modified while running."<<endl;
+  cerr << "\t-fused_em                 Simulate slices and compute robust statistics in one pass,"<<endl;
+  cerr << "\t                          keeping simulated slices in compact form. Less memory,"<<endl;
+  cerr << "\t                          results differ slightly due to single precision."<<endl;
   cerr << "\t-save_transformations     Save slice-wise transformations."<<endl;
   cerr << "\t-no_log                   Do not redirect cout and cerr to log files."<<endl;
   cerr << "\t" << endl;
@@ -115,6 +124,8 @@ int main(int argc, char **argv)
   irtkRealImage *mask=NULL;
   int iterations = 3;
   bool debug = false;
+  bool deterministic = false;
+  bool fused_em = false;
   bool save_transformations = false;
   double sigma=20;
   double resolution = 0;
@@ -167,6 +178,11 @@ int main(int argc, char **argv)
   string log_id;
   bool no_log = false;
 
+  //checkpoint to save after every SH iteration and to resume from
+  char * checkpoint_name = NULL;
+  char * resume_name = NULL;
+  int first_iteration = 0;
+
   //forced exclusion of slices
   int number_of_force_excluded_slices = 0;
   vector<int> force_excluded;
@@ -188,6 +204,14 @@ int main(int argc, char **argv)
   argv++;
   cout<<"Recontructed DWI volume name ... "<<output_name<<endl;
 
+#ifdef HAS_NIFTI
+  //map uncompressed NIfTI inputs copy-on-write instead of reading them
+  //(option -map_inputs, needs to be known before the stacks are read)
+  for (i=1;i<argc;i++)
+    if (strcmp(argv[i], "-map_inputs") == 0)
+      irtkFileNIFTIToImage::SetMapping(true);
+#endif
+
   //read 4D image
   irtkRealImage image4D;
   cout<<"Reading stack ... "<<argv[1]<<endl;
@@ -573,6 +597,29 @@ int main(int argc, char **argv)
       debug=true;
       ok = true;
     }
+
+    //Reproducible reductions
+    if ((ok == false) && (strcmp(argv[1], "-deterministic") == 0)){
+      argc--;
+      argv++;
+      deterministic=true;
+      ok = true;
+    }
+
+    //Map input stacks, handled before the stacks are read
+    if ((ok == false) && (strcmp(argv[1], "-map_inputs") == 0)){
+      argc--;
+      argv++;
+      ok = true;
+    }
+
+    //Fused simulation and robust statistics
+    if ((ok == false) && (strcmp(argv[1], "-fused_em") == 0)){
+      argc--;
+      argv++;
+      fused_em=true;
+      ok = true;
+    }
      //Save transformations
     if ((ok == false) && (strcmp(argv[1], "-save_transformations") == 0)){
       argc--;
@@ -618,6 +665,26 @@ int main(int argc, char **argv)
         argv++;
     }
  
+    //Save checkpoint after every SH iteration
+    if ((ok == false) && (strcmp(argv[1], "-checkpoint") == 0)){
+      argc--;
+      argv++;
+      checkpoint_name=argv[1];
+      ok = true;
+      argc--;
+      argv++;
+    }
+
+    //Resume SH iterations from checkpoint
+    if ((ok == false) && (strcmp(argv[1], "-resume") == 0)){
+      argc--;
+      argv++;
+      resume_name=argv[1];
+      ok = true;
+      argc--;
+      argv++;
+    }
+
     //Read transformations from this folder
     if ((ok == false) && (strcmp(argv[1], "-transformations") == 0)){
       argc--;
@@ -797,6 +864,8 @@ int main(int argc, char **argv)
   //Set debug mode
   if (debug) reconstruction.DebugOn();
   else reconstruction.DebugOff();
+  if (deterministic) reconstruction.DeterministicOn();
+  if (fused_em) reconstruction.FusedEMOn();
   
   //Set force excluded slices
   reconstruction.SetForceExcludedSlices(force_excluded);
@@ -1018,6 +1087,10 @@ int main(int argc, char **argv)
   }
   
   
+  //registration is restored from checkpoint
+  if (resume_name != NULL)
+    iterations = 0;
+
   for (int iter=0;iter<iterations;iter++)
   {
     //only last iteration!!!
@@ -1208,14 +1281,20 @@ int main(int argc, char **argv)
 
       // Simulate slices (needs to be done
       // after the update of the reconstructed volume)
-      reconstruction.SimulateSlices();
+      //optionally simulation, M-step and E-step in one pass over the slices
+      if(robust_statistics && fused_em)
+        reconstruction.EMStep(i+1);
+      else
+      {
+        reconstruction.SimulateSlices();
             
-      if(robust_statistics)
-        reconstruction.MStep(i+1);
+        if(robust_statistics)
+          reconstruction.MStep(i+1);
       
-      //E-step
-      if(robust_statistics)
-        reconstruction.EStep();
+        //E-step
+        if(robust_statistics)
+          reconstruction.EStep();
+      }
       
     //Save intermediate reconstructed image
     if (debug)
@@ -1365,6 +1444,14 @@ int main(int argc, char **argv)
   //reconstruction.SetLambdaLB(1);//to create order=2 effectively
   
   reconstruction.InitSH(dirs_xyz,order);
+
+  //restore SH coefficients, slice transformations, bias fields and weights
+  if (resume_name != NULL)
+  {
+    first_iteration = reconstruction.ReadCheckpoint(resume_name) + 1;
+    reconstruction.CoeffInit();
+    cout<<"Resuming SH iterations from checkpoint "<<resume_name<<" at iteration "<<first_iteration<<endl;
+  }
   
   //reconstruction.Set3DRecon();
   //reconstruction.CoeffInit();
@@ -1377,7 +1464,7 @@ int main(int argc, char **argv)
   for(int sh_iter=1; sh_iter<=1;sh_iter++)
   {
     
-  for(int iteration = 0; iteration < sr_sh_iterations; iteration++ )
+  for(int iteration = first_iteration; iteration < sr_sh_iterations; iteration++ )
   {
       /*
       if (iteration == 0)
@@ -1482,14 +1569,15 @@ int main(int argc, char **argv)
     }
     
     reconstruction.SimulateSlicesDTI();
+    double consistency = reconstruction.Consistency();
     cout.rdbuf (fileConsistency.rdbuf());
-    cout<<reconstruction.Consistency()<<", ";
+    cout<<consistency<<", ";
     cout.rdbuf (fileConsistencyEx.rdbuf());
     cout<<reconstruction.Consistency(true)<<", ";
     cout.rdbuf (strm_buffer);
-    cout<<"SH iter "<<iteration<<": consistency = "<<reconstruction.Consistency()<<endl;
+    cout<<"SH iter "<<iteration<<": consistency = "<<consistency<<endl;
     cout.rdbuf (fileSH.rdbuf());
-    cout<<"SH iter "<<iteration<<": consistency = "<<reconstruction.Consistency()<<endl;
+    cout<<"SH iter "<<iteration<<": consistency = "<<consistency<<endl;
     
     if(robust_statistics_sh)
         reconstruction.MStep(i+1);
@@ -1498,6 +1586,8 @@ int main(int argc, char **argv)
       if(robust_statistics_sh)
         reconstruction.EStep();
     reconstruction.SaveSHcoeffs(iteration);
+    if (checkpoint_name != NULL)
+      reconstruction.SaveCheckpoint(checkpoint_name, iteration);
     /*
     if(robust_statistics)
       reconstruction.MStep(i+1);
@@ -27,10 +27,26 @@
 #include <vector>
 using namespace std;
 
+//scattered point in the lattice of control points: cell, position in the cell and residual
+struct BSPLINEPOINT
+{
+    int l;
+    int m;
+    int n;
+    double s;
+    double t;
+    double u;
+    double value;
+};
 
 class irtkBSplineReconstruction : public irtkObject
 {
 
+  friend class ParallelBSplineResiduals;
+  friend class ParallelBSplineAccumulate;
+  friend class ParallelBSplineEvaluate;
+  friend class ParallelBSplineSubdivide;
+
 protected:
   
 irtkRealImage **_dx;
@@ -52,6 +68,10 @@ double _padding;
 
 double LookupTable  [LOOKUPTABLESIZE][4];
 
+//scattered points sorted by slabs of control points along z and start of each slab
+vector<BSPLINEPOINT> _points;
+vector<int> _slabs;
+
 inline double Bsp(int i, double t);
 void initialiseLookupTable();
 void clearRealImage(irtkRealImage *img);
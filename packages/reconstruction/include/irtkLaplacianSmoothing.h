@@ -21,7 +21,32 @@
 #include <irtkResampling.h>
 #include <irtkResamplingWithPadding.h>
 
-
+/*
+  Level of the multigrid hierarchy of the smoothness problem
+
+  The fieldmap f minimises 1/2 sum data (f-g)^2 + 1/2 sum lambda (L f)^2,
+  where row x of L is f(x) minus the normalised weighted average of the
+  neighbours of x which it includes. On the finest level interior rows
+  (mask 1) include all neighbours and boundary rows (mask 2) only boundary
+  neighbours. Coarse levels are rediscretised and include all active
+  neighbours. Bit i of _rows and _columns flags neighbour i of the
+  26-neighbourhood in row x of L and in column x of L respectively.
+*/
+struct irtkLaplacianLevel
+{
+  int _x, _y, _z;
+  bool _coarse;
+  double _lambda1, _lambda2;
+  int _offset[26];
+  double _factor[26];
+  vector<char> _mask;
+  vector<int> _rows, _columns;
+  vector<double> _data;
+  vector<double> _norm;
+  vector<double> _lambda;
+  vector<double> _diag;
+  vector<double> _b, _e, _r, _u;
+};
 
 class irtkLaplacianSmoothing : public irtkObject
 {
@@ -42,7 +67,10 @@ protected:
   double _rel_diff_threshold;
   double _relax_iter;
   double _boundary_weight;
+  bool _debug;
 
+  //multigrid hierarchy of the smoothness problem
+  vector<irtkLaplacianLevel> _levels;
   
   void InitializeFactors();
   
@@ -55,32 +83,29 @@ protected:
   void ReduceImage(irtkRealImage &image);
   
   void CalculateBoundary(irtkRealImage& m);
-  void CalculateBoundaryWeights(irtkRealImage& w, irtkRealImage m);
-  double LaplacianImage(irtkRealImage image, irtkRealImage m, irtkRealImage& laplacian);
-  double LaplacianBoundary(irtkRealImage image, irtkRealImage m, irtkRealImage& laplacian);
-  void LLaplacian(irtkRealImage& llaplacian, irtkRealImage laplacian, irtkRealImage mask, irtkRealImage weights);
-  void UpdateFieldmap(irtkRealImage& fieldmap, irtkRealImage image, irtkRealImage multipliers, 
-		    irtkRealImage mask, irtkRealImage weights, double alpha);
-  void UpdateFieldmapGD(irtkRealImage& fieldmap, irtkRealImage image, irtkRealImage laplacian, irtkRealImage mask, irtkRealImage weights, double alpha, double lambda1, double lambda2);
-  
-  void UpdateFieldmapWithThreshold(irtkRealImage& fieldmap, irtkRealImage image, irtkRealImage multipliers, 
-		    irtkRealImage mask, irtkRealImage weights, double alpha, double threshold);
-  void UpdateFieldmapHuber(irtkRealImage& fieldmap, irtkRealImage image, irtkRealImage multipliers, 
-		    irtkRealImage mask, irtkRealImage weights, double alpha);
   
+  void BuildLevels(const irtkRealImage& mask, double lambda1, double lambda2);
+  void ApplyOperator(int level, const vector<double>& v, vector<double>& out);
+  void Relax(int level, vector<double>& x, const vector<double>& b, int sweeps);
+  void VCycle(int level);
+  int SolveSmoothness(irtkRealImage& fieldmap, const irtkRealImage& image, const irtkRealImage& mask, double lambda1, double lambda2);
+
   void Smooth(irtkRealImage& im, irtkRealImage m);
-  void SmoothGD(irtkRealImage& im, irtkRealImage m);
-  void UpsampleFieldmap(irtkRealImage& target, irtkRealImage mask, irtkRealImage &newmask);
+  void SmoothGD(irtkRealImage& im, const irtkRealImage& m);
+  void UpsampleFieldmap(irtkRealImage& target, const irtkRealImage& mask, irtkRealImage &newmask);
 
   
 public:
   
   irtkLaplacianSmoothing();
   
-  void SetInput(irtkRealImage image);
+  void SetInput(const irtkRealImage& image);
   void SetMask(irtkRealImage mask);
+  //lap_threshold is the relative residual at which the smoothness solver stops, rel_diff_threshold
+  //the relative decrease of the residual over 10 iterations below which it stops early
   void SetParam(double lap_threshold, double rel_diff_threshold, double relax_iter,double boundary_weight);
   void SetBoundaryWeight(double boundary_weight);
+  void SetDebug(bool debug);
   irtkRealImage GetMask();
   
   irtkRealImage Run();
@@ -91,7 +116,7 @@ public:
 
 };
 
-inline void irtkLaplacianSmoothing::SetInput(irtkRealImage image)
+inline void irtkLaplacianSmoothing::SetInput(const irtkRealImage& image)
 {
   _image = image;
   _mask = _image;
@@ -111,6 +136,11 @@ inline void irtkLaplacianSmoothing::SetBoundaryWeight(double boundary_weight=1)
   _boundary_weight = boundary_weight;
 }
 
+inline void irtkLaplacianSmoothing::SetDebug(bool debug)
+{
+  _debug = debug;
+}
+
 inline irtkRealImage irtkLaplacianSmoothing::GetMask()
 {
   return _mask;
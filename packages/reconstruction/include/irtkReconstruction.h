@@ -30,6 +30,9 @@ using namespace std;
 */
 enum RECON_TYPE {_3D, _1D, _interpolate};
 
+//number of slices reduced serially in deterministic mode
+#define DETERMINISTIC_GRAIN 8
+
 struct POINT3D
 {
     short x;
@@ -38,6 +41,15 @@ struct POINT3D
     double value;
 };
 
+//run of consecutive voxels x1 to x2-1 of row y, z inside the mask
+struct MASKRUN
+{
+    int y;
+    int z;
+    int x1;
+    int x2;
+};
+
 typedef std::vector<POINT3D> VOXELCOEFFS; 
 typedef std::vector<std::vector<VOXELCOEFFS> > SLICECOEFFS;
 
@@ -57,11 +69,16 @@ class irtkReconstruction : public irtkObject
     vector<irtkRealImage> _simulated_slices;
     vector<irtkRealImage> _simulated_weights;
     vector<irtkRealImage> _simulated_inside;
+    /// Simulated slices, weights and inside flags in compact form (fused EM mode)
+    vector<vector<float> > _compact_simulated_slices;
+    vector<vector<float> > _compact_simulated_weights;
+    vector<vector<char> > _compact_simulated_inside;
   
     /// Transformations
     vector<irtkRigidTransformation> _transformations;
     /// Indicator whether slice has an overlap with volumetric mask
-    vector<bool> _slice_inside;
+    /// (not vector<bool>, slices set their flag concurrently)
+    vector<char> _slice_inside;
   
     //VOLUME
     /// Reconstructed volume
@@ -71,6 +88,8 @@ class irtkReconstruction : public irtkObject
     /// Volume mask
     irtkRealImage _mask;
     irtkRealImage _mask_internal;
+    /// Runs of voxels inside the mask in memory order, updated whenever the mask changes
+    vector<MASKRUN> _mask_runs;
     irtkRealImage _brain_probability;
     vector<irtkRealImage> _probability_maps;
   
@@ -161,6 +180,12 @@ class irtkReconstruction : public irtkObject
     //utility
     ///Debug mode
     bool _debug;
+
+    ///Reduce parallel sums over fixed chunks in a fixed order (reproducible results)
+    bool _deterministic;
+
+    ///Fused simulation and robust statistics, simulated slices kept in compact form
+    bool _fused_em;
     
     //do not exclude voxels, only whole slices
     bool _robust_slices_only;
@@ -179,6 +204,36 @@ class irtkReconstruction : public irtkObject
 
     /// Gestational age (to compute expected brain volume)
     double _GA;
+
+    ///Find runs of voxels inside the mask
+    void UpdateMaskRuns();
+
+    ///Run reduction body over 0..n-1, in chunks of grain items in deterministic mode
+    template <class Body> inline void ParallelReduce(size_t n, Body &body, size_t grain = DETERMINISTIC_GRAIN);
+
+    ///Simulate one slice from the reconstructed volume into the given images
+    void SimulateSlice(int inputIndex, irtkRealImage& sim, irtkRealImage& simw, irtkRealImage& inside);
+
+    ///Simulate one slice from the reconstructed volume, in compact form in fused EM mode
+    void SimulateSlice(int inputIndex);
+
+    ///Make room for compact simulated slices of all slices
+    void ResizeCompactSimulatedSlices();
+
+    ///Keep a simulated slice in compact form and release its images
+    void CompactSimulatedSlice(int inputIndex, const irtkRealImage& sim, const irtkRealImage& simw, const irtkRealImage& inside);
+
+    ///Simulated slice, weights and inside flags of a slice,
+    ///expanded into the buffer if they are kept in compact form
+    const irtkRealImage& SimulatedSlice(int inputIndex, irtkRealImage& buffer) const;
+    const irtkRealImage& SimulatedWeights(int inputIndex, irtkRealImage& buffer) const;
+    const irtkRealImage& SimulatedInside(int inputIndex, irtkRealImage& buffer) const;
+
+    ///Update voxel-wise robust statistics from the sums of the M-step
+    void VoxelStatistics(int iter, double sigma, double mix, double num, double min, double max);
+
+    ///Perform E-step, using residuals of the slices if they are given
+    void EStep(vector<vector<float> > *residuals);
   
  public:
 
@@ -188,9 +243,9 @@ class irtkReconstruction : public irtkObject
     ~irtkReconstruction();
 
     ///Create zero image as a template for reconstructed volume
-    double CreateTemplate( irtkRealImage stack,
+    double CreateTemplate( const irtkRealImage& stack,
                            double resolution=0 );
-    double CreateTemplateAniso(irtkRealImage stack);
+    double CreateTemplateAniso(const irtkRealImage& stack);
     double CreateLargeTemplate( vector<irtkRealImage>& stacks,
                                 vector<irtkRigidTransformation>& stack_transformations,
                                 irtkImageAttributes &templateAttr,
@@ -209,14 +264,14 @@ class irtkReconstruction : public irtkObject
     void SetMaskOrient(irtkRealImage * mask, irtkRigidTransformation transformation);
     void StackRegistrations(vector<irtkRealImage>& stacks, vector<irtkRigidTransformation>& stack_transformations);
     void SetTemplateImage(irtkRealImage t, irtkRigidTransformation);
-    void SetTemplateNoProcessing(irtkRealImage templateImage);
+    void SetTemplateNoProcessing(const irtkRealImage& templateImage);
 
 
     /// Set gestational age (to compute expected brain volume)
     void SetGA(double ga);
     
     ///Remember volumetric mask 
-    void PutMask(irtkRealImage mask);
+    void PutMask(const irtkRealImage& mask);
   
     ///Create mask from black background if the flag is set
     void CreateMaskFromBlackBackground( vector<irtkRealImage>& stacks,
@@ -350,6 +405,10 @@ class irtkReconstruction : public irtkObject
   
     ///Calculation of voxel-vise robust statistics
     void MStep(int iter);
+
+    ///Simulate slices, M-step and E-step, with one pass over each slice
+    ///for simulation, residuals and M-step (fused EM mode)
+    void EMStep(int iter);
   
     ///Edge-preserving regularization
     void Regularization(int iter);
@@ -399,11 +458,11 @@ class irtkReconstruction : public irtkObject
     inline void SetSigma( double sigma );
   
     ///Return reconstructed volume
-    inline irtkRealImage GetReconstructed();
+    inline const irtkRealImage& GetReconstructed();
     void SetReconstructed(irtkRealImage &reconstructed);
   
     ///Return resampled mask
-    inline irtkRealImage GetMask();
+    inline const irtkRealImage& GetMask();
   
     ///Set smoothing parameters
     inline void SetSmoothingParameters( double delta, double lambda );
@@ -417,6 +476,13 @@ class irtkReconstruction : public irtkObject
     ///Use slower better quality reconstruction
     inline void SpeedupOff();
   
+    ///Simulate slices, M-step and E-step in one pass (EMStep) and keep
+    ///simulated slices in compact float form, slightly different results
+    inline void FusedEMOn();
+
+    ///Separate simulation, M-step and E-step (default)
+    inline void FusedEMOff();
+
     ///Switch on global bias correction
     inline void GlobalBiasCorrectionOn();
   
@@ -439,6 +505,11 @@ class irtkReconstruction : public irtkObject
     ///Do not save intermediate results
     inline void DebugOff();
 
+    ///Results do not depend on the number of threads
+    inline void DeterministicOn();
+    ///Faster reductions whose rounding depends on the number of threads
+    inline void DeterministicOff();
+
     inline void UseAdaptiveRegularisation();
     
     inline void ExcludeWholeSlicesOnly();
@@ -488,18 +559,18 @@ class irtkReconstruction : public irtkObject
                           int half_iter=1);
   
     ///Splits stacks into packages
-    void SplitImage( irtkRealImage image,
+    void SplitImage( const irtkRealImage& image,
                      int packages,
                      vector<irtkRealImage>& stacks );
     ///Splits stacks into packages and each package into even and odd slices
-    void SplitImageEvenOdd( irtkRealImage image,
+    void SplitImageEvenOdd( const irtkRealImage& image,
                             int packages,
                             vector<irtkRealImage>& stacks );
     ///Splits image into top and bottom half roi according to z coordinate
-    void HalfImage( irtkRealImage image,
+    void HalfImage( const irtkRealImage& image,
                     vector<irtkRealImage>& stacks );
     ///Splits stacks into packages and each package into even and odd slices and top and bottom roi
-    void SplitImageEvenOddHalf( irtkRealImage image,
+    void SplitImageEvenOddHalf( const irtkRealImage& image,
                                 int packages,
                                 vector<irtkRealImage>& stacks,
                                 int iter=1);
@@ -507,9 +578,11 @@ class irtkReconstruction : public irtkObject
     friend class ParallelStackRegistrations;
     friend class ParallelSliceToVolumeRegistration;
     friend class ParallelCoeffInit;
+    friend class ParallelCoeffInitBSpline;
     friend class ParallelSuperresolution;
     friend class ParallelMStep;
     friend class ParallelEStep;
+    friend class ParallelEMStep;
     friend class ParallelBias;
     friend class ParallelBiasGD;
     friend class ParallelScale;
@@ -520,11 +593,11 @@ class irtkReconstruction : public irtkObject
     friend class ParallelSimulateSlicesDTI;
     friend class ParallelAverage;
     friend class ParallelSliceAverage;
-    friend class ParallelAdaptiveRegularization1;
-    friend class ParallelAdaptiveRegularization2;
+    friend class ParallelAdaptiveRegularization;
     friend class ParallelL22Regularization;
     friend class ParallelLaplacianRegularization1;
     friend class ParallelLaplacianRegularization2;
+    friend class ParallelConsistency;
 };
 
 inline double irtkReconstruction::G(double x,double s)
@@ -537,19 +610,20 @@ inline double irtkReconstruction::M(double m)
     return m*_step;
 }
 
-inline irtkRealImage irtkReconstruction::GetReconstructed()
+inline const irtkRealImage& irtkReconstruction::GetReconstructed()
 {
     return _reconstructed;
 }
 
-inline irtkRealImage irtkReconstruction::GetMask()
+inline const irtkRealImage& irtkReconstruction::GetMask()
 {
     return _mask;
 }
 
-inline void irtkReconstruction::PutMask(irtkRealImage mask)
+inline void irtkReconstruction::PutMask(const irtkRealImage& mask)
 {
-    _mask=mask;;
+    _mask=mask;
+    UpdateMaskRuns();
 }
 
 
@@ -575,6 +649,26 @@ inline void irtkReconstruction::DebugOff()
     _debug=false;
 }
 
+inline void irtkReconstruction::DeterministicOn()
+{
+    _deterministic=true;
+}
+
+inline void irtkReconstruction::DeterministicOff()
+{
+    _deterministic=false;
+}
+
+template <class Body> inline void irtkReconstruction::ParallelReduce(size_t n, Body &body, size_t grain)
+{
+    task_scheduler_init init(tbb_no_threads);
+    if (_deterministic)
+        parallel_deterministic_reduce( blocked_range<size_t>(0,n,grain), body );
+    else
+        parallel_reduce( blocked_range<size_t>(0,n), body );
+    init.terminate();
+}
+
 inline void irtkReconstruction::SetSigma(double sigma)
 {
     _sigma_bias=sigma;
@@ -595,6 +689,16 @@ inline void irtkReconstruction::SpeedupOff()
     _quality_factor=2;
 }
 
+inline void irtkReconstruction::FusedEMOn()
+{
+    _fused_em=true;
+}
+
+inline void irtkReconstruction::FusedEMOff()
+{
+    _fused_em=false;
+}
+
 inline void irtkReconstruction::GlobalBiasCorrectionOn()
 {
     _global_bias_correction=true;
@@ -17,6 +17,7 @@
 #include <irtkReconstruction.h>
 //#include <irtkReconstructionb0.h>
 #include <irtkSphericalHarmonics.h>
+#include <irtkSHCoefficientImage.h>
 
 
 #include <vector>
@@ -47,6 +48,10 @@ class irtkReconstructionDTI : public irtkReconstruction
  
  double _lambdaLB;
  vector<int> _slice_order;
+
+ //SH basis of rotated direction of each slice and the direction it was computed for
+ vector<vector<double> > _slice_basis;
+ vector<vector<double> > _slice_basis_dir;
  
  public:
    irtkReconstructionDTI();
@@ -68,6 +73,10 @@ class irtkReconstructionDTI : public irtkReconstruction
    void SuperresolutionDTI(int iter, bool tv = false, double sh_alpha = 5, double regDTI = 0);
    double LaplacianSmoothnessDTI();
    void SaveSHcoeffs(int iteration);
+   ///Save state of SH reconstruction after iteration to restart from it
+   void SaveCheckpoint(const char *name, int iteration);
+   ///Restore state saved by SaveCheckpoint, returns its iteration
+   int ReadCheckpoint(const char *name);
    void SimulateSignal(char *output_name=NULL);
    void SimulateSignal(int iter);
    void SetLambdaLB(double lambda);
@@ -78,7 +87,7 @@ class irtkReconstructionDTI : public irtkReconstruction
    void PostProcessMotionParametersHS2(irtkRealImage target, bool empty=false);
    void SetMotionSigma(double sigma);
    void SliceToVolumeRegistrationSH();
-   void SetSimulatedSignal(irtkRealImage signal);
+   void SetSimulatedSignal(const irtkRealImage& signal);
    void CorrectStackIntensities(vector<irtkRealImage>& stacks);
    
    void NormaliseBiasSH(int iter);
@@ -86,10 +95,13 @@ class irtkReconstructionDTI : public irtkReconstruction
    void NormaliseBiasSH2(int iter, vector<irtkRigidTransformation> &stack_transformations, int order);
    
    inline void WriteSimulatedSignal(char * name);
+   ///attributes of the 4D signal of all directions represented by SH coefficients
+   inline irtkImageAttributes SignalAttributes();
    
    inline void SetSH(irtkRealImage sh);
 
    double ConsistencyDTI();
+   const double* GetSliceBasis(int inputIndex);
 
    
    friend class ParallelSimulateSlicesDTI;
@@ -115,7 +127,7 @@ inline void irtkReconstructionDTI::SetMotionSigma(double sigma)
   _motion_sigma=sigma;
 }
 
-inline void irtkReconstructionDTI::SetSimulatedSignal(irtkRealImage signal)
+inline void irtkReconstructionDTI::SetSimulatedSignal(const irtkRealImage& signal)
 {
   _simulated_signal=signal;
 }
@@ -125,6 +137,13 @@ inline void irtkReconstructionDTI::WriteSimulatedSignal(char * name)
   _simulated_signal.Write(name);
 }
 
+inline irtkImageAttributes irtkReconstructionDTI::SignalAttributes()
+{
+  irtkImageAttributes attr = _SH_coeffs.GetImageAttributes();
+  attr._t = _dirs.Rows();
+  return attr;
+}
+
 
 inline void irtkReconstructionDTI::SetSH(irtkRealImage sh)
 {
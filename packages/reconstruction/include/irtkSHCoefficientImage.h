@@ -0,0 +1,121 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+  Visual Information Processing (VIP), 2011 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+  =========================================================================*/
+
+#ifndef _irtkSHCoefficientImage_H
+
+#define _irtkSHCoefficientImage_H
+
+#include <irtkImage.h>
+
+#include <vector>
+
+/*
+  Spherical harmonic coefficients stored voxel by voxel
+
+  irtkRealImage keeps SH coefficients in t, one volume apart. Here the
+  coefficients of each voxel are contiguous, so that the signal of a voxel
+  in a direction is a single dot product with the basis of that direction.
+  Dot products and updates are unrolled for the number of coefficients of
+  orders 0 to 8.
+*/
+
+class irtkSHCoefficientImage : public irtkObject
+{
+  int _x, _y, _z, _n;
+  std::vector<double> _data;
+
+ public:
+  irtkSHCoefficientImage();
+
+  /// Allocate n coefficients per voxel and set them to zero
+  void Initialize(int x, int y, int z, int n);
+
+  /// Copy coefficients from image with coefficients in t
+  void Put(const irtkRealImage &image);
+
+  /// Copy coefficients into image with coefficients in t
+  void Get(irtkRealImage &image) const;
+
+  int GetNumberOfCoefficients() const;
+
+  /// Coefficients of voxel
+  double *operator()(int i, int j, int k);
+  const double *operator()(int i, int j, int k) const;
+
+  /// Signal of voxel for basis of a direction
+  double Dot(int i, int j, int k, const double *basis) const;
+
+  /// Add w times basis of a direction to coefficients of voxel
+  void Add(int i, int j, int k, const double *basis, double w);
+
+  irtkSHCoefficientImage& operator+=(const irtkSHCoefficientImage &image);
+};
+
+template <int N> inline double irtkSHDot(const double *c, const double *b)
+{
+  double sum = 0;
+  for (int l = 0; l < N; l++) sum += c[l] * b[l];
+  return sum;
+}
+
+template <int N> inline void irtkSHAdd(double *c, const double *b, double w)
+{
+  for (int l = 0; l < N; l++) c[l] += w * b[l];
+}
+
+inline int irtkSHCoefficientImage::GetNumberOfCoefficients() const
+{
+  return _n;
+}
+
+inline double *irtkSHCoefficientImage::operator()(int i, int j, int k)
+{
+  return &(_data[((size_t(k) * _y + j) * _x + i) * _n]);
+}
+
+inline const double *irtkSHCoefficientImage::operator()(int i, int j, int k) const
+{
+  return &(_data[((size_t(k) * _y + j) * _x + i) * _n]);
+}
+
+inline double irtkSHCoefficientImage::Dot(int i, int j, int k, const double *basis) const
+{
+  const double *c = (*this)(i, j, k);
+  switch (_n) {
+    case 1:  return c[0] * basis[0];
+    case 6:  return irtkSHDot<6>(c, basis);
+    case 15: return irtkSHDot<15>(c, basis);
+    case 28: return irtkSHDot<28>(c, basis);
+    case 45: return irtkSHDot<45>(c, basis);
+    default: {
+      double sum = 0;
+      for (int l = 0; l < _n; l++) sum += c[l] * basis[l];
+      return sum;
+    }
+  }
+}
+
+inline void irtkSHCoefficientImage::Add(int i, int j, int k, const double *basis, double w)
+{
+  double *c = (*this)(i, j, k);
+  switch (_n) {
+    case 1:  c[0] += w * basis[0]; break;
+    case 6:  irtkSHAdd<6>(c, basis, w); break;
+    case 15: irtkSHAdd<15>(c, basis, w); break;
+    case 28: irtkSHAdd<28>(c, basis, w); break;
+    case 45: irtkSHAdd<45>(c, basis, w); break;
+    default:
+      for (int l = 0; l < _n; l++) c[l] += w * basis[l];
+  }
+}
+
+#endif
@@ -25,8 +25,10 @@ public:
   irtkMatrix SHbasis(irtkMatrix dirs, int lmax);
   irtkVector Coeff2Signal(irtkVector c);
   irtkVector Signal2Coeff(irtkVector s);
-  irtkRealImage Signal2Coeff(irtkRealImage signal);
-  irtkRealImage Coeff2Signal(irtkRealImage coeff);
+  irtkRealImage Signal2Coeff(const irtkRealImage& signal);
+  irtkRealImage Coeff2Signal(const irtkRealImage& coeff);
+  ///signal of a single direction, without the signal of the other directions
+  irtkRealImage Coeff2Signal(const irtkRealImage& coeff, int direction);
   irtkMatrix LaplaceBeltramiMatrix(int lmax);
   void InitSHTRegul(irtkMatrix dirs, double lambda, int lmax);
 };
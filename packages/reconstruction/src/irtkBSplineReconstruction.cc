@@ -7,6 +7,11 @@
 #include <vector>
 using namespace std;
 
+// Thickness along z of the slabs into which scattered points are sorted.
+// Points of a slab affect control points of at most the slab and the
+// neighbouring slabs, as long as it is not thinner than the support.
+#define BSPLINE_SLAB 4
+
 
 irtkBSplineReconstruction::irtkBSplineReconstruction()
 {
@@ -713,24 +718,74 @@ irtkRealImage * irtkBSplineReconstruction::downsampleFactorTwo(irtkRealImage *in
 }
 
 
+// Subdivide slices k of the lattice, each writes slices 2k and 2k+1
+// of the output lattice.
+class ParallelBSplineSubdivide {
+    irtkRealImage *in;
+    irtkRealImage *out;
+
+public:
+    ParallelBSplineSubdivide(irtkRealImage *_in, irtkRealImage *_out) :
+    in(_in), out(_out) { }
+
+    void operator() (const blocked_range<size_t> &r) const {
+        int i, j, i1, j1, k1, i2, j2, k2;
+        int xdim, ydim;
+        double val;
+
+        // Weights for subdivision
+        double w[2][3];
+        w[1][0] = 0;
+        w[1][1] = 1.0/2.0;
+        w[1][2] = 1.0/2.0;
+        w[0][0] = 1.0/8.0;
+        w[0][1] = 6.0/8.0;
+        w[0][2] = 1.0/8.0;
+
+        xdim = in->GetX();
+        ydim = in->GetY();
+
+        for ( size_t k = r.begin(); k != r.end(); ++k ) {
+            for (j = 1; j < ydim-2; ++j){
+                for (i = 1; i < xdim-2; ++i){
+
+                    for (k1 = 0; k1 < 2; ++k1){
+                        for (j1 = 0; j1 < 2; ++j1){
+                            for (i1 = 0; i1 < 2; ++i1){
+
+                                val = 0;
+
+                                for (k2 = 0; k2 < 3; ++k2){
+                                    for (j2 = 0; j2 < 3; ++j2){
+                                        for (i2 = 0; i2 < 3; ++i2){
+                                            val += w[i1][i2] * w[j1][j2] * w[k1][k2] * in->Get(i+i2-1, j+j2-1, k+k2-1);
+                                        }
+                                    }
+                                }
+                                out->Put(2*i+i1, 2*j+j1, 2*k+k1, val);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(1, max(in->GetZ()-2, 1)), *this );
+        init.terminate();
+    }
+};
+
 // Subdivide image in treating its values as a set of B-spline
 // coefficients.  The output image needs to have dimensions 2x-1,
 // 2y-1, 2z-1 where x, y, z are the dimensions of the input
 // image.
 void irtkBSplineReconstruction::subdivide(irtkRealImage *in, irtkRealImage *out)
 {
-  int i, j, k, i1, j1, k1, i2, j2, k2;
   int xdim, ydim, zdim;
-  double val;
-
-  // Weights for subdivision
-  double w[2][3];
-  w[1][0] = 0;
-  w[1][1] = 1.0/2.0;
-  w[1][2] = 1.0/2.0;
-  w[0][0] = 1.0/8.0;
-  w[0][1] = 6.0/8.0;
-  w[0][2] = 1.0/8.0;
 
   xdim = in->GetX();
   ydim = in->GetY();
@@ -742,31 +797,8 @@ void irtkBSplineReconstruction::subdivide(irtkRealImage *in, irtkRealImage *out)
     exit(1);
   }
 
-  for (k = 1; k < zdim-2; ++k){
-    for (j = 1; j < ydim-2; ++j){
-      for (i = 1; i < xdim-2; ++i){
-
-        for (k1 = 0; k1 < 2; ++k1){
-	  for (j1 = 0; j1 < 2; ++j1){
-            for (i1 = 0; i1 < 2; ++i1){
-
-              val = 0;
-
-              for (k2 = 0; k2 < 3; ++k2){
-                for (j2 = 0; j2 < 3; ++j2){
-                  for (i2 = 0; i2 < 3; ++i2){
-                    val += w[i1][i2] * w[j1][j2] * w[k1][k2] * in->Get(i+i2-1, j+j2-1, k+k2-1);
-                  }
-                }
-              }
-              out->Put(2*i+i1, 2*j+j1, 2*k+k1, val);
-	    }
-	  }
-	}
-      }
-    }
-  }
-
+  ParallelBSplineSubdivide subdivision(in, out);
+  subdivision();
 }
 
 // Get the intensity at a set of world coordinates for a lattice
@@ -849,169 +881,252 @@ double irtkBSplineReconstruction::getIntensity(irtkRealImage *coeffs, double xin
   return value;
 }
 
-void irtkBSplineReconstruction::evaluateCoeffsOnImageLattice(irtkRealImage *img, irtkRealImage *coeffs)
-{
-  int i, j, k;
-  double x, y, z;
-  int xdim, ydim, zdim;
-
-  xdim = img->GetX();
-  ydim = img->GetY();
-  zdim = img->GetZ();
+// Evaluate the B-spline on slices k of an image lattice.
+class ParallelBSplineEvaluate {
+    irtkBSplineReconstruction *reconstructor;
+    irtkBaseImage *img;
+    irtkRealImage *coeffs;
+    bool rounding;
+
+public:
+    ParallelBSplineEvaluate(irtkBSplineReconstruction *_reconstructor, irtkBaseImage *_img, irtkRealImage *_coeffs, bool _rounding) :
+    reconstructor(_reconstructor), img(_img), coeffs(_coeffs), rounding(_rounding) { }
+
+    void operator() (const blocked_range<size_t> &r) const {
+        int i, j;
+        double x, y, z, value;
+
+        for ( size_t k = r.begin(); k != r.end(); ++k ) {
+            for (j = 0; j < img->GetY(); ++j){
+                for (i = 0; i < img->GetX(); ++i){
+                    x = i;
+                    y = j;
+                    z = k;
+                    img->ImageToWorld(x, y, z);
+                    value = reconstructor->getIntensity(coeffs, x, y, z);
+                    if (rounding)
+                        value = round(value);
+                    img->PutAsDouble(i, j, k, value);
+                }
+            }
+        }
+    }
 
-  for (k = 0; k < zdim; ++k){
-    for (j = 0; j < ydim; ++j){
-      for (i = 0; i < xdim; ++i){
-        x = i;
-        y = j;
-        z = k;
-        img->ImageToWorld(x, y, z);
-        img->Put(i, j, k, getIntensity(coeffs, x, y, z));
-      }
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, img->GetZ()), *this );
+        init.terminate();
     }
-  }
+};
 
+void irtkBSplineReconstruction::evaluateCoeffsOnImageLattice(irtkRealImage *img, irtkRealImage *coeffs)
+{
+  ParallelBSplineEvaluate evaluate(this, img, coeffs, false);
+  evaluate();
 }
 
 void irtkBSplineReconstruction::evaluateCoeffsOnImageLattice(irtkGreyImage *img, irtkRealImage *coeffs)
 {
-  int i, j, k;
-  double x, y, z;
-  int xdim, ydim, zdim;
+  ParallelBSplineEvaluate evaluate(this, img, coeffs, true);
+  evaluate();
+}
 
-  xdim = img->GetX();
-  ydim = img->GetY();
-  zdim = img->GetZ();
+// Compute the residuals of the voxels of each input image or package
+// and their cells in the lattice of control points.
+class ParallelBSplineResiduals {
+    irtkBSplineReconstruction *reconstructor;
+    int res;
+    vector<irtkRealImage> &input;
+    vector<irtkRigidTransformation> &transf;
+    vector<vector<BSPLINEPOINT> > &points;
 
-  for (k = 0; k < zdim; ++k){
-    for (j = 0; j < ydim; ++j){
-      for (i = 0; i < xdim; ++i){
-        x = i;
-        y = j;
-        z = k;
-        img->ImageToWorld(x, y, z);
-        img->Put(i, j, k, (int) round(getIntensity(coeffs, x, y, z)));
-      }
-    }
-  }
+public:
+    ParallelBSplineResiduals(irtkBSplineReconstruction *_reconstructor, int _res, vector<irtkRealImage> &_input,
+                             vector<irtkRigidTransformation> &_transf, vector<vector<BSPLINEPOINT> > &_points) :
+    reconstructor(_reconstructor), res(_res), input(_input), transf(_transf), points(_points) { }
 
-}
+    void operator() (const blocked_range<size_t> &r) const {
+        int xi, yi, zi, xdim, ydim, zdim;
+        double xw, yw, zw;
+        BSPLINEPOINT p;
 
-void irtkBSplineReconstruction::estimateCoeffs(int res, vector<irtkRealImage>& _input, vector<irtkRigidTransformation>& _transf)
-{
-  int i, j, k, l, m, n, inputIndex;
-  int I, J, K;
-  int xi, yi, zi, xdim, ydim, zdim;
-  int inputXdim, inputYdim, inputZdim;
-  double xw, yw, zw;
-  double s, t, u;
-  double value, phi, b, norm, tmp;
+        irtkRealImage *coeffs = reconstructor->_coeffs[res];
+        xdim = coeffs->GetX();
+        ydim = coeffs->GetY();
+        zdim = coeffs->GetZ();
 
-  xdim = _coeffs[res]->GetX();
-  ydim = _coeffs[res]->GetY();
-  zdim = _coeffs[res]->GetZ();
+        for ( size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex ) {
+            irtkRealImage &image = input[inputIndex];
+            points[inputIndex].clear();
 
-  cout << "Coefficients at level " << res + 1 << endl;
-  cout << "Dimensions : " << xdim << ", " << ydim << ", " << zdim << endl;
+            for (zi = 0; zi < image.GetZ(); ++zi){
+                for (yi = 0; yi < image.GetY(); ++yi){
+                    for (xi = 0; xi < image.GetX(); ++xi){
 
-  irtkRealPixel lo, hi;
-  _coeffs[res]->GetMinMax(&lo, &hi);
-  cout << "Min and max: " << lo << " " << hi << endl;
+                        if (image.Get(xi, yi, zi) > reconstructor->_padding){
 
+                            xw = xi;
+                            yw = yi;
+                            zw = zi;
 
-  // Loop over input images or packages.
-  for (inputIndex = 0; inputIndex < _inputCount; ++inputIndex){
+                            image.ImageToWorld(xw, yw, zw);
+                            transf[inputIndex].Transform(xw, yw, zw);
+
+                            p.value = image.Get(xi, yi, zi);
+                            p.value -= reconstructor->getIntensity(coeffs, xw, yw, zw);
 
-    //cout << "Using image " << _input_name[inputIndex];
-    //cout << " with " << _dof_name[inputIndex] << " ... ";
-    //cout.flush();
+                            coeffs->WorldToImage(xw, yw, zw);
 
-    inputXdim = _input[inputIndex].GetX();
-    inputYdim = _input[inputIndex].GetY();
-    inputZdim = _input[inputIndex].GetZ();
+                            p.l = (int)floor(xw);
+                            p.m = (int)floor(yw);
+                            p.n = (int)floor(zw);
 
-    // Loop over current input packages voxels.
-    for (zi = 0; zi < inputZdim; ++zi){
-      for (yi = 0; yi < inputYdim; ++yi){
-        for (xi = 0; xi < inputXdim; ++xi){
-	  
-	  if (_input[inputIndex].Get(xi, yi, zi) > _padding)
-	  {
+                            if (p.l-1 < 0 || p.m-1 < 0 || p.n-1 < 0)
+                                continue;
 
-            xw = xi;
-            yw = yi;
-            zw = zi;
+                            if (p.l+3 > xdim || p.m+3 > ydim || p.n+3 > zdim)
+                                continue;
 
-            _input[inputIndex].ImageToWorld(xw, yw, zw);
-            _transf[inputIndex].Transform(xw, yw, zw);
+                            p.s = xw - p.l;
+                            p.t = yw - p.m;
+                            p.u = zw - p.n;
+
+                            points[inputIndex].push_back(p);
+                        }
+                    }
+                }
+            }
+        }
+    }
 
-            value = _input[inputIndex].Get(xi, yi, zi);
-            value -= getIntensity(_coeffs[res], xw, yw, zw);
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, input.size()), *this );
+        init.terminate();
+    }
+};
 
-            _coeffs[res]->WorldToImage(xw, yw, zw);
+// Accumulate the points of every other slab into numerators and
+// denominators of the control points. The points of a slab only affect
+// the control points of the slab and of its neighbours, so slabs of the
+// same parity can be processed in parallel without locking.
+class ParallelBSplineAccumulate {
+    irtkBSplineReconstruction *reconstructor;
+    int res;
+    int parity;
 
-            l = (int)floor(xw);
-            m = (int)floor(yw);
-            n = (int)floor(zw);
+public:
+    ParallelBSplineAccumulate(irtkBSplineReconstruction *_reconstructor, int _res, int _parity) :
+    reconstructor(_reconstructor), res(_res), parity(_parity) { }
 
-            if (l-1 < 0 || m-1 < 0 || n-1 < 0)
-              continue;
+    void operator() (const blocked_range<size_t> &r) const {
+        int i, j, k, p, slab;
+        double bx[4], by[4], bz[4];
+        double norm, phi, b, byz;
+        irtkRealPixel *dx, *weights;
 
-            if (l+3 > xdim || m+3 > ydim || n+3 > zdim)
-              continue;
+        for ( size_t ind = r.begin(); ind != r.end(); ++ind ) {
+            slab = 2 * ind + parity;
 
-            s = xw - l;
-            t = yw - m;
-            u = zw - n;
+            for (p = reconstructor->_slabs[slab]; p < reconstructor->_slabs[slab+1]; ++p){
+                const BSPLINEPOINT &point = reconstructor->_points[p];
 
-            norm = 0;
-            for (k = 0; k < 4; ++k){
-              for (j = 0; j < 4; ++j){
                 for (i = 0; i < 4; ++i){
-                  tmp   = Bsp(i, s) * Bsp(j, t) * Bsp(k, u);
-                  norm += tmp * tmp;
+                    bx[i] = reconstructor->Bsp(i, point.s);
+                    by[i] = reconstructor->Bsp(i, point.t);
+                    bz[i] = reconstructor->Bsp(i, point.u);
                 }
-              }
-            }
 
-            for (k = 0; k < 4; ++k){
-              K = n + k - 1;
-              for (j = 0; j < 4; ++j){
-                J = m + j - 1;
-                for (i = 0; i < 4; ++i){
-                  I = l + i - 1;
+                // The sum of squares of the tensor-product weights is separable
+                norm = (bx[0]*bx[0] + bx[1]*bx[1] + bx[2]*bx[2] + bx[3]*bx[3]) *
+                       (by[0]*by[0] + by[1]*by[1] + by[2]*by[2] + by[3]*by[3]) *
+                       (bz[0]*bz[0] + bz[1]*bz[1] + bz[2]*bz[2] + bz[3]*bz[3]);
+                phi = point.value / norm;
+
+                for (k = 0; k < 4; ++k){
+                    for (j = 0; j < 4; ++j){
+                        byz = by[j] * bz[k];
+                        dx      = reconstructor->_dx[res]->GetPointerToVoxels(point.l - 1, point.m + j - 1, point.n + k - 1);
+                        weights = reconstructor->_weights[res]->GetPointerToVoxels(point.l - 1, point.m + j - 1, point.n + k - 1);
+                        for (i = 0; i < 4; ++i){
+                            b = bx[i] * byz;
+                            dx[i]      += b * b * b * phi;
+                            weights[i] += b * b;
+                        }
+                    }
+                }
+            }
+        }
+    }
 
-                  b = Bsp(i, s) * Bsp(j, t) * Bsp(k, u);
-                  phi = value * b / norm;
+    // execute
+    void operator() () const {
+        int slabs = reconstructor->_slabs.size() - 1;
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, (slabs + 1 - parity) / 2), *this );
+        init.terminate();
+    }
+};
 
-                  _dx[res]->Put(I, J, K,
-                                _dx[res]->Get(I, J, K)  + b * b * phi);
+void irtkBSplineReconstruction::estimateCoeffs(int res, vector<irtkRealImage>& _input, vector<irtkRigidTransformation>& _transf)
+{
+  int i, n, slab, slabs, inputIndex;
+  int xdim, ydim, zdim;
+  irtkRealPixel *coeffs, *dx, *weights;
 
-                  _weights[res]->Put(I, J, K,
-                                     _weights[res]->Get(I, J, K) + b * b);
+  xdim = _coeffs[res]->GetX();
+  ydim = _coeffs[res]->GetY();
+  zdim = _coeffs[res]->GetZ();
 
-                }
-              }
-            } 
-	  }
-        }
-      }
-    }
-    //cout << " done." << endl;
-  }
+  cout << "Coefficients at level " << res + 1 << endl;
+  cout << "Dimensions : " << xdim << ", " << ydim << ", " << zdim << endl;
 
-  for (zi = 0; zi < zdim; ++zi){
-    for (yi = 0; yi < ydim; ++yi){
-      for (xi = 0; xi < xdim; ++xi){
+  irtkRealPixel lo, hi;
+  _coeffs[res]->GetMinMax(&lo, &hi);
+  cout << "Min and max: " << lo << " " << hi << endl;
 
-        if (_weights[res]->Get(xi, yi, zi) > 0){
-          value = _coeffs[res]->Get(xi, yi, zi) +
-            (_dx[res]->Get(xi, yi, zi) / _weights[res]->Get(xi, yi, zi));
+  // Residuals of the voxels of the input images or packages.
+  vector<vector<BSPLINEPOINT> > points(_inputCount);
+  ParallelBSplineResiduals residuals(this, res, _input, _transf, points);
+  residuals();
 
-          _coeffs[res]->Put(xi, yi, zi, value);
-        }
+  // Sort points into slabs of BSPLINE_SLAB control points along z,
+  // keeping the order of the input voxels within each slab.
+  slabs = (zdim + BSPLINE_SLAB - 1) / BSPLINE_SLAB;
+  _slabs.assign(slabs + 1, 0);
+  for (inputIndex = 0; inputIndex < _inputCount; ++inputIndex){
+    for (i = 0; i < (int)points[inputIndex].size(); ++i){
+      _slabs[points[inputIndex][i].n / BSPLINE_SLAB + 1]++;
+    }
+  }
+  for (slab = 0; slab < slabs; ++slab){
+    _slabs[slab + 1] += _slabs[slab];
+  }
+  vector<int> next(_slabs.begin(), _slabs.end() - 1);
+  _points.resize(_slabs[slabs]);
+  for (inputIndex = 0; inputIndex < _inputCount; ++inputIndex){
+    for (i = 0; i < (int)points[inputIndex].size(); ++i){
+      _points[next[points[inputIndex][i].n / BSPLINE_SLAB]++] = points[inputIndex][i];
+    }
+    vector<BSPLINEPOINT>().swap(points[inputIndex]);
+  }
 
-      }
+  // Even slabs first, then odd slabs.
+  ParallelBSplineAccumulate even(this, res, 0);
+  even();
+  ParallelBSplineAccumulate odd(this, res, 1);
+  odd();
+  vector<BSPLINEPOINT>().swap(_points);
+
+  coeffs  = _coeffs[res]->GetPointerToVoxels();
+  dx      = _dx[res]->GetPointerToVoxels();
+  weights = _weights[res]->GetPointerToVoxels();
+  n = _coeffs[res]->GetNumberOfVoxels();
+  for (i = 0; i < n; ++i){
+    if (weights[i] > 0){
+      coeffs[i] += dx[i] / weights[i];
     }
   }
   cout<<"Finished estimating coeff at level"<<res+1<<"."<<endl;
@@ -48,6 +48,7 @@ irtkLaplacianSmoothing::irtkLaplacianSmoothing()
   _rel_diff_threshold=0.0001;
   _relax_iter=5;
   _boundary_weight=0.4;
+  _debug=false;
 }
 
 void irtkLaplacianSmoothing::InitializeFactors()
@@ -123,7 +124,7 @@ void irtkLaplacianSmoothing::SetMask(irtkRealImage mask)
 {
   ResampleOnGrid(mask,_image);
   _mask = mask;
-  _mask.Write("_mask_LaplacianSmoothing.nii.gz");
+  if (_debug) _mask.Write("_mask_LaplacianSmoothing.nii.gz");
 }
 
 void irtkLaplacianSmoothing::EnlargeImage(irtkRealImage &image)
@@ -200,518 +201,445 @@ void irtkLaplacianSmoothing::CalculateBoundary(irtkRealImage& m)
           }
 }
 
-void irtkLaplacianSmoothing::CalculateBoundaryWeights(irtkRealImage& w, irtkRealImage m)
-{
-    int x, y, z, xx, yy, zz,i;
-    double sum;
-
-    int dx = m.GetX();
-    int dy = m.GetY();
-    int dz = m.GetZ();
-    
-    for (x = 0; x < dx; x++)
-      for (y = 0; y < dy; y++)
-        for (z = 0; z < dz; z++) 
-	  if(m(x,y,z)==2)
-	  {
-	    sum=0;
-            for (i = 0; i < 13; i++) {
-              xx = x + _directions[i][0];
-              yy = y + _directions[i][1];
-              zz = z + _directions[i][2];
-              if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	        if (m(xx,yy,zz)==2)
-		  sum += _factor[i];
-	    }
 
-            for (i = 0; i < 13; i++) {
-              xx = x - _directions[i][0];
-              yy = y - _directions[i][1];
-              zz = z - _directions[i][2];
-              if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	        if (m(xx,yy,zz)==2)
-		  sum += _factor[i];
-	    }
-	    w(x,y,z)=sum;
-          }
-}
+//damping of Jacobi relaxation and number of sweeps on each and on the coarsest level
+static const double _LaplacianJacobiDamping = 0.6;
+static const int _LaplacianSweeps = 2;
+static const int _LaplacianCoarsestSweeps = 40;
 
+//maximum number of iterations of conjugate gradients and number of iterations
+//over which the residual has to decrease by the relative difference threshold
+static const int _LaplacianMaxIterations = 500;
+static const int _LaplacianStagnation = 10;
 
-
-double irtkLaplacianSmoothing::LaplacianImage(irtkRealImage image, irtkRealImage m, irtkRealImage& laplacian)
+//index n of neighbour i of the 26-neighbourhood, false if it is outside the image or the mask
+static inline bool LaplacianNeighbour(const irtkLaplacianLevel& level, const int directions[13][3], int i, int x, int y, int z, int& n)
 {
-    //cout << "Diffusion Regularization" << endl;
-    
-    irtkRealImage original = image;
-    laplacian=0;
-
-    int dx = image.GetX();
-    int dy = image.GetY();
-    int dz = image.GetZ();
-
-    int x, y, z, xx, yy, zz;
-    double val,sum,diff;
-    double laplacian_value=0;
-    int i,count=0;
-            
-    for (x = 0; x < dx; x++)
-      for (y = 0; y < dy; y++)
-        for (z = 0; z < dz; z++) 
-	  if(m(x,y,z)==1)
-	  {                    
-            val = 0;
-            sum = 0;
-            for (i = 0; i < 13; i++) {
-              xx = x + _directions[i][0];
-              yy = y + _directions[i][1];
-              zz = z + _directions[i][2];
-              if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	      {
-                val += _factor[i] * original(xx, yy, zz);
-	        sum += _factor[i];
-              }
-            }
-
-            for (i = 0; i < 13; i++) {
-              xx = x - _directions[i][0];
-              yy = y - _directions[i][1];
-              zz = z - _directions[i][2];
-              if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	      {
-                val += _factor[i] * original(xx, yy, zz);
-	        sum += _factor[i];
-              }
-            }
-          
-            if(sum>0.99)//we are inside because all neigbours exist
-            {
-	      diff = original(x,y,z)-val;
-	      laplacian(x,y,z)=diff;
-	      laplacian_value+=0.5*diff*diff;
-	      count++;
-	    }
-	    else
-	    {
-	      cerr<<"Warning: LaplacianImage: sum<=0.99, this should not happen!";
-	    }
-	  }
-    cout<<"Average Laplacian is "<<laplacian_value/count<<" ";
-    return laplacian_value/count;
+  int s = (i < 13) ? 1 : -1;
+  int xx = x + s*directions[i%13][0];
+  int yy = y + s*directions[i%13][1];
+  int zz = z + s*directions[i%13][2];
+  if ((xx < 0) || (xx >= level._x) || (yy < 0) || (yy >= level._y) || (zz < 0) || (zz >= level._z))
+    return false;
+  n = (zz*level._y + yy)*level._x + xx;
+  return level._mask[n] > 0;
 }
 
-double irtkLaplacianSmoothing::LaplacianBoundary(irtkRealImage image, irtkRealImage m, irtkRealImage& laplacian)
+//whether Laplacian row of voxel with mask mx includes neighbour with mask my
+static inline bool LaplacianIncludes(const irtkLaplacianLevel& level, char mx, char my)
 {
-    irtkRealImage original = image;
+  return level._coarse || (mx == 1) || (my == 2);
+}
 
-    int dx = image.GetX();
-    int dy = image.GetY();
-    int dz = image.GetZ();
+class ParallelLaplacianRows {
+    irtkLaplacianLevel &level;
+    const vector<double> &v;
+
+public:
+    ParallelLaplacianRows( irtkLaplacianLevel &_level, const vector<double> &_v ) :
+    level(_level), v(_v) { }
+
+    void operator() (const blocked_range<size_t> &r) const {
+        int i, m, m1, m2, bits;
+        double val;
+        m1 = r.begin()*level._x*level._y;
+        m2 = r.end()*level._x*level._y;
+        for ( m = m1; m < m2; m++ ) {
+          bits = level._rows[m];
+          if (bits == 0) {
+            level._u[m] = (level._norm[m] > 0) ? v[m] : 0;
+            continue;
+          }
+          val = 0;
+          for (i = 0; i < 26; i++)
+            if (bits & (1 << i))
+              val += level._factor[i] * v[m + level._offset[i]];
+          level._u[m] = v[m] - level._norm[m] * val;
+        }
+    }
 
-    int x, y, z, xx, yy, zz;
-    double val,sum,diff;
-    double laplacian_value=0;
-    int i,count=0;
-            
-    for (x = 0; x < dx; x++)
-      for (y = 0; y < dy; y++)
-        for (z = 0; z < dz; z++) 
-	  if(m(x,y,z)==2)
-	  {                    
-            val = 0;
-            sum = 0;
-            for (i = 0; i < 13; i++) {
-              xx = x + _directions[i][0];
-              yy = y + _directions[i][1];
-              zz = z + _directions[i][2];
-              if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-		if(m(xx,yy,zz)==2)
-	        {
-                  val += _factor[i] * original(xx, yy, zz);
-	          sum += _factor[i];
-                }
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, level._z), *this );
+        init.terminate();
+    }
+};
+
+class ParallelLaplacianOperator {
+    irtkLaplacianLevel &level;
+    const vector<double> &v;
+    vector<double> &out;
+
+public:
+    ParallelLaplacianOperator( irtkLaplacianLevel &_level, const vector<double> &_v, vector<double> &_out ) :
+    level(_level), v(_v), out(_out) { }
+
+    void operator() (const blocked_range<size_t> &r) const {
+        int i, m, m1, m2, bits;
+        double val;
+        m1 = r.begin()*level._x*level._y;
+        m2 = r.end()*level._x*level._y;
+        for ( m = m1; m < m2; m++ ) {
+          if (level._mask[m] == 0) {
+            out[m] = 0;
+            continue;
+          }
+          //transpose of Laplacian gathered from the rows which include this voxel
+          bits = level._columns[m];
+          val = 0;
+          for (i = 0; i < 26; i++)
+            if (bits & (1 << i)) {
+              int n = m + level._offset[i];
+              val += level._factor[i] * level._lambda[n] * level._norm[n] * level._u[n];
             }
+          out[m] = level._data[m] * v[m] + level._lambda[m] * level._u[m] - val;
+        }
+    }
 
-            for (i = 0; i < 13; i++) {
-              xx = x - _directions[i][0];
-              yy = y - _directions[i][1];
-              zz = z - _directions[i][2];
-              if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-		if(m(xx,yy,zz)==2)
-	        {
-                  val += _factor[i] * original(xx, yy, zz);
-	          sum += _factor[i];
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, level._z), *this );
+        init.terminate();
+    }
+};
+
+//weight of fine voxel 2*I+d for coarse voxel I, d = -1 to 2
+static const double _LaplacianTransfer[4] = { 0.25, 0.75, 0.75, 0.25 };
+
+class ParallelLaplacianRestrict {
+    irtkLaplacianLevel &fine;
+    irtkLaplacianLevel &coarse;
+
+public:
+    ParallelLaplacianRestrict( irtkLaplacianLevel &_fine, irtkLaplacianLevel &_coarse ) :
+    fine(_fine), coarse(_coarse) { }
+
+    void operator() (const blocked_range<size_t> &r) const {
+        int x, y, z, i, j, k, xx, yy, zz, m;
+        double val;
+        for ( z = (int)r.begin(); z != (int)r.end(); ++z )
+          for ( y = 0; y < coarse._y; y++ )
+            for ( x = 0; x < coarse._x; x++ ) {
+              m = (z*coarse._y + y)*coarse._x + x;
+              coarse._b[m] = 0;
+              if (coarse._mask[m] == 0)
+                continue;
+              val = 0;
+              for (k = 0; k < 4; k++) {
+                zz = 2*z + k - 1;
+                if ((zz < 0) || (zz >= fine._z)) continue;
+                for (j = 0; j < 4; j++) {
+                  yy = 2*y + j - 1;
+                  if ((yy < 0) || (yy >= fine._y)) continue;
+                  for (i = 0; i < 4; i++) {
+                    xx = 2*x + i - 1;
+                    if ((xx < 0) || (xx >= fine._x)) continue;
+                    val += _LaplacianTransfer[i] * _LaplacianTransfer[j] * _LaplacianTransfer[k] * fine._r[(zz*fine._y + yy)*fine._x + xx];
+                  }
                 }
+              }
+              coarse._b[m] = val;
             }
-          
-            if(sum>0)//we are inside because all neigbours exist
-            {
-	      val/=sum;
-	      diff = original(x,y,z)-val;
-	      laplacian(x,y,z)=diff;
-	      laplacian_value+=0.5*diff*diff;
-	      count++;
-	    }
-	    else
-	    {
-	      cerr<<"Warning: LaplacianBoundary: sum=0, this should not happen!";
-	    }
-	  }
-    cout<<"Average Laplacian on boundary is "<<laplacian_value/count<<" ";
-    return laplacian_value/count;
-}
-
-void irtkLaplacianSmoothing::UpdateFieldmapGD(irtkRealImage& fieldmap, irtkRealImage image, irtkRealImage laplacian, irtkRealImage mask, irtkRealImage weights, double alpha, double lambda1, double lambda2)
-{
-    
-  irtkRealImage original = fieldmap;
-  fieldmap = 0;
-
-  int dx = image.GetX();
-  int dy = image.GetY();
-  int dz = image.GetZ();
+    }
 
-  int x, y, z, xx, yy, zz,i;
-  double sum;
-   
-  for (x = 0; x < dx; x++)
-    for (y = 0; y < dy; y++)
-      for (z = 0; z < dz; z++) 
-	if(mask(x,y,z)>0)
-	{
-          sum = 0;
-          for (i = 0; i < 13; i++) {
-            xx = x + _directions[i][0];
-            yy = y + _directions[i][1];
-            zz = z + _directions[i][2];
-            if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	    {
-	      if (mask(xx,yy,zz)==1)
-	      {
-	        sum += lambda1*_factor[i]*laplacian(xx,yy,zz);
-              }
-	      if ((mask(xx,yy,zz)==2)&&(mask(x,y,z)==2))
-	      {
-	        sum += lambda2*_factor[i]*laplacian(xx,yy,zz)/weights(x,y,z);
-              }
-	    }
-          }
-          for (i = 0; i < 13; i++) {
-            xx = x - _directions[i][0];
-            yy = y - _directions[i][1];
-            zz = z - _directions[i][2];
-            if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	    {
-	      if (mask(xx,yy,zz)==1)
-	      {
-	        sum += lambda1*_factor[i]*laplacian(xx,yy,zz);
-              }
-	      if ((mask(xx,yy,zz)==2)&&(mask(x,y,z)==2))
-	      {
-	        sum += lambda2*_factor[i]*laplacian(xx,yy,zz)/weights(x,y,z);
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, coarse._z), *this );
+        init.terminate();
+    }
+};
+
+class ParallelLaplacianProlongate {
+    irtkLaplacianLevel &fine;
+    irtkLaplacianLevel &coarse;
+
+public:
+    ParallelLaplacianProlongate( irtkLaplacianLevel &_fine, irtkLaplacianLevel &_coarse ) :
+    fine(_fine), coarse(_coarse) { }
+
+    void operator() (const blocked_range<size_t> &r) const {
+        int x, y, z, i, j, k, xx[2], yy[2], zz[2], m;
+        double wx[2], wy[2], wz[2], val;
+        for ( z = (int)r.begin(); z != (int)r.end(); ++z ) {
+          //nearest coarse voxel and its neighbour towards this fine voxel
+          zz[0] = z/2; zz[1] = (z%2 == 0) ? z/2 - 1 : z/2 + 1;
+          wz[0] = 0.75; wz[1] = 0.25;
+          for ( y = 0; y < fine._y; y++ ) {
+            yy[0] = y/2; yy[1] = (y%2 == 0) ? y/2 - 1 : y/2 + 1;
+            wy[0] = 0.75; wy[1] = 0.25;
+            for ( x = 0; x < fine._x; x++ ) {
+              m = (z*fine._y + y)*fine._x + x;
+              if (fine._mask[m] == 0)
+                continue;
+              xx[0] = x/2; xx[1] = (x%2 == 0) ? x/2 - 1 : x/2 + 1;
+              wx[0] = 0.75; wx[1] = 0.25;
+              val = 0;
+              for (k = 0; k < 2; k++) {
+                if ((zz[k] < 0) || (zz[k] >= coarse._z)) continue;
+                for (j = 0; j < 2; j++) {
+                  if ((yy[j] < 0) || (yy[j] >= coarse._y)) continue;
+                  for (i = 0; i < 2; i++) {
+                    if ((xx[i] < 0) || (xx[i] >= coarse._x)) continue;
+                    val += wx[i] * wy[j] * wz[k] * coarse._e[(zz[k]*coarse._y + yy[j])*coarse._x + xx[i]];
+                  }
+                }
               }
-	    }
+              fine._e[m] += val;
+            }
           }
-          
-          if(mask(x,y,z)==1)
-	    fieldmap(x,y,z)=(1-alpha)*original(x,y,z)+alpha*image(x,y,z)-alpha*lambda1*laplacian(x,y,z)+alpha*sum;
-	  if(mask(x,y,z)==2)
-            fieldmap(x,y,z)=original(x,y,z)-alpha*lambda2*laplacian(x,y,z)+alpha*sum;  
-	}    
-}
+        }
+    }
 
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, fine._z), *this );
+        init.terminate();
+    }
+};
 
-void irtkLaplacianSmoothing::LLaplacian(irtkRealImage& llaplacian, irtkRealImage laplacian, irtkRealImage mask, irtkRealImage weights)
+void irtkLaplacianSmoothing::BuildLevels(const irtkRealImage& mask, double lambda1, double lambda2)
 {
-    
-  llaplacian = 0;
+  int x, y, z, i, j, n, m, l;
+  double sum;
 
-  int dx = llaplacian.GetX();
-  int dy = llaplacian.GetY();
-  int dz = llaplacian.GetZ();
+  _levels.clear();
+
+  //finest level is the problem solved by SmoothGD
+  irtkLaplacianLevel fine;
+  fine._x = mask.GetX();
+  fine._y = mask.GetY();
+  fine._z = mask.GetZ();
+  fine._coarse = false;
+  fine._lambda1 = lambda1;
+  fine._lambda2 = lambda2;
+  fine._mask.resize(fine._x*fine._y*fine._z);
+  fine._data.resize(fine._mask.size());
+  for (z = 0; z < fine._z; z++)
+    for (y = 0; y < fine._y; y++)
+      for (x = 0; x < fine._x; x++) {
+        m = (z*fine._y + y)*fine._x + x;
+        fine._mask[m] = (mask(x,y,z) == 1) ? 1 : ((mask(x,y,z) == 2) ? 2 : 0);
+        fine._data[m] = (fine._mask[m] == 1) ? 1 : 0;
+      }
+  _levels.push_back(fine);
+
+  //coarser levels until the image is small
+  while ((_levels.back()._x >= 6) && (_levels.back()._y >= 6) && (_levels.back()._z >= 6)) {
+    const irtkLaplacianLevel& f = _levels.back();
+    irtkLaplacianLevel c;
+    c._x = (f._x + 1)/2;
+    c._y = (f._y + 1)/2;
+    c._z = (f._z + 1)/2;
+    c._coarse = true;
+    c._lambda1 = f._lambda1/2;
+    c._lambda2 = f._lambda2/2;
+    c._mask.assign(c._x*c._y*c._z, 0);
+    c._data.assign(c._mask.size(), 0);
+    for (z = 0; z < f._z; z++)
+      for (y = 0; y < f._y; y++)
+        for (x = 0; x < f._x; x++) {
+          m = (z*f._y + y)*f._x + x;
+          n = ((z/2)*c._y + y/2)*c._x + x/2;
+          if ((f._mask[m] == 1) || ((f._mask[m] == 2) && (c._mask[n] == 0)))
+            c._mask[n] = f._mask[m];
+          c._data[n] += f._data[m];
+        }
+    _levels.push_back(c);
+  }
 
-  int x, y, z, xx, yy, zz,i;
-  double sum;
-   
-  for (x = 0; x < dx; x++)
-    for (y = 0; y < dy; y++)
-      for (z = 0; z < dz; z++) 
-	if(mask(x,y,z)>0)
-	{
+  //stencil, normalisation of rows, diagonal of operator and work space
+  for (l = 0; l < (int)_levels.size(); l++) {
+    irtkLaplacianLevel& level = _levels[l];
+    for (i = 0; i < 26; i++) {
+      j = (i < 13) ? 1 : -1;
+      level._offset[i] = j*((_directions[i%13][2]*level._y + _directions[i%13][1])*level._x + _directions[i%13][0]);
+      level._factor[i] = _factor[i%13];
+    }
+    level._rows.assign(level._mask.size(), 0);
+    level._columns.assign(level._mask.size(), 0);
+    level._norm.assign(level._mask.size(), 0);
+    level._lambda.assign(level._mask.size(), 0);
+    level._diag.assign(level._mask.size(), 0);
+    level._b.assign(level._mask.size(), 0);
+    level._e.assign(level._mask.size(), 0);
+    level._r.assign(level._mask.size(), 0);
+    level._u.assign(level._mask.size(), 0);
+    for (z = 0; z < level._z; z++)
+      for (y = 0; y < level._y; y++)
+        for (x = 0; x < level._x; x++) {
+          m = (z*level._y + y)*level._x + x;
+          if (level._mask[m] == 0)
+            continue;
           sum = 0;
-          for (i = 0; i < 13; i++) {
-            xx = x + _directions[i][0];
-            yy = y + _directions[i][1];
-            zz = z + _directions[i][2];
-            if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	    {
-	      if (mask(xx,yy,zz)==1)
-	      {
-	        sum += _factor[i]*laplacian(xx,yy,zz);
+          for (i = 0; i < 26; i++)
+            if (LaplacianNeighbour(level, _directions, i, x, y, z, n)) {
+              if (LaplacianIncludes(level, level._mask[m], level._mask[n])) {
+                level._rows[m] |= 1 << i;
+                sum += level._factor[i];
               }
-	      if ((mask(xx,yy,zz)==2)&&(mask(x,y,z)==2))
-	      {
-	        sum += _factor[i]*laplacian(xx,yy,zz)/weights(x,y,z);
-              }
-	    }
-          }
-          for (i = 0; i < 13; i++) {
-            xx = x - _directions[i][0];
-            yy = y - _directions[i][1];
-            zz = z - _directions[i][2];
-            if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	    {
-	      if (mask(xx,yy,zz)==1)
-	      {
-	        sum += _factor[i]*laplacian(xx,yy,zz);
-              }
-	      if ((mask(xx,yy,zz)==2)&&(mask(x,y,z)==2))
-	      {
-	        sum += _factor[i]*laplacian(xx,yy,zz)/weights(x,y,z);
-              }
-	    }
-          }
-          
-	    llaplacian(x,y,z)=laplacian(x,y,z)-sum;
-	}    
+              if (LaplacianIncludes(level, level._mask[n], level._mask[m]))
+                level._columns[m] |= 1 << i;
+            }
+          //interior rows of the finest level are not normalised
+          if (!level._coarse && (level._mask[m] == 1))
+            level._norm[m] = 1;
+          else if (sum > 0)
+            level._norm[m] = 1/sum;
+          if (level._norm[m] > 0)
+            level._lambda[m] = (level._mask[m] == 1) ? level._lambda1 : level._lambda2;
+        }
+    for (m = 0; m < (int)level._mask.size(); m++) {
+      if (level._mask[m] == 0)
+        continue;
+      level._diag[m] = level._data[m] + level._lambda[m];
+      for (i = 0; i < 26; i++)
+        if (level._columns[m] & (1 << i)) {
+          n = m + level._offset[i];
+          level._diag[m] += level._lambda[n] * level._norm[n] * level._factor[i] * level._norm[n] * level._factor[i];
+        }
+    }
+  }
 }
 
-
-void irtkLaplacianSmoothing::UpdateFieldmap(irtkRealImage& fieldmap, irtkRealImage image, irtkRealImage multipliers, irtkRealImage mask, irtkRealImage weights, double alpha)
+void irtkLaplacianSmoothing::ApplyOperator(int l, const vector<double>& v, vector<double>& out)
 {
-    
-  irtkRealImage original = fieldmap;
-  fieldmap = 0;
-
-  int dx = image.GetX();
-  int dy = image.GetY();
-  int dz = image.GetZ();
-
-  int x, y, z, xx, yy, zz,i;
-  double sum;
-   
-  for (x = 0; x < dx; x++)
-    for (y = 0; y < dy; y++)
-      for (z = 0; z < dz; z++) 
-	if(mask(x,y,z)>0)
-	{
-          sum = 0;
-          for (i = 0; i < 13; i++) {
-            xx = x + _directions[i][0];
-            yy = y + _directions[i][1];
-            zz = z + _directions[i][2];
-            if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	    {
-	      if (mask(xx,yy,zz)==1)
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz);
-              }
-	      if ((mask(xx,yy,zz)==2)&&(mask(x,y,z)==2))
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz)/weights(x,y,z);
-              }
-	    }
-          }
-          for (i = 0; i < 13; i++) {
-            xx = x - _directions[i][0];
-            yy = y - _directions[i][1];
-            zz = z - _directions[i][2];
-            if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	    {
-	      if (mask(xx,yy,zz)==1)
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz);
-              }
-	      if ((mask(xx,yy,zz)==2)&&(mask(x,y,z)==2))
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz)/weights(x,y,z);
-              }
-	    }
-          }
-          
-          if(mask(x,y,z)==1)
-	    fieldmap(x,y,z)=(1-alpha)*original(x,y,z)+alpha*image(x,y,z)-alpha*multipliers(x,y,z)+alpha*sum;
-	  if(mask(x,y,z)==2)
-            fieldmap(x,y,z)=original(x,y,z)-alpha*multipliers(x,y,z)+alpha*sum;  
-	}    
+  ParallelLaplacianRows rows(_levels[l], v);
+  rows();
+  ParallelLaplacianOperator op(_levels[l], v, out);
+  op();
 }
 
-
-void irtkLaplacianSmoothing::UpdateFieldmapWithThreshold(irtkRealImage& fieldmap, irtkRealImage image, irtkRealImage multipliers, 
-		    irtkRealImage mask, irtkRealImage weights, double alpha, double threshold)
+void irtkLaplacianSmoothing::Relax(int l, vector<double>& x, const vector<double>& b, int sweeps)
 {
-    
-  irtkRealImage original = fieldmap;
-  irtkRealImage tr_mask = fieldmap;
-  tr_mask = 0;
-  fieldmap = 0;
-
-  int dx = image.GetX();
-  int dy = image.GetY();
-  int dz = image.GetZ();
+  irtkLaplacianLevel& level = _levels[l];
+  for (int s = 0; s < sweeps; s++) {
+    ApplyOperator(l, x, level._r);
+    for (size_t m = 0; m < x.size(); m++)
+      if (level._diag[m] > 0)
+        x[m] += _LaplacianJacobiDamping * (b[m] - level._r[m]) / level._diag[m];
+  }
+}
 
-  int x, y, z, xx, yy, zz,i;
-  double sum,diff;
-   
-  for (x = 0; x < dx; x++)
-    for (y = 0; y < dy; y++)
-      for (z = 0; z < dz; z++) 
-	if(mask(x,y,z)>0)
-	{
-          sum = 0;
-          for (i = 0; i < 13; i++) {
-            xx = x + _directions[i][0];
-            yy = y + _directions[i][1];
-            zz = z + _directions[i][2];
-            if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	    {
-	      if (mask(xx,yy,zz)==1)
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz);
-              }
-	      if ((mask(xx,yy,zz)==2)&&(mask(x,y,z)==2))
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz)/weights(x,y,z);
-              }
-	    }
-          }
-          for (i = 0; i < 13; i++) {
-            xx = x - _directions[i][0];
-            yy = y - _directions[i][1];
-            zz = z - _directions[i][2];
-            if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	    {
-	      if (mask(xx,yy,zz)==1)
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz);
-              }
-	      if ((mask(xx,yy,zz)==2)&&(mask(x,y,z)==2))
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz)/weights(x,y,z);
-              }
-	    }
-          }
-          
-          diff=original(x,y,z)-image(x,y,z);
-          if(mask(x,y,z)==1)
-	  {
-	    if(fabs(diff)<=threshold)
-	    {
-	      fieldmap(x,y,z)=(1-alpha)*original(x,y,z)+alpha*image(x,y,z)-alpha*multipliers(x,y,z)+alpha*sum;
-	      tr_mask(x,y,z)=1;
-	    }
-	    else
-	    {
-	      if(diff>threshold)
-	        fieldmap(x,y,z)=original(x,y,z)-alpha*threshold-alpha*multipliers(x,y,z)+alpha*sum;
-	      if(diff<-threshold)
-	        fieldmap(x,y,z)=original(x,y,z)+alpha*threshold-alpha*multipliers(x,y,z)+alpha*sum;
-	    }
-	  }
-	  if(mask(x,y,z)==2)
-            fieldmap(x,y,z)=original(x,y,z)-alpha*multipliers(x,y,z)+alpha*sum;  
-	}    
-	tr_mask.Write("tr_mask.nii.gz");
+void irtkLaplacianSmoothing::VCycle(int l)
+{
+  irtkLaplacianLevel& level = _levels[l];
+  size_t m;
+
+  //approximate solution of A e = b starting from zero
+  level._e.assign(level._e.size(), 0);
+  if (l == (int)_levels.size() - 1) {
+    Relax(l, level._e, level._b, _LaplacianCoarsestSweeps);
+    return;
+  }
+  Relax(l, level._e, level._b, _LaplacianSweeps);
+
+  //coarse grid correction
+  ApplyOperator(l, level._e, level._r);
+  for (m = 0; m < level._r.size(); m++)
+    level._r[m] = level._b[m] - level._r[m];
+  ParallelLaplacianRestrict restrict(level, _levels[l+1]);
+  restrict();
+  VCycle(l+1);
+  ParallelLaplacianProlongate prolongate(level, _levels[l+1]);
+  prolongate();
+
+  Relax(l, level._e, level._b, _LaplacianSweeps);
 }
 
-void irtkLaplacianSmoothing::UpdateFieldmapHuber(irtkRealImage& fieldmap, irtkRealImage image, irtkRealImage multipliers, 
-		    irtkRealImage mask, irtkRealImage weights, double alpha)
+int irtkLaplacianSmoothing::SolveSmoothness(irtkRealImage& fieldmap, const irtkRealImage& image, const irtkRealImage& mask, double lambda1, double lambda2)
 {
-    
-  irtkRealImage original = fieldmap;
-  irtkRealImage tr_mask = fieldmap;
-  tr_mask = 0;
-  fieldmap = 0;
+  int x, y, z, m, iter;
+  double rz, rz_new, pq, bb, rr, alpha, beta;
+  double history[_LaplacianStagnation];
+
+  if (_factor.size() == 0)
+    InitializeFactors();
+  BuildLevels(mask, lambda1, lambda2);
+
+  //conjugate gradients preconditioned by a multigrid V-cycle, starting from the image
+  irtkLaplacianLevel& fine = _levels[0];
+  int n = fine._mask.size();
+  vector<double> f(n), b(n), r(n), p(n), q(n);
+  for (z = 0; z < fine._z; z++)
+    for (y = 0; y < fine._y; y++)
+      for (x = 0; x < fine._x; x++) {
+        m = (z*fine._y + y)*fine._x + x;
+        f[m] = (fine._mask[m] > 0) ? image(x,y,z) : 0;
+        b[m] = fine._data[m] * image(x,y,z);
+      }
 
-  int dx = image.GetX();
-  int dy = image.GetY();
-  int dz = image.GetZ();
+  ApplyOperator(0, f, r);
+  bb = 0;
+  for (m = 0; m < n; m++) {
+    r[m] = b[m] - r[m];
+    bb += b[m]*b[m];
+  }
+  fine._b = r;
+  VCycle(0);
+  p = fine._e;
+  rz = 0;
+  for (m = 0; m < n; m++)
+    rz += r[m]*p[m];
+
+  rr = 0;
+  for (iter = 0; iter < _LaplacianMaxIterations; iter++) {
+    ApplyOperator(0, p, q);
+    pq = 0;
+    for (m = 0; m < n; m++)
+      pq += p[m]*q[m];
+    if (pq <= 0)
+      break;
+    alpha = rz/pq;
+    rr = 0;
+    for (m = 0; m < n; m++) {
+      f[m] += alpha*p[m];
+      r[m] -= alpha*q[m];
+      rr += r[m]*r[m];
+    }
+    //stop at the relative residual given by the Laplacian threshold, or when
+    //the residual stagnates by less than the relative difference threshold
+    if ((bb == 0) || (rr <= _lap_threshold*_lap_threshold*bb)) {
+      iter++;
+      break;
+    }
+    if ((iter >= _LaplacianStagnation) && (rr >= (1-_rel_diff_threshold)*(1-_rel_diff_threshold)*history[iter%_LaplacianStagnation])) {
+      iter++;
+      break;
+    }
+    history[iter%_LaplacianStagnation] = rr;
+    fine._b = r;
+    VCycle(0);
+    rz_new = 0;
+    for (m = 0; m < n; m++)
+      rz_new += r[m]*fine._e[m];
+    beta = rz_new/rz;
+    rz = rz_new;
+    for (m = 0; m < n; m++)
+      p[m] = fine._e[m] + beta*p[m];
+  }
 
-  int x, y, z, xx, yy, zz,i;
-  double sum,diff,threshold;
-  
-  std::vector<double> errors;
-  
-  //calculate median
-  for (x = 0; x < dx; x++)
-    for (y = 0; y < dy; y++)
-      for (z = 0; z < dz; z++) 
-	if(mask(x,y,z)==1)
-	{
-	  errors.push_back(fabs(image(x,y,z)-original(x,y,z)));
-	}
-  std::sort(errors.begin(),errors.end());
-  threshold =1.35*errors[round(errors.size()/2)];
-  cout<<"Threshold is "<<threshold<<endl;
-  
-  //update fieldmap
-  for (x = 0; x < dx; x++)
-    for (y = 0; y < dy; y++)
-      for (z = 0; z < dz; z++) 
-	if(mask(x,y,z)>0)
-	{
-          sum = 0;
-          for (i = 0; i < 13; i++) {
-            xx = x + _directions[i][0];
-            yy = y + _directions[i][1];
-            zz = z + _directions[i][2];
-            if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	    {
-	      if (mask(xx,yy,zz)==1)
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz);
-              }
-	      if ((mask(xx,yy,zz)==2)&&(mask(x,y,z)==2))
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz)/weights(x,y,z);
-              }
-	    }
-          }
-          for (i = 0; i < 13; i++) {
-            xx = x - _directions[i][0];
-            yy = y - _directions[i][1];
-            zz = z - _directions[i][2];
-            if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-	    {
-	      if (mask(xx,yy,zz)==1)
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz);
-              }
-	      if ((mask(xx,yy,zz)==2)&&(mask(x,y,z)==2))
-	      {
-	        sum += _factor[i]*multipliers(xx,yy,zz)/weights(x,y,z);
-              }
-	    }
-          }
-          
-          diff=original(x,y,z)-image(x,y,z);
-          if(mask(x,y,z)==1)
-	  {
-	    if(fabs(diff)<=threshold)
-	    {
-	      fieldmap(x,y,z)=(1-alpha)*original(x,y,z)+alpha*image(x,y,z)-alpha*multipliers(x,y,z)+alpha*sum;
-	      tr_mask(x,y,z)=1;
-	    }
-	    else
-	    {
-	      if(diff>threshold)
-	        fieldmap(x,y,z)=original(x,y,z)-alpha*threshold-alpha*multipliers(x,y,z)+alpha*sum;
-	      if(diff<-threshold)
-	        fieldmap(x,y,z)=original(x,y,z)+alpha*threshold-alpha*multipliers(x,y,z)+alpha*sum;
-	    }
-	  }
-	  if(mask(x,y,z)==2)
-            fieldmap(x,y,z)=original(x,y,z)-alpha*multipliers(x,y,z)+alpha*sum;  
-	}    
-	tr_mask.Write("tr_mask.nii.gz");
+  cout<<"Smoothness solved with lambda "<<lambda1<<" and "<<lambda2<<" on "<<_levels.size()<<" levels in "<<iter<<" iterations, relative residual "<<((bb > 0) ? sqrt(rr/bb) : 0)<<endl;
+
+  fieldmap = image;
+  for (z = 0; z < fine._z; z++)
+    for (y = 0; y < fine._y; y++)
+      for (x = 0; x < fine._x; x++)
+        fieldmap(x,y,z) = f[(z*fine._y + y)*fine._x + x];
+
+  _levels.clear();
+  return iter;
 }
 
 void irtkLaplacianSmoothing::Smooth(irtkRealImage& im, irtkRealImage m)
 {
-  double prev_lap, lap;
-  char buffer[255];
-  
-  im.Write("im.nii.gz");
-  m.Write("m.nii.gz");
+  if (_debug) {
+    im.Write("im.nii.gz");
+    m.Write("m.nii.gz");
+  }
   
   irtkRealImage image(im);
   EnlargeImage(image);
@@ -720,68 +648,28 @@ void irtkLaplacianSmoothing::Smooth(irtkRealImage& im, irtkRealImage m)
   EnlargeImage(mask);
   CalculateBoundary(mask);
 
-  image.Write("image.nii.gz");
-  m.Write("mask.nii.gz");
+  if (_debug) {
+    image.Write("image.nii.gz");
+    m.Write("mask.nii.gz");
+    image.Write("smooth-image.nii.gz");
+    mask.Write("smooth-mask.nii.gz");
+  }
 
-  
-  irtkRealImage weights(mask);
-  weights=0;
-  CalculateBoundaryWeights(weights,mask);
-  
+  //minimise 1/2 |f-g|^2 + 1/2 |Lf|^2 with interior and boundary Laplacian
   irtkRealImage fieldmap(image);
-  irtkRealImage laplacian(image);
-  irtkRealImage llaplacian(image);
-  irtkRealImage multipliers(image);
-  laplacian=0;
-  llaplacian=0;
-  multipliers=0;
-  image.Write("smooth-image.nii.gz");
-  mask.Write("smooth-mask.nii.gz");
-
-  double alpha = 0.5;
-  double rel_diff;
-  
-  for (int iter = 1; iter<1000; iter++)
-    {	
-      prev_lap=lap;
-      lap = LaplacianImage(fieldmap, mask,laplacian);
-      laplacian.Write("laplacian.nii.gz");
-      LaplacianBoundary(fieldmap, mask,laplacian);
-      laplacian.Write("laplacian-with-boundary.nii.gz");
-      //LLaplacian(llaplacian,laplacian,mask,weights);
-      //llaplacian.Write("llaplacian.nii.gz");
-      //exit(1);
-      multipliers = multipliers + laplacian*alpha;
-      multipliers.Write("multipliers.nii.gz");
-      
-      //UpdateFieldmapGD(fieldmap, image, laplacian, mask, weights, alpha,1,1);
-      UpdateFieldmap(fieldmap, image, laplacian, mask, weights, alpha);
-      //UpdateFieldmapWithThreshold(fieldmap, image, multipliers, mask, weights, alpha,0.28);
-      //UpdateFieldmapHuber(fieldmap, image, multipliers, mask, weights, alpha);
-
-      //sprintf(buffer,"fieldmap%i.nii.gz",iter);
-      //fieldmap.Write(buffer);
-      fieldmap.Write("fieldmap.nii.gz");
-      
-      rel_diff = (prev_lap-lap)/prev_lap;
-      cout<<"Iter "<<iter<<" alpha "<<alpha<<" prev_lap "<<prev_lap<<" lap "<<lap<<" reldiff "<<rel_diff<<endl;
-      if((iter>1)&&(rel_diff<0.0001)) break;
-    }
-    //reduce fieldmap to original size
-    ReduceImage(fieldmap);
-    //mask out all the boundary voxels
-    im = fieldmap*m;
+  SolveSmoothness(fieldmap, image, mask, 1, 1);
+
+  if (_debug) fieldmap.Write("fieldmap.nii.gz");
+
+  //reduce fieldmap to original size
+  ReduceImage(fieldmap);
+  //mask out all the boundary voxels
+  im = fieldmap*m;
     
 }
 
-void irtkLaplacianSmoothing::SmoothGD(irtkRealImage& im, irtkRealImage m)
+void irtkLaplacianSmoothing::SmoothGD(irtkRealImage& im, const irtkRealImage& m)
 {
-  double prev_lap, lap;
-  char buffer[255];
-  
-  //im.Write("im.nii.gz");
-  //m.Write("m.nii.gz");
-  
   irtkRealImage image(im);
   EnlargeImage(image);
   
@@ -789,64 +677,31 @@ void irtkLaplacianSmoothing::SmoothGD(irtkRealImage& im, irtkRealImage m)
   EnlargeImage(mask);
   CalculateBoundary(mask);
 
-  //image.Write("image.nii.gz");
-  //m.Write("mask.nii.gz");
+  //weight of smoothness reached at the end of the relaxation
+  double alpha = 5;
+  for(int aiter = 1; aiter<_relax_iter; aiter++)
+    alpha/=10;
 
-  
-  irtkRealImage weights(mask);
-  weights=0;
-  CalculateBoundaryWeights(weights,mask);
-  
+  //without relaxation steps the input is returned unsmoothed
   irtkRealImage fieldmap(image);
-  irtkRealImage laplacian(image);
-  irtkRealImage llaplacian(image);
-  irtkRealImage multipliers(image);
-  laplacian=0;
-  llaplacian=0;
-  multipliers=0;
-  //image.Write("smooth-image.nii.gz");
-  //mask.Write("smooth-mask.nii.gz");
-
-  double alpha = 0.5;
-  double rel_diff;
-    alpha = 5;
-    for(int aiter = 1; aiter<_relax_iter; aiter++)
-    {
-      alpha/=10;
-      for (int iter = 1; iter<10000; iter++)
-      {	
-        prev_lap=lap;
-        lap = LaplacianImage(fieldmap, mask,laplacian);
-        //laplacian.Write("laplacian.nii.gz");
-        LaplacianBoundary(fieldmap, mask,laplacian);
-        //laplacian.Write("laplacian-with-boundary.nii.gz");
-	///Change
-        UpdateFieldmapGD(fieldmap, image, laplacian, mask, weights, alpha,0.5/alpha,_boundary_weight*0.5/alpha);
-        //UpdateFieldmapGD(fieldmap, image, laplacian, mask, weights, alpha,0.5/alpha,1);
-        //UpdateFieldmapGD(fieldmap, image, laplacian, mask, weights, alpha,0.5/alpha,sqrt(0.5/alpha));
-        //UpdateFieldmapGD(fieldmap, image, laplacian, mask, weights, alpha,0.5/alpha,0.5/alpha);
-        //UpdateFieldmapGD(fieldmap, image, laplacian, mask, weights, alpha,0.5/alpha,0.05/alpha);
-
-        //sprintf(buffer,"fieldmap%f-%i.nii.gz",alpha,iter);
-        //fieldmap.Write(buffer);
-      
-        rel_diff = (prev_lap-lap)/prev_lap;
-        cout<<"Iter "<<iter<<" alpha "<<alpha<<" prev_lap "<<prev_lap<<" lap "<<lap<<" reldiff "<<rel_diff<<endl;
-        if((iter>1)&&((lap<_lap_threshold)||(rel_diff<_rel_diff_threshold))) break;
-      }
-      //sprintf(buffer,"final-fieldmap%f.nii.gz",alpha);
-      //fieldmap.Write(buffer);
-    }
+  if (_relax_iter > 1)
+    SolveSmoothness(fieldmap, image, mask, 0.5/alpha, _boundary_weight*0.5/alpha);
+
+  if (_debug) {
+    char buffer[255];
+    sprintf(buffer,"final-fieldmap%f.nii.gz",alpha);
+    fieldmap.Write(buffer);
+  }
     
-    //reduce fieldmap to original size
-    ReduceImage(fieldmap);
-    //mask out all the boundary voxels
-    im = fieldmap*m;
+  //reduce fieldmap to original size
+  ReduceImage(fieldmap);
+  //mask out all the boundary voxels
+  im = fieldmap*m;
     
 }
 
 
-void irtkLaplacianSmoothing::UpsampleFieldmap(irtkRealImage& target, irtkRealImage mask, irtkRealImage &newmask)
+void irtkLaplacianSmoothing::UpsampleFieldmap(irtkRealImage& target, const irtkRealImage& mask, irtkRealImage &newmask)
 {
   irtkRealImage f = _fieldmap;
   _fieldmap = target;
@@ -868,7 +723,7 @@ void irtkLaplacianSmoothing::UpsampleFieldmap(irtkRealImage& target, irtkRealIma
     pf++;
   }
   
-  f.Write("f.nii.gz");
+  if (_debug) f.Write("f.nii.gz");
   
   irtkLinearInterpolateImageFunction interpolator;
   interpolator.SetInput(&f);
@@ -931,22 +786,22 @@ irtkRealImage irtkLaplacianSmoothing::Run()
     irtkRealImage image(_image), mask(_mask);
     //step = attr._dz*8;
     step=6;
-    image.Write("image-before.nii.gz");
+    if (_debug) image.Write("image-before.nii.gz");
     Blur(image,step/2,-1000);
-    image.Write("image-blurred.nii.gz");
+    if (_debug) image.Write("image-blurred.nii.gz");
     Resample(image,step,-1000);
-    image.Write("image-res.nii.gz");
-    mask.Write("mask-before.nii.gz");
+    if (_debug) image.Write("image-res.nii.gz");
+    if (_debug) mask.Write("mask-before.nii.gz");
     ResampleOnGrid(mask,image);
-    image.Write("image-after.nii.gz");
-    mask.Write("mask-after.nii.gz");
+    if (_debug) image.Write("image-after.nii.gz");
+    if (_debug) mask.Write("mask-after.nii.gz");
 
 
     
    
     Smooth(image,mask);
     
-    image.Write("fieldmap-lr.nii.gz");
+    if (_debug) image.Write("fieldmap-lr.nii.gz");
     
     _fieldmap=image;
     _m=mask;
@@ -955,32 +810,32 @@ irtkRealImage irtkLaplacianSmoothing::Run()
     mask=_mask;
     //step = attr._dz*4;
     step=3;
-    image.Write("image-before-2.nii.gz");
+    if (_debug) image.Write("image-before-2.nii.gz");
     Blur(image,step/2,-1000);
-    image.Write("image-blurred-2.nii.gz");
+    if (_debug) image.Write("image-blurred-2.nii.gz");
     Resample(image,step,-1000);
-    image.Write("image-res-2.nii.gz");
-    mask.Write("mask-before-2.nii.gz");
+    if (_debug) image.Write("image-res-2.nii.gz");
+    if (_debug) mask.Write("mask-before-2.nii.gz");
     ResampleOnGrid(mask,image);
-    image.Write("image-after-2.nii.gz");
-    mask.Write("mask-after-2.nii.gz");
+    if (_debug) image.Write("image-after-2.nii.gz");
+    if (_debug) mask.Write("mask-after-2.nii.gz");
 
     
     UpsampleFieldmap(image,_m,mask);
-    _fieldmap.Write("upsampled.nii.gz");
+    if (_debug) _fieldmap.Write("upsampled.nii.gz");
     image*=mask;
     image-=_fieldmap;
     
     Smooth(image,mask);
-     image.Write("fieldmap-hr.nii.gz");
+     if (_debug) image.Write("fieldmap-hr.nii.gz");
     _fieldmap += image;
     _m=mask;
-    _fieldmap.Write("fieldmap-added.nii.gz");
-    _image.Write("_image.nii.gz");
-    _m.Write("_m.nii.gz");
-    _mask.Write("_mask.nii.gz");
+    if (_debug) _fieldmap.Write("fieldmap-added.nii.gz");
+    if (_debug) _image.Write("_image.nii.gz");
+    if (_debug) _m.Write("_m.nii.gz");
+    if (_debug) _mask.Write("_mask.nii.gz");
     UpsampleFieldmap(_image,_m,_mask);
-    image.Write("upsampled-2.nii.gz");
+    if (_debug) image.Write("upsampled-2.nii.gz");
     return _fieldmap;
 }
 
@@ -993,31 +848,31 @@ irtkRealImage irtkLaplacianSmoothing::RunGD()
     irtkRealImage image(_image), mask(_mask);
     //step = attr._dz*8;
     step=3;
-    image.Write("image-before.nii.gz");
+    if (_debug) image.Write("image-before.nii.gz");
     Blur(image,step/2, mask,-1000);
-    image.Write("image-blurred.nii.gz");
+    if (_debug) image.Write("image-blurred.nii.gz");
     Resample(image,step,-1000);
-    image.Write("image-res.nii.gz");
-    mask.Write("mask-before.nii.gz");
+    if (_debug) image.Write("image-res.nii.gz");
+    if (_debug) mask.Write("mask-before.nii.gz");
     ResampleOnGrid(mask,image);
-    image.Write("image-after.nii.gz");
-    mask.Write("mask-after.nii.gz");
+    if (_debug) image.Write("image-after.nii.gz");
+    if (_debug) mask.Write("mask-after.nii.gz");
 
 
     
    
     SmoothGD(image,mask);
 
-     image.Write("fieldmap-hr.nii.gz");
+     if (_debug) image.Write("fieldmap-hr.nii.gz");
     _fieldmap = image;
     _m=mask;
-    _fieldmap.Write("fieldmap-added.nii.gz");
-    _image.Write("_image.nii.gz");
-    _m.Write("_m.nii.gz");
-    _mask.Write("_mask.nii.gz");
+    if (_debug) _fieldmap.Write("fieldmap-added.nii.gz");
+    if (_debug) _image.Write("_image.nii.gz");
+    if (_debug) _m.Write("_m.nii.gz");
+    if (_debug) _mask.Write("_mask.nii.gz");
     UpsampleFieldmap(_image,_m,_mask);
-    _mask.Write("final-fieldmap-mask.nii.gz");
-    image.Write("upsampled-2.nii.gz");
+    if (_debug) _mask.Write("final-fieldmap-mask.nii.gz");
+    if (_debug) image.Write("upsampled-2.nii.gz");
     return _fieldmap;
 }
 
@@ -149,6 +149,8 @@ irtkReconstruction::irtkReconstruction()
 {
     _step = 0.0001;
     _debug = false;
+    _deterministic = false;
+    _fused_em = false;
     _quality_factor = 2;
     _sigma_bias = 12;
     _sigma_s = 0.025;
@@ -363,10 +365,7 @@ public:
 
     // execute
     void operator() () {
-        task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,stacks.size()),
-                         *this );
-        init.terminate();
+        reconstructor->ParallelReduce( stacks.size(), *this, 1 );
     }    
 };
 
@@ -462,7 +461,7 @@ irtkRealImage irtkReconstruction::CreateAverage(vector<irtkRealImage>& stacks,
     return average;
 }
 
-double irtkReconstruction::CreateTemplate(irtkRealImage stack, double resolution)
+double irtkReconstruction::CreateTemplate(const irtkRealImage& stack, double resolution)
 {
     double dx, dy, dz, d;
 
@@ -509,7 +508,7 @@ double irtkReconstruction::CreateTemplate(irtkRealImage stack, double resolution
     return d;
 }
 
-double irtkReconstruction::CreateTemplateAniso(irtkRealImage stack)
+double irtkReconstruction::CreateTemplateAniso(const irtkRealImage& stack)
 {
     double dx, dy, dz, d;
 
@@ -606,7 +605,7 @@ void irtkReconstruction::SetTemplate(irtkRealImage templateImage)
   //_reconstructed.Write("t2template.nii.gz");
 }
 
-void irtkReconstruction::SetTemplateNoProcessing(irtkRealImage templateImage)
+void irtkReconstruction::SetTemplateNoProcessing(const irtkRealImage& templateImage)
 {
     _reconstructed = templateImage;
     _reconstructed.Write("Template.nii.gz");
@@ -812,6 +811,7 @@ double irtkReconstruction::CreateLargeTemplate( vector<irtkRealImage>& stacks,
                             smooth_mask, threshold_mask );
     
     bboxCrop( _mask );
+    UpdateMaskRuns();
     _reconstructed = _mask;
 
 
@@ -1224,6 +1224,7 @@ void irtkReconstruction::SetMask(irtkRealImage * mask, double sigma, double thre
     }
     //set flag that mask was created
     _have_mask = true;
+    UpdateMaskRuns();
 
     if (_debug)
         _mask.Write("mask.nii.gz");
@@ -1260,11 +1261,42 @@ void irtkReconstruction::SetMaskOrient(irtkRealImage * mask, irtkRigidTransforma
     }
     //set flag that mask was created
     _have_mask = true;
+    UpdateMaskRuns();
 
     if (_debug)
         _mask.Write("mask.nii.gz");
 }
 
+void irtkReconstruction::UpdateMaskRuns()
+{
+    int x, y, z, x1;
+    int dx = _mask.GetX();
+    int dy = _mask.GetY();
+    int dz = _mask.GetZ();
+    MASKRUN run;
+
+    _mask_runs.clear();
+    for (z = 0; z < dz; z++)
+        for (y = 0; y < dy; y++) {
+            irtkRealPixel *pm = _mask.GetPointerToVoxels(0, y, z);
+            x = 0;
+            while (x < dx) {
+                while ((x < dx) && (pm[x] <= 0))
+                    x++;
+                x1 = x;
+                while ((x < dx) && (pm[x] > 0))
+                    x++;
+                if (x > x1) {
+                    run.y = y;
+                    run.z = z;
+                    run.x1 = x1;
+                    run.x2 = x;
+                    _mask_runs.push_back(run);
+                }
+            }
+        }
+}
+
 void irtkReconstruction::SetTemplateImage(irtkRealImage t, irtkRigidTransformation tr)
 {
   irtkRealImage t2template = _reconstructed;
@@ -1287,23 +1319,59 @@ void irtkReconstruction::SetTemplateImage(irtkRealImage t, irtkRigidTransformati
 
 }
 
+class ParallelConsistency {
+    irtkReconstruction *reconstructor;
+    bool exclude_slices;
+    vector<double> &sum;
+    vector<double> &num;
+
+public:
+    ParallelConsistency( irtkReconstruction *_reconstructor, bool _exclude_slices, vector<double> &_sum, vector<double> &_num ) :
+    reconstructor(_reconstructor), exclude_slices(_exclude_slices), sum(_sum), num(_num) { }
+
+    void operator() (const blocked_range<size_t> &r) const {
+        double diff;
+        for ( size_t ind = r.begin(); ind != r.end(); ++ind ) {
+            sum[ind] = 0;
+            num[ind] = 0;
+            if((exclude_slices)&&(reconstructor->_slice_weight[ind]<=0.5))
+                continue;
+            irtkRealImage& slice = reconstructor->_slices[ind];
+            irtkRealImage simbuf, simwbuf;
+            const irtkRealImage& sim = reconstructor->SimulatedSlice(ind, simbuf);
+            const irtkRealImage& simw = reconstructor->SimulatedWeights(ind, simwbuf);
+            for (int i=0; i<slice.GetX();i++)
+                for (int j=0; j<slice.GetY();j++)
+                    if(slice(i,j,0)>0)
+                        if(simw(i,j,0)>0.99)
+                        {
+                            diff = slice(i,j,0) - sim(i,j,0) * exp(reconstructor->_bias[ind](i, j, 0)) / reconstructor->_scale[ind];
+                            sum[ind]+=diff*diff;
+                            num[ind]++;
+                        }
+        }
+    }
+
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, reconstructor->_slices.size()), *this );
+        init.terminate();
+    }
+};
+
 double irtkReconstruction::Consistency(bool exclude_slices)
 {
-  double sum = 0, num = 0, diff;
+  //sums of slices are added in order so that the result does not depend on the number of threads
+  vector<double> slice_sum(_slices.size()), slice_num(_slices.size());
+  ParallelConsistency consistency(this, exclude_slices, slice_sum, slice_num);
+  consistency();
+
+  double sum = 0, num = 0;
   for(int ind=0;ind<_slices.size();ind++)
   {
-    if((!exclude_slices)||(_slice_weight[ind]>0.5))
-    {
-    for (int i=0; i<_slices[ind].GetX();i++)
-      for (int j=0; j<_slices[ind].GetY();j++)
-	if(_slices[ind](i,j,0)>0)
-	  if(_simulated_weights[ind](i,j,0)>0.99)
-	  {
-	    diff = _slices[ind](i,j,0) - _simulated_slices[ind](i,j,0) * exp(_bias[ind](i, j, 0)) / _scale[ind];
-	    sum+=diff*diff;
-	    num++;
-	  }
-    }
+    sum+=slice_sum[ind];
+    num+=slice_num[ind];
   }
   
   return sqrt(sum/num);
@@ -1608,14 +1676,16 @@ void irtkReconstruction::ScaleVolume()
         //alias for the current weight image
         irtkRealImage& w = _weights[inputIndex];
 
-        // alias for the current simulated slice
-        irtkRealImage& sim = _simulated_slices[inputIndex];
+        // alias for the current simulated slice and weights
+        irtkRealImage simbuf, simwbuf;
+        const irtkRealImage& sim = SimulatedSlice(inputIndex, simbuf);
+        const irtkRealImage& simw = SimulatedWeights(inputIndex, simwbuf);
         
         for (i = 0; i < slice.GetX(); i++)
             for (j = 0; j < slice.GetY(); j++)
                 if (slice(i, j, 0) != -1) {
                     //scale - intensity matching
-                    if ( _simulated_weights[inputIndex](i,j,0) > 0.99 ) {
+                    if ( simw(i,j,0) > 0.99 ) {
                         scalenum += w(i, j, 0) * _slice_weight[inputIndex] * slice(i, j, 0) * sim(i, j, 0);
                         scaleden += w(i, j, 0) * _slice_weight[inputIndex] * sim(i, j, 0) * sim(i, j, 0);
                     }
@@ -1636,6 +1706,116 @@ void irtkReconstruction::ScaleVolume()
     cout<<endl;
 }
 
+void irtkReconstruction::SimulateSlice(int inputIndex, irtkRealImage& sim, irtkRealImage& simw, irtkRealImage& inside)
+{
+    //Calculate simulated slice
+    sim.Initialize( _slices[inputIndex].GetImageAttributes() );
+    sim = 0;
+
+    simw.Initialize( _slices[inputIndex].GetImageAttributes() );
+    simw = 0;
+
+    inside.Initialize( _slices[inputIndex].GetImageAttributes() );
+    inside = 0;            
+
+    _slice_inside[inputIndex] = false;
+            
+    POINT3D p;
+    for ( unsigned int i = 0; i < _slices[inputIndex].GetX(); i++ )
+        for ( unsigned int j = 0; j < _slices[inputIndex].GetY(); j++ )
+            if ( _slices[inputIndex](i, j, 0) != -1 ) {
+                double weight = 0;
+                int n = _volcoeffs[inputIndex][i][j].size();
+                for ( unsigned int k = 0; k < n; k++ ) {
+                    p = _volcoeffs[inputIndex][i][j][k];
+                    sim(i, j, 0) += p.value * _reconstructed(p.x, p.y, p.z);
+                    weight += p.value;
+                    if (_mask(p.x, p.y, p.z) == 1) {
+                        inside(i, j, 0) = 1;
+                        _slice_inside[inputIndex] = true;
+                    }
+                }                    
+                if( weight > 0 ) {
+                    sim(i,j,0) /= weight;
+                    simw(i,j,0) = weight;
+                }
+            }
+}
+
+void irtkReconstruction::SimulateSlice(int inputIndex)
+{
+    if (_fused_em) {
+        irtkRealImage sim, simw, inside;
+        SimulateSlice(inputIndex, sim, simw, inside);
+        CompactSimulatedSlice(inputIndex, sim, simw, inside);
+    }
+    else
+        SimulateSlice(inputIndex, _simulated_slices[inputIndex],
+                      _simulated_weights[inputIndex], _simulated_inside[inputIndex]);
+}
+
+void irtkReconstruction::ResizeCompactSimulatedSlices()
+{
+    _compact_simulated_slices.resize(_slices.size());
+    _compact_simulated_weights.resize(_slices.size());
+    _compact_simulated_inside.resize(_slices.size());
+}
+
+void irtkReconstruction::CompactSimulatedSlice(int inputIndex, const irtkRealImage& sim, const irtkRealImage& simw, const irtkRealImage& inside)
+{
+    int n = sim.GetNumberOfVoxels();
+    const irtkRealPixel *psim = sim.GetPointerToVoxels();
+    const irtkRealPixel *pw = simw.GetPointerToVoxels();
+    const irtkRealPixel *pin = inside.GetPointerToVoxels();
+    
+    _compact_simulated_slices[inputIndex].resize(n);
+    _compact_simulated_weights[inputIndex].resize(n);
+    _compact_simulated_inside[inputIndex].resize(n);
+    for (int k = 0; k < n; k++) {
+        _compact_simulated_slices[inputIndex][k] = psim[k];
+        _compact_simulated_weights[inputIndex][k] = pw[k];
+        _compact_simulated_inside[inputIndex][k] = (pin[k] == 1);
+    }
+    
+    _simulated_slices[inputIndex].Clear();
+    _simulated_weights[inputIndex].Clear();
+    _simulated_inside[inputIndex].Clear();
+}
+
+//Images are used as they are, unless they were released after compacting them
+template <class T>
+static const irtkRealImage& ExpandSimulated(const irtkRealImage& image, const vector<vector<T> >& compact,
+                                            const irtkRealImage& slice, int inputIndex, irtkRealImage& buffer)
+{
+    if ((image.GetNumberOfVoxels() > 0) || (inputIndex >= (int)compact.size())
+        || (compact[inputIndex].size() == 0))
+        return image;
+    
+    buffer.Initialize( slice.GetImageAttributes() );
+    irtkRealPixel *ptr = buffer.GetPointerToVoxels();
+    for (size_t k = 0; k < compact[inputIndex].size(); k++)
+        ptr[k] = compact[inputIndex][k];
+    return buffer;
+}
+
+const irtkRealImage& irtkReconstruction::SimulatedSlice(int inputIndex, irtkRealImage& buffer) const
+{
+    return ExpandSimulated(_simulated_slices[inputIndex], _compact_simulated_slices,
+                           _slices[inputIndex], inputIndex, buffer);
+}
+
+const irtkRealImage& irtkReconstruction::SimulatedWeights(int inputIndex, irtkRealImage& buffer) const
+{
+    return ExpandSimulated(_simulated_weights[inputIndex], _compact_simulated_weights,
+                           _slices[inputIndex], inputIndex, buffer);
+}
+
+const irtkRealImage& irtkReconstruction::SimulatedInside(int inputIndex, irtkRealImage& buffer) const
+{
+    return ExpandSimulated(_simulated_inside[inputIndex], _compact_simulated_inside,
+                           _slices[inputIndex], inputIndex, buffer);
+}
+
 class ParallelSimulateSlices {
     irtkReconstruction *reconstructor;
         
@@ -1644,41 +1824,8 @@ public:
     reconstructor(_reconstructor) { }
 
     void operator() (const blocked_range<size_t> &r) const {
-        for ( size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex ) {
-            //Calculate simulated slice
-            reconstructor->_simulated_slices[inputIndex].Initialize( reconstructor->_slices[inputIndex].GetImageAttributes() );
-            reconstructor->_simulated_slices[inputIndex] = 0;
-
-            reconstructor->_simulated_weights[inputIndex].Initialize( reconstructor->_slices[inputIndex].GetImageAttributes() );
-            reconstructor->_simulated_weights[inputIndex] = 0;
-
-            reconstructor->_simulated_inside[inputIndex].Initialize( reconstructor->_slices[inputIndex].GetImageAttributes() );
-            reconstructor->_simulated_inside[inputIndex] = 0;            
-
-            reconstructor->_slice_inside[inputIndex] = false;
-            
-            POINT3D p;
-            for ( unsigned int i = 0; i < reconstructor->_slices[inputIndex].GetX(); i++ )
-                for ( unsigned int j = 0; j < reconstructor->_slices[inputIndex].GetY(); j++ )
-                    if ( reconstructor->_slices[inputIndex](i, j, 0) != -1 ) {
-                        double weight = 0;
-                        int n = reconstructor->_volcoeffs[inputIndex][i][j].size();
-                        for ( unsigned int k = 0; k < n; k++ ) {
-                            p = reconstructor->_volcoeffs[inputIndex][i][j][k];
-                            reconstructor->_simulated_slices[inputIndex](i, j, 0) += p.value * reconstructor->_reconstructed(p.x, p.y, p.z);
-                            weight += p.value;
-                            if (reconstructor->_mask(p.x, p.y, p.z) == 1) {
-                                reconstructor->_simulated_inside[inputIndex](i, j, 0) = 1;
-                                reconstructor->_slice_inside[inputIndex] = true;
-                            }
-                        }                    
-                        if( weight > 0 ) {
-                            reconstructor->_simulated_slices[inputIndex](i,j,0) /= weight;
-                            reconstructor->_simulated_weights[inputIndex](i,j,0) = weight;
-                        }
-                    }
-            
-        }
+        for ( size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex )
+            reconstructor->SimulateSlice(inputIndex);
     }
     
     // execute
@@ -1696,6 +1843,9 @@ void irtkReconstruction::SimulateSlices()
     if (_debug)
         cout<<"Simulating slices."<<endl;
 
+    if (_fused_em)
+        ResizeCompactSimulatedSlices();
+
     ParallelSimulateSlices parallelSimulateSlices( this );
     parallelSimulateSlices();
 
@@ -2073,9 +2223,17 @@ void irtkReconstruction::CreateSlicesAndTransformations( vector<irtkRealImage> &
             slice.PutPixelSize(attr._dx, attr._dy, thickness[i]);
             //remember the slice
             _slices.push_back(slice);
-            _simulated_slices.push_back(slice);
-            _simulated_weights.push_back(slice);
-            _simulated_inside.push_back(slice);
+            //simulated slices are created when they are simulated in fused EM mode
+            if (_fused_em) {
+                _simulated_slices.push_back(irtkRealImage());
+                _simulated_weights.push_back(irtkRealImage());
+                _simulated_inside.push_back(irtkRealImage());
+            }
+            else {
+                _simulated_slices.push_back(slice);
+                _simulated_weights.push_back(slice);
+                _simulated_inside.push_back(slice);
+            }
             //remeber stack index for this slice
             _stack_index.push_back(i);
             //initialize slice transformation with the stack transformation
@@ -2302,90 +2460,104 @@ void irtkReconstruction::SliceToVolumeRegistration()
     registration();
 }
 
+class ParallelCoeffInitBSpline {
+    irtkReconstruction *reconstructor;
+
+public:
+    ParallelCoeffInitBSpline(irtkReconstruction *_reconstructor) :
+    reconstructor(_reconstructor) { }
+
+    void operator() (const blocked_range<size_t> &r) const {
+        int i,j,l,m,n,nx,ny,nz;
+        double weight,sum,x,y,z;
+        irtkRealImage &reconstructed = reconstructor->_reconstructed;
+
+        for ( size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex ) {
+            //read the slice
+            irtkRealImage &slice = reconstructor->_slices[inputIndex];
+
+            //prepare structures for storage
+            POINT3D p;
+            VOXELCOEFFS empty;
+            SLICECOEFFS slicecoeffs(slice.GetX(),vector<VOXELCOEFFS>(slice.GetY(),empty));
+
+            //Find values for slice voxel i,j using linear interpolation
+            for(i=0;i<slice.GetX();i++)
+                for(j=0;j<slice.GetY();j++)
+                    if (slice(i,j,0)!=-1)
+                    {
+                        //slice voxel in slice image coordinates
+                        x=i;y=j;z=0;
+                        slice.ImageToWorld(x,y,z);
+                        reconstructor->_transformations[inputIndex].Transform(x,y,z);
+                        reconstructed.WorldToImage(x,y,z);
+                        // x,y,z is now slice voxel in volume image coordinates
+                        // will be linear combination of volume voxels
+
+                        if ((x > -0.5) && (x < reconstructed.GetX()-0.5) &&
+                            (y > -0.5) && (y < reconstructed.GetY()-0.5) &&
+                            (z > -0.5) && (z < reconstructed.GetZ()-0.5))
+                        {
+                            nx = (int)floor(x);
+                            ny = (int)floor(y);
+                            nz = (int)floor(z);
+
+                            sum=0;
+                            for (l=nx;l<=nx+1;l++)
+                                if ((l>=0)&&(l<reconstructed.GetX()))
+                                    for (m=ny;m<=ny+1;m++)
+                                        if ((m>=0)&&(m<reconstructed.GetY()))
+                                            for (n=nz;n<=nz+1;n++)
+                                                if ((n>=0)&&(n<reconstructed.GetZ()))
+                                                {
+                                                    weight=(1 - fabs(l - x))*(1 - fabs(m - y))*(1 - fabs(n - z));
+                                                    sum+=weight;
+                                                }
+                            //remember (up to) 8 volume voxels that affect slice voxel i,j
+                            for (l=nx;l<=nx+1;l++)
+                                if ((l>=0)&&(l<reconstructed.GetX()))
+                                    for (m=ny;m<=ny+1;m++)
+                                        if ((m>=0)&&(m<reconstructed.GetY()))
+                                            for (n=nz;n<=nz+1;n++)
+                                                if ((n>=0)&&(n<reconstructed.GetZ()))
+                                                {
+                                                    weight=(1 - fabs(l - x))*(1 - fabs(m - y))*(1 - fabs(n - z));
+                                                    p.x=l;
+                                                    p.y=m;
+                                                    p.z=n;
+                                                    p.value=weight/sum;
+                                                    slicecoeffs[i][j].push_back(p);
+                                                }
+                        }
+                    }
+
+            reconstructor->_volcoeffs[inputIndex] = slicecoeffs;
+            reconstructor->_slice_inside[inputIndex] = true;
+        }
+    }
+
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, reconstructor->_slices.size() ),
+                      *this );
+        init.terminate();
+    }
+};
+
 void irtkReconstruction::CoeffInitBSpline()
 {
-  int i,j,l,m,n,nx,ny,nz;
-  double weight,sum,x,y,z;
-  int inputIndex;
-  irtkRealImage slice;
-  
   //clear slice-volume matrix
   _volcoeffs.clear();
+  _volcoeffs.resize(_slices.size());
   _slice_inside.clear();
-
+  _slice_inside.resize(_slices.size());
 
   cout<<"Initialising matrix coefficients...";
-  for (inputIndex = 0; inputIndex < _slices.size(); inputIndex++)
-  {
-  //start of a loop for a slice inputIndex  
-    cout<<inputIndex<<" ";
-    cout.flush();
-    
-    //read the slice
-    slice=_slices[inputIndex];
-
-    //prepare structures for storage  
-    POINT3D p;
-    VOXELCOEFFS empty;
-    SLICECOEFFS slicecoeffs(slice.GetX(),vector<VOXELCOEFFS>(slice.GetY(),empty));
-    
-    _slice_inside.push_back(true);
-    
-    //Find values for slice voxel i,j using linear interpolation
-    for(i=0;i<slice.GetX();i++)
-    {
-      for(j=0;j<slice.GetY();j++)
-      {
-          if (slice(i,j,0)!=-1)
-	  {
-	    //slice voxel in slice image coordinates
-	    x=i;y=j;z=0;
-	    slice.ImageToWorld(x,y,z);
-	    _transformations[inputIndex].Transform(x,y,z);
-	    _reconstructed.WorldToImage(x,y,z);
-	    // x,y,z is now slice voxel in volume image coordinates
-	    // will be linear combination of volume voxels
-	    
-            if ((x > -0.5) && (x < _reconstructed.GetX()-0.5) &&
-                (y > -0.5) && (y < _reconstructed.GetY()-0.5) &&
-                (z > -0.5) && (z < _reconstructed.GetZ()-0.5)) 
-	    {
-	      nx = (int)floor(x);
-              ny = (int)floor(y);
-              nz = (int)floor(z);
-
-	      sum=0;
-	      for (l=nx;l<=nx+1;l++)	
-		if ((l>=0)&&(l<_reconstructed.GetX()))
-	          for (m=ny;m<=ny+1;m++)	    
-		    if ((m>=0)&&(m<_reconstructed.GetY()))
-	              for (n=nz;n<=nz+1;n++)	    
-		        if ((n>=0)&&(n<_reconstructed.GetZ()))
-			{
-			  weight=(1 - fabs(l - x))*(1 - fabs(m - y))*(1 - fabs(n - z));
-			  sum+=weight;
-			}
-	      //remember (up to) 8 volume voxels that affect slice voxel i,j
-	      for (l=nx;l<=nx+1;l++)	
-		if ((l>=0)&&(l<_reconstructed.GetX()))
-	          for (m=ny;m<=ny+1;m++)	    
-		    if ((m>=0)&&(m<_reconstructed.GetY()))
-	              for (n=nz;n<=nz+1;n++)	    
-		        if ((n>=0)&&(n<_reconstructed.GetZ()))
-			{
-			  weight=(1 - fabs(l - x))*(1 - fabs(m - y))*(1 - fabs(n - z));
-			  p.x=l;
-			  p.y=m;
-			  p.z=n;
-			  p.value=weight/sum;
-			  slicecoeffs[i][j].push_back(p);
-			}
-	    }
-	  }
-      }
-    }
-    _volcoeffs.push_back(slicecoeffs);
-  }
+  cout.flush();
+  ParallelCoeffInitBSpline coeffinit(this);
+  coeffinit();
+  cout<<" ... done."<<endl;
 }
 
 
@@ -3091,6 +3263,10 @@ void irtkReconstruction::InitializeRobustStatistics()
     //for each slice
     for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
         slice = _slices[inputIndex];
+        irtkRealImage simbuf, simwbuf, insidebuf;
+        const irtkRealImage& simslice = SimulatedSlice(inputIndex, simbuf);
+        const irtkRealImage& simw = SimulatedWeights(inputIndex, simwbuf);
+        const irtkRealImage& inside = SimulatedInside(inputIndex, insidebuf);
 
         //Voxel-wise sigma will be set to stdev of volumetric errors
         //For each slice voxel
@@ -3098,9 +3274,9 @@ void irtkReconstruction::InitializeRobustStatistics()
             for (j = 0; j < slice.GetY(); j++)
                 if (slice(i, j, 0) != -1) {
                     //calculate stev of the errors
-                    if ( (_simulated_inside[inputIndex](i, j, 0)==1)
-                         &&(_simulated_weights[inputIndex](i,j,0)>0.99) ) {
-                        slice(i,j,0) -= _simulated_slices[inputIndex](i,j,0);
+                    if ( (inside(i, j, 0)==1)
+                         &&(simw(i,j,0)>0.99) ) {
+                        slice(i,j,0) -= simslice(i,j,0);
                         sigma += slice(i, j, 0) * slice(i, j, 0);
                         num++;
                     }
@@ -3135,16 +3311,22 @@ void irtkReconstruction::InitializeRobustStatistics()
 class ParallelEStep {
     irtkReconstruction* reconstructor;
     vector<double> &slice_potential;
+    vector<vector<float> > *residuals;
     
 public:
     
     void operator()( const blocked_range<size_t>& r ) const {
         for ( size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
-            // read the current slice
-            irtkRealImage slice = reconstructor->_slices[inputIndex];
+            //alias the current slice
+            const irtkRealImage& slice = reconstructor->_slices[inputIndex];
             
-            // read the current slice
-            irtkRealImage sim = reconstructor->_simulated_slices[inputIndex];
+            //alias the current simulated weights, and the simulated slice unless
+            //the residuals are given
+            irtkRealImage simbuf, simwbuf;
+            const irtkRealImage *sim = NULL;
+            if (residuals == NULL)
+                sim = &reconstructor->SimulatedSlice(inputIndex, simbuf);
+            const irtkRealImage& simw = reconstructor->SimulatedWeights(inputIndex, simwbuf);
                 
             //read current weight image
             reconstructor->_weights[inputIndex] = 0;
@@ -3160,12 +3342,6 @@ public:
             for (int i = 0; i < slice.GetX(); i++)
                 for (int j = 0; j < slice.GetY(); j++)
                     if (slice(i, j, 0) != -1) {
-                        //bias correct and scale the slice
-		        if(reconstructor->_intensity_matching_GD)
-			  sim(i, j, 0) *= b(i, j, 0) / scale;
-			else
-			  sim(i, j, 0) *= exp(b(i, j, 0)) / scale;
-
                         //number of volumetric voxels to which
                         // current slice voxel contributes
                         int n = reconstructor->_volcoeffs[inputIndex][i][j].size();
@@ -3174,13 +3350,23 @@ public:
                         // do not process it
 
                         if ( (n>0) &&
-                             (reconstructor->_simulated_weights[inputIndex](i,j,0) > 0) ) {
-                            slice(i,j,0) -= sim(i,j,0);
+                             (simw(i,j,0) > 0) ) {
+                            double e;
+                            if (residuals != NULL)
+                                //residual computed when the slice was simulated
+                                e = (*residuals)[inputIndex][j * slice.GetX() + i];
+                            else {
+                                //bias correct and scale the slice
+                                if(reconstructor->_intensity_matching_GD)
+                                    e = slice(i, j, 0) - (*sim)(i, j, 0) * (b(i, j, 0) / scale);
+                                else
+                                    e = slice(i, j, 0) - (*sim)(i, j, 0) * (exp(b(i, j, 0)) / scale);
+                            }
 
                             //calculate norm and voxel-wise weights
                       
                             //Gaussian distribution for inliers (likelihood)
-                            double g = reconstructor->G(slice(i, j, 0), reconstructor->_sigma);
+                            double g = reconstructor->G(e, reconstructor->_sigma);
                             //Uniform distribution for outliers (likelihood)
                             double m = reconstructor->M(reconstructor->_m);
                                         
@@ -3189,7 +3375,7 @@ public:
                             reconstructor->_weights[inputIndex].PutAsDouble(i, j, 0, weight);
 
                             //calculate slice potentials
-                            if(reconstructor->_simulated_weights[inputIndex](i,j,0)>0.99) {
+                            if(simw(i,j,0)>0.99) {
                                 slice_potential[inputIndex] += (1 - weight) * (1 - weight);
                                 num++;
                             }
@@ -3207,8 +3393,9 @@ public:
     }
              
     ParallelEStep( irtkReconstruction *reconstructor,
-                   vector<double> &slice_potential ) :
-        reconstructor(reconstructor), slice_potential(slice_potential)
+                   vector<double> &slice_potential,
+                   vector<vector<float> > *residuals = NULL ) :
+        reconstructor(reconstructor), slice_potential(slice_potential), residuals(residuals)
     { }
 
     // execute
@@ -3222,17 +3409,21 @@ public:
 };
 
 void irtkReconstruction::EStep()
+{
+    EStep(NULL);
+}
+
+void irtkReconstruction::EStep(vector<vector<float> > *residuals)
 {
     //EStep performs calculation of voxel-wise and slice-wise posteriors (weights)
     if (_debug)
         cout << "EStep: " << endl;
 
     unsigned int inputIndex;
-    irtkRealImage slice, w, b, sim;
     int num = 0;
     vector<double> slice_potential(_slices.size(), 0);
 
-    ParallelEStep parallelEStep( this, slice_potential );
+    ParallelEStep parallelEStep( this, slice_potential, residuals );
     parallelEStep();
 
     //To force-exclude slices predefined by a user, set their potentials to -1
@@ -3478,8 +3669,10 @@ public:
             // alias the current slice
             irtkRealImage& slice = reconstructor->_slices[inputIndex];
             
-            // alias the current slice
-            irtkRealImage& sim = reconstructor->_simulated_slices[inputIndex];
+            // alias the current simulated slice and weights
+            irtkRealImage simbuf, simwbuf;
+            const irtkRealImage& sim = reconstructor->SimulatedSlice(inputIndex, simbuf);
+            const irtkRealImage& simw = reconstructor->SimulatedWeights(inputIndex, simwbuf);
 
             //alias the current weight image
             irtkRealImage& w = reconstructor->_weights[inputIndex];
@@ -3494,7 +3687,7 @@ public:
             for (int i = 0; i < slice.GetX(); i++)
                 for (int j = 0; j < slice.GetY(); j++)
                     if (slice(i, j, 0) != -1) {
-                        if(reconstructor->_simulated_weights[inputIndex](i,j,0)>0.99) {
+                        if(simw(i,j,0)>0.99) {
                             //scale - intensity matching
                             double eb;
 			    if(reconstructor->_intensity_matching_GD)
@@ -3561,11 +3754,14 @@ public:
     
     void operator()( const blocked_range<size_t>& r ) const {
         for ( size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
-            // read the current slice
-            irtkRealImage slice = reconstructor->_slices[inputIndex];
+            //alias the current slice
+            const irtkRealImage& slice = reconstructor->_slices[inputIndex];
             
-            // read the current slice
-            irtkRealImage sim = reconstructor->_simulated_slices[inputIndex];
+            // read the current simulated slice and weights
+            irtkRealImage simbuf, simwbuf;
+            const irtkRealImage& simslice = reconstructor->SimulatedSlice(inputIndex, simbuf);
+            const irtkRealImage& simw = reconstructor->SimulatedWeights(inputIndex, simwbuf);
+            irtkRealImage sim = simslice;
                                 
             //alias the current weight image
             irtkRealImage& w = reconstructor->_weights[inputIndex];
@@ -3594,7 +3790,7 @@ public:
             for (int i = 0; i < slice.GetX(); i++)
                 for (int j = 0; j < slice.GetY(); j++)
                     if (slice(i, j, 0) != -1) {
-                        if( reconstructor->_simulated_weights[inputIndex](i,j,0) > 0.99 ) {
+                        if( simw(i,j,0) > 0.99 ) {
                             //bias-correct and scale current slice
                             double eb = exp(b(i, j, 0));
                             sim(i, j, 0) *= (eb / scale);
@@ -3605,7 +3801,7 @@ public:
                             //calculate weighted residual image
                             //make sure it is far from zero to avoid numerical instability
                             //if ((sim(i,j,0)>_low_intensity_cutoff*_max_intensity)&&(slice(i,j,0)>_low_intensity_cutoff*_max_intensity))
-                            if ( (reconstructor->_simulated_slices[inputIndex](i, j, 0) > 1) && (slice(i, j, 0) > 1)) {
+                            if ( (simslice(i, j, 0) > 1) && (slice(i, j, 0) > 1)) {
                                 wresidual(i, j, 0) = log(slice(i, j, 0) / sim(i, j, 0)) * wb(i, j, 0);
                                 residual(i, j, 0) = log(slice(i, j, 0) / sim(i, j, 0));
 
@@ -3719,17 +3915,18 @@ public:
     
     void operator()( const blocked_range<size_t>& r ) const {
         for ( size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
-            // read the current slice
-            irtkRealImage slice = reconstructor->_slices[inputIndex];
+            //alias the current slice
+            const irtkRealImage& slice = reconstructor->_slices[inputIndex];
             
 	    // simulated slice
-            irtkRealImage simslice = reconstructor->_simulated_slices[inputIndex];
+	    irtkRealImage simbuf, simwbuf;
+            const irtkRealImage& simslice = reconstructor->SimulatedSlice(inputIndex, simbuf);
 	    
 	    // simulated slice ROI
-	    irtkRealImage simweights = reconstructor->_simulated_weights[inputIndex];
+	    const irtkRealImage& simweights = reconstructor->SimulatedWeights(inputIndex, simwbuf);
 
 	    // weight image
-            irtkRealImage w = reconstructor->_weights[inputIndex];
+            const irtkRealImage& w = reconstructor->_weights[inputIndex];
                 
             // bias image
             irtkRealImage b = reconstructor->_bias[inputIndex];
@@ -3988,11 +4185,12 @@ public:
     
     void operator()( const blocked_range<size_t>& r ) {
         for ( size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
-            // read the current slice
-            irtkRealImage slice = reconstructor->_slices[inputIndex];
+            //alias the current slice
+            const irtkRealImage& slice = reconstructor->_slices[inputIndex];
             
-            // read the current slice
-            irtkRealImage sim = reconstructor->_simulated_slices[inputIndex];
+            //alias the current simulated slice
+            irtkRealImage simbuf;
+            const irtkRealImage& sim = reconstructor->SimulatedSlice(inputIndex, simbuf);
                 
             //read the current weight image
             irtkRealImage& w = reconstructor->_weights[inputIndex];
@@ -4011,28 +4209,28 @@ public:
                 for ( int j = 0; j < slice.GetY(); j++)
                     if (slice(i, j, 0) != -1) {
                         //bias correct and scale the slice
-		        if(reconstructor->_intensity_matching_GD)
-			  sim(i, j, 0) *= b(i, j, 0) / scale;
-			else
-                          sim(i, j, 0) *= exp(b(i, j, 0)) / scale;
-                        
-                        if ( reconstructor->_simulated_slices[inputIndex](i,j,0) > 0 )
-                            slice(i,j,0) -= sim(i,j,0);
+                        double e;
+                        if ( sim(i,j,0) > 0 ) {
+                            if(reconstructor->_intensity_matching_GD)
+                                e = slice(i, j, 0) - sim(i, j, 0) * (b(i, j, 0) / scale);
+                            else
+                                e = slice(i, j, 0) - sim(i, j, 0) * (exp(b(i, j, 0)) / scale);
+                        }
                         else
-                            slice(i,j,0) = 0;
+                            e = 0;
 
                         int n = reconstructor->_volcoeffs[inputIndex][i][j].size();
                         for (int k = 0; k < n; k++) {
                             p = reconstructor->_volcoeffs[inputIndex][i][j][k];
 			    if(reconstructor->_robust_slices_only)
 			    {
-                              addon(p.x, p.y, p.z) += p.value * slice(i, j, 0) * reconstructor->_slice_weight[inputIndex] * exp(b(i, j, 0)) / scale;
+                              addon(p.x, p.y, p.z) += p.value * e * reconstructor->_slice_weight[inputIndex] * exp(b(i, j, 0)) / scale;
                               confidence_map(p.x, p.y, p.z) += p.value * reconstructor->_slice_weight[inputIndex] * exp(b(i, j, 0)) / scale;
 			      
 			    }
 			    else
 			    {
-                              addon(p.x, p.y, p.z) += p.value * slice(i, j, 0) * w(i, j, 0) * reconstructor->_slice_weight[inputIndex] * exp(b(i, j, 0)) / scale;
+                              addon(p.x, p.y, p.z) += p.value * e * w(i, j, 0) * reconstructor->_slice_weight[inputIndex] * exp(b(i, j, 0)) / scale;
                               confidence_map(p.x, p.y, p.z) += p.value * w(i, j, 0) * reconstructor->_slice_weight[inputIndex] * exp(b(i, j, 0)) / scale;
 			    }
                         }
@@ -4071,10 +4269,7 @@ public:
 
     // execute
     void operator() () {
-        task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,reconstructor->_slices.size()),
-                         *this );
-        init.terminate();
+        reconstructor->ParallelReduce( reconstructor->_slices.size(), *this );
     }         
 };
 
@@ -4153,11 +4348,13 @@ public:
     
     void operator()( const blocked_range<size_t>& r ) {
         for ( size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
-            // read the current slice
-            irtkRealImage slice = reconstructor->_slices[inputIndex];
+            //alias the current slice
+            const irtkRealImage& slice = reconstructor->_slices[inputIndex];
             
-            // read the current slice
-            irtkRealImage sim = reconstructor->_simulated_slices[inputIndex];
+            //alias the current simulated slice and weights
+            irtkRealImage simbuf, simwbuf;
+            const irtkRealImage& sim = reconstructor->SimulatedSlice(inputIndex, simbuf);
+            const irtkRealImage& simw = reconstructor->SimulatedWeights(inputIndex, simwbuf);
                 
             //alias the current weight image
             irtkRealImage& w = reconstructor->_weights[inputIndex];
@@ -4172,18 +4369,16 @@ public:
             for (int i = 0; i < slice.GetX(); i++)
                 for (int j = 0; j < slice.GetY(); j++)
                     if (slice(i, j, 0) != -1) {
-                        //bias correct and scale the slice
-		        if(reconstructor->_intensity_matching_GD)
-			  sim(i, j, 0) *= b(i, j, 0) / scale;
-			else
-                          sim(i, j, 0) *= exp(b(i, j, 0)) / scale;
-
                         //otherwise the error has no meaning - it is equal to slice intensity
-                        if ( reconstructor->_simulated_weights[inputIndex](i,j,0) > 0.99 ) {
-                            slice(i,j,0) -= sim(i,j,0);
+                        if ( simw(i,j,0) > 0.99 ) {
+                            //bias correct and scale the slice
+                            double e;
+                            if(reconstructor->_intensity_matching_GD)
+                                e = slice(i, j, 0) - sim(i, j, 0) * (b(i, j, 0) / scale);
+                            else
+                                e = slice(i, j, 0) - sim(i, j, 0) * (exp(b(i, j, 0)) / scale);
                             
                             //sigma and mix
-                            double e = slice(i, j, 0);
                             sigma += e * e * w(i, j, 0);
                             mix += w(i, j, 0);
 
@@ -4232,10 +4427,7 @@ public:
 
     // execute
     void operator() () {
-        task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,reconstructor->_slices.size()),
-                         *this );
-        init.terminate();
+        reconstructor->ParallelReduce( reconstructor->_slices.size(), *this );
     }    
 };
 
@@ -4246,12 +4438,12 @@ void irtkReconstruction::MStep(int iter)
     
     ParallelMStep parallelMStep(this);
     parallelMStep();
-    double sigma = parallelMStep.sigma;
-    double mix = parallelMStep.mix;
-    double num = parallelMStep.num;
-    double min = parallelMStep.min;
-    double max = parallelMStep.max;
+    VoxelStatistics(iter, parallelMStep.sigma, parallelMStep.mix, parallelMStep.num,
+                    parallelMStep.min, parallelMStep.max);
+}
 
+void irtkReconstruction::VoxelStatistics(int iter, double sigma, double mix, double num, double min, double max)
+{
     //Calculate sigma and mix
     if (mix > 0) {
         _sigma = sigma / mix;
@@ -4276,127 +4468,204 @@ void irtkReconstruction::MStep(int iter)
 
 }
 
-class ParallelAdaptiveRegularization1 {
-    irtkReconstruction *reconstructor;
-    vector<irtkRealImage> &b;
-    vector<double> &factor;
-    irtkRealImage &original;
-        
+class ParallelEMStep{
+    irtkReconstruction* reconstructor;
+    vector<vector<float> > &residuals;
 public:
-    ParallelAdaptiveRegularization1( irtkReconstruction *_reconstructor,
-                                     vector<irtkRealImage> &_b,
-                                     vector<double> &_factor,
-                                     irtkRealImage &_original) : 
-        reconstructor(_reconstructor),
-        b(_b),
-        factor(_factor),
-        original(_original) { }
+    double sigma;
+    double mix;
+    double num;
+    double min;
+    double max;
+    
+    void operator()( const blocked_range<size_t>& r ) {
+        for ( size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
+            //simulate the slice, into local images in fused EM mode
+            bool fused = reconstructor->_fused_em;
+            irtkRealImage simbuf, simwbuf, insidebuf;
+            irtkRealImage& sim = fused ? simbuf : reconstructor->_simulated_slices[inputIndex];
+            irtkRealImage& simw = fused ? simwbuf : reconstructor->_simulated_weights[inputIndex];
+            irtkRealImage& inside = fused ? insidebuf : reconstructor->_simulated_inside[inputIndex];
+            reconstructor->SimulateSlice(inputIndex, sim, simw, inside);
+
+            //alias the current slice, weights and bias
+            const irtkRealImage& slice = reconstructor->_slices[inputIndex];
+            irtkRealImage& w = reconstructor->_weights[inputIndex];
+            irtkRealImage& b = reconstructor->_bias[inputIndex];
+        
+            //identify scale factor
+            double scale = reconstructor->_scale[inputIndex];
 
-    void operator() (const blocked_range<size_t> &r) const {
-        int dx = reconstructor->_reconstructed.GetX();
-        int dy = reconstructor->_reconstructed.GetY();
-        int dz = reconstructor->_reconstructed.GetZ();
-        for ( size_t i = r.begin(); i != r.end(); ++i ) {
-            //b[i] = reconstructor->_reconstructed;
-            // b[i].Initialize( reconstructor->_reconstructed.GetImageAttributes() );
+            //residuals are kept for the E-step
+            residuals[inputIndex].resize(slice.GetX() * slice.GetY());
 
-            int x, y, z, xx, yy, zz;
-            double diff;
-            for (x = 0; x < dx; x++)
-                for (y = 0; y < dy; y++)
-                    for (z = 0; z < dz; z++) {
-                        xx = x + reconstructor->_directions[i][0];
-                        yy = y + reconstructor->_directions[i][1];
-                        zz = z + reconstructor->_directions[i][2];
-                        if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)
-                            && (reconstructor->_mask(x, y, z) > 0) && (reconstructor->_mask(xx, yy, zz) > 0)) {
-                            diff = (original(xx, yy, zz) - original(x, y, z)) * sqrt(factor[i]) / reconstructor->_delta;
-                            b[i](x, y, z) = factor[i] / sqrt(1 + diff * diff);
+            for (int i = 0; i < slice.GetX(); i++)
+                for (int j = 0; j < slice.GetY(); j++)
+                    if ((slice(i, j, 0) != -1) && (simw(i, j, 0) > 0)) {
+                        //bias correct and scale the slice
+                        double e;
+                        if(reconstructor->_intensity_matching_GD)
+                            e = slice(i, j, 0) - sim(i, j, 0) * (b(i, j, 0) / scale);
+                        else
+                            e = slice(i, j, 0) - sim(i, j, 0) * (exp(b(i, j, 0)) / scale);
+                        residuals[inputIndex][j * slice.GetX() + i] = e;
+
+                        //otherwise the error has no meaning - it is equal to slice intensity
+                        if (simw(i, j, 0) > 0.99) {
+                            //sigma and mix
+                            sigma += e * e * w(i, j, 0);
+                            mix += w(i, j, 0);
+
+                            //_m
+                            if (e < min)
+                                min = e;
+                            if (e > max)
+                                max = e;
 
+                            num++;
                         }
-                        else
-                            b[i](x, y, z) = 0;
                     }
-        }
-    }
 
-    // execute
-    void operator() () const {
-        task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, 13),
-                      *this );
-        init.terminate();
+            //only the compact form of the simulated slice is kept
+            if (fused)
+                reconstructor->CompactSimulatedSlice(inputIndex, sim, simw, inside);
+        } //end of loop for a slice inputIndex
+    }
+ 
+    ParallelEMStep( ParallelEMStep& x, split ) :
+        reconstructor(x.reconstructor), residuals(x.residuals)
+    {
+        sigma = 0;
+        mix = 0;
+        num = 0;
+        min = 0;
+        max = 0;
+    }
+ 
+    void join( const ParallelEMStep& y ) {
+        if (y.min < min)
+            min = y.min;
+        if (y.max > max)
+            max = y.max;
+        
+        sigma += y.sigma;
+        mix += y.mix;
+        num += y.num;
+    }
+             
+    ParallelEMStep( irtkReconstruction *reconstructor, vector<vector<float> > &residuals ) :
+    reconstructor(reconstructor), residuals(residuals)
+    {
+        sigma = 0;
+        mix = 0;
+        num = 0;
+        min = voxel_limits<irtkRealPixel>::max();
+        max = voxel_limits<irtkRealPixel>::min();
     }
 
+    // execute
+    void operator() () {
+        reconstructor->ParallelReduce( reconstructor->_slices.size(), *this );
+    }    
 };
 
-class ParallelAdaptiveRegularization2 {
+void irtkReconstruction::EMStep(int iter)
+{
+    if (_debug)
+        cout << "EMStep" << endl;
+
+    if (_fused_em)
+        ResizeCompactSimulatedSlices();
+
+    //simulate slices and collect M-step sums in a single pass over each slice
+    vector<vector<float> > residuals(_slices.size());
+    ParallelEMStep parallelEMStep(this, residuals);
+    parallelEMStep();
+    VoxelStatistics(iter, parallelEMStep.sigma, parallelEMStep.mix, parallelEMStep.num,
+                    parallelEMStep.min, parallelEMStep.max);
+
+    //E-step from the stored residuals
+    EStep(&residuals);
+}
+
+class ParallelAdaptiveRegularization {
     irtkReconstruction *reconstructor;
-    vector<irtkRealImage> &b;
     vector<double> &factor;
     irtkRealImage &original;
+    irtkRealImage &original2;
         
 public:
-    ParallelAdaptiveRegularization2( irtkReconstruction *_reconstructor,
-                                     vector<irtkRealImage> &_b,
-                                     vector<double> &_factor,
-                                     irtkRealImage &_original) : 
+    ParallelAdaptiveRegularization( irtkReconstruction *_reconstructor,
+                                    vector<double> &_factor,
+                                    irtkRealImage &_original,
+                                    irtkRealImage &_original2) : 
         reconstructor(_reconstructor),
-        b(_b),
         factor(_factor),
-        original(_original) { }
+        original(_original),
+        original2(_original2) { }
 
     void operator() (const blocked_range<size_t> &r) const {
         int dx = reconstructor->_reconstructed.GetX();
         int dy = reconstructor->_reconstructed.GetY();
         int dz = reconstructor->_reconstructed.GetZ();
-        for ( size_t x = r.begin(); x != r.end(); ++x ) {
-            int xx, yy, zz;
-            for (int y = 0; y < dy; y++)
-                for (int z = 0; z < dz; z++) 
-		  if(reconstructor->_mask(x,y,z)>0)
-		  {                    
-                    double val = 0;
-                    double sum = 0;
-                    for (int i = 0; i < 13; i++) {
+        for ( size_t run = r.begin(); run != r.end(); ++run ) {
+            int x, xx, yy, zz, i;
+            int y = reconstructor->_mask_runs[run].y;
+            int z = reconstructor->_mask_runs[run].z;
+            double diff, b[13];
+            bool inside[13];
+            for (x = reconstructor->_mask_runs[run].x1; x < reconstructor->_mask_runs[run].x2; x++) {
+                //edge-preserving weights of the directions, zero if the neighbour is outside the mask
+                for (i = 0; i < 13; i++) {
+                    xx = x + reconstructor->_directions[i][0];
+                    yy = y + reconstructor->_directions[i][1];
+                    zz = z + reconstructor->_directions[i][2];
+                    inside[i] = (xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)
+                        && (reconstructor->_mask(xx, yy, zz) > 0);
+                    if (inside[i]) {
+                        diff = (original(xx, yy, zz) - original(x, y, z)) * sqrt(factor[i]) / reconstructor->_delta;
+                        b[i] = factor[i] / sqrt(1 + diff * diff);
+                    }
+                    else
+                        b[i] = 0;
+                }
+
+                double val = 0;
+                double sum = 0;
+                for (i = 0; i < 13; i++)
+                    if (inside[i]) {
                         xx = x + reconstructor->_directions[i][0];
                         yy = y + reconstructor->_directions[i][1];
                         zz = z + reconstructor->_directions[i][2];
-                        if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-			  if(reconstructor->_mask(xx,yy,zz)>0)
-			  {
-                            val += b[i](x, y, z) * original(xx, yy, zz);
-                            sum += b[i](x, y, z);
-                          }
+                        val += b[i] * original2(xx, yy, zz);
+                        sum += b[i];
                     }
 
-                    for (int i = 0; i < 13; i++) {
-                        xx = x - reconstructor->_directions[i][0];
-                        yy = y - reconstructor->_directions[i][1];
-                        zz = z - reconstructor->_directions[i][2];
-                        if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-			  if(reconstructor->_mask(xx,yy,zz)>0)
-			  {
-                            val += b[i](x, y, z) * original(xx, yy, zz);
-                            sum += b[i](x, y, z);
-                          }
-                        
-                    }
+                for (i = 0; i < 13; i++) {
+                    xx = x - reconstructor->_directions[i][0];
+                    yy = y - reconstructor->_directions[i][1];
+                    zz = z - reconstructor->_directions[i][2];
+                    if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
+                        if(reconstructor->_mask(xx,yy,zz)>0)
+                        {
+                            val += b[i] * original2(xx, yy, zz);
+                            sum += b[i];
+                        }
+                }
 
-                    val -= sum * original(x, y, z);
-                    val = original(x, y, z) 
-                        + reconstructor->_alpha * reconstructor->_lambda / (reconstructor->_delta * reconstructor->_delta) * val;
+                val -= sum * original2(x, y, z);
+                val = original2(x, y, z) 
+                    + reconstructor->_alpha * reconstructor->_lambda / (reconstructor->_delta * reconstructor->_delta) * val;
 
-                        reconstructor->_reconstructed(x, y, z) = val;
-                }
-            
+                reconstructor->_reconstructed(x, y, z) = val;
+            }
         }
     }
 
     // execute
     void operator() () const {
         task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, reconstructor->_reconstructed.GetX()),
+        parallel_for( blocked_range<size_t>(0, reconstructor->_mask_runs.size()),
                       *this );
         init.terminate();
     }
@@ -4416,22 +4685,13 @@ void irtkReconstruction::AdaptiveRegularization(int iter, irtkRealImage& origina
         factor[i] = 1 / factor[i];
     }
 
-    vector<irtkRealImage> b;//(13);
-    for (int i = 0; i < 13; i++)
-        b.push_back( _reconstructed );
-
-    ParallelAdaptiveRegularization1 parallelAdaptiveRegularization1( this,
-                                                                     b,
-                                                                     factor,
-                                                                     original );
-    parallelAdaptiveRegularization1();
-
+    //weights of the directions are computed for each voxel when it is updated
     irtkRealImage original2 = _reconstructed;
-    ParallelAdaptiveRegularization2 parallelAdaptiveRegularization2( this,
-                                                                     b,
-                                                                     factor,
-                                                                     original2 );
-    parallelAdaptiveRegularization2();
+    ParallelAdaptiveRegularization parallelAdaptiveRegularization( this,
+                                                                   factor,
+                                                                   original,
+                                                                   original2 );
+    parallelAdaptiveRegularization();
 
     if (_alpha * _lambda / (_delta * _delta) > 0.068) {
         cerr
@@ -4463,22 +4723,20 @@ public:
         int dx = reconstructor->_reconstructed.GetX();
         int dy = reconstructor->_reconstructed.GetY();
         int dz = reconstructor->_reconstructed.GetZ();
-        for ( size_t i = r.begin(); i != r.end(); ++i ) {
-            //b[i] = reconstructor->_reconstructed;
-            // b[i].Initialize( reconstructor->_reconstructed.GetImageAttributes() );
-
-            int x, y, z, xx, yy, zz;
+        for ( size_t run = r.begin(); run != r.end(); ++run ) {
+            //internal mask is inside the mask
+            int x, xx, yy, zz, i;
+            int y = reconstructor->_mask_runs[run].y;
+            int z = reconstructor->_mask_runs[run].z;
             double diff;
-            for (x = 0; x < dx; x++)
-                for (y = 0; y < dy; y++)
-                    for (z = 0; z < dz; z++) {
+            for (x = reconstructor->_mask_runs[run].x1; x < reconstructor->_mask_runs[run].x2; x++)
+                if (reconstructor->_mask_internal(x, y, z) > 0)
+                    for (i = 0; i < 13; i++) {
                         xx = x + reconstructor->_directions[i][0];
                         yy = y + reconstructor->_directions[i][1];
                         zz = z + reconstructor->_directions[i][2];
                         if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)
-                            && (reconstructor->_mask_internal(x, y, z) > 0) 
-			     && (reconstructor->_mask(xx, yy, zz) > 0)) 
-			{
+                            && (reconstructor->_mask(xx, yy, zz) > 0)) {
                             diff = (original(xx, yy, zz) - original(x, y, z)) * factor[i];
                             laplacian(x, y, z) += diff;
 
@@ -4488,8 +4746,7 @@ public:
                         yy = y - reconstructor->_directions[i][1];
                         zz = z - reconstructor->_directions[i][2];
                         if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)
-                            && (reconstructor->_mask_internal(x, y, z) > 0) 
-			     && (reconstructor->_mask(xx, yy, zz) > 0)) {
+                            && (reconstructor->_mask(xx, yy, zz) > 0)) {
                             diff = (original(xx, yy, zz) - original(x, y, z)) * factor[i];
                             laplacian(x, y, z) += diff;
 
@@ -4501,7 +4758,7 @@ public:
     // execute
     void operator() () const {
         task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, 13),
+        parallel_for( blocked_range<size_t>(0, reconstructor->_mask_runs.size()),
                       *this );
         init.terminate();
     }
@@ -4528,55 +4785,53 @@ public:
         int dx = reconstructor->_reconstructed.GetX();
         int dy = reconstructor->_reconstructed.GetY();
         int dz = reconstructor->_reconstructed.GetZ();
-        for ( size_t x = r.begin(); x != r.end(); ++x ) {
-            int xx, yy, zz;
-            for (int y = 0; y < dy; y++)
-                for (int z = 0; z < dz; z++) 
-		  if(reconstructor->_mask(x,y,z)>0)
-		  {                    
-                    double val = 0;
-                    double sum = 0;
-                    for (int i = 0; i < 13; i++) {
-                        xx = x + reconstructor->_directions[i][0];
-                        yy = y + reconstructor->_directions[i][1];
-                        zz = z + reconstructor->_directions[i][2];
-                        if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-			  if(reconstructor->_mask_internal(xx,yy,zz)>0)
-			  {
+        for ( size_t run = r.begin(); run != r.end(); ++run ) {
+            int x, xx, yy, zz;
+            int y = reconstructor->_mask_runs[run].y;
+            int z = reconstructor->_mask_runs[run].z;
+            for (x = reconstructor->_mask_runs[run].x1; x < reconstructor->_mask_runs[run].x2; x++) {
+                double val = 0;
+                double sum = 0;
+                for (int i = 0; i < 13; i++) {
+                    xx = x + reconstructor->_directions[i][0];
+                    yy = y + reconstructor->_directions[i][1];
+                    zz = z + reconstructor->_directions[i][2];
+                    if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
+                        if(reconstructor->_mask_internal(xx,yy,zz)>0)
+                        {
                             val += factor[i] * laplacian(xx, yy, zz);
                             sum += factor[i];
-                          }
-                    }
+                        }
+                }
 
-                    for (int i = 0; i < 13; i++) {
-                        xx = x - reconstructor->_directions[i][0];
-                        yy = y - reconstructor->_directions[i][1];
-                        zz = z - reconstructor->_directions[i][2];
-                        if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
-			  if(reconstructor->_mask_internal(xx,yy,zz)>0)
-			  {
+                for (int i = 0; i < 13; i++) {
+                    xx = x - reconstructor->_directions[i][0];
+                    yy = y - reconstructor->_directions[i][1];
+                    zz = z - reconstructor->_directions[i][2];
+                    if ((xx >= 0) && (xx < dx) && (yy >= 0) && (yy < dy) && (zz >= 0) && (zz < dz)) 
+                        if(reconstructor->_mask_internal(xx,yy,zz)>0)
+                        {
                             val += factor[i] * laplacian(xx, yy, zz);
                             sum += factor[i];
-                          }
+                        }
                         
-                    }
+                }
                     
-                    if(reconstructor->_mask_internal(x,y,z)>0)
-                      val -= sum * laplacian(x, y, z);
-		    
-                    val = original(x, y, z) 
-                        - reconstructor->_alpha * reconstructor->_lambda / (reconstructor->_delta * reconstructor->_delta) * val/0.068;
+                if(reconstructor->_mask_internal(x,y,z)>0)
+                    val -= sum * laplacian(x, y, z);
 
-                    reconstructor->_reconstructed(x, y, z) = val;
-                }
-            
+                val = original(x, y, z) 
+                    - reconstructor->_alpha * reconstructor->_lambda / (reconstructor->_delta * reconstructor->_delta) * val/0.068;
+
+                reconstructor->_reconstructed(x, y, z) = val;
+            }
         }
     }
 
     // execute
     void operator() () const {
         task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, reconstructor->_reconstructed.GetX()),
+        parallel_for( blocked_range<size_t>(0, reconstructor->_mask_runs.size()),
                       *this );
         init.terminate();
     }
@@ -4695,10 +4950,10 @@ public:
         int dx = reconstructor->_reconstructed.GetX();
         int dy = reconstructor->_reconstructed.GetY();
         int dz = reconstructor->_reconstructed.GetZ();
-        for ( size_t x = r.begin(); x != r.end(); ++x ) {
+        for ( size_t z = r.begin(); z != r.end(); ++z ) {
             int xx, yy, zz, xxx, yyy, zzz;
             for (int y = 0; y < dy; y++)
-                for (int z = 0; z < dz; z++) 
+                for (int x = 0; x < dx; x++) 
 		  if(reconstructor->_confidence_map(x,y,z)>0)
 		  {                    
                     double val = 0;
@@ -4749,7 +5004,7 @@ public:
     // execute
     void operator() () const {
         task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, reconstructor->_reconstructed.GetX()),
+        parallel_for( blocked_range<size_t>(0, reconstructor->_reconstructed.GetZ()),
                       *this );
         init.terminate();
     }
@@ -4964,10 +5219,7 @@ public:
 
     // execute
     void operator() () {
-        task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,reconstructor->_slices.size()),
-                         *this );
-        init.terminate();
+        reconstructor->ParallelReduce( reconstructor->_slices.size(), *this );
     }        
 };
 
@@ -5061,7 +5313,8 @@ void irtkReconstruction::NormaliseBias(int iter, irtkRealImage& image)
     
     for(int t=0;t<image.GetT();t++)
     {
-      irtkRealImage stack = image.GetRegion(0,0,0,t,image.GetX(),image.GetY(),image.GetZ(),t+1);
+      //correct the frame in place
+      irtkGenericImageView<irtkRealPixel> stack = image.GetFrameView(t);
       irtkRealPixel *pi, *pb;
       pi = stack.GetPointerToVoxels();
       pb = bias.GetPointerToVoxels();
@@ -5072,12 +5325,6 @@ void irtkReconstruction::NormaliseBias(int iter, irtkRealImage& image)
         pi++;
         pb++;
       }
-      
-      for (int i = 0; i < image.GetX(); i++)
-        for (int j = 0; j < image.GetY(); j++)
-	  for (int k = 0; k < image.GetZ(); k++) 
-	  image(i,j,k,t)=stack(i,j,k);
-	
     }
     
     
@@ -5163,10 +5410,7 @@ public:
 
     // execute
     void operator() () {
-        task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,reconstructor->_slices.size()),
-                         *this );
-        init.terminate();
+        reconstructor->ParallelReduce( reconstructor->_slices.size(), *this );
     }        
 };
 
@@ -5296,7 +5540,9 @@ void irtkReconstruction::SaveSimulatedSlices()
     for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++)
         {
             sprintf(buffer, "simslice%i.nii.gz", inputIndex);
-            _simulated_slices[inputIndex].Write(buffer);
+            irtkRealImage simbuf;
+            irtkRealImage sim = SimulatedSlice(inputIndex, simbuf);
+            sim.Write(buffer);
         }
         cout<<"done."<<endl;
 }
@@ -5395,7 +5641,7 @@ void irtkReconstruction::SlicesInfo( const char* filename,
 /* end Set/Get/Save operations */
 
 /* Package specific functions */
-void irtkReconstruction::SplitImage(irtkRealImage image, int packages, vector<irtkRealImage>& stacks)
+void irtkReconstruction::SplitImage(const irtkRealImage& image, int packages, vector<irtkRealImage>& stacks)
 {
     
   if (packages==1)
@@ -5461,7 +5707,7 @@ void irtkReconstruction::SplitImage(irtkRealImage image, int packages, vector<ir
   }
 }
 
-void irtkReconstruction::SplitImageEvenOdd(irtkRealImage image, int packages, vector<irtkRealImage>& stacks)
+void irtkReconstruction::SplitImageEvenOdd(const irtkRealImage& image, int packages, vector<irtkRealImage>& stacks)
 {
     vector<irtkRealImage> packs;
     vector<irtkRealImage> packs2;
@@ -5480,7 +5726,7 @@ void irtkReconstruction::SplitImageEvenOdd(irtkRealImage image, int packages, ve
     cout<<"done."<<endl;
 }
 
-void irtkReconstruction::SplitImageEvenOddHalf(irtkRealImage image, int packages, vector<irtkRealImage>& stacks, int iter)
+void irtkReconstruction::SplitImageEvenOddHalf(const irtkRealImage& image, int packages, vector<irtkRealImage>& stacks, int iter)
 {
     vector<irtkRealImage> packs;
     vector<irtkRealImage> packs2;
@@ -5500,7 +5746,7 @@ void irtkReconstruction::SplitImageEvenOddHalf(irtkRealImage image, int packages
 }
 
 
-void irtkReconstruction::HalfImage(irtkRealImage image, vector<irtkRealImage>& stacks)
+void irtkReconstruction::HalfImage(const irtkRealImage& image, vector<irtkRealImage>& stacks)
 {
     irtkRealImage tmp;
     irtkImageAttributes attr = image.GetImageAttributes();
@@ -814,10 +814,11 @@ void irtkReconstructionDTI::CorrectStackIntensities(vector<irtkRealImage>& stack
 
 class ParallelSimulateSlicesDTI {
     irtkReconstructionDTI *reconstructor;
+    const irtkSHCoefficientImage *coeffs;
         
 public:
-    ParallelSimulateSlicesDTI( irtkReconstructionDTI *_reconstructor ) : 
-    reconstructor(_reconstructor) { }
+    ParallelSimulateSlicesDTI( irtkReconstructionDTI *_reconstructor, const irtkSHCoefficientImage *_coeffs ) : 
+    reconstructor(_reconstructor), coeffs(_coeffs) { }
 
     void operator() (const blocked_range<size_t> &r) const {
         for ( size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex ) {
@@ -833,25 +834,8 @@ public:
 
             reconstructor->_slice_inside[inputIndex] = false;
 	    
-	    
-	    //direction for current slice
-            int dirIndex = reconstructor->_stack_index[inputIndex]+1;
-            double gx=reconstructor->_directions[0][dirIndex];
-            double gy=reconstructor->_directions[1][dirIndex];
-            double gz=reconstructor->_directions[2][dirIndex];
-            reconstructor->RotateDirections(gx,gy,gz,inputIndex);
-            double bval=reconstructor->_bvalues[dirIndex];
-	    irtkSphericalHarmonics sh;
-	    irtkMatrix dir(1,3);
-	    dir(0,0)=gx;
-	    dir(0,1)=gy;
-	    dir(0,2)=gz;
-	    irtkMatrix basis = sh.SHbasis(dir,reconstructor->_order);
-	    if(basis.Cols() != reconstructor->_SH_coeffs.GetT())
-	    {
-	      cerr<<"ParallelSimulateSlicesDTI:basis numbers does not match SH coefficients number."<<endl;
-	      exit(1);
-	    }
+	    //SH basis of direction for current slice
+	    const double *basis = reconstructor->GetSliceBasis(inputIndex);
 	    double sim_signal;
             
             POINT3D p;
@@ -864,9 +848,7 @@ public:
 			     //PSF
                             p = reconstructor->_volcoeffs[inputIndex][i][j][k];
 			    //signal simulated from SH
-			     sim_signal = 0;
-			     for(unsigned int l = 0; l < basis.Cols(); l++ )
-			       sim_signal += reconstructor->_SH_coeffs(p.x, p.y, p.z,l)*basis(0,l);
+			     sim_signal = coeffs->Dot(p.x, p.y, p.z, basis);
 			     //update slice
                             reconstructor->_simulated_slices[inputIndex](i, j, 0) += p.value * sim_signal;
                             weight += p.value;
@@ -894,12 +876,55 @@ public:
 
 };
 
+const double* irtkReconstructionDTI::GetSliceBasis(int inputIndex)
+{
+    //direction for current slice
+    int dirIndex = _stack_index[inputIndex]+1;
+    double gx=_directions[0][dirIndex];
+    double gy=_directions[1][dirIndex];
+    double gz=_directions[2][dirIndex];
+    RotateDirections(gx,gy,gz,inputIndex);
+
+    //basis only changes with the direction, i.e. with the slice transformation
+    vector<double>& dir = _slice_basis_dir[inputIndex];
+    vector<double>& basis = _slice_basis[inputIndex];
+    if ((dir.size() != 4) || (dir[0] != gx) || (dir[1] != gy) || (dir[2] != gz) || (dir[3] != _order))
+    {
+      irtkSphericalHarmonics sh;
+      irtkMatrix d(1,3);
+      d(0,0)=gx;
+      d(0,1)=gy;
+      d(0,2)=gz;
+      irtkMatrix b = sh.SHbasis(d,_order);
+      if(b.Cols() != _SH_coeffs.GetT())
+      {
+        cerr<<"GetSliceBasis: basis numbers does not match SH coefficients number."<<endl;
+        exit(1);
+      }
+      basis.resize(b.Cols());
+      for(int l = 0; l < b.Cols(); l++)
+        basis[l] = b(0,l);
+      dir.resize(4);
+      dir[0]=gx;
+      dir[1]=gy;
+      dir[2]=gz;
+      dir[3]=_order;
+    }
+    return &basis[0];
+}
+
 void irtkReconstructionDTI::SimulateSlicesDTI()
 {
     if (_debug)
         cout<<"Simulating slices DTI."<<endl;
 
-    ParallelSimulateSlicesDTI parallelSimulateSlicesDTI( this );
+    //SH coefficients voxel by voxel and a basis cache entry per slice
+    irtkSHCoefficientImage coeffs;
+    coeffs.Put(_SH_coeffs);
+    _slice_basis.resize(_slices.size());
+    _slice_basis_dir.resize(_slices.size());
+
+    ParallelSimulateSlicesDTI parallelSimulateSlicesDTI( this, &coeffs );
     parallelSimulateSlicesDTI();
 
     if (_debug)
@@ -913,11 +938,14 @@ double irtkReconstructionDTI::ConsistencyDTI()
   double diff;
   for(int index = 0; index< _slices.size(); index++)
   {
+    irtkRealImage simbuf, insidebuf;
+    const irtkRealImage& sim = SimulatedSlice(index, simbuf);
+    const irtkRealImage& inside = SimulatedInside(index, insidebuf);
     for(int i=0;i<_slices[index].GetX();i++)
       for(int j=0;j<_slices[index].GetY();j++)
-	if((_slices[index](i,j,0)>=0)&&(_simulated_inside[index](i,j,0)==1))
+	if((_slices[index](i,j,0)>=0)&&(inside(i,j,0)==1))
 	{
-	  diff = _slices[index](i,j,0)-_simulated_slices[index](i,j,0);
+	  diff = _slices[index](i,j,0)-sim(i,j,0);
 	  ssd+=diff*diff;
 	  num++;
 	}
@@ -929,16 +957,19 @@ double irtkReconstructionDTI::ConsistencyDTI()
 class ParallelSuperresolutionDTI {
     irtkReconstructionDTI* reconstructor;
 public:
+    //confidence is the same for all SH coefficients of a voxel
     irtkRealImage confidence_map;
-    irtkRealImage addon;
+    irtkSHCoefficientImage addon;
     
     void operator()( const blocked_range<size_t>& r ) {
         for ( size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
             // read the current slice
             irtkRealImage slice = reconstructor->_slices[inputIndex];
                 
-            // read the current slice
-            irtkRealImage sim = reconstructor->_simulated_slices[inputIndex];
+            // read the current simulated slice and weights
+            irtkRealImage simbuf, simwbuf;
+            irtkRealImage sim = reconstructor->SimulatedSlice(inputIndex, simbuf);
+            const irtkRealImage& simw = reconstructor->SimulatedWeights(inputIndex, simwbuf);
                 
             //read the current weight image
             irtkRealImage& w = reconstructor->_weights[inputIndex];
@@ -953,24 +984,9 @@ public:
 	      cerr<<"Scale is 0 for slice "<<inputIndex<<endl;
 	      exit(1);
 	    }
-	    //direction for current slice
-            int dirIndex = reconstructor->_stack_index[inputIndex]+1;
-            double gx=reconstructor->_directions[0][dirIndex];
-            double gy=reconstructor->_directions[1][dirIndex];
-            double gz=reconstructor->_directions[2][dirIndex];
-            reconstructor->RotateDirections(gx,gy,gz,inputIndex);
-            double bval=reconstructor->_bvalues[dirIndex];
-	    irtkSphericalHarmonics sh;
-	    irtkMatrix dir(1,3);
-	    dir(0,0)=gx;
-	    dir(0,1)=gy;
-	    dir(0,2)=gz;
-	    irtkMatrix basis = sh.SHbasis(dir,reconstructor->_order);
-	    if(basis.Cols() != reconstructor->_SH_coeffs.GetT())
-	    {
-	      cerr<<"ParallelSimulateSlicesDTI:basis numbers does not match SH coefficients number."<<endl;
-	      exit(1);
-	    }
+	    //SH basis of direction for current slice
+	    const double *basis = reconstructor->GetSliceBasis(inputIndex);
+	    double slice_weight = reconstructor->_slice_weight[inputIndex];
 
             //Update reconstructed volume using current slice
 
@@ -985,37 +1001,29 @@ public:
 			else
                           sim(i, j, 0) *= exp(b(i, j, 0)) / scale;
                         
-                        if ( reconstructor->_simulated_weights[inputIndex](i,j,0) > 0.5 )
+                        if ( simw(i,j,0) > 0.5 )
                             slice(i,j,0) -= sim(i,j,0);
                         else
                             slice(i,j,0) = 0;
 
+                        //weights of PSF values for error and confidence
+                        double error_weight, confidence_weight;
+			if(reconstructor->_robust_slices_only)
+			{
+			  error_weight = slice(i, j, 0) * slice_weight;
+			  confidence_weight = slice_weight;
+			}
+			else
+			{
+			  error_weight = slice(i, j, 0) * w(i, j, 0) * slice_weight * exp(b(i, j, 0)) / scale;
+			  confidence_weight = w(i, j, 0) * slice_weight;
+			}
+
                         int n = reconstructor->_volcoeffs[inputIndex][i][j].size();
                         for (int k = 0; k < n; k++) {
                             p = reconstructor->_volcoeffs[inputIndex][i][j][k];
-			    if(reconstructor->_robust_slices_only)
-			    {
-			      for(unsigned int l = 0; l < basis.Cols(); l++ )
-			      {				
-                                addon(p.x, p.y, p.z,l) += p.value * basis(0,l) * slice(i, j, 0) * reconstructor->_slice_weight[inputIndex];
-                                confidence_map(p.x, p.y, p.z,l) += p.value *reconstructor->_slice_weight[inputIndex];
-			      }
-			      
-			    }
-			    else
-			    {
-                              for(unsigned int l = 0; l < basis.Cols(); l++ )
-			       {
-				 if((p.x==20)&&(p.y==50)&&(p.z==40))
-				  {
-				    //cerr<<inputIndex<<" "<<p.value<<" "<<basis(0,l)<<" "<<slice(i, j, 0)<<" "<<w(i, j, 0)<<" "<<reconstructor->_slice_weight[inputIndex]<<endl;
-				    //cerr<<inputIndex<<" "<<exp(b(i, j, 0)) / scale<<" "<<b(i,j,0)<<" "<<scale<<" "<<slice(i, j, 0)<<" "<<w(i, j, 0)<<" "<<reconstructor->_slices[inputIndex](i,j,0)<<" "<<reconstructor->_weights[inputIndex](i,j,0)<<endl;
-				  }
-				  addon(p.x, p.y, p.z, l) += p.value * basis(0,l) * slice(i, j, 0) * w(i, j, 0) * reconstructor->_slice_weight[inputIndex]* exp(b(i, j, 0)) / scale;
-                                confidence_map(p.x, p.y, p.z, l) += p.value * w(i, j, 0) * reconstructor->_slice_weight[inputIndex];
-                                //p.value * basis(0,l) * w(i, j, 0) * reconstructor->_slice_weight[inputIndex];
-			       }
-			    }
+                            addon.Add(p.x, p.y, p.z, basis, p.value * error_weight);
+                            confidence_map(p.x, p.y, p.z) += p.value * confidence_weight;
                         }
                     }
         } //end of loop for a slice inputIndex
@@ -1025,11 +1033,12 @@ public:
         reconstructor(x.reconstructor)
     {
         //Clear addon
-        addon.Initialize( reconstructor->_SH_coeffs.GetImageAttributes() );
-        addon = 0;
+        addon.Initialize( reconstructor->_SH_coeffs.GetX(), reconstructor->_SH_coeffs.GetY(), reconstructor->_SH_coeffs.GetZ(), reconstructor->_SH_coeffs.GetT() );
 
         //Clear confidence map
-        confidence_map.Initialize( reconstructor->_SH_coeffs.GetImageAttributes() );
+        irtkImageAttributes attr = reconstructor->_SH_coeffs.GetImageAttributes();
+        attr._t = 1;
+        confidence_map.Initialize( attr );
         confidence_map = 0;
     }
  
@@ -1042,20 +1051,18 @@ public:
     reconstructor(reconstructor)
     {
         //Clear addon
-        addon.Initialize( reconstructor->_SH_coeffs.GetImageAttributes() );
-        addon = 0;
+        addon.Initialize( reconstructor->_SH_coeffs.GetX(), reconstructor->_SH_coeffs.GetY(), reconstructor->_SH_coeffs.GetZ(), reconstructor->_SH_coeffs.GetT() );
 
         //Clear confidence map
-        confidence_map.Initialize( reconstructor->_SH_coeffs.GetImageAttributes() );
+        irtkImageAttributes attr = reconstructor->_SH_coeffs.GetImageAttributes();
+        attr._t = 1;
+        confidence_map.Initialize( attr );
         confidence_map = 0;
     }
 
     // execute
     void operator() () {
-        task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,reconstructor->_slices.size()),
-                         *this );
-        init.terminate();
+        reconstructor->ParallelReduce( reconstructor->_slices.size(), *this );
     }         
 };
 
@@ -1071,10 +1078,21 @@ void irtkReconstructionDTI::SuperresolutionDTI(int iter, bool tv, double sh_alph
     //Remember current reconstruction for edge-preserving smoothing
     original = _SH_coeffs;
 
+    _slice_basis.resize(_slices.size());
+    _slice_basis_dir.resize(_slices.size());
+
     ParallelSuperresolutionDTI parallelSuperresolutionDTI(this);
     parallelSuperresolutionDTI();
-    addon = parallelSuperresolutionDTI.addon;
-    _confidence_map = parallelSuperresolutionDTI.confidence_map;
+
+    //back to coefficients in t, confidence repeated for each coefficient
+    addon.Initialize( _SH_coeffs.GetImageAttributes() );
+    parallelSuperresolutionDTI.addon.Get(addon);
+    _confidence_map.Initialize( _SH_coeffs.GetImageAttributes() );
+    for (l = 0; l < _confidence_map.GetT(); l++)
+      for (k = 0; k < _confidence_map.GetZ(); k++)
+        for (j = 0; j < _confidence_map.GetY(); j++)
+          for (i = 0; i < _confidence_map.GetX(); i++)
+            _confidence_map(i, j, k, l) = parallelSuperresolutionDTI.confidence_map(i, j, k);
     //_confidence4mask = _confidence_map;
     
     if(_debug) {
@@ -1154,11 +1172,14 @@ void irtkReconstructionDTI::SuperresolutionDTI(int iter, bool tv, double sh_alph
       for (int steps = 0; steps < _regul_steps; steps ++)
       {
       r=_reconstructed;
+      o.Initialize(_SH_coeffs.GetFrameView(0).GetImageAttributes());
+      _reconstructed.Initialize(o.GetImageAttributes());
       for(t=0;t<_SH_coeffs.GetT();t++)
       {
-	o=original.GetRegion(0,0,0,t,original.GetX(),original.GetY(),original.GetZ(),t+1);
+	irtkGenericImageView<irtkRealPixel> frame = _SH_coeffs.GetFrameView(t);
+	original.GetFrameView(t).CopyTo(o.GetPointerToVoxels());
 	//o.Write("o.nii.gz");
-	_reconstructed=_SH_coeffs.GetRegion(0,0,0,t,original.GetX(),original.GetY(),original.GetZ(),t+1);
+	frame.CopyTo(_reconstructed.GetPointerToVoxels());
 	//_reconstructed.Write("r.nii.gz");
 	
 	//L22Regularization(iter, o);
@@ -1173,12 +1194,7 @@ void irtkReconstructionDTI::SuperresolutionDTI(int iter, bool tv, double sh_alph
 	//_reconstructed.Write("r1.nii.gz");
 	
 	//put it back to _SH_coeffs
-        for (i = 0; i < _SH_coeffs.GetX(); i++)
-          for (j = 0; j < _SH_coeffs.GetY(); j++)
-            for (k = 0; k < _SH_coeffs.GetZ(); k++) 
-	    {
-	      _SH_coeffs(i,j,k,t)=_reconstructed(i,j,k);
-	    }
+	frame.CopyFrom(_reconstructed.GetPointerToVoxels());
       }
           _reconstructed=r;
       }
@@ -1234,10 +1250,12 @@ double irtkReconstructionDTI::LaplacianSmoothnessDTI()
     double sum=0;
     irtkRealImage o,r;
     r=_reconstructed;
+    o.Initialize(_SH_coeffs.GetFrameView(0).GetImageAttributes());
+    _reconstructed.Initialize(o.GetImageAttributes());
     for(int t=0;t<_SH_coeffs.GetT();t++)
     {
-      o=_SH_coeffs.GetRegion(0,0,0,t,_SH_coeffs.GetX(),_SH_coeffs.GetY(),_SH_coeffs.GetZ(),t+1);
-      _reconstructed=_SH_coeffs.GetRegion(0,0,0,t,_SH_coeffs.GetX(),_SH_coeffs.GetY(),_SH_coeffs.GetZ(),t+1);
+      _SH_coeffs.GetFrameView(t).CopyTo(o.GetPointerToVoxels());
+      _SH_coeffs.GetFrameView(t).CopyTo(_reconstructed.GetPointerToVoxels());
       sum+=LaplacianSmoothness(o);
       
     }     
@@ -1357,6 +1375,9 @@ void irtkReconstructionDTI::InitSH(irtkMatrix dirs, int order)
   
   _SH_coeffs = _sh.Signal2Coeff(_simulated_signal);
   _SH_coeffs.Write("_SH_coeffs.nii.gz");
+  //the 4D signal of all directions is not needed any more, SH coefficients
+  //represent it and single directions are simulated on demand
+  _simulated_signal.Clear();
   _order = order;
   _dirs = dirs;
   _coeffNum = _sh.NforL(_order);
@@ -1405,6 +1426,134 @@ void irtkReconstructionDTI::SaveSHcoeffs(int iteration)
   _SH_coeffs.Write(buffer);
 }
 
+//magic string and end marker of checkpoint files
+static const char _checkpoint_magic[16] = "IRTKDWICHECKPT1";
+static const int _checkpoint_end = 0x454e4421;
+
+void irtkReconstructionDTI::SaveCheckpoint(const char *name, int iteration)
+{
+  unsigned int inputIndex;
+  int j, n;
+  int header[7];
+  double robust[9], slice[2], params[6];
+  char buffer[16];
+
+  //write to a temporary file which replaces the checkpoint when complete
+  string tmp_name = string(name) + ".tmp";
+  irtkCofstream to;
+  to.Open(tmp_name.c_str());
+
+  memcpy(buffer, _checkpoint_magic, 16);
+  to.WriteAsChar(buffer, 16);
+  header[0] = iteration;
+  header[1] = _slices.size();
+  header[2] = _SH_coeffs.GetX();
+  header[3] = _SH_coeffs.GetY();
+  header[4] = _SH_coeffs.GetZ();
+  header[5] = _SH_coeffs.GetT();
+  header[6] = _order;
+  to.WriteAsInt(header, 7);
+
+  //robust statistics
+  robust[0] = _sigma;
+  robust[1] = _mix;
+  robust[2] = _m;
+  robust[3] = _mean_s;
+  robust[4] = _sigma_s;
+  robust[5] = _mean_s2;
+  robust[6] = _sigma_s2;
+  robust[7] = _mix_s;
+  robust[8] = _step;
+  to.WriteAsDouble(robust, 9);
+
+  //SH coefficients
+  to.WriteAsDouble(_SH_coeffs.GetPointerToVoxels(), _SH_coeffs.GetNumberOfVoxels());
+
+  //slice weights, scales, transformations, bias fields and voxel weights
+  for (inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+    n = _slices[inputIndex].GetNumberOfVoxels();
+    to.WriteAsInt(n);
+    slice[0] = _slice_weight[inputIndex];
+    slice[1] = _scale[inputIndex];
+    to.WriteAsDouble(slice, 2);
+    for (j = 0; j < 6; j++)
+      params[j] = _transformations[inputIndex].Get(j);
+    to.WriteAsDouble(params, 6);
+    to.WriteAsDouble(_bias[inputIndex].GetPointerToVoxels(), n);
+    to.WriteAsDouble(_weights[inputIndex].GetPointerToVoxels(), n);
+  }
+  to.WriteAsInt(_checkpoint_end);
+  to.Close();
+
+  if (rename(tmp_name.c_str(), name) != 0) {
+    cerr << "irtkReconstructionDTI::SaveCheckpoint: Can't write " << name << endl;
+    exit(1);
+  }
+}
+
+int irtkReconstructionDTI::ReadCheckpoint(const char *name)
+{
+  unsigned int inputIndex;
+  int j, n, end;
+  int header[7];
+  double robust[9], slice[2], params[6];
+  char buffer[16];
+
+  irtkCifstream from;
+  from.Open(name);
+
+  from.ReadAsChar(buffer, 16);
+  if (memcmp(buffer, _checkpoint_magic, 16) != 0) {
+    cerr << "irtkReconstructionDTI::ReadCheckpoint: " << name << " is not a checkpoint" << endl;
+    exit(1);
+  }
+  from.ReadAsInt(header, 7);
+  if ((header[1] != int(_slices.size())) || (header[2] != _SH_coeffs.GetX()) || (header[3] != _SH_coeffs.GetY()) ||
+      (header[4] != _SH_coeffs.GetZ()) || (header[5] != _SH_coeffs.GetT()) || (header[6] != _order)) {
+    cerr << "irtkReconstructionDTI::ReadCheckpoint: " << name << " does not match slices or SH coefficients" << endl;
+    exit(1);
+  }
+
+  from.ReadAsDouble(robust, 9);
+  _sigma = robust[0];
+  _mix = robust[1];
+  _m = robust[2];
+  _mean_s = robust[3];
+  _sigma_s = robust[4];
+  _mean_s2 = robust[5];
+  _sigma_s2 = robust[6];
+  _mix_s = robust[7];
+  _step = robust[8];
+
+  from.ReadAsDouble(_SH_coeffs.GetPointerToVoxels(), _SH_coeffs.GetNumberOfVoxels());
+
+  for (inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+    from.ReadAsInt(&n, 1);
+    if (n != _slices[inputIndex].GetNumberOfVoxels()) {
+      cerr << "irtkReconstructionDTI::ReadCheckpoint: slice " << inputIndex << " does not match" << endl;
+      exit(1);
+    }
+    from.ReadAsDouble(slice, 2);
+    _slice_weight[inputIndex] = slice[0];
+    _scale[inputIndex] = slice[1];
+    from.ReadAsDouble(params, 6);
+    for (j = 0; j < 6; j++)
+      _transformations[inputIndex].Put(j, params[j]);
+    from.ReadAsDouble(_bias[inputIndex].GetPointerToVoxels(), n);
+    from.ReadAsDouble(_weights[inputIndex].GetPointerToVoxels(), n);
+  }
+
+  end = 0;
+  from.ReadAsInt(&end, 1);
+  from.Close();
+  if (end != _checkpoint_end) {
+    cerr << "irtkReconstructionDTI::ReadCheckpoint: " << name << " is incomplete" << endl;
+    exit(1);
+  }
+
+  return header[0];
+}
+
 void irtkReconstructionDTI::PostProcessMotionParameters(irtkRealImage target, bool empty) //, int packages)
 {
   if(_slice_order.size()!=_transformations.size())
@@ -2547,7 +2696,7 @@ public:
                 m=m*mo;
                 reconstructor->_transformations[inputIndex].PutMatrix(m);
 
-                irtkGreyImage source = reconstructor->_simulated_signal.GetRegion(0,0,0,reconstructor->_stack_index[inputIndex],reconstructor->_simulated_signal.GetX(),reconstructor->_simulated_signal.GetY(),reconstructor->_simulated_signal.GetZ(),reconstructor->_stack_index[inputIndex]+1);
+                irtkGreyImage source = reconstructor->_sh.Coeff2Signal(reconstructor->_SH_coeffs,reconstructor->_stack_index[inputIndex]);
 		sprintf(buffer,"source%i.nii.gz",ii);
 		source.Write(buffer);
                 registration.SetInput(&target, &source);
@@ -2637,9 +2786,9 @@ public:
     ParallelNormaliseBiasDTI( ParallelNormaliseBiasDTI& x, split ) :
         reconstructor(x.reconstructor)
     {
-        bias.Initialize( reconstructor->_simulated_signal.GetImageAttributes() );
+        bias.Initialize( reconstructor->SignalAttributes() );
         bias = 0;    
-	weights.Initialize( reconstructor->_simulated_signal.GetImageAttributes() );
+	weights.Initialize( reconstructor->SignalAttributes() );
 	weights = 0;
     }
  
@@ -2651,18 +2800,15 @@ public:
     ParallelNormaliseBiasDTI( irtkReconstructionDTI *reconstructor ) :
     reconstructor(reconstructor)
     {
-        bias.Initialize( reconstructor->_simulated_signal.GetImageAttributes() );
+        bias.Initialize( reconstructor->SignalAttributes() );
         bias = 0;    
-	weights.Initialize( reconstructor->_simulated_signal.GetImageAttributes() );
+	weights.Initialize( reconstructor->SignalAttributes() );
 	weights = 0;
     }
 
     // execute
     void operator() () {
-        task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,reconstructor->_slices.size()),
-                         *this );
-        init.terminate();
+        reconstructor->ParallelReduce( reconstructor->_slices.size(), *this );
     }        
 };
 /*
@@ -2730,10 +2876,7 @@ public:
 
     // execute
     void operator() () {
-        task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,reconstructor->_slices.size()),
-                         *this );
-        init.terminate();
+        reconstructor->ParallelReduce( reconstructor->_slices.size(), *this );
     }        
 };
 */
@@ -1319,6 +1319,7 @@ void irtkReconstructionb0::SmoothFieldmap(int iter)
 
     //Smooth the distortion displacements
     irtkLaplacianSmoothing smoothing;
+    smoothing.SetDebug(_debug);
     smoothing.SetInput(distortion);
     smoothing.SetMask(_larger_mask);
     irtkRealImage fieldmap = smoothing.RunGD();
@@ -1373,6 +1374,7 @@ void irtkReconstructionb0::SmoothFieldmapGroup(irtkRealImage mask, int group, in
   cout<<"test"<<endl;
   cout.flush();
   irtkLaplacianSmoothing smoothing;
+  smoothing.SetDebug(_debug);
   sprintf(buffer,"_distortion%i-%i.nii.gz",iter,group);
   _distortion.Write(buffer);
   smoothing.SetInput(_distortion);
@@ -0,0 +1,65 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+  Visual Information Processing (VIP), 2011 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+  =========================================================================*/
+
+#include <irtkSHCoefficientImage.h>
+
+irtkSHCoefficientImage::irtkSHCoefficientImage()
+{
+  _x = _y = _z = _n = 0;
+}
+
+void irtkSHCoefficientImage::Initialize(int x, int y, int z, int n)
+{
+  _x = x;
+  _y = y;
+  _z = z;
+  _n = n;
+  _data.assign(size_t(x) * y * z * n, 0);
+}
+
+void irtkSHCoefficientImage::Put(const irtkRealImage &image)
+{
+  int l;
+  size_t i, nvox;
+
+  Initialize(image.GetX(), image.GetY(), image.GetZ(), image.GetT());
+  nvox = size_t(_x) * _y * _z;
+  const irtkRealPixel *ptr = image.GetPointerToVoxels();
+  for (l = 0; l < _n; l++)
+    for (i = 0; i < nvox; i++)
+      _data[i * _n + l] = *ptr++;
+}
+
+void irtkSHCoefficientImage::Get(irtkRealImage &image) const
+{
+  int l;
+  size_t i, nvox;
+
+  if ((image.GetX() != _x) || (image.GetY() != _y) || (image.GetZ() != _z) || (image.GetT() != _n)) {
+    cerr << "irtkSHCoefficientImage::Get: image has wrong dimensions" << endl;
+    exit(1);
+  }
+  nvox = size_t(_x) * _y * _z;
+  irtkRealPixel *ptr = image.GetPointerToVoxels();
+  for (l = 0; l < _n; l++)
+    for (i = 0; i < nvox; i++)
+      *ptr++ = _data[i * _n + l];
+}
+
+irtkSHCoefficientImage& irtkSHCoefficientImage::operator+=(const irtkSHCoefficientImage &image)
+{
+  size_t i;
+
+  for (i = 0; i < _data.size(); i++)
+    _data[i] += image._data[i];
+  return *this;
+}
@@ -214,7 +214,49 @@ irtkVector irtkSphericalHarmonics::Signal2Coeff(irtkVector s)
   
 }
 
-irtkRealImage irtkSphericalHarmonics::Signal2Coeff(irtkRealImage signal)
+class ParallelSHTransform {
+    const vector<double> &matrix;
+    const irtkRealImage &input;
+    irtkRealImage &output;
+    bool positive_only;
+
+public:
+    ParallelSHTransform( const vector<double> &_matrix, const irtkRealImage &_input, irtkRealImage &_output, bool _positive_only ) :
+    matrix(_matrix), input(_input), output(_output), positive_only(_positive_only) { }
+
+    void operator() (const blocked_range<size_t> &r) const {
+        int i, j, t, c;
+        int nIn = input.GetT();
+        int nOut = output.GetT();
+        double value;
+        vector<double> v(nIn);
+        for ( size_t k = r.begin(); k != r.end(); ++k )
+            for(j=0;j<input.GetY();j++)
+                for(i=0;i<input.GetX();i++)
+                {
+                    if((positive_only)&&(input(i,j,k,0)<=0))
+                        continue;
+                    for(c=0;c<nIn;c++)
+                        v[c]=input(i,j,k,c);
+                    for(t=0;t<nOut;t++)
+                    {
+                        value=0;
+                        for(c=0;c<nIn;c++)
+                            value+=matrix[t*nIn+c]*v[c];
+                        output(i,j,k,t)=value;
+                    }
+                }
+    }
+
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, input.GetZ()), *this );
+        init.terminate();
+    }
+};
+
+irtkRealImage irtkSphericalHarmonics::Signal2Coeff(const irtkRealImage& signal)
 {
   if(signal.GetT()!=_iSHT.Cols())
   {
@@ -225,29 +267,18 @@ irtkRealImage irtkSphericalHarmonics::Signal2Coeff(irtkRealImage signal)
   irtkImageAttributes attr = signal.GetImageAttributes();
   attr._t = _iSHT.Rows();
   irtkRealImage coeffs(attr);
-  irtkVector s(signal.GetT());
-  irtkVector a;
-  int i,j,k,t;
-  for(k=0;k<signal.GetZ();k++)
-    for(j=0;j<signal.GetY();j++)
-      for(i=0;i<signal.GetX();i++)
-      {
-	if(signal(i,j,k,0)>0)
-	{
-	  for(t=0;t<signal.GetT();t++)
-	    s(t)=signal(i,j,k,t);
-	  a=Signal2Coeff(s);
-	  for(t=0;t<coeffs.GetT();t++)
-	    coeffs(i,j,k,t)=a(t);
-	}
-      }
-  
+  vector<double> matrix(_iSHT.Rows()*_iSHT.Cols());
+  for(int t=0;t<_iSHT.Rows();t++)
+    for(int c=0;c<_iSHT.Cols();c++)
+      matrix[t*_iSHT.Cols()+c]=_iSHT(t,c);
+  ParallelSHTransform transform(matrix, signal, coeffs, true);
+  transform();
   
   return coeffs;
 }
 
 
-irtkRealImage irtkSphericalHarmonics::Coeff2Signal(irtkRealImage coeffs)
+irtkRealImage irtkSphericalHarmonics::Coeff2Signal(const irtkRealImage& coeffs)
 {
   if(coeffs.GetT()!=_SHT.Cols())
   {
@@ -258,24 +289,33 @@ irtkRealImage irtkSphericalHarmonics::Coeff2Signal(irtkRealImage coeffs)
   irtkImageAttributes attr = coeffs.GetImageAttributes();
   attr._t = _SHT.Rows();
   irtkRealImage signal(attr);
-  irtkVector c(coeffs.GetT());
-  irtkVector s;
-  int i,j,k,t;
-  for(k=0;k<coeffs.GetZ();k++)
-    for(j=0;j<coeffs.GetY();j++)
-      for(i=0;i<coeffs.GetX();i++)
-      {
-	//it should be ok - the first coeff should not be negative for positive signal
-	//if(coeffs(i,j,k,0)>0)
-	//{
-	  for(t=0;t<coeffs.GetT();t++)
-	    c(t)=coeffs(i,j,k,t);
-	  s=Coeff2Signal(c);
-	  for(t=0;t<signal.GetT();t++)
-	    signal(i,j,k,t)=s(t);
-	//}
-      }
+  //it should be ok - the first coeff should not be negative for positive signal
+  vector<double> matrix(_SHT.Rows()*_SHT.Cols());
+  for(int t=0;t<_SHT.Rows();t++)
+    for(int c=0;c<_SHT.Cols();c++)
+      matrix[t*_SHT.Cols()+c]=_SHT(t,c);
+  ParallelSHTransform transform(matrix, coeffs, signal, false);
+  transform();
   
+  return signal;
+}
+
+irtkRealImage irtkSphericalHarmonics::Coeff2Signal(const irtkRealImage& coeffs, int direction)
+{
+  if((coeffs.GetT()!=_SHT.Cols())||(direction<0)||(direction>=_SHT.Rows()))
+  {
+    cerr<<"dimensions of SH coeffs and number of basis do not match or invalid direction: "<<coeffs.GetT()<<" "<<_SHT.Cols()<<" "<<direction<<endl;
+    exit(1);
+  }
+  //create image with signal of the direction
+  irtkImageAttributes attr = coeffs.GetImageAttributes();
+  attr._t = 1;
+  irtkRealImage signal(attr);
+  vector<double> matrix(_SHT.Cols());
+  for(int c=0;c<_SHT.Cols();c++)
+    matrix[c]=_SHT(direction,c);
+  ParallelSHTransform transform(matrix, coeffs, signal, false);
+  transform();
   
   return signal;
 }
\ No newline at end of file
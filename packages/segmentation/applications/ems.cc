@@ -17,13 +17,19 @@ char *output_name;
 void usage()
 {
   cerr << "Usage: ems [image] [n] [atlas 1 ... atlas n] [output] <options>" << endl;
+  cerr << "where <options> is one or more of the following:" << endl;
+  cerr << "<-iterations n>       Maximum number of iterations" << endl;
+  cerr << "<-padding value>      Padding value of the image" << endl;
+  cerr << "<-background file>    Probability map of the background" << endl;
+  cerr << "<-nobg>               Do not add a background tissue" << endl;
+  cerr << "<-compress>           Store the atlas as 16 bit quantised tiles" << endl;
   exit(1);
 }
 
 int main(int argc, char **argv)
 {
   int i, n, ok, padding, iterations;
-  bool nobg=false;
+  bool nobg=false, compress=false;
 
   if (argc < 4) {
     usage();
@@ -100,6 +106,12 @@ int main(int argc, char **argv)
       cerr << "Not adding background tissue."<<endl;
       ok = true;
     }
+    if ((ok == false) && (strcmp(argv[1], "-compress") == 0)) {
+      argc--;
+      argv++;
+      compress = true;
+      ok = true;
+    }
     if (ok == false) {
       cerr << "Can not parse argument " << argv[1] << endl;
       usage();
@@ -113,6 +125,7 @@ int main(int argc, char **argv)
   classification->SetPadding(padding);
   classification->SetInput(image);
   classification->Initialise();
+  if (compress) classification->CompressAtlas();
 
   double rel_diff;
   //for (i = 0; rel_diff > 0.0001; i++){
@@ -6,15 +6,16 @@
  */
 
 #include <irtkImage.h>
-#include <irtkMeanShift.h>
+#include <irtkConnectedComponents.h>
 
 char *input_name = NULL,*output_name = NULL;
 int label = 1;
+int connectivity = 6;
 bool ok;
 
 void usage()
 {
-  cerr << "Usage: lcc-queue [image] [output] <-label label>" << endl;
+  cerr << "Usage: lcc-queue [image] [output] <-label label> <-connectivity 6|18|26>" << endl;
   exit(1);
 }
 
@@ -50,6 +51,19 @@ int main(int argc, char **argv)
       ok = true;
     }
 
+    if ((ok == false) && (strcmp(argv[1], "-connectivity") == 0))
+    {
+      argc--;
+      argv++;
+
+      connectivity = atoi(argv[1]);
+      cout << "connectivity = " << connectivity << endl;
+
+      argc--;
+      argv++;
+      ok = true;
+    }
+
     if (ok == false){
       cerr << "Can not parse argument " << argv[1] << endl;
       usage();
@@ -61,9 +75,22 @@ int main(int argc, char **argv)
   // Read input
   image.Read(input_name);
 
-  irtkMeanShift msh(image);
-  msh.SetOutput(&image);
-  msh.Lcc(label);
+  irtkConnectedComponents<irtkGreyPixel> components(label);
+  if (connectivity == 6) components.SetConnectivity(CONNECTIVITY_06);
+  else if (connectivity == 18) components.SetConnectivity(CONNECTIVITY_18);
+  else if (connectivity == 26) components.SetConnectivity(CONNECTIVITY_26);
+  else usage();
+  components.SetInput(&image);
+  components.SetOutput(&image);
+  components.Run();
+
+  // Keep largest connected component
+  int lcc = components.GetLargestComponent();
+  const int *labels = components.GetPointerToLabels();
+  irtkGreyPixel *ptr = image.GetPointerToVoxels();
+  for (int i = 0; i < image.GetNumberOfVoxels(); i++) {
+    ptr[i] = ((lcc > 0) && (labels[i] == lcc)) ? 1 : 0;
+  }
 
   image.Write(output_name);
 
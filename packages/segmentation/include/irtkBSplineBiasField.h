@@ -127,7 +127,10 @@ public:
       the residual displacement errors at the points */
   virtual double Approximate(double *, double *, double *, double *, int);
 
-  /// Calculate weighted least square fit of B-spline to data
+  /** Calculate weighted least square fit of B-spline to data. The normal
+      equations are assembled in parallel from the separable basis and solved
+      by preconditioned conjugate gradients, starting from the current
+      control points. */
   virtual void WeightedLeastSquares(double *x1, double *y1, double *z1, double *bias, double *weights, int no);
 
   /** Interpolates displacements: This function takes a set of displacements
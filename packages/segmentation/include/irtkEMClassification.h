@@ -77,6 +77,15 @@ protected:
   /// Number of voxels
   int _number_of_voxels;
 
+  /// Indices of all voxels, those inside the mask first
+  vector<int> _voxel_index;
+
+  /// Number of voxels inside the mask (leading entries of _voxel_index)
+  int _number_of_masked_voxels;
+
+  /// Whether _voxel_index has been built for the current mask
+  bool _voxel_index_valid;
+
   /// Gaussian distribution parameters for each tissue type
   double *_mi;
   double *_sigma;
@@ -230,6 +239,9 @@ public:
   void GInit();
   void CreateMask();
   void SetMask(irtkRealImage &mask);
+  /// Rebuild the masked voxel list. SetMask() and CreateMask() call it, code
+  /// which modifies _mask in place must call it as well
+  void UpdateMaskedVoxels();
   virtual double MatchIntensity(double) {
     return 0;
   }
@@ -245,6 +257,9 @@ public:
 
   virtual void SetDebugFlag(bool debug);
 
+  /// Stores the atlas as 16 bit quantised tiles to reduce its memory
+  void CompressAtlas();
+
 };
 
 inline void irtkEMClassification::SetDebugFlag(bool debug)
@@ -252,6 +267,13 @@ inline void irtkEMClassification::SetDebugFlag(bool debug)
   _debug = debug;
 }
 
+inline void irtkEMClassification::CompressAtlas()
+{
+  long size = _atlas.GetMemorySize();
+  _atlas.Compress();
+  cerr << "Compressed atlas from " << size / 1048576.0 << " MB to " << _atlas.GetMemorySize() / 1048576.0 << " MB" << endl;
+}
+
 inline void irtkEMClassification::SetPadding(irtkRealPixel padding)
 {
   _padding = padding;
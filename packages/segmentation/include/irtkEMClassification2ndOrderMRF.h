@@ -66,9 +66,6 @@ protected:
 
 private:
   bool isPVclass(int pvclass);
-  double getMRFenergy(int index, int tissue);
-  double getMRFenergy_2nd_order(int index, int tissue);
-
   double getTau(int index, int tissue);
 
 public:
@@ -120,6 +117,9 @@ public:
   /// estimate probabilities using 1st and 2nd order MRF
   void EStepMRF_2nd_order(void);
 
+  /// estimate probabilities, in parallel over a red-black voxel partition if an MRF is used
+  void EStepMRF(bool first_order, bool second_order);
+
   /// relax priors
   void RStep(void);
 
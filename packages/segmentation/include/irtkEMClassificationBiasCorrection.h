@@ -41,6 +41,12 @@ protected:
   /// Gaussian filter
   irtkGaussianBlurring<irtkRealPixel>* _gb;
 
+  /// Weighted log residual, reused by every bias step
+  irtkRealImage _residual;
+
+  /// Blurred weights, reused by every bias step
+  irtkRealImage _blurred_weights;
+
 
  
 public:
@@ -4,6 +4,7 @@
 // queue::push/pop
 
 #include <irtkImage.h>
+#include <irtkConnectedComponents.h>
 #include <irtkDilation.h>
 #include <irtkErosion.h>
 #include <irtkGaussianBlurring.h>
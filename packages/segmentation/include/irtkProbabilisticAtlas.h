@@ -20,6 +20,30 @@
 
 #include <vector>
 
+/// Number of voxels per tile of a compressed probability map
+#define ATLASTILESIZE 4096
+
+/**
+
+Tile of a compressed probability map, quantised to 16 bits between the
+minimum and maximum of the tile. The quantisation error of a voxel is at
+most half a level, i.e. (max-min)/131070 or less than 7.7e-6 for values
+in [0, 1]. Tiles which are constant, in particular tiles outside the
+support of a prior, store no voxel data.
+
+*/
+
+struct irtkProbabilisticAtlasTile
+{
+  /// Value of quantisation level zero
+  irtkRealPixel _offset;
+
+  /// Difference between two consecutive quantisation levels
+  irtkRealPixel _step;
+
+  /// Quantisation levels, empty if the tile is constant
+  vector<unsigned short> _data;
+};
 
 /**
 
@@ -44,6 +68,23 @@ class irtkProbabilisticAtlas : public irtkObject
   /// Hard segmentation
   irtkRealImage _segmentation;
 
+  /// Whether the probability maps are stored as compressed tiles
+  bool _compressed;
+
+  /// Current voxel of a compressed atlas
+  int _current;
+
+  /// Geometry of the probability maps while compressed
+  irtkImageAttributes _attr;
+
+  /// Number of tiles per probability map
+  int _tiles_per_channel;
+
+  /// Tiles of all compressed probability maps
+  vector<irtkProbabilisticAtlasTile> _tiles;
+
+  /// Exits with an error if the atlas is compressed
+  void CheckUncompressed(const char *) const;
 
 public:
 
@@ -74,6 +115,12 @@ public:
   /// Returns intensity value at position
   irtkRealPixel GetValue(int x, int y, int z, int t, unsigned int tissue);
 
+  /// Returns intensity value at voxel index, safe for concurrent use
+  irtkRealPixel GetValueAtIndex(int index, unsigned int channel) const;
+
+  /// Returns pointer to the first voxel of a probability map (atlas must not be compressed)
+  irtkRealPixel *GetPointerToVoxels(unsigned int channel);
+
   ///Sets intensity value at pointer
   void SetValue(unsigned int tissue, irtkRealPixel value);
 
@@ -115,23 +162,52 @@ public:
 
   irtkRealImage GetImage(int);
 
+  /** Stores the probability maps as tiles quantised to 16 bits. The values
+      are read through GetValue as before. A compressed atlas is read-only:
+      GetPointerToVoxels and all functions which modify the probability
+      maps exit with an error until Decompress() is called. */
+  void Compress();
+
+  /// Restores the full probability maps of a compressed atlas
+  void Decompress();
+
+  /// Returns whether the atlas is compressed
+  bool IsCompressed() const;
+
+  /// Returns the memory used by the probability maps in bytes
+  long GetMemorySize() const;
+
 };
 
 inline void irtkProbabilisticAtlas::First()
 {
   unsigned int i;
+  _current = 0;
+  if (_compressed) return;
   for (i=0; i<_pointers.size(); i++) _pointers[i] = _images[i].GetPointerToVoxels();
 }
 
 inline void irtkProbabilisticAtlas::Next()
 {
   unsigned int i;
+  _current++;
+  if (_compressed) return;
   for (i=0; i<_pointers.size(); i++) _pointers[i]++;
 }
 
+inline irtkRealPixel irtkProbabilisticAtlas::GetValueAtIndex(int index, unsigned int channel) const
+{
+  if (!_compressed) return _images[channel].GetPointerToVoxels()[index];
+
+  const unsigned int i = index;
+  const irtkProbabilisticAtlasTile &tile = _tiles[channel * _tiles_per_channel + i / ATLASTILESIZE];
+  if (tile._data.empty()) return tile._offset;
+  return tile._offset + tile._step * tile._data[i % ATLASTILESIZE];
+}
+
 inline irtkRealPixel irtkProbabilisticAtlas::GetValue(unsigned int channel)
 {
-  if (channel < _images.size()) return *_pointers[channel];
+  if (channel < _images.size()) return (!_compressed) ? *_pointers[channel] : GetValueAtIndex(_current, channel);
   else {
     cerr << "Channel identificator " << channel <<" out of range." <<endl;
     exit(1);
@@ -140,7 +216,10 @@ inline irtkRealPixel irtkProbabilisticAtlas::GetValue(unsigned int channel)
 
 inline irtkRealPixel irtkProbabilisticAtlas::GetValue(int x, int y, int z, unsigned int channel)
 {
-  if (channel < _images.size()) return _images[channel].Get(x,y,z);
+  if (channel < _images.size()) {
+    if (_compressed) return GetValueAtIndex(x + _attr._x * (y + _attr._y * z), channel);
+    return _images[channel].Get(x,y,z);
+  }
   else {
     cerr << "Channel identificator " << channel <<" out of range." <<endl;
     exit(1);
@@ -149,7 +228,20 @@ inline irtkRealPixel irtkProbabilisticAtlas::GetValue(int x, int y, int z, unsig
 
 inline irtkRealPixel irtkProbabilisticAtlas::GetValue(int x, int y, int z, int t, unsigned int channel)
 {
-  if (channel < _images.size()) return _images[channel].Get(x,y,z,t);
+  if (channel < _images.size()) {
+    if (_compressed) return GetValueAtIndex(x + _attr._x * (y + _attr._y * (z + _attr._z * t)), channel);
+    return _images[channel].Get(x,y,z,t);
+  }
+  else {
+    cerr << "Channel identificator " << channel <<" out of range." <<endl;
+    exit(1);
+  }
+}
+
+inline irtkRealPixel *irtkProbabilisticAtlas::GetPointerToVoxels(unsigned int channel)
+{
+  CheckUncompressed("GetPointerToVoxels");
+  if (channel < _images.size()) return _images[channel].GetPointerToVoxels();
   else {
     cerr << "Channel identificator " << channel <<" out of range." <<endl;
     exit(1);
@@ -158,6 +250,7 @@ inline irtkRealPixel irtkProbabilisticAtlas::GetValue(int x, int y, int z, int t
 
 inline void irtkProbabilisticAtlas::SetValue(unsigned int channel, irtkRealPixel value)
 {
+  CheckUncompressed("SetValue");
   if (channel < _images.size()) *_pointers[channel] = value;
   else {
     cerr << "Channel identificator " << channel << " out of range." <<endl;
@@ -167,6 +260,7 @@ inline void irtkProbabilisticAtlas::SetValue(unsigned int channel, irtkRealPixel
 
 inline void irtkProbabilisticAtlas::SetValue(int x, int y, int z, unsigned int channel, irtkRealPixel value)
 {
+  CheckUncompressed("SetValue");
   if (channel < _images.size()) _images[channel].Put( x, y, z, value);
   else {
     cerr << "Channel identificator " << channel <<" out of range." <<endl;
@@ -176,6 +270,7 @@ inline void irtkProbabilisticAtlas::SetValue(int x, int y, int z, unsigned int c
 
 inline void irtkProbabilisticAtlas::SetValue(int x, int y, int z, int t, unsigned int channel, irtkRealPixel value)
 {
+  CheckUncompressed("SetValue");
   if (channel < _images.size()) _images[channel].Put( x, y, z, t, value);
   else {
     cerr << "Channel identificator " << channel <<" out of range." <<endl;
@@ -193,4 +288,17 @@ inline int irtkProbabilisticAtlas::GetNumberOfTissues()
   return _number_of_tissues;
 }
 
+inline bool irtkProbabilisticAtlas::IsCompressed() const
+{
+  return _compressed;
+}
+
+inline void irtkProbabilisticAtlas::CheckUncompressed(const char *method) const
+{
+  if (_compressed) {
+    cerr << "irtkProbabilisticAtlas::" << method << ": Atlas is compressed, call Decompress() first" << endl;
+    exit(1);
+  }
+}
+
 #endif
@@ -619,167 +619,405 @@ double irtkBSplineBiasField::Approximate(double *x1, double *y1, double *z1, dou
   return error;
 }
 
-void irtkBSplineBiasField::WeightedLeastSquares(double *x1, double *y1, double *z1, double *bias, double *weights, int no)
-{
-  int index, i, j, k, ii, jj, kk, l, m, n, indx, indx1;
-  double b,w, s, t, u, x, y, z;
-  irtkVector P(_x*_y*_z),T(_x*_y*_z);
-  irtkMatrix M(_x*_y*_z, _x*_y*_z);
-
-  cerr<<_x<<" "<<_y<<" "<< _z<<endl;
+/// Number of entries per row of the weighted least squares system. The basis
+/// functions of two control points overlap if the points are at most three
+/// lattice units apart along each axis, which gives a 7x7x7 stencil.
+#define BIASSTENCILSIZE 343
 
-  cerr<<"Starting weighted least squares...";
+/// Offset of the diagonal entry within a row of the stencil
+#define BIASSTENCILCENTRE 171
 
-  int per=0;
+/// Maximum number of sample groups processed per pass of the assembly
+static const int _BiasGroupChunk = 65536;
 
-  for (index = 0; index < no; index++) {
-    if (index*10/no > per) {
-      per++;
-      cerr<<per<<"0%...";
-    }
-    //cerr<<index<<" "<<endl;
-    x = x1[index];
-    y = y1[index];
-    z = z1[index];
-    b = bias[index];
-    w = weights[index];
+/// Converts a sample to lattice coordinates clamped to the control point
+/// domain and returns the index of the first control point of its support
+static inline bool irtkBSplineBiasFieldToLattice(const irtkBSplineBiasField *field, int nx, int ny, int nz,
+    double &x, double &y, double &z, int &l, int &m, int &n)
+{
+  field->WorldToLattice(x, y, z);
 
-    //cerr<<x<<" "<<y<<" "<<z<<endl;
+  // Small numerical errors are introduced by the change of coordinate systems
+  if (x < 0) x = 0;
+  if (y < 0) y = 0;
+  if (z < 0) z = 0;
+  if (x > nx-1) x = nx-1;
+  if (y > ny-1) y = ny-1;
+  if (z > nz-1) z = nz-1;
 
-    this->WorldToLattice(x, y, z);
+  l = (x == nx-1) ? nx-2 : (int)floor(x);
+  m = (y == ny-1) ? ny-2 : (int)floor(y);
+  n = (z == nz-1) ? nz-2 : (int)floor(z);
 
-    ///this must be added because of small numerical errors introduced by change between the coordinate systems
-    if (x<0) x=0;
-    if (y<0) y=0;
-    if (z<0) z=0;
-    if (x>_x-1) x=_x-1;
-    if (y>_y-1) y=_y-1;
-    if (z>_z-1) z=_z-1;
+  return (l >= 0) && (m >= 0) && (n >= 0);
+}
 
-    l = (int)floor(x);
-    m = (int)floor(y);
-    n = (int)floor(z);
-    s = x-l;
-    t = y-m;
-    u = z-n;
+/// Parallel computation of the sample moments of a group of samples
+///
+/// A group is a run of consecutive samples which share their lattice y and z
+/// coordinates and the support of the B-spline basis along x, e.g. the
+/// voxels of one image row within one lattice cell. Since the basis is a
+/// tensor product, the contribution of the whole group to the normal
+/// equations follows from the weighted sums over x alone.
+class irtkBSplineBiasFieldMoments
+{
+  const irtkBSplineBiasField *_field;
+
+  int _x, _y, _z;
+
+  const double *_x1, *_y1, *_z1, *_bias, *_weights;
+
+  const int *_start, *_end, *_m, *_n;
+
+  /// Per group: basis along x (weighted outer product and data term) and
+  /// basis values along y and z
+  double *_Axx, *_bx, *_Ny, *_Nz;
+
+public:
+
+  irtkBSplineBiasFieldMoments(const irtkBSplineBiasField *field, int x, int y, int z,
+                              const double *x1, const double *y1, const double *z1,
+                              const double *bias, const double *weights,
+                              const int *start, const int *end, const int *m, const int *n,
+                              double *Axx, double *bx, double *Ny, double *Nz)
+  {
+    _field = field;
+    _x = x;
+    _y = y;
+    _z = z;
+    _x1 = x1;
+    _y1 = y1;
+    _z1 = z1;
+    _bias = bias;
+    _weights = weights;
+    _start = start;
+    _end = end;
+    _m = m;
+    _n = n;
+    _Axx = Axx;
+    _bx = bx;
+    _Ny = Ny;
+    _Nz = Nz;
+  }
 
-    ///Adjust parameters for x=_x,...
-    if (x==_x-1) {
-      l=_x-2;
-      s=1;
-    }
-    if (y==_y-1) {
-      m=_y-2;
-      t=1;
-    }
+  void operator()(const blocked_range<int> &r) const
+  {
+    int g, index, i, ii, l, m, n;
+    double x, y, z, w, Nx[4], *A, *b;
+
+    for (g = r.begin(); g != r.end(); g++) {
+      A = &_Axx[16*g];
+      b = &_bx[4*g];
+      for (i = 0; i < 16; i++) A[i] = 0;
+      for (i = 0; i < 4; i++) b[i] = 0;
+
+      for (index = _start[g]; index < _end[g]; index++) {
+        x = _x1[index];
+        y = _y1[index];
+        z = _z1[index];
+        irtkBSplineBiasFieldToLattice(_field, _x, _y, _z, x, y, z, l, m, n);
+        for (i = 0; i < 4; i++) Nx[i] = irtkBSplineBiasField::N(i+l-1, x, _x);
+        w = _weights[index];
+        for (i = 0; i < 4; i++) {
+          b[i] += w * _bias[index] * Nx[i];
+          for (ii = 0; ii < 4; ii++) A[4*i+ii] += w * Nx[i] * Nx[ii];
+        }
+      }
 
-    if (z==_z-1) {
-      n=_z-2;
-      u=1;
+      // The group shares y and z, so the basis along these axes is evaluated once
+      x = _x1[_start[g]];
+      y = _y1[_start[g]];
+      z = _z1[_start[g]];
+      irtkBSplineBiasFieldToLattice(_field, _x, _y, _z, x, y, z, l, m, n);
+      for (i = 0; i < 4; i++) {
+        _Ny[4*g+i] = irtkBSplineBiasField::N(i+_m[g]-1, y, _y);
+        _Nz[4*g+i] = irtkBSplineBiasField::N(i+_n[g]-1, z, _z);
+      }
     }
+  }
+};
+
+/// Parallel assembly of the weighted least squares normal equations
+///
+/// Each task owns one row of control points (fixed y and z index) and adds
+/// the contributions of all groups whose support contains it. Tasks never
+/// write to the same equations and the groups are visited in a fixed order,
+/// so the result does not depend on the number of threads.
+class irtkBSplineBiasFieldNormalEquations
+{
+  int _x, _y, _z;
+
+  const int *_l, *_m, *_n;
+
+  const double *_Axx, *_bx, *_Ny, *_Nz;
+
+  /// Groups sorted by lattice cell (m, n)
+  const int *_bucket_start, *_bucket_group;
+
+  double *_matrix, *_rhs;
+
+public:
+
+  irtkBSplineBiasFieldNormalEquations(int x, int y, int z, const int *l, const int *m, const int *n,
+                                      const double *Axx, const double *bx, const double *Ny, const double *Nz,
+                                      const int *bucket_start, const int *bucket_group,
+                                      double *matrix, double *rhs)
+  {
+    _x = x;
+    _y = y;
+    _z = z;
+    _l = l;
+    _m = m;
+    _n = n;
+    _Axx = Axx;
+    _bx = bx;
+    _Ny = Ny;
+    _Nz = Nz;
+    _bucket_start = bucket_start;
+    _bucket_group = bucket_group;
+    _matrix = matrix;
+    _rhs = rhs;
+  }
 
-    //cerr<<s<<" "<<t<<" "<<u<<" "<<w<<" "<<b<<endl;
-
-
-    for (k = 0; k < 4; k++) {
-      for (j = 0; j < 4; j++) {
-        for (i = 0; i < 4; i++) {
-
-          indx=Ind(i+l-1, j+m-1, k+n-1);
-          if ((indx >= 0) && (indx <_x*_y*_z)) {
-            //P(indx) += b*B(i, s) * B(j, t) * B(k, u)*w;
-            P(indx) += b*N(i+l-1,x,_x) * N(j+m-1,y,_y) * N(k+n-1,z,_z)*w;
-          } else {
-            //cerr<<"out of range:"<< i+l-1<<" "<<j+m-1<<" "<<k+n-1<<endl;
-          }
-          //cerr<<i+l-1<<" "<<j+m-1<<" "<<k+n-1<<endl;
-          for (kk = 0; kk < 4; kk++) {
-            for (jj = 0; jj < 4; jj++) {
-              for (ii = 0; ii < 4; ii++) {
-                indx1=Ind(ii+l-1, jj+m-1, kk+n-1);
-                if ((indx >= 0) && (indx <_x*_y*_z) && (indx1 >= 0) && (indx1 <_x*_y*_z)) {
-                  M(indx,indx1)
-                  //+= B(i, s) * B(j, t) * B(k, u) * B(ii, s) * B(jj, t) * B(kk, u)*w;
-                  += N(i+l-1,x,_x) * N(j+m-1,y,_y) * N(k+n-1,z,_z)*N(ii+l-1,x,_x) * N(jj+m-1,y,_y) * N(kk+n-1,z,_z)*w;
-                } else {
-                  //cerr<<"out of range:"<< i+l-1<<" "<<j+m-1<<" "<<k+n-1<< ii+l-1<<" "<<jj+m-1<<" "<<kk+n-1<<endl;
+  void operator()(const blocked_range<int> &r) const
+  {
+    int row, g, b, i, ii, jj, kk, j, k, l, m, n, I, J, K, II, JJ, KK, p, o;
+    double wyz, c, *M;
+    const double *A, *Ny, *Nz;
+
+    for (row = r.begin(); row != r.end(); row++) {
+      J = row % _y;
+      K = row / _y;
+      for (n = K-2; n <= K+1; n++) {
+        if ((n < 0) || (n > _z-2)) continue;
+        k = K - n + 1;
+        for (m = J-2; m <= J+1; m++) {
+          if ((m < 0) || (m > _y-2)) continue;
+          j = J - m + 1;
+          b = m + n * (_y-1);
+          for (g = _bucket_start[b]; g < _bucket_start[b+1]; g++) {
+            p  = _bucket_group[g];
+            l  = _l[p];
+            A  = &_Axx[16*p];
+            Ny = &_Ny[4*p];
+            Nz = &_Nz[4*p];
+            wyz = Ny[j] * Nz[k];
+            if (wyz == 0) continue;
+            for (i = 0; i < 4; i++) {
+              I = i + l - 1;
+              if ((I < 0) || (I >= _x)) continue;
+              _rhs[I + J*_x + K*_x*_y] += wyz * _bx[4*p+i];
+              M = &_matrix[BIASSTENCILSIZE * (I + J*_x + K*_x*_y)];
+              for (kk = 0; kk < 4; kk++) {
+                KK = kk + n - 1;
+                if ((KK < 0) || (KK >= _z)) continue;
+                for (jj = 0; jj < 4; jj++) {
+                  JJ = jj + m - 1;
+                  if ((JJ < 0) || (JJ >= _y)) continue;
+                  c = wyz * Ny[jj] * Nz[kk];
+                  o = ((KK-K+3)*7 + (JJ-J+3))*7 + 3 - I;
+                  for (ii = 0; ii < 4; ii++) {
+                    II = ii + l - 1;
+                    if ((II < 0) || (II >= _x)) continue;
+                    M[o+II] += c * A[4*i+ii];
+                  }
                 }
               }
             }
           }
-
         }
       }
     }
-
   }
+};
 
-  M.Invert();
-  P=M*P;
-
-
-/*
-    for (i=0;i<_x*_y*_z; i++)
-    for (j=0;j<_x*_y*_z; j++) {
-      T(i)+=M(i,j);
-    }
-  //M.Print();
-
-  cerr<<"Right side:"<<endl;
-  //P.Print();
-
-  cerr<<"Singular value decomposition:"<<endl;
-
-  double **aa, *ww, **vv, *pp, *xx;
-  //int *ind;
-  int rows = _x*_y*_z;
-
-  // Allocate memory
-  aa = dmatrix(1, rows, 1, rows);
-  vv = dmatrix(1, rows, 1, rows);
-  ww = dvector(1, rows);
-  pp = dvector(1, rows);
-  xx = dvector(1, rows);
+/// Parallel product of the banded least squares matrix with a vector
+class irtkBSplineBiasFieldStencilProduct
+{
+  int _x, _y, _z;
 
-  // Convert matrix to NR format
-  M.Matrix2NR(aa);
-  P.Vector2NR(pp);
+  const double *_matrix, *_in;
 
-  //ind = ivector(1, rows);
+  double *_out;
 
-  svdcmp(aa, rows, rows, ww, vv);
+public:
 
- // for (j = 1; j <= rows; j++)  cerr <<ww[j]<<endl;
+  irtkBSplineBiasFieldStencilProduct(int x, int y, int z, const double *matrix, const double *in, double *out)
+  {
+    _x = x;
+    _y = y;
+    _z = z;
+    _matrix = matrix;
+    _in = in;
+    _out = out;
+  }
 
+  void operator()(const blocked_range<int> &r) const
+  {
+    int p, I, J, K, di, dj, dk, i0, i1, j0, j1, k0, k1;
+    double sum;
+    const double *M, *in;
+
+    for (p = r.begin(); p != r.end(); p++) {
+      I = p % _x;
+      J = (p / _x) % _y;
+      K = p / (_x * _y);
+
+      // Clip the stencil to the lattice
+      i0 = (I < 3) ? -I : -3;
+      j0 = (J < 3) ? -J : -3;
+      k0 = (K < 3) ? -K : -3;
+      i1 = (I + 3 >= _x) ? _x - 1 - I : 3;
+      j1 = (J + 3 >= _y) ? _y - 1 - J : 3;
+      k1 = (K + 3 >= _z) ? _z - 1 - K : 3;
+
+      sum = 0;
+      for (dk = k0; dk <= k1; dk++) {
+        for (dj = j0; dj <= j1; dj++) {
+          M  = &_matrix[BIASSTENCILSIZE * p + ((dk+3)*7 + (dj+3))*7 + 3];
+          in = &_in[p + dj*_x + dk*_x*_y];
+          for (di = i0; di <= i1; di++) sum += M[di] * in[di];
+        }
+      }
+      _out[p] = sum;
+    }
+  }
+};
 
-  svbksb(aa,ww,vv,rows,rows,pp,xx);
-  P.NR2Vector(xx);
-  // Convert NR format back
-  //M.NR2Matrix();
+void irtkBSplineBiasField::WeightedLeastSquares(double *x1, double *y1, double *z1, double *bias, double *weights, int no)
+{
+  int index, i, j, k, g, l, m, n, last_l, last_m, last_n, groups, buckets, iter;
+  double x, y, z, last_y, last_z, alpha, beta, rz, rz_new, pq, norm, tol;
+  const int size = _x * _y * _z;
+
+  std::vector<double> M(BIASSTENCILSIZE * size, 0.0), P(size, 0.0);
+
+  // Group the samples and accumulate the normal equations one chunk of groups at a time
+  std::vector<int> start, end, gl, gm, gn;
+  std::vector<double> Axx, bx, Ny, Nz;
+  buckets = (_x > 1 && _y > 1 && _z > 1) ? (_y-1) * (_z-1) : 0;
+  std::vector<int> bucket_start(buckets + 1), bucket_group;
+
+  task_scheduler_init init(tbb_no_threads);
+
+  index = 0;
+  while (index < no) {
+    start.clear();
+    end.clear();
+    gl.clear();
+    gm.clear();
+    gn.clear();
+    last_l = last_m = last_n = -1;
+    last_y = last_z = 0;
+    while (index < no) {
+      x = x1[index];
+      y = y1[index];
+      z = z1[index];
+      if (irtkBSplineBiasFieldToLattice(this, _x, _y, _z, x, y, z, l, m, n) && (buckets > 0)) {
+        if (!end.empty() && (end.back() == index) && (l == last_l) && (m == last_m) && (n == last_n) &&
+            (y == last_y) && (z == last_z)) {
+          end.back()++;
+        } else if ((int)start.size() < _BiasGroupChunk) {
+          start.push_back(index);
+          end.push_back(index + 1);
+          gl.push_back(l);
+          gm.push_back(m);
+          gn.push_back(n);
+          last_l = l;
+          last_m = m;
+          last_n = n;
+          last_y = y;
+          last_z = z;
+        } else {
+          break;
+        }
+      }
+      index++;
+    }
+    groups = start.size();
+    if (groups == 0) continue;
+
+    Axx.resize(16 * groups);
+    bx.resize(4 * groups);
+    Ny.resize(4 * groups);
+    Nz.resize(4 * groups);
+    irtkBSplineBiasFieldMoments moments(this, _x, _y, _z, x1, y1, z1, bias, weights,
+                                        &start[0], &end[0], &gm[0], &gn[0],
+                                        &Axx[0], &bx[0], &Ny[0], &Nz[0]);
+    parallel_for(blocked_range<int>(0, groups), moments);
+
+    // Sort the groups by lattice cell (counting sort, keeps the sample order)
+    for (i = 0; i <= buckets; i++) bucket_start[i] = 0;
+    for (g = 0; g < groups; g++) bucket_start[gm[g] + gn[g]*(_y-1) + 1]++;
+    for (i = 0; i < buckets; i++) bucket_start[i+1] += bucket_start[i];
+    bucket_group.resize(groups);
+    std::vector<int> next(bucket_start.begin(), bucket_start.end() - 1);
+    for (g = 0; g < groups; g++) bucket_group[next[gm[g] + gn[g]*(_y-1)]++] = g;
+
+    irtkBSplineBiasFieldNormalEquations equations(_x, _y, _z, &gl[0], &gm[0], &gn[0],
+                                                  &Axx[0], &bx[0], &Ny[0], &Nz[0],
+                                                  &bucket_start[0], &bucket_group[0], &M[0], &P[0]);
+    parallel_for(blocked_range<int>(0, _y * _z), equations);
+  }
 
-  // Deallocate memory
-  free_dmatrix(aa, 1, rows, 1, rows);
-  free_dmatrix(vv, 1, rows, 1, rows);
-  free_dvector(ww, 1,rows);
-  free_dvector(pp, 1,rows);
-  free_dvector(xx, 1,rows);
-  //free_ivector( ind, 1, rows);
-*/
-  cerr<<"Resulting  control points:"<<endl;
+  // Solve the normal equations by Jacobi preconditioned conjugate gradients,
+  // starting from the current control points. Control points without any
+  // samples in their support are set to zero.
+  std::vector<double> X(size), R(size), Z(size), D(size), Q(size);
   for (k = 0; k < _z; k++) {
     for (j = 0; j < _y; j++) {
       for (i = 0; i < _x; i++) {
-        cerr<<P(Ind(i,j,k))<<" ";
+        X[Ind(i, j, k)] = _data[k][j][i];
       }
-      cerr<<" ";
     }
-    cerr<<endl;
   }
+  norm = 0;
+  for (i = 0; i < size; i++) {
+    D[i] = M[BIASSTENCILSIZE * i + BIASSTENCILCENTRE];
+    if (D[i] > 0) D[i] = 1.0 / D[i];
+    else D[i] = X[i] = 0;
+    norm += P[i] * P[i];
+  }
+  tol = 1e-24 * norm;
+
+  parallel_for(blocked_range<int>(0, size), irtkBSplineBiasFieldStencilProduct(_x, _y, _z, &M[0], &X[0], &Q[0]));
+  rz = 0;
+  for (i = 0; i < size; i++) {
+    R[i] = P[i] - Q[i];
+    Z[i] = D[i] * R[i];
+    rz  += R[i] * Z[i];
+  }
+  std::vector<double> S(Z);
+
+  for (iter = 0; (iter < 10 * size) && (rz > 0); iter++) {
+    parallel_for(blocked_range<int>(0, size), irtkBSplineBiasFieldStencilProduct(_x, _y, _z, &M[0], &S[0], &Q[0]));
+    pq = 0;
+    for (i = 0; i < size; i++) pq += S[i] * Q[i];
+    if (pq <= 0) break;
+    alpha = rz / pq;
+    norm = 0;
+    for (i = 0; i < size; i++) {
+      X[i] += alpha * S[i];
+      R[i] -= alpha * Q[i];
+      norm += R[i] * R[i];
+    }
+    if (norm <= tol) break;
+    rz_new = 0;
+    for (i = 0; i < size; i++) {
+      Z[i] = D[i] * R[i];
+      rz_new += R[i] * Z[i];
+    }
+    beta = rz_new / rz;
+    rz = rz_new;
+    for (i = 0; i < size; i++) S[i] = Z[i] + beta * S[i];
+  }
+
+  init.terminate();
 
   for (k = 0; k < _z; k++) {
     for (j = 0; j < _y; j++) {
       for (i = 0; i < _x; i++) {
-        _data[k][j][i] = P(Ind(i,j,k));
+        _data[k][j][i] = X[Ind(i, j, k)];
       }
     }
   }
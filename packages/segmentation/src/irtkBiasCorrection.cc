@@ -108,6 +108,7 @@ void irtkBiasCorrection::Run()
   delete []y;
   delete []z;
   delete []b;
+  delete []w;
 
   // Do the final cleaning up for all levels
   this->Finalize();
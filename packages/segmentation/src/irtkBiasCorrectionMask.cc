@@ -104,6 +104,7 @@ void irtkBiasCorrectionMask::Run()
   delete []y;
   delete []z;
   delete []b;
+  delete []w;
 
   // Do the final cleaning up for all levels
   this->Finalize();
@@ -12,6 +12,303 @@
 
 #include <irtkEMClassification.h>
 
+/// Parallel E-step over the masked voxel list
+///
+/// The unnormalised posteriors are written straight into the output maps
+/// and normalised in place, so the voxel loop needs no temporary storage.
+/// Voxels outside the mask (the trailing entries of the voxel list) are
+/// assigned to the last tissue.
+class irtkEMClassificationEStep
+{
+  const int *_index;
+
+  int _number_of_masked_voxels;
+
+  int _number_of_tissues;
+
+  irtkRealPixel *_input;
+
+  /// Prior probability maps, or NULL if the mixing coefficients are used
+  irtkRealPixel * const *_prior;
+
+  /// Compressed atlas read instead of the prior maps, or NULL
+  const irtkProbabilisticAtlas *_compressed;
+
+  /// Mixing coefficients, or NULL for a uniform prior
+  const double *_c;
+
+  irtkRealPixel * const *_posterior;
+
+  irtkGaussian *_G;
+
+public:
+
+  /// Number of masked voxels for which all tissue likelihoods vanished
+  int _zero;
+
+  /// Number of masked voxels with a posterior outside [0, 1]
+  int _invalid;
+
+  irtkEMClassificationEStep(const int *index, int masked, int tissues, irtkRealPixel *input,
+                            irtkRealPixel * const *prior, const double *c,
+                            irtkRealPixel * const *posterior, irtkGaussian *G)
+  {
+    _index = index;
+    _number_of_masked_voxels = masked;
+    _number_of_tissues = tissues;
+    _input = input;
+    _prior = prior;
+    _compressed = NULL;
+    _c = c;
+    _posterior = posterior;
+    _G = G;
+    _zero = 0;
+    _invalid = 0;
+  }
+
+  irtkEMClassificationEStep(irtkEMClassificationEStep &x, split)
+  {
+    *this = x;
+    _zero = 0;
+    _invalid = 0;
+  }
+
+  void SetCompressedAtlas(const irtkProbabilisticAtlas *atlas)
+  {
+    _compressed = atlas;
+  }
+
+  void join(const irtkEMClassificationEStep &x)
+  {
+    _zero    += x._zero;
+    _invalid += x._invalid;
+  }
+
+  void operator()(const blocked_range<int> &r)
+  {
+    int i, k, idx;
+    double x, temp, denominator, value;
+
+    for (i = r.begin(); i != r.end(); i++) {
+      idx = _index[i];
+      if (i < _number_of_masked_voxels) {
+        x = _input[idx];
+        denominator = 0;
+        for (k = 0; k < _number_of_tissues; k++) {
+          temp = _G[k].Evaluate(x);
+          if (_prior != NULL) temp *= _prior[k][idx];
+          else if (_compressed != NULL) temp *= _compressed->GetValueAtIndex(idx, k);
+          else if (_c != NULL) temp *= _c[k];
+          _posterior[k][idx] = temp;
+          denominator += temp;
+        }
+        if (denominator != 0) {
+          for (k = 0; k < _number_of_tissues; k++) {
+            value = _posterior[k][idx] / denominator;
+            if ((value < 0) || (value > 1)) _invalid++;
+            _posterior[k][idx] = value;
+          }
+        } else {
+          _zero++;
+          for (k = 0; k < _number_of_tissues; k++) _posterior[k][idx] = (k == 0) ? 1 : 0;
+        }
+      } else {
+        for (k = 0; k < _number_of_tissues - 1; k++) _posterior[k][idx] = 0;
+        _posterior[_number_of_tissues - 1][idx] = 1;
+      }
+    }
+  }
+};
+
+/// Number of masked voxels per block of the parallel reductions below. The
+/// partial sums of the blocks are added up in a fixed order, so that the
+/// results do not depend on the number of threads or on the scheduling.
+static const int _EMBlockSize = 4096;
+
+/// Parallel accumulation of posterior weighted intensity sums (means)
+/// or, if the means are given, squared deviations (variances)
+class irtkEMClassificationMStep
+{
+  const int *_index;
+
+  int _number_of_voxels;
+
+  int _number_of_tissues;
+
+  irtkRealPixel *_input;
+
+  irtkRealPixel * const *_posterior;
+
+  /// Tissue means, or NULL to accumulate the mean numerators
+  const double *_mi;
+
+  /// Partial sums per block and tissue
+  double *_block_num;
+  double *_block_denom;
+
+public:
+
+  /// Weighted sums of intensities or of squared deviations
+  vector<double> _num;
+
+  /// Sums of posteriors
+  vector<double> _denom;
+
+  irtkEMClassificationMStep(const int *index, int tissues, irtkRealPixel *input,
+                            irtkRealPixel * const *posterior, const double *mi = NULL)
+    : _num(tissues, 0), _denom(tissues, 0)
+  {
+    _index = index;
+    _number_of_voxels = 0;
+    _number_of_tissues = tissues;
+    _input = input;
+    _posterior = posterior;
+    _mi = mi;
+  }
+
+  void operator()(const blocked_range<int> &r) const
+  {
+    int b, i, k, idx, end;
+    double x, p, d;
+
+    for (b = r.begin(); b != r.end(); b++) {
+      double *num   = _block_num   + b * _number_of_tissues;
+      double *denom = _block_denom + b * _number_of_tissues;
+      for (k = 0; k < _number_of_tissues; k++) num[k] = denom[k] = 0;
+      end = min((b + 1) * _EMBlockSize, _number_of_voxels);
+      for (i = b * _EMBlockSize; i < end; i++) {
+        idx = _index[i];
+        x = _input[idx];
+        if (_mi == NULL) {
+          for (k = 0; k < _number_of_tissues; k++) {
+            p = _posterior[k][idx];
+            num[k]   += p * x;
+            denom[k] += p;
+          }
+        } else {
+          for (k = 0; k < _number_of_tissues; k++) {
+            d = x - _mi[k];
+            num[k] += _posterior[k][idx] * d * d;
+          }
+        }
+      }
+    }
+  }
+
+  /// Accumulate sums over the first n entries of the voxel list
+  void Run(int n)
+  {
+    int b, k, blocks = (n + _EMBlockSize - 1) / _EMBlockSize;
+
+    vector<double> block_num(blocks * _number_of_tissues), block_denom(blocks * _number_of_tissues);
+
+    _number_of_voxels = n;
+    _block_num   = block_num.data();
+    _block_denom = block_denom.data();
+    if (blocks > 0) parallel_for(blocked_range<int>(0, blocks), *this);
+
+    for (k = 0; k < _number_of_tissues; k++) _num[k] = _denom[k] = 0;
+    for (b = 0; b < blocks; b++) {
+      for (k = 0; k < _number_of_tissues; k++) {
+        _num[k]   += block_num  [b * _number_of_tissues + k];
+        _denom[k] += block_denom[b * _number_of_tissues + k];
+      }
+    }
+  }
+};
+
+/// Parallel log likelihood of the masked voxels, the Gaussian likelihoods
+/// being weighted either by the posterior maps or by mixing coefficients
+class irtkEMClassificationLogLikelihood
+{
+  const int *_index;
+
+  int _number_of_voxels;
+
+  int _number_of_tissues;
+
+  irtkRealPixel *_input;
+
+  /// Posterior probability maps, or NULL if the mixing coefficients are used
+  irtkRealPixel * const *_posterior;
+
+  const double *_c;
+
+  irtkGaussian *_G;
+
+  /// Partial sums and invalid voxel counts per block
+  double *_block_f;
+  int    *_block_invalid;
+
+public:
+
+  /// Sum of log likelihoods
+  double _f;
+
+  /// Number of voxels with a likelihood outside [0, 1]
+  int _invalid;
+
+  irtkEMClassificationLogLikelihood(const int *index, int tissues, irtkRealPixel *input,
+                                    irtkRealPixel * const *posterior, const double *c, irtkGaussian *G)
+  {
+    _index = index;
+    _number_of_voxels = 0;
+    _number_of_tissues = tissues;
+    _input = input;
+    _posterior = posterior;
+    _c = c;
+    _G = G;
+    _f = 0;
+    _invalid = 0;
+  }
+
+  void operator()(const blocked_range<int> &r) const
+  {
+    int b, i, k, idx, end, invalid;
+    double x, temp, f;
+
+    for (b = r.begin(); b != r.end(); b++) {
+      f = 0;
+      invalid = 0;
+      end = min((b + 1) * _EMBlockSize, _number_of_voxels);
+      for (i = b * _EMBlockSize; i < end; i++) {
+        idx = _index[i];
+        x = _input[idx];
+        temp = 0;
+        for (k = 0; k < _number_of_tissues; k++) {
+          if (_posterior != NULL) temp += _G[k].Evaluate(x) * _posterior[k][idx];
+          else temp += _G[k].Evaluate(x) * _c[k];
+        }
+        if ((temp > 1) || (temp < 0)) invalid++;
+        else f += log(temp);
+      }
+      _block_f[b] = f;
+      _block_invalid[b] = invalid;
+    }
+  }
+
+  /// Sum log likelihoods over the first n entries of the voxel list
+  void Run(int n)
+  {
+    int b, blocks = (n + _EMBlockSize - 1) / _EMBlockSize;
+
+    vector<double> block_f(blocks);
+    vector<int> block_invalid(blocks);
+
+    _number_of_voxels = n;
+    _block_f = block_f.data();
+    _block_invalid = block_invalid.data();
+    if (blocks > 0) parallel_for(blocked_range<int>(0, blocks), *this);
+
+    _f = 0;
+    _invalid = 0;
+    for (b = 0; b < blocks; b++) {
+      _f       += block_f[b];
+      _invalid += block_invalid[b];
+    }
+  }
+};
+
 irtkEMClassification::irtkEMClassification()
 {
   _padding = MIN_GREY;
@@ -21,6 +318,8 @@ irtkEMClassification::irtkEMClassification()
   _f = 0;
   _G = NULL;
   _number_of_voxels = 0;
+  _number_of_masked_voxels = 0;
+  _voxel_index_valid = false;
   _background_tissue = -1;
   _debug = false;
 
@@ -49,6 +348,8 @@ irtkEMClassification::irtkEMClassification(int noTissues, irtkRealImage **atlas,
   _c = new double[_number_of_tissues+1];
   _f = 0;
   _number_of_voxels = 0;
+  _number_of_masked_voxels = 0;
+  _voxel_index_valid = false;
   _G = NULL;
   _debug = false;
 }
@@ -63,6 +364,8 @@ irtkEMClassification::irtkEMClassification(int noTissues, irtkRealImage **atlas)
   _padding = MIN_GREY;
   _number_of_tissues = noTissues;
   _number_of_voxels = 0;
+  _number_of_masked_voxels = 0;
+  _voxel_index_valid = false;
   _mi = new double[_number_of_tissues];
   _sigma = new double[_number_of_tissues];
   _c = new double[_number_of_tissues];
@@ -100,11 +403,33 @@ void irtkEMClassification::CreateMask()
     else *p=0;
     p++;
   }
+  UpdateMaskedVoxels();
 }
 
 void irtkEMClassification::SetMask(irtkRealImage &mask)
 {
   _mask=mask;
+  UpdateMaskedVoxels();
+}
+
+void irtkEMClassification::UpdateMaskedVoxels()
+{
+  int i, n;
+
+  n = _mask.GetNumberOfVoxels();
+  _voxel_index.resize(n);
+
+  // Voxels inside the mask first, in memory order, followed by the others
+  irtkRealPixel *pm = _mask.GetPointerToVoxels();
+  _number_of_masked_voxels = 0;
+  for (i = 0; i < n; i++) {
+    if (pm[i] == 1) _voxel_index[_number_of_masked_voxels++] = i;
+  }
+  int j = _number_of_masked_voxels;
+  for (i = 0; i < n; i++) {
+    if (pm[i] != 1) _voxel_index[j++] = i;
+  }
+  _voxel_index_valid = true;
 }
 
 void irtkEMClassification::Initialise()
@@ -301,129 +626,66 @@ void irtkEMClassification::InitialiseGMMParameters(int n, double *m, double *s,
 
 void irtkEMClassification::MStep()
 {
-  int i, k;
-  vector<double> mi_num(_number_of_tissues);
-  vector<double> sigma_num(_number_of_tissues);
-  vector<double> denom(_number_of_tissues);
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    mi_num[k] = 0;
-  }
+  int k;
 
-  for (k = 0; k < _number_of_tissues; k++) {
-    sigma_num[k] = 0;
-  }
+  if (!_voxel_index_valid) UpdateMaskedVoxels();
 
-  for (k = 0; k < _number_of_tissues; k++) {
-    denom[k] = 0;
-  }
+  vector<irtkRealPixel *> posterior(_number_of_tissues);
+  for (k = 0; k < _number_of_tissues; k++) posterior[k] = _output.GetPointerToVoxels(k);
 
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
+  task_scheduler_init init(tbb_no_threads);
 
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k < _number_of_tissues; k++) {
-        mi_num[k] += _output.GetValue(k) * *ptr;
-        denom[k]  += _output.GetValue(k);
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  irtkEMClassificationMStep mean(_voxel_index.data(), _number_of_tissues, _input.GetPointerToVoxels(), posterior.data());
+  mean.Run(_number_of_masked_voxels);
 
   for (k = 0; k < _number_of_tissues; k++) {
-    if (denom[k] != 0) {
-      _mi[k] = mi_num[k] / denom[k];
+    if (mean._denom[k] != 0) {
+      _mi[k] = mean._num[k] / mean._denom[k];
     } else {
       cerr << "Division by zero while computing tissue mean for tissue " << k << "!" << endl;
       exit(1);
     }
   }
 
-  _output.First();
-  ptr = _input.GetPointerToVoxels();
-  pm = _mask.GetPointerToVoxels();
+  irtkEMClassificationMStep variance(_voxel_index.data(), _number_of_tissues, _input.GetPointerToVoxels(), posterior.data(), _mi);
+  variance.Run(_number_of_masked_voxels);
 
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k <_number_of_tissues; k++) {
-        sigma_num[k] += (_output.GetValue(k) * (*ptr - _mi[k]) * (*ptr - _mi[k]));
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  init.terminate();
 
   for (k = 0; k <_number_of_tissues; k++) {
-    _sigma[k] = sigma_num[k] / denom[k];
+    _sigma[k] = variance._num[k] / mean._denom[k];
   }
 }
 
 void irtkEMClassification::EStep()
 {
-  int i, k;
-  double x;
+  int k;
 
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
+  if (!_voxel_index_valid) UpdateMaskedVoxels();
 
+  vector<irtkGaussian> G(_number_of_tissues);
+  vector<irtkRealPixel *> prior(_number_of_tissues), posterior(_number_of_tissues);
   for (k = 0; k < _number_of_tissues; k++) {
     G[k].Initialise( _mi[k], _sigma[k]);
+    prior[k]     = _atlas.IsCompressed() ? NULL : _atlas.GetPointerToVoxels(k);
+    posterior[k] = _output.GetPointerToVoxels(k);
   }
 
-  _atlas.First();
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    double* gv = new double[_number_of_tissues];
-    double* numerator = new double[_number_of_tissues];
-    double denominator=0, temp=0;
-    if (*pm == 1) {
-      x = *ptr;
-      for (k = 0; k < _number_of_tissues; k++) {
-        temp = G[k].Evaluate(x);
-        gv[k] = temp;
-        temp = temp * _atlas.GetValue(k);
-        numerator[k] = temp;
-        denominator += temp;
-      }
-      for (k = 0; k < _number_of_tissues; k++) {
-        if (denominator != 0) {
-          double value = numerator[k]/denominator;
-          _output.SetValue(k, value);
-          if ((value < 0) || (value > 1)) {
-            cerr << "Probability value out of range = " << value << endl;
-            cerr << value << " " << k << " " << i << " " << _atlas.GetValue(k) <<  " " << _sigma[k] << endl;
-            exit(1);
-          }
-        } else {
-          cerr << "Division by 0 while computing probabilities" << endl;
-          cerr<<"tissue="<<k;
-          if (k==0) _output.SetValue(k, 1);
-          else     _output.SetValue(k, 0);
-        }
-      }
-    } else {
-      for (k = 0; k < _number_of_tissues - 1; k++) {
-        _output.SetValue(k, 0);
-      }
-      _output.SetValue(_number_of_tissues - 1, 1);
-    }
-    ptr++;
-    pm++;
-    _atlas.Next();
-    _output.Next();
-    delete[] gv;
-    delete[] numerator;
-  }
-  delete[] G;
+  irtkEMClassificationEStep estep(_voxel_index.data(), _number_of_masked_voxels, _number_of_tissues,
+                                  _input.GetPointerToVoxels(),
+                                  _atlas.IsCompressed() ? NULL : prior.data(), NULL, posterior.data(), G.data());
+  if (_atlas.IsCompressed()) estep.SetCompressedAtlas(&_atlas);
+  task_scheduler_init init(tbb_no_threads);
+  parallel_reduce(blocked_range<int>(0, (int)_voxel_index.size()), estep);
+  init.terminate();
 
+  if (estep._invalid > 0) {
+    cerr << "Probability value out of range in " << estep._invalid << " voxels" << endl;
+    exit(1);
+  }
+  if (estep._zero > 0) {
+    cerr << "Division by 0 while computing probabilities in " << estep._zero << " voxels" << endl;
+  }
 }
 
 void irtkEMClassification::WStep()
@@ -469,10 +731,12 @@ void irtkEMClassification::WStep()
     _output.Next();
     _atlas.Next();
   }
-  _estimate.Write("_e.nii.gz");
-  _weights.Write("_weights.nii.gz");
-  _weightsR.Write("_weightsR.nii.gz");
-  _weightsB.Write("_weightsB.nii.gz");
+  if (_debug) {
+    _estimate.Write("_e.nii.gz");
+    _weights.Write("_weights.nii.gz");
+    _weightsR.Write("_weightsR.nii.gz");
+    _weightsB.Write("_weightsB.nii.gz");
+  }
   cerr<<"done."<<endl;
 }
 
@@ -510,82 +774,44 @@ void irtkEMClassification::BrainmaskInput()
     cerr<<"no background tissue."<<endl;
   }
   CreateMask();
-  _mask.Write("_m.nii.gz");
-
-  _input.Write("_i.nii.gz");
+  if (_debug) {
+    _mask.Write("_m.nii.gz");
+    _input.Write("_i.nii.gz");
+  }
 }
 
 void irtkEMClassification::MStepGMM(bool uniform_prior)
 {
-  int i, k;
-  vector<double> mi_num(_number_of_tissues);
-  vector<double> sigma_num(_number_of_tissues);
-  vector<double> denom(_number_of_tissues);
-  vector<double> num_vox(_number_of_tissues);
+  int k;
 
-  for (k = 0; k < _number_of_tissues; k++) {
-    mi_num[k] = 0;
-  }
+  if (!_voxel_index_valid) UpdateMaskedVoxels();
 
-  for (k = 0; k < _number_of_tissues; k++) {
-    sigma_num[k] = 0;
-  }
+  vector<irtkRealPixel *> posterior(_number_of_tissues);
+  for (k = 0; k < _number_of_tissues; k++) posterior[k] = _output.GetPointerToVoxels(k);
 
-  for (k = 0; k < _number_of_tissues; k++) {
-    denom[k] = 0;
-  }
+  task_scheduler_init init(tbb_no_threads);
 
-  for (k = 0; k < _number_of_tissues; k++) {
-    num_vox[k] = 0;
-  }
-
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k < _number_of_tissues; k++) {
-        mi_num[k] += _output.GetValue(k) * *ptr;
-        denom[k]  += _output.GetValue(k);
-        num_vox[k]+= 1;
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  irtkEMClassificationMStep mean(_voxel_index.data(), _number_of_tissues, _input.GetPointerToVoxels(), posterior.data());
+  mean.Run(_number_of_masked_voxels);
 
   for (k = 0; k < _number_of_tissues; k++) {
-    if (denom[k] != 0) {
-      _mi[k] = mi_num[k] / denom[k];
+    if (mean._denom[k] != 0) {
+      _mi[k] = mean._num[k] / mean._denom[k];
     } else {
       cerr <<"Tissue "<< k <<": Division by zero while computing tissue mean!" << endl;
       exit(1);
     }
      if (uniform_prior) _c[k]=1.0/_number_of_tissues;
-     else _c[k]=denom[k]/num_vox[k];
+     else _c[k]=mean._denom[k]/_number_of_masked_voxels;
   }
 
-  _output.First();
-  ptr = _input.GetPointerToVoxels();
-  pm = _mask.GetPointerToVoxels();
+  irtkEMClassificationMStep variance(_voxel_index.data(), _number_of_tissues, _input.GetPointerToVoxels(), posterior.data(), _mi);
+  variance.Run(_number_of_masked_voxels);
 
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k <_number_of_tissues; k++) {
-        sigma_num[k] += (_output.GetValue(k) * (*ptr - _mi[k]) * (*ptr - _mi[k]));
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  init.terminate();
 
   for (k = 0; k <_number_of_tissues; k++) {
-    _sigma[k] = sigma_num[k] / denom[k];
+    _sigma[k] = variance._num[k] / mean._denom[k];
 	if(_sigma[k]<1)
 		_sigma[k] = 1;
   }
@@ -593,137 +819,72 @@ void irtkEMClassification::MStepGMM(bool uniform_prior)
 
 void irtkEMClassification::MStepVarGMM(bool uniform_prior)
 {
-  int i, k;
-  vector<double> mi_num(_number_of_tissues);
-  double sigma_num;
-  vector<double> denom(_number_of_tissues);
-  vector<double> num_vox(_number_of_tissues);
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    mi_num[k] = 0;
-  }
+  int k;
 
-    sigma_num = 0;
+  if (!_voxel_index_valid) UpdateMaskedVoxels();
 
-  for (k = 0; k < _number_of_tissues; k++) {
-    denom[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    num_vox[k] = 0;
-  }
+  vector<irtkRealPixel *> posterior(_number_of_tissues);
+  for (k = 0; k < _number_of_tissues; k++) posterior[k] = _output.GetPointerToVoxels(k);
 
+  task_scheduler_init init(tbb_no_threads);
 
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k < _number_of_tissues; k++) {
-        mi_num[k] += _output.GetValue(k) * *ptr;
-        denom[k]  += _output.GetValue(k);
-        num_vox[k]+= 1;
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
-
+  irtkEMClassificationMStep mean(_voxel_index.data(), _number_of_tissues, _input.GetPointerToVoxels(), posterior.data());
+  mean.Run(_number_of_masked_voxels);
 
   for (k = 0; k < _number_of_tissues; k++) {
-    if (denom[k] != 0) {
-      _mi[k] = mi_num[k] / denom[k];
+    if (mean._denom[k] != 0) {
+      _mi[k] = mean._num[k] / mean._denom[k];
     } else {
       cerr << "Division by zero while computing tissue mean!" << endl;
       //exit(1);
     }
      if (uniform_prior) _c[k]=1.0/_number_of_tissues;
-     else _c[k]=denom[k]/num_vox[k];
+     else _c[k]=mean._denom[k]/_number_of_masked_voxels;
   }
 
-  _output.First();
-  ptr = _input.GetPointerToVoxels();
-  pm = _mask.GetPointerToVoxels();
+  irtkEMClassificationMStep variance(_voxel_index.data(), _number_of_tissues, _input.GetPointerToVoxels(), posterior.data(), _mi);
+  variance.Run(_number_of_masked_voxels);
 
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k <_number_of_tissues; k++) {
-        sigma_num += (_output.GetValue(k) * (*ptr - _mi[k]) * (*ptr - _mi[k]));
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  init.terminate();
 
-  double sum =0;
-  for (k = 0; k <_number_of_tissues; k++) sum += denom[k];
+  double sigma_num = 0, sum = 0;
+  for (k = 0; k <_number_of_tissues; k++) {
+    sigma_num += variance._num[k];
+    sum += mean._denom[k];
+  }
   for (k = 0; k <_number_of_tissues; k++) {
     if (sum>0) _sigma[k] = sigma_num / sum;
   }
 }
 
-
-
 void irtkEMClassification::EStepGMM(bool uniform_prior)
 {
-  int i, k;
-  double x;
-  double *gv = new double[_number_of_tissues];
-  double *numerator = new double[_number_of_tissues];
-  irtkGaussian *G = new irtkGaussian[_number_of_tissues];
+  int k;
 
+  if (!_voxel_index_valid) UpdateMaskedVoxels();
+
+  vector<irtkGaussian> G(_number_of_tissues);
+  vector<irtkRealPixel *> posterior(_number_of_tissues);
   for (k = 0; k < _number_of_tissues; k++) {
     G[k].Initialise( _mi[k], _sigma[k]);
+    posterior[k] = _output.GetPointerToVoxels(k);
   }
 
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
+  irtkEMClassificationEStep estep(_voxel_index.data(), _number_of_masked_voxels, _number_of_tissues,
+                                  _input.GetPointerToVoxels(), NULL, uniform_prior ? NULL : _c,
+                                  posterior.data(), G.data());
+  task_scheduler_init init(tbb_no_threads);
+  parallel_reduce(blocked_range<int>(0, (int)_voxel_index.size()), estep);
+  init.terminate();
 
-  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    double denominator=0, temp=0;
-    if (*pm == 1) {
-      x = *ptr;
-      for (k = 0; k < _number_of_tissues; k++) {
-        temp = G[k].Evaluate(x);
-        gv[k] = temp;
-        if (!uniform_prior) temp = temp * _c[k];
-        numerator[k] = temp;
-        denominator += temp;
-      }
-      for (k = 0; k < _number_of_tissues; k++) {
-        if (denominator != 0) {
-          double value = numerator[k]/denominator;
-          _output.SetValue(k, value);
-          if ((value < 0) || (value > 1)) {
-            cerr << "Probability value out of range = " << value << endl;
-            exit(1);
-          }
-        } else {
-          cerr << "Division by 0 while computing probabilities" << endl;
-          cerr<<"tissue="<<k;
-          exit(1);
-        }
-      }
-    } else {
-      for (k = 0; k < _number_of_tissues - 1; k++) {
-        _output.SetValue(k, 0);
-      }
-      _output.SetValue(_number_of_tissues - 1, 1);
-    }
-    ptr++;
-    pm++;
-    _output.Next();
+  if (estep._invalid > 0) {
+    cerr << "Probability value out of range in " << estep._invalid << " voxels" << endl;
+    exit(1);
+  }
+  if (estep._zero > 0) {
+    cerr << "Division by 0 while computing probabilities in " << estep._zero << " voxels" << endl;
+    exit(1);
   }
-
-  delete[] G;
-  delete[] gv;
-  delete[] numerator;
 }
 
 void irtkEMClassification::Print()
@@ -775,42 +936,31 @@ double irtkEMClassification::IterateGMM(int iteration, bool equal_var, bool unif
 
 double irtkEMClassification::LogLikelihood()
 {
-  int i, k;
-  double temp, f;
+  int k;
+  double f;
   cerr<< "Log likelihood: ";
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
-  double* gv = new double[_number_of_tissues];
 
+  if (!_voxel_index_valid) UpdateMaskedVoxels();
+
+  vector<irtkGaussian> G(_number_of_tissues);
+  vector<irtkRealPixel *> posterior(_number_of_tissues);
   for (k = 0; k < _number_of_tissues; k++) {
     G[k].Initialise( _mi[k], _sigma[k]);
+    posterior[k] = _output.GetPointerToVoxels(k);
   }
 
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  _output.First();
-  f = 0;
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    if (*pm == 1) {
-      temp = 0;
-      for (k=0; k < _number_of_tissues; k++) {
-        // Estimation of gaussian probability of intensity (*ptr) for tissue k
-        gv[k] = G[k].Evaluate(*ptr);
-        // Probability that current voxel is from tissue k
-        temp += gv[k] * _output.GetValue(k);
-      }
+  irtkEMClassificationLogLikelihood likelihood(_voxel_index.data(), _number_of_tissues, _input.GetPointerToVoxels(),
+                                               posterior.data(), NULL, G.data());
+  task_scheduler_init init(tbb_no_threads);
+  likelihood.Run(_number_of_masked_voxels);
+  init.terminate();
 
-      if ((temp > 1) || (temp < 0)) {
-        cerr << "Could not compute likelihood, probability out of range = " << temp << endl;
-        exit(1);
-      }
-      f += log(temp);
-    }
-    ptr++;
-    pm++;
-    _output.Next();
+  if (likelihood._invalid > 0) {
+    cerr << "Could not compute likelihood, probability out of range in " << likelihood._invalid << " voxels" << endl;
+    exit(1);
   }
 
-  f = -f;
+  f = -likelihood._f;
   double diff, rel_diff;
   diff = _f-f;
 
@@ -820,50 +970,35 @@ double irtkEMClassification::LogLikelihood()
   _f=f;
 
   cerr << "f= "<< f << " diff = " << diff << " rel_diff = " << rel_diff <<endl;
-  delete[] G;
-  delete[] gv;
 
   return rel_diff;
 }
 
 double irtkEMClassification::LogLikelihoodGMM()
 {
-  int i, k;
-  double temp, f;
+  int k;
+  double f;
   cerr<< "Log likelihood: ";
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
-  double* gv = new double[_number_of_tissues];
 
+  if (!_voxel_index_valid) UpdateMaskedVoxels();
+
+  vector<irtkGaussian> G(_number_of_tissues);
   for (k = 0; k < _number_of_tissues; k++) {
     G[k].Initialise( _mi[k], _sigma[k]);
   }
 
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  _output.First();
-  f = 0;
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    if (*pm == 1) {
-      temp = 0;
-      for (k=0; k < _number_of_tissues; k++) {
-        // Estimation of gaussian probability of intensity (*ptr) for tissue k
-        gv[k] = G[k].Evaluate(*ptr);
-        // Probability that current voxel is from tissue k
-        temp += gv[k] * _c[k];
-      }
+  irtkEMClassificationLogLikelihood likelihood(_voxel_index.data(), _number_of_tissues, _input.GetPointerToVoxels(),
+                                               NULL, _c, G.data());
+  task_scheduler_init init(tbb_no_threads);
+  likelihood.Run(_number_of_masked_voxels);
+  init.terminate();
 
-      if ((temp > 1) || (temp < 0)) {
-        cerr << "Could not compute likelihood, probability out of range = " << temp << endl;
-        exit(1);
-      }
-      f += log(temp);
-    }
-    ptr++;
-    pm++;
-    _output.Next();
+  if (likelihood._invalid > 0) {
+    cerr << "Could not compute likelihood, probability out of range in " << likelihood._invalid << " voxels" << endl;
+    exit(1);
   }
 
-  f = -f;
+  f = -likelihood._f;
   double diff, rel_diff;
   diff = _f-f;
 
@@ -873,8 +1008,6 @@ double irtkEMClassification::LogLikelihoodGMM()
   _f=f;
 
   cerr << "f= "<< f << " diff = " << diff << " rel_diff = " << rel_diff <<endl;
-  delete[] G;
-  delete[] gv;
 
   return rel_diff;
 }
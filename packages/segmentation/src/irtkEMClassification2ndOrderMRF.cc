@@ -29,6 +29,232 @@
 #include <irtkEMClassification2ndOrderMRF.h>
 #include <irtkGaussianBlurring.h>
 
+/// Parallel E-step of irtkEMClassification2ndOrderMRF for a list of voxels
+///
+/// The MRF energies of a voxel only depend on the posteriors of its six
+/// face neighbours. The masked voxels are therefore split into two colours
+/// by the parity of x+y+z+t and each colour is updated in parallel: no voxel
+/// reads a posterior written in the same pass, which makes the result
+/// independent of the number of threads and of the scheduling.
+class irtkEMClassification2ndOrderMRFEStep
+{
+  const int *_index;
+
+  int _number_of_tissues;
+
+  /// Image dimensions used to locate the neighbours of a voxel
+  int _X, _Y, _Z, _XY, _XYZ;
+
+  /// Neighbour weights (inverse voxel sizes)
+  double _sx, _sy, _sz;
+
+  irtkRealPixel *_input;
+
+  irtkRealPixel * const *_atlas;
+
+  /// Compressed atlas read instead of the prior maps, or NULL
+  const irtkProbabilisticAtlas *_compressed;
+
+  irtkRealPixel * const *_output;
+
+  irtkGaussian *_G;
+
+  bool _log_transformed;
+
+  /// Set all voxels of the list to background instead
+  bool _background;
+
+  /// Local MRF weights (first time frame), or NULL if no first order MRF is used
+  irtkRealPixel *_beta;
+
+  /// First order interaction weights, entry k*K+l for class k next to class l, or NULL
+  const double *_W;
+
+  /// Second order connectivity in compressed row form, or NULL
+  const int *_offset;
+  const int *_a;
+  const int *_b;
+  const double *_w;
+
+  /// Per-tissue work space (numerators, neighbour sums and MRF energies),
+  /// allocated once per body rather than once per range
+  vector<double> _work;
+
+public:
+
+  /// Number of voxels for which all tissue likelihoods vanished
+  int _zero;
+
+  /// Number of voxels with a posterior outside [0, 1]
+  int _invalid;
+
+  irtkEMClassification2ndOrderMRFEStep(const int *index, int tissues, const irtkImageAttributes &attr,
+                                       irtkRealPixel *input, irtkRealPixel * const *atlas,
+                                       irtkRealPixel * const *output, irtkGaussian *G, bool log_transformed)
+  {
+    _index = index;
+    _number_of_tissues = tissues;
+    _X   = attr._x;
+    _Y   = attr._y;
+    _Z   = attr._z;
+    _XY  = _X * _Y;
+    _XYZ = _XY * _Z;
+    _sx  = 1.0 / attr._dx;
+    _sy  = 1.0 / attr._dy;
+    _sz  = 1.0 / attr._dz;
+    _input = input;
+    _atlas = atlas;
+    _compressed = NULL;
+    _output = output;
+    _G = G;
+    _log_transformed = log_transformed;
+    _background = false;
+    _beta = NULL;
+    _W = NULL;
+    _offset = NULL;
+    _a = NULL;
+    _b = NULL;
+    _w = NULL;
+    _work.resize(3 * tissues);
+    _zero = 0;
+    _invalid = 0;
+  }
+
+  irtkEMClassification2ndOrderMRFEStep(irtkEMClassification2ndOrderMRFEStep &x, split)
+  {
+    *this = x;
+    _zero = 0;
+    _invalid = 0;
+  }
+
+  void SetIndex(const int *index)
+  {
+    _index = index;
+  }
+
+  void SetBackground(bool background)
+  {
+    _background = background;
+  }
+
+  void SetCompressedAtlas(const irtkProbabilisticAtlas *atlas)
+  {
+    _compressed = atlas;
+  }
+
+  double Prior(int l, int idx) const
+  {
+    return (_compressed != NULL) ? _compressed->GetValueAtIndex(idx, l) : _atlas[l][idx];
+  }
+
+  void SetMRF(irtkRealPixel *beta, const double *W)
+  {
+    _beta = beta;
+    _W = W;
+  }
+
+  void SetMRF_2nd_order(const int *offset, const int *a, const int *b, const double *w)
+  {
+    _offset = offset;
+    _a = a;
+    _b = b;
+    _w = w;
+  }
+
+  void join(const irtkEMClassification2ndOrderMRFEStep &x)
+  {
+    _zero    += x._zero;
+    _invalid += x._invalid;
+  }
+
+  void operator()(const blocked_range<int> &r)
+  {
+    int i, k, l, idx, rem, x, y, z, lx, rx, ly, ry, lz, rz;
+    double value, temp, hp, hm, energy, denominator, denominatorMRF;
+    double *numerator  = _work.data();
+    double *neighbours = numerator  + _number_of_tissues;
+    double *energies   = neighbours + _number_of_tissues;
+
+    for (i = r.begin(); i != r.end(); i++) {
+      idx = _index[i];
+
+      if (_background) {
+        for (k = 0; k < _number_of_tissues - 1; k++) _output[k][idx] = 0;
+        _output[_number_of_tissues - 1][idx] = 1;
+        continue;
+      }
+
+      value = _input[idx];
+      hp = 0.5;
+      hm = 0.5;
+      if (_log_transformed) {
+        hp = log( exp(value)+0.5 ) - value;
+        hm = value - log( (exp(value) - 0.5) > 0 ? exp(value) - 0.5 : exp(value) );
+      }
+
+      if ((_W != NULL) || (_offset != NULL)) {
+        // Weighted sum of the posteriors of the six face neighbours, border voxels count themselves
+        rem = idx % _XYZ;
+        z = rem / _XY;
+        rem -= z * _XY;
+        y = rem / _X;
+        x = rem % _X;
+        lx = (x > 0)      ? idx - 1   : idx;
+        rx = (x < _X - 1) ? idx + 1   : idx;
+        ly = (y > 0)      ? idx - _X  : idx;
+        ry = (y < _Y - 1) ? idx + _X  : idx;
+        lz = (z > 0)      ? idx - _XY : idx;
+        rz = (z < _Z - 1) ? idx + _XY : idx;
+        for (k = 0; k < _number_of_tissues; k++) {
+          temp = 0;
+          temp += _sx * (_output[k][rx] + _output[k][lx]);
+          temp += _sy * (_output[k][ry] + _output[k][ly]);
+          temp += _sz * (_output[k][rz] + _output[k][lz]);
+          neighbours[k] = temp;
+        }
+
+        denominatorMRF = 0;
+        for (l = 0; l < _number_of_tissues; l++) {
+          energies[l] = Prior(l, idx);
+          if (_W != NULL) {
+            energy = 0;
+            for (k = 0; k < _number_of_tissues; k++) energy += neighbours[k] * _W[k * _number_of_tissues + l];
+            energies[l] *= exp(-_beta[idx % _XYZ] * energy);
+          }
+          if ((_offset != NULL) && (_offset[l] != _offset[l+1])) {
+            energy = 0;
+            for (k = _offset[l]; k < _offset[l+1]; k++) energy += _w[k] * neighbours[_a[k]] * neighbours[_b[k]];
+            energies[l] *= exp(-1.0 * energy);
+          }
+          denominatorMRF += energies[l];
+        }
+        for (l = 0; l < _number_of_tissues; l++) energies[l] /= denominatorMRF;
+      } else {
+        for (l = 0; l < _number_of_tissues; l++) energies[l] = Prior(l, idx);
+      }
+
+      denominator = 0;
+      for (k = 0; k < _number_of_tissues; k++) {
+        temp = 0.5 * ( hm + hp ) * (_G[k].Evaluate(value+hp)+_G[k].Evaluate(value-hm));
+        temp = temp * energies[k];
+        numerator[k] = temp;
+        denominator += temp;
+      }
+
+      if (denominator != 0) {
+        for (k = 0; k < _number_of_tissues; k++) {
+          temp = numerator[k] / denominator;
+          if ((temp < 0) || (temp > 1)) _invalid++;
+          _output[k][idx] = temp;
+        }
+      } else {
+        _zero++;
+        for (k = 0; k < _number_of_tissues; k++) _output[k][idx] = (k == 0) ? 1 : 0;
+      }
+    }
+  }
+};
+
 
 // Default constructor
 irtkEMClassification2ndOrderMRF::irtkEMClassification2ndOrderMRF() : irtkEMClassification()
@@ -888,351 +1114,115 @@ void irtkEMClassification2ndOrderMRF::ConstructSegmentationPV(irtkRealImage &seg
   }
 }
 
-double irtkEMClassification2ndOrderMRF::getMRFenergy_2nd_order(int index, int tissue)
+void irtkEMClassification2ndOrderMRF::EStepMRF_2nd_order()
 {
-	vector< pair< pair<int,int>, double > > vec = _connectivity_2nd_order[tissue];
-	vector< pair< pair<int,int>, double > >::iterator iter = vec.begin();
-	if( iter == vec.end() )
-	{
-		return 1.0;
-	}
-
-	double dx,dy,dz;
-	_input.GetPixelSize(&dx,&dy,&dz);
-
-	double sx, sy,sz, st;
-	sx = 1.0/dx;
-	sy = 1.0/dy;
-	sz = 1.0/dz;
-	// do not do spatial smoothing !!!
-	st = 0.0;
-
-	int x,y,z,t;
-
-	t = index / (_input.GetX() * _input.GetY() * _input.GetZ());
-	index -= t * (_input.GetX() * _input.GetY() * _input.GetZ());
-
-    z = index / (_input.GetX() * _input.GetY());
-    index -= z * (_input.GetX() * _input.GetY());
-
-    x = index % _input.GetX();
-    y = index / _input.GetX();
-
-	int lt = max(t-1,0);
-	int rt = min(t+1, _input.GetT()-1 );
-	int lx = max(x-1,0);
-	int rx = min(x+1, _input.GetX()-1 );
-	int ly = max(y-1,0);
-	int ry = min(y+1, _input.GetY()-1 );
-	int lz = max(z-1,0);
-	int rz = min(z+1, _input.GetZ()-1 );
-
-	double weight_2nd = 0.0;
-
-	double* cumulated_probs = new double[_number_of_tissues];
-
-	for( int k = 0; k < _number_of_tissues; k++)
-	{
-		cumulated_probs[k] = 0;
-		cumulated_probs[k] += sx*(_output.GetValue( rx ,y,z,t,k) + _output.GetValue( lx,y,z,t,k));
-		cumulated_probs[k] += sy*(_output.GetValue(x,ry,z,t,k) + _output.GetValue(x,ly,z,t,k));
-		cumulated_probs[k] += sz*(_output.GetValue(x,y,rz,t,k) + _output.GetValue(x,y,lz,t,k));
-
-		if( rt != t )
-			cumulated_probs[k] += st*_output.GetValue(x,y,z,rt,k);
-		if( lt != t )
-			cumulated_probs[k] += st*_output.GetValue(x,y,z,lt,k);
-	}
-
-	for( ; iter != vec.end(); ++iter )
-	{
-		pair<int,int> neighbors = (*iter).first;
-		double w = (*iter).second;
-		int neighborA = neighbors.first;
-		int neighborB = neighbors.second;
-
-		weight_2nd += w * cumulated_probs[neighborA] * cumulated_probs[neighborB];
-	}
-
-	delete[] cumulated_probs;
-
-	double expo = -1.0 * weight_2nd;
-	return exp(expo);
+  cout << "E-Step with 2nd order MRF" << endl;
+  this->EStepMRF(true, _has_MRF_2nd_order);
 }
 
-double irtkEMClassification2ndOrderMRF::getMRFenergy(int index, int tissue)
+void irtkEMClassification2ndOrderMRF::EStepMRF()
 {
-	if( _connectivity.Rows() == 1 )
-	{
-		return 1.0;
-	}
-	double dx,dy,dz;
-	_input.GetPixelSize(&dx,&dy,&dz);
-
-	double sx, sy,sz, st;
-	sx = 1.0/dx;
-	sy = 1.0/dy;
-	sz = 1.0/dz;
-	// do not do spatial smoothing !!!
-	st = 0.0;
-
-	double expo = -1.0;
-
-	double energy = .0;
-	int x,y,z,t;
-
-	t = index / (_input.GetX() * _input.GetY() * _input.GetZ());
-	index -= t * (_input.GetX() * _input.GetY() * _input.GetZ());
-
-    z = index / (_input.GetX() * _input.GetY());
-    index -= z * (_input.GetX() * _input.GetY());
-
-    x = index % _input.GetX();
-    y = index / _input.GetX();
-
-	// if MRF field is spatially invariant keep this beta constant!
-	// double beta = 1.0;
-	double beta = _MRF_weights.Get(x,y,z);
-	expo *= beta;
-
-	// PAPER
-//	double distant = 3.0;
-//	double close = 0.5;
-	// IMPLEMENTATION
-	double distant = _mrf_weight_distant;
-	double close = _mrf_weight_adjacent;
-
-	double weight = 0;
-	int lt = max(t-1,0);
-	int rt = min(t+1, _input.GetT()-1 );
-	int lx = max(x-1,0);
-	int rx = min(x+1, _input.GetX()-1 );
-	int ly = max(y-1,0);
-	int ry = min(y+1, _input.GetY()-1 );
-	int lz = max(z-1,0);
-	int rz = min(z+1, _input.GetZ()-1 );
-
-	for( int k = 0; k < _number_of_tissues; k++)
-	{
-		double temp = 0;
-		weight = 0;
-		double conn = _connectivity.Get(k, tissue);
-
-		if( conn  == 1 )
-			weight = close;
-		else if( conn == 2 )
-			weight = distant;
-
-		temp += sx * (_output.GetValue( rx ,y,z,t,k) + _output.GetValue( lx,y,z,t,k) );
-		temp += sy * ( _output.GetValue(x,ry,z,t,k) + _output.GetValue(x,ly,z,t,k) );
-		temp += sz * ( _output.GetValue(x,y,rz,t,k) + _output.GetValue(x,y,lz,t,k) );
-		if( lt != t )
-			temp += st * _output.GetValue(x,y,z,rt,k);
-		if( rt != t )
-			temp += st * _output.GetValue(x,y,z,lt,k);
-		energy += temp * weight;
-	}
-
-	expo *= energy;
-	return exp(expo);
+  cout << "E-Step with 1st order MRF" << endl;
+  this->EStepMRF(true, false);
 }
 
-void irtkEMClassification2ndOrderMRF::EStepMRF_2nd_order()
+void irtkEMClassification2ndOrderMRF::EStepMRF(bool first_order, bool second_order)
 {
-	cout << "E-Step with 2nd order MRF" << endl;
-	  int i, k;
-	  double x;
-	  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
+  int i, k, l, idx, X, Y, XY, XYZ;
 
-	  for (k = 0; k < _number_of_tissues; k++) {
-	    G[k].Initialise( _mi[k], _sigma[k]);
-	  }
-
-	  _atlas.First();
-	  _output.First();
-	  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-	  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-	  int per = 0;
-	  double* numerator = new double[_number_of_tissues];
-	  double denominator=0, temp=0;
-	  bool bMRF = _number_of_tissues == _connectivity.Rows();
-
-	  if(!bMRF)
-	  {
-		  cout << "Warning: number of tissues does not match size of connectivity matrix!" << endl;
-	  }
-	  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-		if (i*10.0/_input.GetNumberOfVoxels() > per) {
-		  per++;
-		  cerr<<per<<"0%...";
-		}
-		denominator = 0;
-		temp = 0;
-
-	    if (*pm == 1) {
-	      x = *ptr;
-	      double hp = 0.5;
-		  double hm = 0.5;
-		  if( _isLogTransformed )
-		  {
-				hp = log( exp(x)+0.5 ) - x;
-				hm = x - log( (exp(x) - 0.5) > 0 ? exp(x) - 0.5 : exp(x) );
-		  }
-	      double* MRFenergies = new double[_number_of_tissues];
-
-	      double denominatorMRF = .0;
-
-	      for (k = 0; k < _number_of_tissues; k++) {
-    		  MRFenergies[k] = _atlas.GetValue(k) * getMRFenergy(i,k) * getMRFenergy_2nd_order(i,k);
-	    	  denominatorMRF += MRFenergies[k];
-	      }
+  if (!_voxel_index_valid) UpdateMaskedVoxels();
 
-	      for (k = 0; k < _number_of_tissues; k++) {
-	    	temp = 0.5 * ( hm + hp ) * (G[k].Evaluate(x+hp)+G[k].Evaluate(x-hm));
-	        // MRF matrix fits number of tissues?
-	        if( bMRF )
-	        {
-	        	temp = temp * MRFenergies[k] / denominatorMRF;
-	        }
-	        else
-	        {
-	        	temp = temp * _atlas.GetValue(k);
-	        }
-
-	        numerator[k] = temp;
-	        denominator += temp;
-	      }
-	      delete[] MRFenergies;
-
-	      for (k = 0; k < _number_of_tissues; k++) {
-	        if (denominator != 0) {
-	          double value = numerator[k]/denominator;
-	          _output.SetValue(k, value);
-	          if ((value < 0) || (value > 1)) {
-	            cerr << "Probability value out of range = " << value << endl;
-	            cerr << value << " " << k << " " << i << " " << _atlas.GetValue(k) <<  " " << _sigma[k] << endl;
-	            exit(1);
-	          }
-	        } else {
-	          cerr << "Division by 0 while computing probabilities" << endl;
-	          cerr<<"tissue="<<k;
-	          if (k==0) _output.SetValue(k, 1);
-	          else     _output.SetValue(k, 0);
-	        }
-	      }
-	    } else {
-	      for (k = 0; k < _number_of_tissues - 1; k++) {
-	        _output.SetValue(k, 0);
-	      }
-	      _output.SetValue(_number_of_tissues - 1, 1);
-	    }
-	    ptr++;
-	    pm++;
-	    _atlas.Next();
-	    _output.Next();
-	  }
-	  delete[] numerator;
-	  delete[] G;
-}
-
-
-void irtkEMClassification2ndOrderMRF::EStepMRF()
-{
-	  cout << "E-Step with 1st order MRF" << endl;
-	  int i, k;
-	  double x;
-	  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
+  bool bMRF = _number_of_tissues == _connectivity.Rows();
+  if (!bMRF && (first_order || second_order)) {
+    cout << "Warning: number of tissues does not match size of connectivity matrix!" << endl;
+  }
 
-	  for (k = 0; k < _number_of_tissues; k++) {
-	    G[k].Initialise( _mi[k], _sigma[k]);
-	  }
+  vector<irtkGaussian> G(_number_of_tissues);
+  vector<irtkRealPixel *> atlas(_number_of_tissues), output(_number_of_tissues);
+  for (k = 0; k < _number_of_tissues; k++) {
+    G[k].Initialise( _mi[k], _sigma[k]);
+    atlas[k]  = _atlas.IsCompressed() ? NULL : _atlas.GetPointerToVoxels(k);
+    output[k] = _output.GetPointerToVoxels(k);
+  }
 
-	  _atlas.First();
-	  _output.First();
-	  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-	  irtkRealPixel *pm = _mask.GetPointerToVoxels();
+  irtkEMClassification2ndOrderMRFEStep estep(_voxel_index.data(), _number_of_tissues, _input.GetImageAttributes(),
+                                             _input.GetPointerToVoxels(), atlas.data(), output.data(), G.data(),
+                                             _isLogTransformed);
+  if (_atlas.IsCompressed()) estep.SetCompressedAtlas(&_atlas);
+
+  // First order interactions between tissue classes (none for a 1x1 connectivity matrix)
+  vector<double> W;
+  if (bMRF && first_order && (_connectivity.Rows() != 1)) {
+    W.resize(_number_of_tissues * _number_of_tissues);
+    for (k = 0; k < _number_of_tissues; k++) {
+      for (l = 0; l < _number_of_tissues; l++) {
+        double conn = _connectivity.Get(k, l);
+        if (conn == 1) W[k * _number_of_tissues + l] = _mrf_weight_adjacent;
+        else if (conn == 2) W[k * _number_of_tissues + l] = _mrf_weight_distant;
+        else W[k * _number_of_tissues + l] = 0;
+      }
+    }
+    estep.SetMRF(_MRF_weights.GetPointerToVoxels(), W.data());
+  }
 
-	  int per = 0;
-	  double* numerator = new double[_number_of_tissues];
-	  double denominator=0, temp=0;
-	  bool bMRF = _number_of_tissues == _connectivity.Rows();
-	  if(!bMRF)
-	  {
-		  cout << "Warning: number of tissues does not match size of connectivity matrix!" << endl;
-	  }
+  // Flatten second order connectivity into compressed row form
+  vector<int> offset, a, b;
+  vector<double> w;
+  if (bMRF && second_order) {
+    offset.push_back(0);
+    for (k = 0; k < _number_of_tissues; k++) {
+      if (k < (int)_connectivity_2nd_order.size()) {
+        for (l = 0; l < (int)_connectivity_2nd_order[k].size(); l++) {
+          a.push_back(_connectivity_2nd_order[k][l].first.first);
+          b.push_back(_connectivity_2nd_order[k][l].first.second);
+          w.push_back(_connectivity_2nd_order[k][l].second);
+        }
+      }
+      offset.push_back(a.size());
+    }
+    if (a.size() > 0) estep.SetMRF_2nd_order(offset.data(), a.data(), b.data(), w.data());
+  }
 
-	  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-		if (i*10.0/_input.GetNumberOfVoxels() > per) {
-		  per++;
-		  cerr<<per<<"0%...";
-		}
-		denominator = 0;
-		temp = 0;
-
-	    if (*pm == 1) {
-	      x = *ptr;
-		  double hp = 0.5;
-		  double hm = 0.5;
-		  if( _isLogTransformed )
-		  {
-				hp = log( exp(x)+0.5 ) - x;
-				hm = x - log( (exp(x) - 0.5) > 0 ? exp(x) - 0.5 : exp(x) );
-		  }
-	      double* MRFenergies = new double[_number_of_tissues];
-	      double denominatorMRF = .0;
-
-	      for (k = 0; k < _number_of_tissues; k++) {
-	    	  MRFenergies[k] = _atlas.GetValue(k) * getMRFenergy(i,k);
-	    	  denominatorMRF += MRFenergies[k];
-	      }
+  task_scheduler_init init(tbb_no_threads);
+
+  // Voxels outside the mask are assigned to the background first, so that
+  // the masked voxels see their final values as neighbours
+  irtkEMClassification2ndOrderMRFEStep background(estep, split());
+  background.SetBackground(true);
+  parallel_reduce(blocked_range<int>(_number_of_masked_voxels, (int)_voxel_index.size()), background);
+  estep.join(background);
+
+  if (W.size() == 0 && a.size() == 0) {
+    parallel_reduce(blocked_range<int>(0, _number_of_masked_voxels), estep);
+  } else {
+    // Red-black partition of the masked voxels
+    vector<int> colour[2];
+    X   = _input.GetX();
+    Y   = _input.GetY();
+    XY  = X * Y;
+    XYZ = XY * _input.GetZ();
+    for (i = 0; i < _number_of_masked_voxels; i++) {
+      idx = _voxel_index[i];
+      colour[(idx % X + (idx / X) % Y + (idx / XY) % _input.GetZ() + idx / XYZ) % 2].push_back(idx);
+    }
+    for (k = 0; k < 2; k++) {
+      if (colour[k].size() == 0) continue;
+      irtkEMClassification2ndOrderMRFEStep pass(estep, split());
+      pass.SetIndex(colour[k].data());
+      parallel_reduce(blocked_range<int>(0, (int)colour[k].size()), pass);
+      estep.join(pass);
+    }
+  }
 
-	      for (k = 0; k < _number_of_tissues; k++) {
-	    	temp = 0.5 * ( hm + hp ) * (G[k].Evaluate(x+hp)+G[k].Evaluate(x-hm));
-	        //temp = G[k].Evaluate(x);
-	        // MRF matrix fits number of tissues?
-	        if( bMRF )
-	        {
-	        	temp = temp * MRFenergies[k] / denominatorMRF;
-	        }
-	        else
-	        {
-	        	temp = temp * _atlas.GetValue(k);
-	        }
+  init.terminate();
 
-	        numerator[k] = temp;
-	        denominator += temp;
-	      }
-	      delete[] MRFenergies;
-
-	      for (k = 0; k < _number_of_tissues; k++) {
-	        if (denominator != 0) {
-	          double value = numerator[k]/denominator;
-	          _output.SetValue(k, value);
-	          if ((value < 0) || (value > 1)) {
-	            cerr << "Probability value out of range = " << value << endl;
-	            cerr << value << " " << k << " " << i << " " << _atlas.GetValue(k) <<  " " << _sigma[k] << endl;
-	            exit(1);
-	          }
-	        } else {
-	          cerr << "Division by 0 while computing probabilities" << endl;
-	          cerr<<"tissue="<<k;
-	          if (k==0) _output.SetValue(k, 1);
-	          else     _output.SetValue(k, 0);
-	        }
-	      }
-	    } else {
-	      for (k = 0; k < _number_of_tissues - 1; k++) {
-	        _output.SetValue(k, 0);
-	      }
-	      _output.SetValue(_number_of_tissues - 1, 1);
-	    }
-	    pm++;
-	    ptr++;
-	    _atlas.Next();
-	    _output.Next();
-	  }
-	  delete[] numerator;
-	  delete[] G;
+  if (estep._invalid > 0) {
+    cerr << "Probability value out of range in " << estep._invalid << " voxels" << endl;
+    exit(1);
+  }
+  if (estep._zero > 0) {
+    cerr << "Division by 0 while computing probabilities in " << estep._zero << " voxels" << endl;
+  }
 }
 
 void irtkEMClassification2ndOrderMRF::SetBiasField(irtkBiasField *biasfield)
@@ -1445,70 +1435,5 @@ double irtkEMClassification2ndOrderMRF::LogLikelihood()
 
 void irtkEMClassification2ndOrderMRF::EStep()
 {
-  int i, k;
-  double x;
-
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    G[k].Initialise( _mi[k], _sigma[k]);
-  }
-
-  _atlas.First();
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    double* gv = new double[_number_of_tissues];
-    double* numerator = new double[_number_of_tissues];
-    double denominator=0, temp=0;
-    if (*pm == 1) {
-      x = *ptr;
-	  double hp = 0.5;
-	  double hm = 0.5;
-	  if( _isLogTransformed )
-	  {
-			hp = log( exp(x)+0.5 ) - x;
-			hm = x - log( (exp(x) - 0.5) > 0 ? exp(x) - 0.5 : exp(x) );
-	  }
-      for (k = 0; k < _number_of_tissues; k++) {
-        temp = 0.5 * ( hm + hp ) * (G[k].Evaluate(x+hp)+G[k].Evaluate(x-hm));
-    	//temp = G[k].Evaluate(x);
-        gv[k] = temp;
-        temp = temp * _atlas.GetValue(k);
-        numerator[k] = temp;
-        denominator += temp;
-      }
-      for (k = 0; k < _number_of_tissues; k++) {
-        if (denominator != 0) {
-          double value = numerator[k]/denominator;
-          _output.SetValue(k, value);
-          if ((value < 0) || (value > 1)) {
-            cerr << "Probability value out of range = " << value << endl;
-            cerr << value << " " << k << " " << i << " " << _atlas.GetValue(k) <<  " " << _sigma[k] << endl;
-            exit(1);
-          }
-        } else {
-          cerr << "Division by 0 while computing probabilities" << endl;
-          cerr<<"tissue="<<k;
-          if (k==0) _output.SetValue(k, 1);
-          else     _output.SetValue(k, 0);
-        }
-      }
-    } else {
-      for (k = 0; k < _number_of_tissues - 1; k++) {
-        _output.SetValue(k, 0);
-      }
-      _output.SetValue(_number_of_tissues - 1, 1);
-    }
-    ptr++;
-    pm++;
-    _atlas.Next();
-    _output.Next();
-    delete[] gv;
-    delete[] numerator;
-  }
-  delete[] G;
-
+  this->EStepMRF(false, false);
 }
-
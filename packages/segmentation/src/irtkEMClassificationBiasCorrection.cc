@@ -48,129 +48,84 @@ void irtkEMClassificationBiasCorrection::SetInput(const irtkRealImage &image)
 
 void irtkEMClassificationBiasCorrection::BStep()
 {
-  int i;
+  int i, num;
   double scale = 1000;
-  irtkRealImage residual(_input);
-  irtkRealImage wresidual(_input);
+  double r, d, sum, mean;
   // Because of equal sigmas mask is just normalized version of weights
 
   cerr<<"Calculating bias ...";
 
-  //calculate residual image
+  // The buffers keep their memory from one iteration to the next
+  _residual.Initialize(_input.GetImageAttributes());
+  _blurred_weights = _weights;
+
+  //calculate weighted log residual
   irtkRealPixel *pi=_input.GetPointerToVoxels();
   irtkRealPixel *pw=_weights.GetPointerToVoxels();
   irtkRealPixel *pe=_estimate.GetPointerToVoxels();
   irtkRealPixel *pm=_mask.GetPointerToVoxels();
-  irtkRealPixel *pr=residual.GetPointerToVoxels();
-  irtkRealPixel *prw=wresidual.GetPointerToVoxels();
-
-  //_output.First();
-  //_atlas.First();
+  irtkRealPixel *pr=_residual.GetPointerToVoxels();
 
   for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    if ((*pm == 1)&&(*pi != _padding)) {
-      *pr=*pi / *pe;
-      *prw= (*pw) * log(*pr)*scale;
+    if ((pm[i] == 1)&&(pi[i] != _padding)) {
+      pr[i] = pw[i] * log(pi[i] / pe[i]) * scale;
     } else {
-      *pr=_padding;
-      *prw=_padding;
+      pr[i] = _padding;
     }
-    pi++;
-    pm++;
-    pw++;
-    pr++;
-    prw++;
-    pe++;
-    //_output.Next();
-    //_atlas.Next();
   }
-  residual.Write("residual.nii.gz");
-  wresidual.Write("wresidual.nii.gz");
-  _weights.Write("_weights.nii.gz");
-  _bias.Write("bias-start.nii.gz");
-  
-  irtkMultiChannelImage mch;
-  mch.AddImage(wresidual);
-  mch.AddImage(_weights);
-  mch.SetMask(_mask);
-  mch.SetPadding(0);
-  //mch.Log(0);
-  //mch.Log(1);
-  //mch.Write(0,"logresidual.nii.gz");
-  //mch.Write(1,"logweights.nii.gz");
+  if (_debug) {
+    _residual.Write("wresidual.nii.gz");
+    _weights.Write("_weights.nii.gz");
+    _bias.Write("bias-start.nii.gz");
+  }
 
-  _gb->SetInput(&mch.GetImage(0));
-  _gb->SetOutput(&mch.GetImage(0));
+  _gb->SetInput(&_residual);
+  _gb->SetOutput(&_residual);
   _gb->Run();
-  mch.Write(0,"wresidualblurred.nii.gz");
-  
-  _gb->SetInput(&mch.GetImage(1));
-  _gb->SetOutput(&mch.GetImage(1));
+
+  _gb->SetInput(&_blurred_weights);
+  _gb->SetOutput(&_blurred_weights);
   _gb->Run();
-  mch.Write(1,"weights-blurred.nii.gz");
-
-  //calculate weighted blurring of log residual
-  irtkRealImage res;
-  res = mch.Divide();
-  mch.SetImage(0,res);
-  mch.Write(0,"logresidualblurredweigted.nii.gz");
-
-  //Calculate bias
-  //mch.Brainmask();
-  _bias += mch.GetImage(0);
-  //_bias = mch.GetImage(0);
-  _bias.Write("bias.nii.gz");
-  mch.Write(0,"diffbias.nii.gz");
-  
-  //set the mean of the bias field to zero
+
+  if (_debug) {
+    _residual.Write("wresidualblurred.nii.gz");
+    _blurred_weights.Write("weights-blurred.nii.gz");
+  }
+
+  //calculate weighted blurring of log residual and update the bias
+  pr=_residual.GetPointerToVoxels();
   irtkRealPixel *pb=_bias.GetPointerToVoxels();
-  pi=_input.GetPointerToVoxels();
-  pm=_mask.GetPointerToVoxels();
-  double sum=0;
-  int num=0;
+  irtkRealPixel *pbw=_blurred_weights.GetPointerToVoxels();
+  sum=0;
+  num=0;
   for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    if ((*pm == 1)&&(*pi != _padding)) {
-      sum+=*pb;
+    r = pr[i];
+    if (r != 0) {
+      if (pbw[i] != 0) r /= pbw[i];
+    }
+    pr[i] = r;
+    pb[i] += r;
+    if ((pm[i] == 1)&&(pi[i] != _padding)) {
+      sum+=pb[i];
       num++;
-    } 
-    pi++;
-    pm++;
-    pb++;
+    }
   }
-  double mean = sum/num;
-  //irtkRealImage diffbias=mch.GetImage(0);
+  if (_debug) _bias.Write("bias.nii.gz");
 
-  irtkRealPixel *pd=mch.GetImage(0).GetPointerToVoxels();
-  pb=_bias.GetPointerToVoxels();
-  pi=_input.GetPointerToVoxels();
-  pm=_mask.GetPointerToVoxels();
+  //set the mean of the bias field to zero and correct the input
+  mean = sum/num;
   for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    //if ((*pm == 1)&&(*pi != _padding)) {
-      *pb-=mean;
-      *pd-=mean;
-    //} 
-    pi++;
-    pm++;
-    pb++;
-    pd++;
+    pb[i] -= mean;
+    d = pr[i] - mean;
+    if (d != 0) d = exp(d/scale);
+    if (pm[i] == 0) d = 0;
+    if ((pi[i] != 0) && (d != 0)) pi[i] /= d;
   }
   cerr<<"Adjusted mean of the bias "<<mean<<" to zero."<<endl;
-  _bias.Write("zerobias.nii.gz");
-  
-  
-  mch.Exp(0,1000);  
-  mch.Write(0,"residualblurredweigted.nii.gz");
-  mch.Brainmask();
-  mch.Write(0,"expbias.nii.gz");
-
-  //Correct input
-  mch.SetImage(1,mch.GetImage(0));
-  mch.SetImage(0,_input);
-  //mch.Exp(1,1);
-  mch.Write(0,"input.nii.gz");
-  //mch.Write(1,"biasexp.nii.gz");
-  _input=mch.Divide();
-  _input.Write("corrected.nii.gz");
+  if (_debug) {
+    _bias.Write("zerobias.nii.gz");
+    _input.Write("corrected.nii.gz");
+  }
   cerr<<"done."<<endl;
 }
 
@@ -341,8 +296,10 @@ void irtkEMClassificationBiasCorrection::BStepGD(int iteration)
     pi++;
   }
   
-  _input.Write("corrected.nii.gz");
-  _bias.Write("_bias.nii.gz");
+  if (_debug) {
+    _input.Write("corrected.nii.gz");
+    _bias.Write("_bias.nii.gz");
+  }
 
 //exit(1);
  
@@ -434,7 +391,7 @@ void irtkEMClassificationBiasCorrection::WStep()
     _output.Next();
     _atlas.Next();
   }
-  _estimate.Write("estimate.nii.gz");
+  if (_debug) _estimate.Write("estimate.nii.gz");
   //_weights.Write("_weights.nii.gz");
   //_weightsR.Write("_weightsR.nii.gz");
   //_weightsB.Write("_weightsB.nii.gz");
@@ -365,119 +365,70 @@ void irtkMeanShift::SetTreshold()
 
 int irtkMeanShift::Lcc(int label, bool add_second)
 {
- int i,j,k;
- int lcc_size = 0;
- int lcc2_size = 0;
- int lcc_x = 0, lcc_y = 0, lcc_z = 0, lcc2_x = 0, lcc2_y = 0, lcc2_z = 0;
-
- //cout<<"Finding Lcc"<<endl;
-  _map=_image;
-  //_image.Write("image.nii.gz");
+  int i, l, n, lcc, lcc2;
+  const int *labels;
+
+  irtkConnectedComponents<irtkGreyPixel> components(label, CONNECTIVITY_06);
+  components.SetInput(&_image);
+  components.SetOutput(&_map);
+  components.Run();
+
+  // Largest and second largest cluster
+  lcc = lcc2 = 0;
+  for (l = 1; l <= components.GetNumberOfComponents(); l++) {
+    if ((lcc == 0) || (components.GetComponent(l)._Size > components.GetComponent(lcc)._Size)) {
+      lcc2 = lcc;
+      lcc  = l;
+    } else if ((lcc2 == 0) || (components.GetComponent(l)._Size > components.GetComponent(lcc2)._Size)) {
+      lcc2 = l;
+    }
+  }
 
-  irtkGreyPixel* ptr=_map.GetPointerToVoxels();
-  int n = _image.GetNumberOfVoxels();
-  for(i=0;i<n;i++)
+  if ((add_second) && (lcc2 > 0) && (components.GetComponent(lcc2)._Size > 0.5*components.GetComponent(lcc)._Size))
   {
-    *ptr=0;
-    ptr++;
+    cout<<"Adding second largest cluster too. ";
+  } else {
+    lcc2 = 0;
   }
 
-  for (i=0; i<_image.GetX();i++)
-    for (j=0; j<_image.GetY();j++)
-      for (k=0; k<_image.GetZ();k++)
-      {
-        _clusterSize = 0;
-        if ((_map.Get(i,j,k)==0)&&(_image.Get(i,j,k)==label)) Grow(i,j,k,label);
-        if (_clusterSize > lcc_size)
-        {
-          lcc2_size = lcc_size;
-          lcc2_x = lcc_x;
-          lcc2_y = lcc_y;
-          lcc2_z = lcc_z;
-
-          lcc_size = _clusterSize;
-          lcc_x = i;
-          lcc_y = j;
-          lcc_z = k;
-        }
-      }
-
-  ptr=_map.GetPointerToVoxels();
+  labels = components.GetPointerToLabels();
+  irtkGreyPixel* ptr=_map.GetPointerToVoxels();
   n = _image.GetNumberOfVoxels();
   for(i=0;i<n;i++)
   {
-    *ptr=0;
-    ptr++;
-  }
-  
-  Grow(lcc_x,lcc_y,lcc_z,label);
-
-  if((add_second)&&(lcc2_size > 0.5*lcc_size))
-  {
-    cout<<"Adding second largest cluster too. ";
-    Grow(lcc2_x,lcc2_y,lcc2_z,label);
+    ptr[i] = ((labels[i] > 0) && ((labels[i] == lcc) || (labels[i] == lcc2))) ? 1 : 0;
   }
   //_map.Write("lcc.nii.gz");
   *_output = _map;
 
-  return lcc_size;
+  return (lcc > 0) ? components.GetComponent(lcc)._Size : 0;
 }
 
 int irtkMeanShift::LccS(int label, double treshold)
 {
- int i,j,k;
- int lcc_size = 0;
- int lcc_x, lcc_y, lcc_z;
- queue<irtkPoint> seed;
- queue<int> size;
+  int i, l, n, lcc_size;
+  const int *labels;
 
- //cout<<"Finding Lcc and all cluster of 70% of the size of Lcc"<<endl;
-  _map=_image;
-  //_image.Write("image.nii.gz");
+  irtkConnectedComponents<irtkGreyPixel> components(label, CONNECTIVITY_06);
+  components.SetInput(&_image);
+  components.SetOutput(&_map);
+  components.Run();
 
-  irtkGreyPixel* ptr=_map.GetPointerToVoxels();
-  int n = _image.GetNumberOfVoxels();
-  for(i=0;i<n;i++)
-  {
-    *ptr=0;
-    ptr++;
-  }
+  // Keep all clusters larger than treshold times the largest cluster
+  l = components.GetLargestComponent();
+  lcc_size = (l > 0) ? components.GetComponent(l)._Size : 0;
 
-  for (i=0; i<_image.GetX();i++)
-    for (j=0; j<_image.GetY();j++)
-      for (k=0; k<_image.GetZ();k++)
-      {
-        _clusterSize = 0;
-        if ((_map.Get(i,j,k)==0)&&(_image.Get(i,j,k)==label)) Grow(i,j,k,label);
-        if (_clusterSize > lcc_size)
-        {
-          lcc_size = _clusterSize;
-          lcc_x = i;
-          lcc_y = j;
-          lcc_z = k;
-        }
-
-        if (_clusterSize > 0)
-        {
-          size.push(_clusterSize);
-          irtkPoint p(i,j,k);
-          seed.push(p);
-        }
-      }
+  vector<bool> keep(components.GetNumberOfComponents() + 1, false);
+  for (l = 1; l <= components.GetNumberOfComponents(); l++) {
+    keep[l] = (components.GetComponent(l)._Size > treshold*lcc_size);
+  }
 
-  ptr=_map.GetPointerToVoxels();
+  labels = components.GetPointerToLabels();
+  irtkGreyPixel* ptr=_map.GetPointerToVoxels();
   n = _image.GetNumberOfVoxels();
   for(i=0;i<n;i++)
   {
-    *ptr=0;
-    ptr++;
-  }
-  
-  while (!size.empty())
-  {
-    if ( size.front()> treshold*lcc_size ) Grow(seed.front()._x,seed.front()._y,seed.front()._z,label);
-    seed.pop();
-    size.pop();
+    ptr[i] = keep[labels[i]] ? 1 : 0;
   }
   //_map.Write("lcc.nii.gz");
   *_output = _map;
@@ -602,12 +553,14 @@ void irtkMeanShift::RemoveBackground()
   irtkDilation<irtkGreyPixel> dilation;
   dilation.SetInput(_brain);
   dilation.SetOutput(_brain);
-  for (i = 0; i < iterations; i++) dilation.Run();
+  dilation.SetIterations(iterations);
+  dilation.Run();
 
   irtkErosion<irtkGreyPixel> erosion;
   erosion.SetInput(_brain);
   erosion.SetOutput(_brain);
-  for (i = 0; i < iterations; i++) erosion.Run();
+  erosion.SetIterations(iterations);
+  erosion.Run();
 
   cout<<"recalculating ... ";
 
@@ -649,7 +602,8 @@ void irtkMeanShift::RemoveBackground()
 
   erosion.SetInput(_brain);
   erosion.SetOutput(_brain);
-  for (i = 0; i < iterations; i++) erosion.Run();
+  erosion.SetIterations(iterations);
+  erosion.Run();
 
   cout<<"final recalculation ...";
 
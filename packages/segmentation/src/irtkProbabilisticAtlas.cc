@@ -18,6 +18,9 @@ irtkProbabilisticAtlas::irtkProbabilisticAtlas()
 {
   _number_of_voxels=0;
   _number_of_tissues=0;
+  _compressed=false;
+  _current=0;
+  _tiles_per_channel=0;
 }
 
 void irtkProbabilisticAtlas::ReplaceImage(int a, irtkRealImage image)
@@ -27,6 +30,7 @@ void irtkProbabilisticAtlas::ReplaceImage(int a, irtkRealImage image)
 		cerr << "cannot replace image, index out of bounds!" << endl;
 		return;
 	}
+	CheckUncompressed("ReplaceImage");
 	_images[a] = image;
 	_pointers[a] = _images[a].GetPointerToVoxels();
 }
@@ -38,6 +42,7 @@ void irtkProbabilisticAtlas::SwapImages(int a, int b)
 		cerr << "cannot swap images, index out of bounds!" << endl;
 		return;
 	}
+	CheckUncompressed("SwapImages");
 	irtkRealImage tmpimage = _images[a];
 	_images[a] = _images[b];
 	_images[b] = tmpimage;
@@ -48,6 +53,7 @@ void irtkProbabilisticAtlas::SwapImages(int a, int b)
 
 void irtkProbabilisticAtlas::AddImage(irtkRealImage image)
 {
+  CheckUncompressed("AddImage");
   if (_images.size() == 0) {
     _number_of_voxels = image.GetNumberOfVoxels();
   } else {
@@ -66,6 +72,8 @@ void irtkProbabilisticAtlas::NormalizeAtlas(irtkRealImage background)
   int i, j;
   irtkRealPixel norm;
 
+  CheckUncompressed("NormalizeAtlas");
+
   // Add extra image
   if (_number_of_tissues == 0) {
     cerr << "irtkProbabilisticAtlas::NormalizeAtlas: No probability maps found" << endl;
@@ -100,6 +108,8 @@ void irtkProbabilisticAtlas::NormalizeAtlas()
   int i, j;
   irtkRealPixel norm;
 
+  CheckUncompressed("NormalizeAtlas");
+
   // Add extra image
   if (_number_of_tissues == 0) {
     cerr << "irtkProbabilisticAtlas::NormalizeAtlas: No probability maps found" << endl;
@@ -133,6 +143,8 @@ void irtkProbabilisticAtlas::AddBackground()
   int i, j;
   irtkRealPixel norm, min, max;
 
+  CheckUncompressed("AddBackground");
+
   // Add extra image
   if (_number_of_tissues == 0) {
     cerr << "irtkProbabilisticAtlas::AddBackground: No probability maps found" << endl;
@@ -179,6 +191,12 @@ void irtkProbabilisticAtlas::AddProbabilityMaps(int n, irtkRealImage **atlas)
 void irtkProbabilisticAtlas::Write(int i, const char *filename)
 {
   if  (i < _number_of_tissues) {
+    if (_compressed) {
+      irtkRealImage image = GetImage(i);
+      image *= 255;
+      image.Write(filename);
+      return;
+    }
     _images[i] *= 255;
     _images[i].Write(filename);
     _images[i] /= 255;
@@ -193,7 +211,8 @@ irtkRealImage irtkProbabilisticAtlas::ComputeHardSegmentation()
   cerr<<"irtkProbabilisticAtlas::ComputeHardSegmentation"<<endl;
   int i, tissue, j=0;
   double max = 0;
-  _segmentation = _images[0];
+  if (_compressed) _segmentation.Initialize(_attr);
+  else _segmentation = _images[0];
   First();
   irtkRealPixel *ptr = _segmentation.GetPointerToVoxels();
 
@@ -244,7 +263,14 @@ irtkRealImage irtkProbabilisticAtlas::ComputeHardSegmentation()
 
 irtkRealImage irtkProbabilisticAtlas::GetImage(int i)
 {
-  return _images[i];
+  int j;
+
+  if (!_compressed) return _images[i];
+
+  irtkRealImage image(_attr);
+  irtkRealPixel *ptr = image.GetPointerToVoxels();
+  for (j = 0; j < _number_of_voxels; j++) ptr[j] = GetValueAtIndex(j, i);
+  return image;
 }
 
 void irtkProbabilisticAtlas::ExtractLabel(int label, irtkRealImage& image)
@@ -268,3 +294,78 @@ void irtkProbabilisticAtlas::WriteHardSegmentation(const char *filename)
 {
   _segmentation.Write(filename);
 }
+
+void irtkProbabilisticAtlas::Compress()
+{
+  int i, j, k, n, levels;
+  irtkRealPixel vmin, vmax, *ptr;
+
+  if (_compressed) return;
+  if (_number_of_tissues == 0) return;
+
+  _attr = _images[0].GetImageAttributes();
+  _tiles_per_channel = (_number_of_voxels + ATLASTILESIZE - 1) / ATLASTILESIZE;
+  _tiles.clear();
+  _tiles.resize(_number_of_tissues * _tiles_per_channel);
+  levels = 65535;
+
+  for (k = 0; k < _number_of_tissues; k++) {
+    ptr = _images[k].GetPointerToVoxels();
+    for (i = 0; i < _tiles_per_channel; i++) {
+      irtkProbabilisticAtlasTile &tile = _tiles[k * _tiles_per_channel + i];
+      n = min(ATLASTILESIZE, _number_of_voxels - i * ATLASTILESIZE);
+
+      vmin = vmax = ptr[0];
+      for (j = 1; j < n; j++) {
+        if (ptr[j] < vmin) vmin = ptr[j];
+        if (ptr[j] > vmax) vmax = ptr[j];
+      }
+      tile._offset = vmin;
+      tile._step   = (vmax - vmin) / levels;
+
+      // Constant tiles, e.g. outside the support of a prior, need no voxel data
+      if (vmax > vmin) {
+        tile._data.resize(n);
+        for (j = 0; j < n; j++) {
+          tile._data[j] = (unsigned short)round((ptr[j] - vmin) / tile._step);
+        }
+      }
+      ptr += n;
+    }
+
+    // Release the full probability map
+    _images[k].Clear();
+    _pointers[k] = NULL;
+  }
+  _compressed = true;
+}
+
+void irtkProbabilisticAtlas::Decompress()
+{
+  int i, k;
+  irtkRealPixel *ptr;
+
+  if (!_compressed) return;
+
+  for (k = 0; k < _number_of_tissues; k++) {
+    _images[k].Initialize(_attr);
+    ptr = _images[k].GetPointerToVoxels();
+    for (i = 0; i < _number_of_voxels; i++) ptr[i] = GetValueAtIndex(i, k);
+  }
+  _tiles.clear();
+  _compressed = false;
+
+  // Keep the position of the voxel iteration
+  for (k = 0; k < _number_of_tissues; k++) _pointers[k] = _images[k].GetPointerToVoxels() + _current;
+}
+
+long irtkProbabilisticAtlas::GetMemorySize() const
+{
+  unsigned int i;
+  long size = 0;
+
+  if (!_compressed) return (long)_number_of_tissues * _number_of_voxels * sizeof(irtkRealPixel);
+
+  for (i = 0; i < _tiles.size(); i++) size += sizeof(irtkProbabilisticAtlasTile) + _tiles[i]._data.size() * sizeof(unsigned short);
+  return size;
+}